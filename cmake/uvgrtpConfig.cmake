@@ -3,5 +3,10 @@ include(CMakeFindDependencyMacro)
 
 find_dependency(Threads)
 
+# uvgRTP built with the OpenSSL crypto backend links OpenSSL::Crypto
+if (@UVGRTP_USE_OPENSSL@)
+    find_dependency(OpenSSL 3.0)
+endif()
+
 include("${CMAKE_CURRENT_LIST_DIR}/uvgrtpTargets.cmake")
 include("${CMAKE_CURRENT_LIST_DIR}/uvgrtpMacros.cmake")
\ No newline at end of file
@@ -11,6 +11,7 @@ namespace uvgrtp {
 
     class session;
     class socketfactory;
+    class zrtp_key_pool;
 
     /**
      * \brief Provides CNAME isolation and can be used to create uvgrtp::session objects
@@ -86,6 +87,32 @@ namespace uvgrtp {
              */
             bool crypto_enabled() const;
 
+            /**
+             * \brief Keep precomputed ZRTP key pairs ready for the sessions of this context
+             *
+             * \details Generating the ephemeral key pair is the slowest step of a ZRTP handshake.
+             * When the pool is enabled, a low-priority background thread keeps "keys" fresh key pairs
+             * of each supported key agreement type ready, and ZRTP takes one from the pool instead of
+             * generating it during the handshake. Each key pair is used only once. If the pool is empty,
+             * the key pair is generated during the handshake as usual. The pool is disabled by default.
+             *
+             * \param keys Number of key pairs kept ready per key agreement type, 0 disables the pool
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK                On success
+             * \retval RTP_INVALID_VALUE     If "keys" is larger than 256
+             * \retval RTP_NOT_SUPPORTED     If uvgRTP was built without crypto
+             */
+            rtp_error_t set_zrtp_key_pool_size(size_t keys);
+
+            /**
+             * \brief Get the number of ZRTP key pairs kept ready per key agreement type
+             *
+             * \return Size set with set_zrtp_key_pool_size(), 0 if the pool is disabled
+             */
+            size_t get_zrtp_key_pool_size() const;
+
         private:
             /* Generate CNAME for participant using host and login names */
             std::string generate_cname() const;
@@ -93,6 +120,9 @@ namespace uvgrtp {
             /* CNAME is the same for all connections */
             std::string cname_;
             std::shared_ptr<uvgrtp::socketfactory> sfp_;
+
+            /* Precomputed ZRTP key pairs shared by the sessions */
+            std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool_;
         };
 }
 
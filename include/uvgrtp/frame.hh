@@ -43,7 +43,8 @@ namespace uvgrtp {
         };
 
         enum RTCP_RTPFB_FMT {
-            RTCP_RTPFB_NACK   = 1 /* Generic NACK, defined in RFC 4585 section 6.2 */
+            RTCP_RTPFB_NACK   = 1,  /* Generic NACK, defined in RFC 4585 section 6.2 */
+            RTCP_RTPFB_TWCC   = 15  /* Transport-wide congestion control feedback, defined in draft-holmer-rmcat-transport-wide-cc-extensions */
         };
 
         PACK(struct rtp_header {
@@ -64,12 +65,73 @@ namespace uvgrtp {
             uint8_t *data = nullptr;
         });
 
+        /** \brief How many RFC 8285 extension elements are stored from one packet */
+        constexpr size_t RTP_EXT_MAX_ELEMENTS = 8;
+
+        /** \brief How many bytes of RFC 8285 extension element data are stored from one packet */
+        constexpr size_t RTP_EXT_INLINE_SIZE = 64;
+
+        /** \brief RFC 8285 header extension element of a received packet */
+        struct rtp_ext_element {
+            /** \brief Local identifier of the element */
+            uint8_t id = 0;
+            /** \brief Length of the element data in bytes */
+            uint8_t len = 0;
+            /** \brief Offset of the element data in rtp_frame::ext_data */
+            uint8_t offset = 0;
+        };
+
+        /** \brief One NAL unit of a frame given to uvgrtp::media_stream::push_nal_units()
+         *
+         * \details The NAL unit starts with its NAL unit header, it must not be preceded by a start code */
+        struct nal_unit {
+            /** \brief First byte of the NAL unit header */
+            uint8_t *data = nullptr;
+            /** \brief Length of the NAL unit in bytes */
+            size_t len = 0;
+        };
+
+        /** \brief Part of a fragmented NAL unit given to the hook installed with uvgrtp::media_stream::install_nal_chunk_hook()
+         *
+         * \details The chunks of one NAL unit are given in order and without gaps */
+        struct nal_chunk {
+            /** \brief RTP timestamp of the NAL unit */
+            uint32_t timestamp = 0;
+            /** \brief Sequence number of the first fragment, identifies the NAL unit within its access unit */
+            uint16_t seq = 0;
+            /** \brief Position of the chunk in the NAL unit. If start codes are prepended, the first chunk begins with one */
+            size_t offset = 0;
+            /** \brief Data of the chunk, only valid during the call */
+            const uint8_t *data = nullptr;
+            /** \brief Length of the chunk in bytes */
+            size_t len = 0;
+            /** \brief One of ::RTP_NAL_CHUNK_STATE */
+            int state = RTP_NAL_CHUNK_PARTIAL;
+        };
+
+        /** \brief Location of one NAL unit in the payload of an access unit received with RCE_H26X_ACCESS_UNITS */
+        struct nal_location {
+            /** \brief Offset of the NAL unit header in rtp_frame::payload, the start code is before it */
+            size_t offset = 0;
+            /** \brief Length of the NAL unit in bytes without the start code */
+            size_t len = 0;
+        };
+
         /** \brief See <a href="https://www.rfc-editor.org/rfc/rfc3550#section-5" target="_blank">RFC 3550 section 5</a> */
         struct rtp_frame {
             struct rtp_header header;
             uint32_t *csrc = nullptr;
+
+            /** \brief Header extension that does not use the RFC 8285 format, nullptr otherwise */
             struct ext_header *ext = nullptr;
 
+            /** \brief Number of RFC 8285 header extension elements in ext_elements.
+             *
+             * \details Use get_header_extension() to find an element by its identifier */
+            size_t ext_count = 0;
+            rtp_ext_element ext_elements[RTP_EXT_MAX_ELEMENTS];
+            uint8_t ext_data[RTP_EXT_INLINE_SIZE];
+
             size_t padding_len = 0; /* non-zero if frame is padded */
 
             /** \brief Length of the packet payload in bytes added by uvgRTP to help process the frame
@@ -79,6 +141,11 @@ namespace uvgrtp {
             size_t payload_len = 0; 
             uint8_t* payload = nullptr;
 
+            /** \brief NAL units of the access unit in decoding order if RCE_H26X_ACCESS_UNITS is used, nullptr otherwise */
+            nal_location *nals = nullptr;
+            /** \brief Number of elements in nals */
+            size_t nal_count = 0;
+
             /// \cond DO_NOT_DOCUMENT
             uint8_t *dgram = nullptr;      /* pointer to the UDP datagram (for internal use only) */
             size_t   dgram_size = 0;       /* size of the UDP datagram */
@@ -194,6 +261,9 @@ namespace uvgrtp {
 
         /** \brief RTCP Feedback Control Information, See RFC 4585 section 6.1 */
         struct rtcp_fb_fci {
+            /// \cond DO_NOT_DOCUMENT
+            rtcp_fb_fci() : fir() {}
+            /// \endcond
 
             union {
                 rtcp_fir fir;
@@ -244,6 +314,19 @@ namespace uvgrtp {
          * Return RTP_INVALID_VALUE if "frame" is nullptr */
         rtp_error_t dealloc_frame(uvgrtp::frame::rtp_frame *frame);
 
+        /**
+         * \brief Find an RFC 8285 header extension element from a received frame
+         *
+         * \param frame Received RTP frame
+         * \param id Local identifier of the extension element
+         * \param len Length of the element data is written here
+         *
+         * \return Pointer to the element data, valid as long as the frame
+         *
+         * \retval nullptr If the frame does not have an element with identifier "id"
+         */
+        const uint8_t *get_header_extension(const uvgrtp::frame::rtp_frame *frame, uint8_t id, size_t *len);
+
 
         /* Allocate ZRTP frame
          * Parameter "payload_size" defines the length of the frame
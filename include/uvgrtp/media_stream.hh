@@ -7,6 +7,7 @@
 #include <string>
 #include <atomic>
 #include <cstdint>
+#include <functional>
 
 #ifndef _WIN32
 #include <sys/socket.h>
@@ -24,6 +25,10 @@ namespace uvgrtp {
     class base_srtp;
     class srtp;
     class srtcp;
+    class fec;
+    class header_extensions;
+    class transport_cc;
+    class jitter_buffer;
 
     class reception_flow;
     class holepuncher;
@@ -33,6 +38,8 @@ namespace uvgrtp {
 
     namespace frame {
         struct rtp_frame;
+        struct nal_unit;
+        struct nal_chunk;
     }
 
     namespace formats {
@@ -291,6 +298,124 @@ namespace uvgrtp {
              */
             rtp_error_t push_frame(std::unique_ptr<uint8_t[]> data, size_t data_len, uint32_t ts, uint64_t ntp_ts, int rtp_flags);
 
+            /**
+             * \brief Send a frame that has already been split into NAL units
+             *
+             * \details The NAL units are packetized directly from the buffers given by the application
+             * so they do not need to be in one contiguous Annex B buffer and no start code lookup is done.
+             * NAL units are aggregated and fragmented the same way as with push_frame() and all of them
+             * share the same RTP timestamp.
+             *
+             * Only H.264, H.265 and H.266 streams support this. uvgRTP does not take ownership
+             * of the memory and the NAL units have been sent when the call returns so the
+             * buffers can be reused after that. ::RTP_COPY has no effect.
+             *
+             * \param nals Array of NAL units without start codes, in decoding order
+             * \param count Number of NAL units in nals
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If nals is empty or one of the NAL units is empty
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream does not consist of NAL units
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_nal_units(const uvgrtp::frame::nal_unit *nals, size_t count, int rtp_flags);
+
+            /**
+             * \brief Send a frame that has already been split into NAL units with a custom timestamp
+             *
+             * \details Same as push_nal_units(const uvgrtp::frame::nal_unit *, size_t, int) but the
+             * RTP timestamp is provided by the application.
+             *
+             * \param nals Array of NAL units without start codes, in decoding order
+             * \param count Number of NAL units in nals
+             * \param ts 32-bit timestamp value for the frame
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If nals is empty or one of the NAL units is empty
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream does not consist of NAL units
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the data to remote
+             * \retval  RTP_GENERIC_ERROR If an unspecified error occurred
+             */
+            rtp_error_t push_nal_units(const uvgrtp::frame::nal_unit *nals, size_t count, uint32_t ts, int rtp_flags);
+
+            /**
+             * \brief Start a frame that is sent slice by slice while the encoder is still producing it
+             *
+             * \details After this call, the slices of the frame are given to push_slice() as soon as
+             * the encoder has finished them and end_frame() is called after the last one. All slices
+             * share the same RTP timestamp and the marker bit is set in the last packet of the frame.
+             *
+             * Each slice is sent right away except its last packet, because only end_frame() tells
+             * which slice is the last one. uvgRTP holds back that packet and sends it when the next
+             * slice or end_frame() arrives. Other push functions must not be called between
+             * begin_frame() and end_frame().
+             *
+             * Only H.264, H.265 and H.266 streams support this.
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream does not consist of NAL units
+             * \retval  RTP_GENERIC_ERROR If the stream cannot send
+             */
+            rtp_error_t begin_frame();
+
+            /**
+             * \brief Start a frame that is sent slice by slice with a custom timestamp
+             *
+             * \details Same as begin_frame() but the RTP timestamp of the frame is provided by the application.
+             *
+             * \param ts 32-bit timestamp value for the frame
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_NOT_SUPPORTED If the media format of the stream does not consist of NAL units
+             * \retval  RTP_GENERIC_ERROR If the stream cannot send
+             */
+            rtp_error_t begin_frame(uint32_t ts);
+
+            /**
+             * \brief Send the next slice of the frame started with begin_frame()
+             *
+             * \details The slice may contain one or more NAL units in Annex B format, or a single NAL unit
+             * without a start code if ::RTP_NO_H26X_SCL is given. NAL units are aggregated and fragmented
+             * the same way as with push_frame(). The packets of the slice are sent before the call
+             * returns except the last one, whose payload uvgRTP copies, so the buffer can be reused
+             * when the call returns.
+             *
+             * \param data Pointer to the slice
+             * \param data_len Length of the slice
+             * \param rtp_flags Optional flags, see ::RTP_FLAGS for more details
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If the slice is empty
+             * \retval  RTP_NOT_READY     If begin_frame() has not been called
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the slice
+             */
+            rtp_error_t push_slice(uint8_t *data, size_t data_len, int rtp_flags);
+
+            /**
+             * \brief Send the last packet of the frame with the marker bit set
+             *
+             * \return RTP error code
+             *
+             * \retval  RTP_OK            On success
+             * \retval  RTP_INVALID_VALUE If no slices were pushed after begin_frame()
+             * \retval  RTP_NOT_READY     If begin_frame() has not been called
+             * \retval  RTP_SEND_ERROR    If uvgRTP failed to send the packet
+             */
+            rtp_error_t end_frame();
+
             // Disabled for now
             //rtp_error_t push_user_packet(uint8_t* data, uint32_t len);
             //rtp_error_t install_user_receive_hook(void* arg, void (*hook)(void*, uint8_t* data, uint32_t len));
@@ -337,6 +462,30 @@ namespace uvgrtp {
              * \retval RTP_INVALID_VALUE If hook is nullptr */
             rtp_error_t install_receive_hook(void *arg, void (*hook)(void *, uvgrtp::frame::rtp_frame *));
 
+            /**
+             * \brief Receive fragmented H.264/H.265/H.266 NAL units progressively
+             *
+             * \details Instead of waiting until every fragment of a NAL unit has arrived, uvgRTP gives the part
+             * of the NAL unit received in order to the hook whenever it has grown by RCC_NAL_CHUNK_SIZE bytes.
+             * This lets a decoder start on the beginning of a large picture while the rest of it is still arriving.
+             *
+             * The last chunk of a NAL unit has the state ::RTP_NAL_CHUNK_COMPLETE. If the rest of the NAL unit is
+             * lost, the hook is called once more with ::RTP_NAL_CHUNK_LOST. Fragmented NAL units are then only given
+             * to this hook, NAL units that fit in one packet are still returned by pull_frame() and the receive hook.
+             *
+             * The hook is called from the reception thread and must not block. The data of the chunk is
+             * only valid during the call.
+             *
+             * \param hook Function receiving the chunks
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             * \retval RTP_NOT_SUPPORTED If the stream does not carry NAL units or RCE_H26X_ACCESS_UNITS has been enabled
+             * \retval RTP_NOT_INITIALIZED If the media stream has not been initialized */
+            rtp_error_t install_nal_chunk_hook(std::function<void(const uvgrtp::frame::nal_chunk&)> hook);
+
             /**
              * \brief Configure the media stream, see ::RTP_CTX_CONFIGURATION_FLAGS for more details
              *
@@ -358,6 +507,91 @@ namespace uvgrtp {
              */
             int get_configuration_value(int rcc_flag);
 
+            /**
+             * \brief Add an RFC 8285 header extension to every outgoing RTP packet
+             *
+             * \details uvgRTP generates the contents of the transport-wide sequence number,
+             * absolute send time and frame marking extensions. The contents of other
+             * extensions are set with set_header_extension_data(). The one-byte header
+             * form is used when all elements fit it and the two-byte form otherwise.
+             *
+             * The space for the extensions is reserved from the payload of each packet.
+             *
+             * \param type Type of the extension, see ::RTP_HEADER_EXTENSION
+             * \param id Local identifier of the extension, 1-14 for the one-byte form and 1-255 for the two-byte form
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If type or id is invalid or id is already in use
+             */
+            rtp_error_t register_header_extension(int type, uint8_t id);
+
+            /**
+             * \brief Set the contents of a registered header extension
+             *
+             * \details The contents are added to every packet sent after this call.
+             * Setting the length to 0 stops sending the extension.
+             *
+             * \param id Local identifier of the extension
+             * \param data Contents of the extension
+             * \param len Length of the contents, at most 16 bytes for the one-byte form and 255 bytes for the two-byte form
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If len is invalid
+             * \retval RTP_NOT_FOUND If id has not been registered
+             * \retval RTP_NOT_SUPPORTED If the contents of the extension are generated by uvgRTP
+             */
+            rtp_error_t set_header_extension_data(uint8_t id, uint8_t *data, size_t len);
+
+            /**
+             * \brief Install a function that is called when the target bitrate of the congestion controller changes
+             *
+             * \details The application should adjust the bitrate of its encoder to the target.
+             * The function is called from the RTCP reception thread and must not block.
+             *
+             * \param hook Function receiving the new target bitrate in bits per second
+             *
+             * \return RTP error code
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             * \retval RTP_NOT_INITIALIZED If RCE_TRANSPORT_CC has not been enabled
+             */
+            rtp_error_t install_target_bitrate_hook(std::function<void(uint32_t)> hook);
+
+            /**
+             * \brief Get the current target bitrate of the congestion controller
+             *
+             * \return Target bitrate in bits per second, 0 if RCE_TRANSPORT_CC has not been enabled
+             */
+            uint32_t get_target_bitrate() const;
+
+            /**
+             * \brief Get the number of payload bytes dropped by the sender to stay within RCC_SEND_LATENCY_BUDGET
+             *
+             * \details NAL units are dropped lowest priority first and only if no NAL unit
+             * sent later depends on them. Parameter sets and intra pictures are never dropped.
+             *
+             * \param priority Priority class of the dropped data, see RTP_NAL_PRIORITY
+             *
+             * \return Number of bytes dropped, 0 if "priority" is invalid
+             */
+            uint64_t get_shed_bytes(int priority) const;
+
+            /**
+             * \brief Get the number of received frames that were discarded incomplete
+             *
+             * \details A frame is discarded if some of its packets have not arrived within
+             * RCC_PKT_MAX_DELAY milliseconds. Only frames that are reassembled from several
+             * packets, H26x fragmentation units and RCE_FRAGMENT_GENERIC frames, are counted.
+             *
+             * \return Number of discarded frames
+             */
+            uint64_t get_lost_frames() const;
+
             /// \cond DO_NOT_DOCUMENT
 
             /* Get unique key of the media stream
@@ -406,6 +640,9 @@ namespace uvgrtp {
 
             rtp_error_t install_packet_handlers();
 
+            /* Keep the packets within MTU when the size of the header extensions changes */
+            void update_header_extension_size(size_t old_size);
+
             uint32_t get_default_bandwidth_kbps(rtp_format_t fmt);
 
             bool check_pull_preconditions();
@@ -423,6 +660,10 @@ namespace uvgrtp {
             std::shared_ptr<uvgrtp::rtp>    rtp_;
             std::shared_ptr<uvgrtp::rtcp>   rtcp_;
             std::shared_ptr<uvgrtp::zrtp>   zrtp_;
+            std::shared_ptr<uvgrtp::fec>    fec_;
+            std::shared_ptr<uvgrtp::header_extensions> header_ext_;
+            std::shared_ptr<uvgrtp::transport_cc> tcc_;
+            std::shared_ptr<uvgrtp::jitter_buffer> jitter_buffer_;
 
             std::shared_ptr<uvgrtp::socketfactory> sfp_;
 
@@ -458,9 +699,19 @@ namespace uvgrtp {
             ssize_t pace_numerator_ = 8;
             ssize_t pace_denominator_ = 10;
             uint32_t bandwidth_ = 0;
+            ssize_t latency_budget_ = 0;
+            size_t parallel_scl_threshold_ = 0;
+            size_t parameter_set_interval_ = 0;
+            size_t nal_chunk_size_ = 0;
+
+            // RTP timestamp given to begin_frame(), shared by the slices of the frame. UINT64_MAX if not given
+            uint64_t slice_frame_ts_ = UINT64_MAX;
             std::shared_ptr<std::atomic<std::uint32_t>> ssrc_;
             std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc_;
 
+            // SSRC of the repair packets of the remote stream, 0 if not set
+            uint32_t remote_fec_ssrc_ = 0;
+
             // Save values associated with context flags, to be returned with get_configuration_value
             // Values are initialized to -2, which means value not set
             int snd_buf_size_;
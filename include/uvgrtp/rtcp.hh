@@ -28,6 +28,7 @@ namespace uvgrtp {
     class socket;
     class socketfactory;
     class rtcp_reader;
+    class transport_cc;
 
     typedef std::vector<std::pair<size_t, uint8_t*>> buf_vec; // also defined in socket.hh
 
@@ -196,6 +197,38 @@ namespace uvgrtp {
              */
             rtp_error_t send_bye_packet(std::vector<uint32_t> ssrcs);
 
+            /**
+             * \brief Send an RTCP Picture Loss Indication
+             *
+             * \details The PLI tells the sender of "media_ssrc" that the decoder has lost
+             * pictures and needs a keyframe to recover. Unlike the other packets, the PLI is
+             * sent immediately in its own compound packet instead of the next report.
+             *
+             * See <a href="https://www.rfc-editor.org/rfc/rfc4585#section-6.3.1" target="_blank">RFC 4585 section 6.3.1</a>
+             *
+             * \param media_ssrc SSRC of the media source that should send a keyframe
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_GENERIC_ERROR If sending fails
+             */
+            rtp_error_t send_pli_packet(uint32_t media_ssrc);
+
+            /**
+             * \brief Send an RTCP Full Intra Request
+             *
+             * \details The FIR asks the sender of "media_ssrc" to send a keyframe.
+             * Each call is a new request and carries a new sequence number. Like the PLI,
+             * the FIR is sent immediately.
+             *
+             * See <a href="https://www.rfc-editor.org/rfc/rfc5104#section-4.3.1" target="_blank">RFC 5104 section 4.3.1</a>
+             *
+             * \param media_ssrc SSRC of the media source that should send a keyframe
+             *
+             * \retval RTP_OK On success
+             * \retval RTP_GENERIC_ERROR If sending fails
+             */
+            rtp_error_t send_fir_packet(uint32_t media_ssrc);
+
             /// \cond DO_NOT_DOCUMENT
             /* Return the latest RTCP packet received from participant of "ssrc"
              * Return nullptr if we haven't received this kind of packet or if "ssrc" doesn't exist
@@ -253,6 +286,10 @@ namespace uvgrtp {
 
             /* Return SSRCs of all participants */
             std::vector<uint32_t> get_participants() const;
+
+            /* Return the interarrival jitter of participant "ssrc" in RTP timestamp units
+             * Return a negative value if "ssrc" is not a participant */
+            double get_jitter(uint32_t ssrc) const;
             /// \endcond
 
             /**
@@ -371,6 +408,21 @@ namespace uvgrtp {
              */
             rtp_error_t install_app_hook(std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>)> app_handler);
 
+            /**
+             * \brief Install a keyframe request hook
+             *
+             * \details This function is called when a remote participant asks us to send a
+             * keyframe with a Picture Loss Indication or a Full Intra Request. The encoder should
+             * then encode the next picture as a keyframe. Retransmitted FIRs do not call the hook
+             * again. The received feedback packet is still passed on like any other feedback packet.
+             *
+             * \param kf_handler C++ function pointer to the hook, called with the SSRC of the requester
+             *
+             * \retval RTP_OK on success
+             * \retval RTP_INVALID_VALUE If hook is nullptr
+             */
+            rtp_error_t install_keyframe_request_hook(std::function<void(uint32_t)> kf_handler);
+
             /// \cond DO_NOT_DOCUMENT
             // These have been replaced by functions with unique_ptr in them
             rtp_error_t install_sender_hook(std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_sender_report>)> sr_handler);
@@ -425,6 +477,30 @@ namespace uvgrtp {
             size_t rtcp_length_in_bytes(uint16_t length);
 
             void set_payload_size(size_t mtu_size);
+
+            /* Send transport-wide feedback of received packets and pass
+             * the received feedback to the congestion controller */
+            void set_transport_cc(std::shared_ptr<uvgrtp::transport_cc> tcc);
+
+            /* Ask the sender of "media_ssrc" for a keyframe with the configured feedback message.
+             * A request is sent at most once per request interval or round-trip time,
+             * whichever is longer, as an earlier request is most likely still being answered
+             *
+             * Return RTP_OK if the request was sent
+             * Return RTP_NOT_READY if the previous request was sent too recently */
+            rtp_error_t request_keyframe(uint32_t media_ssrc);
+
+            /* Return RTP_INVALID_VALUE if "type" is not ::RTCP_PSFB_PLI or ::RTCP_PSFB_FIR */
+            rtp_error_t set_keyframe_request_type(int type);
+            void set_keyframe_request_interval(uint32_t ms);
+
+            int get_keyframe_request_type() const;
+            uint32_t get_keyframe_request_interval() const;
+
+            /* Return the round-trip time to the remote participants in milliseconds,
+             * calculated from the report blocks about our stream
+             * Return 0 if it is not known yet */
+            uint32_t get_rtt() const;
             /// \endcond
 
         private:
@@ -437,6 +513,18 @@ namespace uvgrtp {
             uint32_t size_of_compound_packet(uint16_t reports,
                 bool sr_packet, bool rr_packet, bool sdes_packet, uint32_t app_size, bool bye_packet) const;
 
+            /* Send an empty receiver report followed by a transport-wide feedback message about "media_ssrc" */
+            rtp_error_t send_transport_feedback(uint32_t media_ssrc);
+
+            /* Send an empty receiver report followed by a PLI or a FIR about "media_ssrc" */
+            rtp_error_t send_psfb_packet(uvgrtp::frame::RTCP_PSFB_FMT fmt, uint32_t media_ssrc);
+
+            /* Update the round-trip time from the report blocks about our stream, see RFC 3550 section 6.4.1 */
+            void update_rtt(const std::vector<uvgrtp::frame::rtcp_report_block>& reports);
+
+            /* Call the keyframe request hook unless the request is a retransmitted FIR */
+            void handle_keyframe_request(uvgrtp::frame::RTCP_PSFB_FMT fmt, uint32_t requester, uint8_t fir_seq);
+
             /* read the header values from rtcp packet */
             void read_rtcp_header(const uint8_t* buffer, size_t& read_ptr, 
                 uvgrtp::frame::rtcp_header& header);
@@ -649,12 +737,14 @@ namespace uvgrtp {
             std::function<void(std::shared_ptr<uvgrtp::frame::rtcp_app_packet>)>      app_hook_f_;
             std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_app_packet>)>      app_hook_u_;
             std::function<void(std::unique_ptr<uvgrtp::frame::rtcp_fb_packet>)>       fb_hook_u_;
+            std::function<void(uint32_t)>                                             kf_hook_;
 
             std::mutex sr_mutex_;
             std::mutex rr_mutex_;
             std::mutex sdes_mutex_;
             std::mutex app_mutex_;
             std::mutex fb_mutex_;
+            std::mutex kf_mutex_;
             mutable std::mutex participants_mutex_;
 			std::mutex send_app_mutex_;
 
@@ -662,6 +752,20 @@ namespace uvgrtp {
             std::shared_ptr<uvgrtp::socket> rtcp_socket_;
             std::shared_ptr<uvgrtp::socketfactory> sfp_;
             std::shared_ptr<uvgrtp::rtcp_reader> rtcp_reader_;
+            std::shared_ptr<uvgrtp::transport_cc> tcc_;
+
+            /* Keyframe requests, both sent and received */
+            std::atomic<int> kf_request_type_;
+            std::atomic<uint32_t> kf_request_interval_ms_;
+            uvgrtp::clock::hrc::hrc_t last_kf_request_;
+            bool kf_requested_;
+            std::mutex kf_request_mutex_;
+            std::atomic<uint8_t> fir_seq_;
+
+            /* The last FIR sequence number of each requester, a repeated number is a retransmission */
+            std::map<uint32_t, uint8_t> received_fir_seqs_;
+
+            std::atomic<uint32_t> rtt_ms_;
 
             bool is_active() const
             {
@@ -13,6 +13,7 @@ namespace uvgrtp {
     class media_stream;
     class zrtp;
     class socketfactory;
+    class zrtp_key_pool;
 
     /** \brief Provides ZRTP synchronization and can be used to create uvgrtp::media_stream objects
      *
@@ -27,8 +28,10 @@ namespace uvgrtp {
     class session {
         public:
             /// \cond DO_NOT_DOCUMENT
-            session(std::string cname, std::string addr, std::shared_ptr<uvgrtp::socketfactory> sfp);
-            session(std::string cname, std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::socketfactory> sfp);
+            session(std::string cname, std::string addr, std::shared_ptr<uvgrtp::socketfactory> sfp,
+                std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool);
+            session(std::string cname, std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::socketfactory> sfp,
+                std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool);
             ~session();
             /// \endcond
 
@@ -125,6 +128,9 @@ namespace uvgrtp {
 
             std::string cname_;
             std::shared_ptr<uvgrtp::socketfactory> sf_;
+
+            /* Precomputed ZRTP key pairs shared by all sessions of the context */
+            std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool_;
     };
 }
 
@@ -267,9 +267,61 @@ enum RTP_CTX_ENABLE_FLAGS {
 
     /** Use a single UDP port for both RTP and RTCP transmission (default RTCP port is +1) **/
     RCE_RTCP_MUX                    = 1 << 21,
-    
+
+    /** Protect the stream with FlexFEC (RFC 8627) forward error correction. Must be given
+     * to both sender and receiver. The sender adds XOR repair packets over rows and columns
+     * of media packets and the receiver uses them to recover lost packets without retransmissions.
+     * See RCC_FEC_ROW_LENGTH and RCC_FEC_COLUMN_DEPTH. Not supported together with RCE_SRTP */
+    RCE_FEC                         = 1 << 22,
+
+    /** Enable transport-wide congestion control. The receiver reports the arrival times of the
+     * packets in RTCP transport-wide feedback messages and the sender estimates the available
+     * bandwidth from them, paces the outgoing packets to it and reports the target bitrate with
+     * uvgrtp::media_stream::install_target_bitrate_hook(). Both sides must register
+     * RTP_EXT_TRANSPORT_WIDE_SEQ with the same identifier. Requires RCE_RTCP */
+    RCE_TRANSPORT_CC                = 1 << 23,
+
+    /** Deliver received H26x streams one access unit at a time. All NAL units with the same
+     * timestamp are collected into a single frame with a start code before each NAL unit and
+     * the offsets of the NAL units are listed in uvgrtp::frame::rtp_frame::nals. The access unit
+     * is delivered when the packet with the marker bit and all packets before it have been received
+     * or when it has waited longer than RCC_PKT_MAX_DELAY */
+    RCE_H26X_ACCESS_UNITS           = 1 << 24,
+
+    /** Pass received frames through a jitter buffer. The frames are reordered by their RTP
+     * timestamp and sequence number and delivered at a steady pace derived from their timestamps.
+     * The playout delay adapts to the interarrival jitter, see RCC_JITTER_BUFFER_MIN_DELAY,
+     * RCC_JITTER_BUFFER_MAX_DELAY and RCC_JITTER_BUFFER_LATE_POLICY */
+    RCE_JITTER_BUFFER               = 1 << 25,
+
+    /** Cache the latest H26x parameter sets (VPS, SPS and PPS) at both ends of the stream.
+     *
+     * The sender inserts the cached parameter sets in front of every intra picture that does not
+     * carry them itself and, if RCC_PARAMETER_SET_INTERVAL is set, in front of the next frame once
+     * the interval has passed. With RCE_H26X_ACCESS_UNITS, the receiver inserts the parameter sets
+     * it has received but not delivered in front of the first intra picture it delivers, so a receiver
+     * joining mid-stream can start decoding from the first intra picture */
+    RCE_H26X_PARAMETER_SETS         = 1 << 26,
+
+    /** Ask the sender for a keyframe with an RTCP Picture Loss Indication or Full Intra Request
+     * whenever the H26x depacketizer drops a frame, either because its packets were lost or because
+     * it depends on a dropped frame (RCE_H26X_DEPENDENCY_ENFORCEMENT). The requests are rate limited,
+     * see RCC_KEYFRAME_REQUEST_INTERVAL and RCC_KEYFRAME_REQUEST_TYPE. Requires RCE_RTCP.
+     *
+     * The sender is notified of received requests with uvgrtp::rtcp::install_keyframe_request_hook() */
+    RCE_H26X_KEYFRAME_REQUESTS      = 1 << 27,
+
+    /** Protect SRTP and SRTCP packets with AEAD_AES_128_GCM, or AEAD_AES_256_GCM together with
+     * RCE_SRTP_KEYSIZE_256, instead of AES-CM and HMAC-SHA1 (RFC 7714). Every packet is encrypted
+     * and authenticated in one pass and carries a 16-byte authentication tag, so RCE_SRTP_NULL_CIPHER
+     * and RCE_SRTP_AUTHENTICATE_RTP have no effect. The master salt is the first 12 bytes of the salt.
+     * Keys negotiated with ZRTP are used with AEAD_AES_128_GCM. Both participants must set this flag.
+     *
+     * NOTE: this flag must be coupled with at least RCE_SRTP */
+    RCE_SRTP_AEAD_GCM               = 1 << 28,
+
     /// \cond DO_NOT_DOCUMENT
-    RCE_LAST                        = 1 << 22
+    RCE_LAST                        = 1 << 29
    /// \endcond
 }; // maximum is 1 << 30 for int
 
@@ -315,7 +367,7 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
      * Default is 500 milliseconds
      *
      * This is valid only for fragmented frames,
-     * i.e. RTP_FORMAT_H26X and RTP_FORMAT_GENERIC with RCE_FRAGMENT_GENERIC (TODO) */
+     * i.e. RTP_FORMAT_H26X and RTP_FORMAT_GENERIC with RCE_FRAGMENT_GENERIC */
     RCC_PKT_MAX_DELAY    = 4,
 
     /** Change uvgRTP's default payload number in RTP header */
@@ -411,9 +463,238 @@ enum RTP_CTX_CONFIGURATION_FLAGS {
     */
     RCC_PACE_FRAG_DENOMINATOR  = 17,
 
+    /** Set how many consecutive packets are protected by one FEC row repair packet
+    *
+    * Default is 10, i.e. 10 % overhead. 0 disables row protection.
+    *
+    * Row protection can recover one lost packet per row. Valid only with RCE_FEC
+    */
+    RCC_FEC_ROW_LENGTH = 18,
+
+    /** Set how many packets are protected by one FEC column repair packet
+    *
+    * Default is 0 (disabled). Columns consist of packets spaced RCC_FEC_ROW_LENGTH
+    * packets apart so that burst losses of up to row length packets can be recovered.
+    * (depth - 1) * row length must be smaller than 110. Valid only with RCE_FEC
+    */
+    RCC_FEC_COLUMN_DEPTH = 19,
+
+    /** Set the payload type of the FEC repair packets
+    *
+    * Default is 110. Must differ from the payload type of the media. Valid only with RCE_FEC
+    */
+    RCC_FEC_PAYLOAD_TYPE = 20,
+
+    /** Set the lowest target bitrate of the congestion controller in kbps
+    *
+    * Default is 30. Valid only with RCE_TRANSPORT_CC
+    */
+    RCC_TWCC_MIN_BITRATE = 21,
+
+    /** Set the target bitrate the congestion controller starts from in kbps
+    *
+    * Default is 1000. Valid only with RCE_TRANSPORT_CC
+    */
+    RCC_TWCC_START_BITRATE = 22,
+
+    /** Set the highest target bitrate of the congestion controller in kbps
+    *
+    * Default is 50000. Valid only with RCE_TRANSPORT_CC
+    */
+    RCC_TWCC_MAX_BITRATE = 23,
+
+    /** Set the latency budget of sending one frame in milliseconds
+    *
+    * If delivering an H.264/H.265/H.266 frame at the target bitrate of the congestion controller
+    * would take longer than the budget, the least important NAL units are shed, see ::RTP_NAL_PRIORITY.
+    * Once packets of a frame sent slice by slice have left, its last NAL unit is not shed so that
+    * the marker bit still ends the frame. Default is 0 (disabled). Valid only with RCE_TRANSPORT_CC
+    */
+    RCC_SEND_LATENCY_BUDGET = 24,
+
+    /** Search H.264/H.265/H.266 frames larger than this many bytes for start codes using several threads
+    *
+    * The frame is split into chunks that are searched concurrently by a thread pool shared by all
+    * media streams, which reduces the time before the first packet of a very large frame is sent.
+    * Default is 0 (disabled)
+    */
+    RCC_PARALLEL_SCL_THRESHOLD = 25,
+
+    /** Set the smallest playout delay of the jitter buffer in milliseconds
+    *
+    * Default is 10. Valid only with RCE_JITTER_BUFFER
+    */
+    RCC_JITTER_BUFFER_MIN_DELAY = 26,
+
+    /** Set the largest playout delay of the jitter buffer in milliseconds
+    *
+    * The delay adapts to the interarrival jitter between the smallest and the largest delay.
+    * Default is 200. Valid only with RCE_JITTER_BUFFER
+    */
+    RCC_JITTER_BUFFER_MAX_DELAY = 27,
+
+    /** Set what the jitter buffer does with frames that arrive after a later frame has already
+    * been delivered, see ::RTP_JITTER_LATE_POLICY
+    *
+    * Default is RTP_JITTER_DROP_LATE. Valid only with RCE_JITTER_BUFFER
+    */
+    RCC_JITTER_BUFFER_LATE_POLICY = 28,
+
+    /** Send the cached parameter sets at least this often, in milliseconds
+    *
+    * The parameter sets are sent in front of the first frame after the interval has passed.
+    * Default is 0, which sends them only in front of intra pictures. Valid only with RCE_H26X_PARAMETER_SETS
+    */
+    RCC_PARAMETER_SET_INTERVAL = 29,
+
+    /** The shortest time between two keyframe requests, in milliseconds
+    *
+    * A request is not repeated within one round-trip time either, if it is known from the RTCP reports.
+    * Default is 200 ms. Valid only with RCE_H26X_KEYFRAME_REQUESTS
+    */
+    RCC_KEYFRAME_REQUEST_INTERVAL = 30,
+
+    /** The feedback message used to request keyframes, either uvgrtp::frame::RTCP_PSFB_PLI
+    * or uvgrtp::frame::RTCP_PSFB_FIR
+    *
+    * Default is uvgrtp::frame::RTCP_PSFB_PLI. Valid only with RCE_H26X_KEYFRAME_REQUESTS
+    */
+    RCC_KEYFRAME_REQUEST_TYPE = 31,
+
+    /** Give a fragmented NAL unit to the hook installed with uvgrtp::media_stream::install_nal_chunk_hook()
+    * once at least this many new bytes of it have been received in order
+    *
+    * Default is 0, which calls the hook every time the part received in order grows
+    */
+    RCC_NAL_CHUNK_SIZE = 32,
+
+    /** Size of the SRTP and SRTCP replay window in packets, see RFC 3711 section 3.3.2
+    *
+    * Must be a power of two between 64 and 1024. Packets older than the window are discarded.
+    * Default is 64. Valid only with RCE_SRTP_REPLAY_PROTECTION
+    */
+    RCC_SRTP_REPLAY_WINDOW_SIZE = 33,
+
+    /** Encrypt and authenticate frames of at least this many packets using several threads
+    *
+    * The packets of the frame are split between the thread pool shared by all media streams
+    * and the sending thread, and sent in order once all of them have been protected.
+    * Default is 0 (disabled). Valid only with RCE_SRTP
+    */
+    RCC_PARALLEL_SRTP_THRESHOLD = 34,
+
+    /** Precompute the AES-CTR keystream of this many upcoming packets in a background thread
+    *
+    * Encrypting a packet whose keystream is ready is then a single XOR, which shortens the
+    * sending path of latency-critical streams. Keystream is generated for the current payload size
+    * so set RCC_MTU_SIZE first. Memory use is this value times the payload size, at most 1024 packets.
+    * The keystream is discarded when the keys change.
+    * Default is 0 (disabled). Valid only with RCE_SRTP and AES-CTR encryption
+    */
+    RCC_SRTP_KEYSTREAM_LOOKAHEAD = 35,
+
+    /** Set the SSRC of the FEC repair packets sent by this stream
+    *
+    * Repair packets form a stream of their own and carry the SSRC of the protected stream
+    * as their only CSRC. By default the SSRC is generated randomly. Valid only with RCE_FEC
+    */
+    RCC_FEC_SSRC = 36,
+
+    /** Set the SSRC of the FEC repair packets sent by the remote stream
+    *
+    * Required when several streams share the socket, otherwise the repair packets cannot be
+    * matched to the stream they protect. Default is 0 (not set). Valid only with RCE_FEC
+    */
+    RCC_FEC_REMOTE_SSRC = 37,
+
     /// \cond DO_NOT_DOCUMENT
     RCC_LAST
     /// \endcond
 };
 
+/**
+ * \enum RTP_HEADER_EXTENSION
+ *
+ * \brief RTP header extensions (<a href="https://www.rfc-editor.org/rfc/rfc8285" target="_blank">RFC 8285</a>)
+ * that can be added to outgoing packets with uvgrtp::media_stream::register_header_extension()
+ *
+ * \details The local identifier of each extension is negotiated out-of-band, for example with SDP extmap attributes.
+ * On the receiving side, the extension elements can be read with uvgrtp::frame::get_header_extension()
+ */
+enum RTP_HEADER_EXTENSION {
+    /** Transport-wide sequence number (2 bytes), incremented by uvgRTP for every packet of the stream */
+    RTP_EXT_TRANSPORT_WIDE_SEQ      = 1,
+
+    /** Absolute send time (3 bytes, 6.18 fixed point seconds), written by uvgRTP when the packet is sent */
+    RTP_EXT_ABS_SEND_TIME           = 2,
+
+    /** Frame marking, short form (1 byte). uvgRTP sets the start of frame and end of frame bits */
+    RTP_EXT_FRAME_MARKING           = 3,
+
+    /** Video layers allocation. The contents are set by the application with
+     * uvgrtp::media_stream::set_header_extension_data() */
+    RTP_EXT_VIDEO_LAYERS_ALLOCATION = 4,
+
+    /** Any other extension. The contents are set by the application with
+     * uvgrtp::media_stream::set_header_extension_data() */
+    RTP_EXT_APPLICATION             = 5
+};
+
+/**
+ * \enum RTP_NAL_PRIORITY
+ *
+ * \brief Importance classes of H.264/H.265/H.266 NAL units, see RCC_SEND_LATENCY_BUDGET
+ *
+ * \details Non-reference slices are shed first, then reference slices starting from the highest temporal
+ * sub-layer. Once a slice has been shed, the slices that may reference it are also shed until the next
+ * intra NAL unit (or sub-layer switching point) so that the receiver never gets a broken reference chain.
+ */
+enum RTP_NAL_PRIORITY {
+    /** Parameter sets, SEI and other non-VCL NAL units. Never shed */
+    RTP_NAL_PRIORITY_NON_VCL       = 0,
+
+    /** IDR and other intra random access point slices. Never shed */
+    RTP_NAL_PRIORITY_INTRA         = 1,
+
+    /** Slices that other pictures may use for reference */
+    RTP_NAL_PRIORITY_REFERENCE     = 2,
+
+    /** Slices that no picture of the same temporal sub-layer uses for reference */
+    RTP_NAL_PRIORITY_NON_REFERENCE = 3,
+
+    /// \cond DO_NOT_DOCUMENT
+    RTP_NAL_PRIORITY_COUNT         = 4
+    /// \endcond
+};
+
+/**
+ * \enum RTP_JITTER_LATE_POLICY
+ *
+ * \brief What the jitter buffer does with a frame that arrives after a frame with a later
+ * RTP timestamp has already been delivered, see RCC_JITTER_BUFFER_LATE_POLICY
+ */
+enum RTP_JITTER_LATE_POLICY {
+    /** Free the late frame */
+    RTP_JITTER_DROP_LATE    = 0,
+
+    /** Deliver the late frame immediately, out of order */
+    RTP_JITTER_DELIVER_LATE = 1
+};
+
+/**
+ * \enum RTP_NAL_CHUNK_STATE
+ *
+ * \brief State of a fragmented NAL unit given to the hook installed with uvgrtp::media_stream::install_nal_chunk_hook()
+ */
+enum RTP_NAL_CHUNK_STATE {
+    /** More chunks of the NAL unit follow */
+    RTP_NAL_CHUNK_PARTIAL  = 0,
+
+    /** This is the last chunk, the NAL unit has been received completely */
+    RTP_NAL_CHUNK_COMPLETE = 1,
+
+    /** The rest of the NAL unit was lost and the chunks given so far should be discarded. This chunk has no data */
+    RTP_NAL_CHUNK_LOST     = 2
+};
+
 extern thread_local rtp_error_t rtp_errno;
@@ -7,6 +7,7 @@
 #include "debug.hh"
 #include "hostname.hh"
 #include "socketfactory.hh"
+#include "zrtp/key_pool.hh"
 
 #include <cstdlib>
 #include <cstring>
@@ -35,9 +36,11 @@ static inline std::string generate_string(size_t length)
 uvgrtp::context::context()
 {
     UVG_LOG_INFO("uvgRTP version: %s", uvgrtp::get_version().c_str());
+    UVG_LOG_DEBUG("Crypto backend: %s", uvgrtp::crypto::backend());
 
     cname_  = uvgrtp::context::generate_cname();
     sfp_ = std::make_shared<uvgrtp::socketfactory>(RCE_NO_FLAGS);
+    key_pool_ = std::make_shared<uvgrtp::zrtp_key_pool>();
 
 #ifdef _WIN32
     WSADATA wsd;
@@ -68,7 +71,7 @@ uvgrtp::session *uvgrtp::context::create_session(std::string address)
         return nullptr;
     }
 
-    return new uvgrtp::session(get_cname(), address, sfp_);
+    return new uvgrtp::session(get_cname(), address, sfp_, key_pool_);
 }
 
 uvgrtp::session* uvgrtp::context::create_session(std::string remote_addr, std::string local_addr)
@@ -78,7 +81,7 @@ uvgrtp::session* uvgrtp::context::create_session(std::string remote_addr, std::s
         UVG_LOG_ERROR("Please specify at least one address for create_session");
         return nullptr;
     }
-    return new uvgrtp::session(get_cname(), remote_addr, local_addr, sfp_);
+    return new uvgrtp::session(get_cname(), remote_addr, local_addr, sfp_, key_pool_);
 }
 
 rtp_error_t uvgrtp::context::destroy_session(uvgrtp::session *session)
@@ -114,3 +117,18 @@ bool uvgrtp::context::crypto_enabled() const
 {
     return uvgrtp::crypto::enabled();
 }
+
+rtp_error_t uvgrtp::context::set_zrtp_key_pool_size(size_t keys)
+{
+    if (!uvgrtp::crypto::enabled()) {
+        UVG_LOG_ERROR("uvgRTP was built without crypto, ZRTP key pool cannot be used");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    return key_pool_->set_size(keys);
+}
+
+size_t uvgrtp::context::get_zrtp_key_pool_size() const
+{
+    return key_pool_->get_size();
+}
@@ -1,7 +1,12 @@
 #include "crypto.hh"
 
+/* Crypto++ backend, also used for the stubs of builds without crypto */
+#ifndef __RTP_CRYPTO_OPENSSL__
+
 #include "debug.hh"
 
+#include <cstring>
+
 
 /* ***************** hmac-sha1 ***************** */
 
@@ -137,6 +142,11 @@ void uvgrtp::crypto::sha256::final(uint8_t *digest)
 
 /* ***************** aes-128 ***************** */
 
+#ifdef __RTP_CRYPTO__
+/* Placeholder IV for ciphers that get the real one from set_iv() */
+static const uint8_t ZERO_IV[CryptoPP::AES::BLOCKSIZE] = { 0 };
+#endif
+
 uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t *iv)
 #ifdef __RTP_CRYPTO__
     :enc_(key, key_size, iv),
@@ -148,10 +158,34 @@ uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t
 #endif
 }
 
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size)
+#ifdef __RTP_CRYPTO__
+    :enc_(key, key_size, ZERO_IV),
+    dec_(key, key_size, ZERO_IV)
+#endif
+{
+#ifndef __RTP_CRYPTO__
+    (void)key, (void)key_size;
+#endif
+}
+
 uvgrtp::crypto::aes::ctr::~ctr()
 {
 }
 
+void uvgrtp::crypto::aes::ctr::set_iv(const uint8_t *iv)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Resynchronize(iv, CryptoPP::AES::BLOCKSIZE);
+    dec_.Resynchronize(iv, CryptoPP::AES::BLOCKSIZE);
+#else
+    (void)iv;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
 {
 #ifdef __RTP_CRYPTO__
@@ -254,6 +288,122 @@ void uvgrtp::crypto::aes::ecb::decrypt(uint8_t *output, const uint8_t *input, si
 #endif
 }
 
+/* ***************** aes-gcm ***************** */
+
+#ifdef __RTP_CRYPTO__
+static const uint8_t ZERO_GCM_IV[12] = { 0 };
+#endif
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.SetKeyWithIV(key, key_size, ZERO_GCM_IV, sizeof(ZERO_GCM_IV));
+    dec_.SetKeyWithIV(key, key_size, ZERO_GCM_IV, sizeof(ZERO_GCM_IV));
+#else
+    (void)key, (void)key_size;
+#endif
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_start(const uint8_t *iv)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Resynchronize(iv, sizeof(ZERO_GCM_IV));
+#else
+    (void)iv;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_aad(const uint8_t *aad, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.Update(aad, len);
+#else
+    (void)aad, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.ProcessData(output, input, len);
+#else
+    (void)output, (void)input, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_final(uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    enc_.TruncatedFinal(tag, tag_len);
+#else
+    (void)tag, (void)tag_len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_start(const uint8_t *iv)
+{
+#ifdef __RTP_CRYPTO__
+    dec_.Resynchronize(iv, sizeof(ZERO_GCM_IV));
+#else
+    (void)iv;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_aad(const uint8_t *aad, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    dec_.Update(aad, len);
+#else
+    (void)aad, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    dec_.ProcessData(output, input, len);
+#else
+    (void)output, (void)input, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+bool uvgrtp::crypto::aes::gcm::decrypt_verify(const uint8_t *tag, size_t tag_len)
+{
+#ifdef __RTP_CRYPTO__
+    return dec_.TruncatedVerify(tag, tag_len);
+#else
+    (void)tag, (void)tag_len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 /* ***************** diffie-hellman 3072 ***************** */
 
 uvgrtp::crypto::dh::dh()
@@ -368,6 +518,112 @@ void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
 #endif
 }
 
+/* ***************** elliptic curve diffie-hellman ***************** */
+
+/* Crypto++ encodes P-256 public keys with the leading point format byte */
+constexpr uint8_t EC_POINT_UNCOMPRESSED = 0x04;
+
+uvgrtp::crypto::ecdh::ecdh(curve c):
+    curve_(c)
+#ifdef __RTP_CRYPTO__
+    ,prng_(),
+    domain_(),
+    sk_(),
+    pk_(),
+    rpk_()
+#endif
+{
+#ifdef __RTP_CRYPTO__
+    if (curve_ == P256)
+        domain_.reset(new CryptoPP::ECDH<CryptoPP::ECP>::Domain(CryptoPP::ASN1::secp256r1()));
+    else
+        domain_.reset(new CryptoPP::x25519());
+#endif
+}
+
+uvgrtp::crypto::ecdh::~ecdh()
+{
+}
+
+size_t uvgrtp::crypto::ecdh::pk_len() const
+{
+    return (curve_ == P256) ? 64 : 32;
+}
+
+size_t uvgrtp::crypto::ecdh::ss_len() const
+{
+    return 32;
+}
+
+void uvgrtp::crypto::ecdh::generate_keys()
+{
+#ifdef __RTP_CRYPTO__
+    sk_.New(domain_->PrivateKeyLength());
+    pk_.New(domain_->PublicKeyLength());
+    domain_->GenerateKeyPair(prng_, sk_, pk_);
+#else
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::ecdh::get_pk(uint8_t *pk, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    size_t offset = (curve_ == P256) ? 1 : 0;
+
+    memset(pk, 0, len);
+
+    if (pk_.size() == pk_len() + offset && len >= pk_len())
+        memcpy(pk, pk_.BytePtr() + offset, pk_len());
+#else
+    (void)pk, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+void uvgrtp::crypto::ecdh::set_remote_pk(const uint8_t *pk, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    if (len != pk_len()) {
+        rpk_.New(0);
+        return;
+    }
+
+    rpk_.New(domain_->PublicKeyLength());
+
+    if (curve_ == P256) {
+        rpk_[0] = EC_POINT_UNCOMPRESSED;
+        memcpy(rpk_.BytePtr() + 1, pk, len);
+    } else {
+        memcpy(rpk_.BytePtr(), pk, len);
+    }
+#else
+    (void)pk, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
+bool uvgrtp::crypto::ecdh::get_shared_secret(uint8_t *ss, size_t len)
+{
+#ifdef __RTP_CRYPTO__
+    if (rpk_.size() != domain_->PublicKeyLength() || len < domain_->AgreedValueLength())
+        return false;
+
+    /* validate the remote public key before using it */
+    return domain_->Agree(ss, sk_, rpk_, true);
+#else
+    (void)ss, (void)len;
+
+    UVG_LOG_ERROR("Recompile uvgRTP with -D__RTP_CRYPTO__");
+    exit(EXIT_FAILURE);
+#endif
+}
+
 /* ***************** base32 ***************** */
 uvgrtp::crypto::b32::b32()
 #ifdef __RTP_CRYPTO__
@@ -475,3 +731,14 @@ bool uvgrtp::crypto::enabled()
     return false;
 #endif
 }
+
+const char *uvgrtp::crypto::backend()
+{
+#ifdef __RTP_CRYPTO__
+    return "Crypto++";
+#else
+    return "none";
+#endif
+}
+
+#endif // __RTP_CRYPTO_OPENSSL__
@@ -1,54 +1,98 @@
 #pragma once
 
-#if __cplusplus >= 201703L || _MSC_VER >= 1911
+/* The classes below are the interface of the crypto backend. The backend is selected at
+ * CMake time with UVGRTP_CRYPTO_BACKEND: Crypto++ (crypto.cc) or OpenSSL libcrypto (crypto_openssl.cc).
+ * Without either of them crypto.cc provides stubs and crypto::enabled() returns false */
+#if defined(__RTP_OPENSSL__)
+#ifndef __RTP_NO_CRYPTO__
+#define __RTP_CRYPTO__
+#define __RTP_CRYPTO_OPENSSL__
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+
+#endif
+#elif __cplusplus >= 201703L || _MSC_VER >= 1911
 #if __has_include(<cryptopp/aes.h>) && \
     __has_include(<cryptopp/base32.h>) && \
     __has_include(<cryptopp/cryptlib.h>) && \
     __has_include(<cryptopp/dh.h>) && \
+    __has_include(<cryptopp/eccrypto.h>) && \
+    __has_include(<cryptopp/gcm.h>) && \
     __has_include(<cryptopp/hmac.h>) && \
     __has_include(<cryptopp/modes.h>) && \
     __has_include(<cryptopp/osrng.h>) && \
     __has_include(<cryptopp/sha.h>) && \
     __has_include(<cryptopp/crc.h>) && \
+    __has_include(<cryptopp/xed25519.h>) && \
     !defined(__RTP_NO_CRYPTO__)
 
 #define __RTP_CRYPTO__
+#define __RTP_CRYPTO_CRYPTOPP__
 
 #include <cryptopp/aes.h>
 #include <cryptopp/base32.h>
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/dh.h>
+#include <cryptopp/eccrypto.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/modes.h>
+#include <cryptopp/oids.h>
 #include <cryptopp/osrng.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/crc.h>
+#include <cryptopp/xed25519.h>
 
 #endif
 #else // __cplusplus < 201703L
 #ifndef __RTP_NO_CRYPTO__
 #define __RTP_CRYPTO__
+#define __RTP_CRYPTO_CRYPTOPP__
 
 #include <cryptopp/aes.h>
 #include <cryptopp/base32.h>
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/dh.h>
+#include <cryptopp/eccrypto.h>
+#include <cryptopp/gcm.h>
 #include <cryptopp/hmac.h>
 #include <cryptopp/modes.h>
+#include <cryptopp/oids.h>
 #include <cryptopp/osrng.h>
 #include <cryptopp/sha.h>
 #include <cryptopp/crc.h>
+#include <cryptopp/xed25519.h>
 
 #endif
 #endif // __cplusplus
 
 #include <iostream>
 #include <cstdint>
+#include <memory>
 
 namespace uvgrtp {
 
     namespace crypto {
 
+#ifdef __RTP_CRYPTO_OPENSSL__
+        namespace openssl {
+            struct deleter {
+                void operator()(EVP_MAC_CTX *ctx) const    { EVP_MAC_CTX_free(ctx); }
+                void operator()(EVP_MD_CTX *ctx) const     { EVP_MD_CTX_free(ctx); }
+                void operator()(EVP_CIPHER_CTX *ctx) const { EVP_CIPHER_CTX_free(ctx); }
+                void operator()(BN_CTX *ctx) const         { BN_CTX_free(ctx); }
+                void operator()(BIGNUM *bn) const          { BN_clear_free(bn); }
+                void operator()(EVP_PKEY *key) const       { EVP_PKEY_free(key); }
+                void operator()(EVP_PKEY_CTX *ctx) const   { EVP_PKEY_CTX_free(ctx); }
+            };
+
+            /* Owning pointer to a libcrypto object */
+            template <typename T>
+            using ptr = std::unique_ptr<T, deleter>;
+        }
+#endif
+
         /* hash-based message authentication code */
         namespace hmac {
             class sha1 {
@@ -63,8 +107,10 @@ namespace uvgrtp {
                     void final(uint8_t *digest, size_t size);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                     CryptoPP::HMAC<CryptoPP::SHA1> hmac_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                    openssl::ptr<EVP_MAC_CTX> hmac_;
 #endif
             };
 
@@ -77,8 +123,10 @@ namespace uvgrtp {
                     void final(uint8_t *digest);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                     CryptoPP::HMAC<CryptoPP::SHA256> hmac_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                    openssl::ptr<EVP_MAC_CTX> hmac_;
 #endif
             };
         }
@@ -92,8 +140,10 @@ namespace uvgrtp {
                 void final(uint8_t *digest);
 
             private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                 CryptoPP::SHA256 sha_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                openssl::ptr<EVP_MD_CTX> sha_;
 #endif
         };
 
@@ -108,9 +158,12 @@ namespace uvgrtp {
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                     CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption dec_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                    openssl::ptr<EVP_CIPHER_CTX> enc_;
+                    openssl::ptr<EVP_CIPHER_CTX> dec_;
 #endif
             };
 
@@ -123,24 +176,69 @@ namespace uvgrtp {
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                     CryptoPP::CFB_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::CFB_Mode<CryptoPP::AES>::Decryption dec_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                    openssl::ptr<EVP_CIPHER_CTX> enc_;
+                    openssl::ptr<EVP_CIPHER_CTX> dec_;
 #endif
             };
 
             class ctr {
                 public:
                     ctr(const uint8_t *key, size_t key_size, const uint8_t *iv);
+
+                    /* The key is expanded once here, set_iv() must be called before every packet */
+                    ctr(const uint8_t *key, size_t key_size);
                     ~ctr();
 
+                    /* Restart the key stream from "iv" (16 bytes) without expanding the key again */
+                    void set_iv(const uint8_t *iv);
+
                     void encrypt(uint8_t *output, const uint8_t *input, size_t len);
                     void decrypt(uint8_t *output, const uint8_t *input, size_t len);
 
                 private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                     CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption enc_;
                     CryptoPP::CTR_Mode<CryptoPP::AES>::Decryption dec_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                    openssl::ptr<EVP_CIPHER_CTX> enc_;
+                    openssl::ptr<EVP_CIPHER_CTX> dec_;
+#endif
+            };
+
+            /* Galois/Counter Mode, encrypts and authenticates in one pass
+             *
+             * A message is processed by giving the IV, then all additional authenticated data,
+             * then the payload and finally computing or verifying the authentication tag */
+            class gcm {
+                public:
+                    /* The key is expanded once here */
+                    gcm(const uint8_t *key, size_t key_size);
+                    ~gcm();
+
+                    /* "iv" is 12 bytes */
+                    void encrypt_start(const uint8_t *iv);
+                    void encrypt_aad(const uint8_t *aad, size_t len);
+                    void encrypt(uint8_t *output, const uint8_t *input, size_t len);
+                    void encrypt_final(uint8_t *tag, size_t tag_len);
+
+                    void decrypt_start(const uint8_t *iv);
+                    void decrypt_aad(const uint8_t *aad, size_t len);
+                    void decrypt(uint8_t *output, const uint8_t *input, size_t len);
+
+                    /* Return true if "tag" matches the data given since decrypt_start() */
+                    bool decrypt_verify(const uint8_t *tag, size_t tag_len);
+
+                private:
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
+                    CryptoPP::GCM<CryptoPP::AES>::Encryption enc_;
+                    CryptoPP::GCM<CryptoPP::AES>::Decryption dec_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                    openssl::ptr<EVP_CIPHER_CTX> enc_;
+                    openssl::ptr<EVP_CIPHER_CTX> dec_;
 #endif
             };
         }
@@ -157,10 +255,48 @@ namespace uvgrtp {
                 void get_shared_secret(uint8_t *ss, size_t len);
 
             private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                 CryptoPP::AutoSeededRandomPool prng_;
                 CryptoPP::DH dh_;
                 CryptoPP::Integer sk_, pk_, rpk_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                openssl::ptr<BN_CTX> bn_ctx_;
+                openssl::ptr<BIGNUM> p_, g_, sk_, pk_, rpk_;
+#endif
+        };
+
+        /* elliptic curve diffie-hellman */
+        class ecdh {
+            public:
+                enum curve {
+                    X25519, /* RFC 7748 */
+                    P256    /* NIST P-256 */
+                };
+
+                ecdh(curve c);
+                ~ecdh();
+
+                void generate_keys();
+
+                /* Length of the public key and the shared secret in bytes.
+                 * P-256 public key is the coordinates x || y without the point format byte */
+                size_t pk_len() const;
+                size_t ss_len() const;
+
+                void get_pk(uint8_t *pk, size_t len);
+                void set_remote_pk(const uint8_t *pk, size_t len);
+
+                /* Return false if the remote public key is not a valid point on the curve */
+                bool get_shared_secret(uint8_t *ss, size_t len);
+
+            private:
+                curve curve_;
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
+                CryptoPP::AutoSeededRandomPool prng_;
+                std::unique_ptr<CryptoPP::SimpleKeyAgreementDomain> domain_;
+                CryptoPP::SecByteBlock sk_, pk_, rpk_;
+#elif defined(__RTP_CRYPTO_OPENSSL__)
+                openssl::ptr<EVP_PKEY> key_, rpk_;
 #endif
         };
 
@@ -173,7 +309,7 @@ namespace uvgrtp {
                 void encode(const uint8_t *input, uint8_t *output, size_t len);
 
             private:
-#ifdef __RTP_CRYPTO__
+#if defined(__RTP_CRYPTO_CRYPTOPP__)
                 CryptoPP::Base32Encoder enc_;
 #endif
         };
@@ -189,6 +325,9 @@ namespace uvgrtp {
         }
 
         bool enabled();
+
+        /* Name of the crypto library uvgRTP was built with */
+        const char *backend();
     }
 }
 
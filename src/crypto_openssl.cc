@@ -0,0 +1,561 @@
+#include "crypto.hh"
+
+/* OpenSSL libcrypto backend, selected with UVGRTP_CRYPTO_BACKEND=openssl */
+#ifdef __RTP_CRYPTO_OPENSSL__
+
+#include "debug.hh"
+
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#include <openssl/rand.h>
+
+#include <cstring>
+
+/* ***************** hmac ***************** */
+
+static uvgrtp::crypto::openssl::ptr<EVP_MAC_CTX> new_hmac(const char *digest, const uint8_t *key, size_t key_size)
+{
+    EVP_MAC *mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+    uvgrtp::crypto::openssl::ptr<EVP_MAC_CTX> ctx(mac ? EVP_MAC_CTX_new(mac) : nullptr);
+    EVP_MAC_free(mac);
+
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char *)digest, 0),
+        OSSL_PARAM_construct_end()
+    };
+
+    if (!ctx || !EVP_MAC_init(ctx.get(), key, key_size, params))
+        UVG_LOG_ERROR("Failed to initialize HMAC-%s", digest);
+
+    return ctx;
+}
+
+/* Produce the MAC of the data given so far and start a new message with the same key */
+static void final_hmac(EVP_MAC_CTX *ctx, uint8_t *digest, size_t size)
+{
+    uint8_t d[EVP_MAX_MD_SIZE] = { 0 };
+    size_t len                 = 0;
+
+    EVP_MAC_final(ctx, d, &len, sizeof(d));
+    memcpy(digest, d, size < len ? size : len);
+
+    EVP_MAC_init(ctx, nullptr, 0, nullptr);
+}
+
+uvgrtp::crypto::hmac::sha1::sha1(const uint8_t *key, size_t key_size):
+    hmac_(new_hmac("SHA1", key, key_size))
+{
+}
+
+uvgrtp::crypto::hmac::sha1::~sha1()
+{
+}
+
+void uvgrtp::crypto::hmac::sha1::update(const uint8_t *data, size_t len)
+{
+    EVP_MAC_update(hmac_.get(), data, len);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest)
+{
+    final_hmac(hmac_.get(), digest, 20);
+}
+
+void uvgrtp::crypto::hmac::sha1::final(uint8_t *digest, size_t size)
+{
+    final_hmac(hmac_.get(), digest, size);
+}
+
+uvgrtp::crypto::hmac::sha256::sha256(const uint8_t *key, size_t key_size):
+    hmac_(new_hmac("SHA256", key, key_size))
+{
+}
+
+uvgrtp::crypto::hmac::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::hmac::sha256::update(const uint8_t *data, size_t len)
+{
+    EVP_MAC_update(hmac_.get(), data, len);
+}
+
+void uvgrtp::crypto::hmac::sha256::final(uint8_t *digest)
+{
+    final_hmac(hmac_.get(), digest, 32);
+}
+
+/* ***************** sha256 ***************** */
+
+uvgrtp::crypto::sha256::sha256():
+    sha_(EVP_MD_CTX_new())
+{
+    if (!sha_ || !EVP_DigestInit_ex(sha_.get(), EVP_sha256(), nullptr))
+        UVG_LOG_ERROR("Failed to initialize SHA-256");
+}
+
+uvgrtp::crypto::sha256::~sha256()
+{
+}
+
+void uvgrtp::crypto::sha256::update(const uint8_t *data, size_t len)
+{
+    EVP_DigestUpdate(sha_.get(), data, len);
+}
+
+void uvgrtp::crypto::sha256::final(uint8_t *digest)
+{
+    EVP_DigestFinal_ex(sha_.get(), digest, nullptr);
+    EVP_DigestInit_ex(sha_.get(), EVP_sha256(), nullptr);
+}
+
+/* ***************** aes ***************** */
+
+static const EVP_CIPHER *aes_ctr(size_t key_size)
+{
+    return key_size == 32 ? EVP_aes_256_ctr() : key_size == 24 ? EVP_aes_192_ctr() : EVP_aes_128_ctr();
+}
+
+static const EVP_CIPHER *aes_cfb(size_t key_size)
+{
+    return key_size == 32 ? EVP_aes_256_cfb128() : key_size == 24 ? EVP_aes_192_cfb128() : EVP_aes_128_cfb128();
+}
+
+static const EVP_CIPHER *aes_ecb(size_t key_size)
+{
+    return key_size == 32 ? EVP_aes_256_ecb() : key_size == 24 ? EVP_aes_192_ecb() : EVP_aes_128_ecb();
+}
+
+static const EVP_CIPHER *aes_gcm(size_t key_size)
+{
+    return key_size == 32 ? EVP_aes_256_gcm() : key_size == 24 ? EVP_aes_192_gcm() : EVP_aes_128_gcm();
+}
+
+/* Return a cipher context keyed with "key". Stream modes keep their position between calls
+ * like Crypto++ does, so a payload can be processed in several parts */
+static uvgrtp::crypto::openssl::ptr<EVP_CIPHER_CTX> new_cipher(const EVP_CIPHER *cipher,
+    const uint8_t *key, size_t key_size, const uint8_t *iv, bool encrypt)
+{
+    uvgrtp::crypto::openssl::ptr<EVP_CIPHER_CTX> ctx(EVP_CIPHER_CTX_new());
+
+    if (!ctx || (size_t)EVP_CIPHER_get_key_length(cipher) != key_size ||
+        !EVP_CipherInit_ex(ctx.get(), cipher, nullptr, key, iv, encrypt)) {
+        UVG_LOG_ERROR("Failed to initialize %s with a %zu-byte key", EVP_CIPHER_get0_name(cipher), key_size);
+        return ctx;
+    }
+
+    EVP_CIPHER_CTX_set_padding(ctx.get(), 0);
+    return ctx;
+}
+
+static void process(EVP_CIPHER_CTX *ctx, uint8_t *output, const uint8_t *input, size_t len)
+{
+    int out_len = 0;
+
+    if (!EVP_CipherUpdate(ctx, output, &out_len, input, (int)len))
+        UVG_LOG_ERROR("Failed to process %zu bytes", len);
+}
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size, const uint8_t *iv):
+    enc_(new_cipher(aes_ctr(key_size), key, key_size, iv, true)),
+    dec_(new_cipher(aes_ctr(key_size), key, key_size, iv, false))
+{
+}
+
+uvgrtp::crypto::aes::ctr::ctr(const uint8_t *key, size_t key_size):
+    enc_(new_cipher(aes_ctr(key_size), key, key_size, nullptr, true)),
+    dec_(new_cipher(aes_ctr(key_size), key, key_size, nullptr, false))
+{
+}
+
+uvgrtp::crypto::aes::ctr::~ctr()
+{
+}
+
+void uvgrtp::crypto::aes::ctr::set_iv(const uint8_t *iv)
+{
+    /* the key schedule is kept, only the counter block is reset */
+    EVP_CipherInit_ex(enc_.get(), nullptr, nullptr, nullptr, iv, 1);
+    EVP_CipherInit_ex(dec_.get(), nullptr, nullptr, nullptr, iv, 0);
+}
+
+void uvgrtp::crypto::aes::ctr::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(enc_.get(), output, input, len);
+}
+
+void uvgrtp::crypto::aes::ctr::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(dec_.get(), output, input, len);
+}
+
+uvgrtp::crypto::aes::cfb::cfb(const uint8_t *key, size_t key_size, const uint8_t *iv):
+    enc_(new_cipher(aes_cfb(key_size), key, key_size, iv, true)),
+    dec_(new_cipher(aes_cfb(key_size), key, key_size, iv, false))
+{
+}
+
+uvgrtp::crypto::aes::cfb::~cfb()
+{
+}
+
+void uvgrtp::crypto::aes::cfb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(enc_.get(), output, input, len);
+}
+
+void uvgrtp::crypto::aes::cfb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(dec_.get(), output, input, len);
+}
+
+uvgrtp::crypto::aes::ecb::ecb(const uint8_t *key, size_t key_size):
+    enc_(new_cipher(aes_ecb(key_size), key, key_size, nullptr, true)),
+    dec_(new_cipher(aes_ecb(key_size), key, key_size, nullptr, false))
+{
+}
+
+uvgrtp::crypto::aes::ecb::~ecb()
+{
+}
+
+void uvgrtp::crypto::aes::ecb::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(enc_.get(), output, input, len);
+}
+
+void uvgrtp::crypto::aes::ecb::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(dec_.get(), output, input, len);
+}
+
+/* ***************** aes-gcm ***************** */
+
+uvgrtp::crypto::aes::gcm::gcm(const uint8_t *key, size_t key_size):
+    enc_(new_cipher(aes_gcm(key_size), key, key_size, nullptr, true)),
+    dec_(new_cipher(aes_gcm(key_size), key, key_size, nullptr, false))
+{
+}
+
+uvgrtp::crypto::aes::gcm::~gcm()
+{
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_start(const uint8_t *iv)
+{
+    EVP_CipherInit_ex(enc_.get(), nullptr, nullptr, nullptr, iv, 1);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_aad(const uint8_t *aad, size_t len)
+{
+    process(enc_.get(), nullptr, aad, len);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(enc_.get(), output, input, len);
+}
+
+void uvgrtp::crypto::aes::gcm::encrypt_final(uint8_t *tag, size_t tag_len)
+{
+    int out_len = 0;
+
+    if (!EVP_CipherFinal_ex(enc_.get(), nullptr, &out_len) ||
+        !EVP_CIPHER_CTX_ctrl(enc_.get(), EVP_CTRL_GCM_GET_TAG, (int)tag_len, tag))
+        UVG_LOG_ERROR("Failed to compute the authentication tag");
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_start(const uint8_t *iv)
+{
+    EVP_CipherInit_ex(dec_.get(), nullptr, nullptr, nullptr, iv, 0);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt_aad(const uint8_t *aad, size_t len)
+{
+    process(dec_.get(), nullptr, aad, len);
+}
+
+void uvgrtp::crypto::aes::gcm::decrypt(uint8_t *output, const uint8_t *input, size_t len)
+{
+    process(dec_.get(), output, input, len);
+}
+
+bool uvgrtp::crypto::aes::gcm::decrypt_verify(const uint8_t *tag, size_t tag_len)
+{
+    int out_len = 0;
+
+    if (!EVP_CIPHER_CTX_ctrl(dec_.get(), EVP_CTRL_GCM_SET_TAG, (int)tag_len, (void *)tag))
+        return false;
+
+    return EVP_CipherFinal_ex(dec_.get(), nullptr, &out_len) > 0;
+}
+
+/* ***************** diffie-hellman 3072 ***************** */
+
+uvgrtp::crypto::dh::dh():
+    bn_ctx_(BN_CTX_secure_new()),
+    p_(BN_get_rfc3526_prime_3072(nullptr)),
+    g_(BN_new()),
+    sk_(BN_secure_new()),
+    pk_(BN_new()),
+    rpk_(BN_new())
+{
+    if (!bn_ctx_ || !p_ || !g_ || !sk_ || !pk_ || !rpk_ || !BN_set_word(g_.get(), 2))
+        UVG_LOG_ERROR("Failed to initialize Diffie-Hellman");
+}
+
+uvgrtp::crypto::dh::~dh()
+{
+}
+
+void uvgrtp::crypto::dh::generate_keys()
+{
+    /* the private key is uniform in [2, p - 2] like with Crypto++ */
+    openssl::ptr<BIGNUM> range(BN_dup(p_.get()));
+
+    if (!range || !BN_sub_word(range.get(), 3) ||
+        !BN_priv_rand_range(sk_.get(), range.get()) || !BN_add_word(sk_.get(), 2) ||
+        !BN_mod_exp_mont_consttime(pk_.get(), g_.get(), sk_.get(), p_.get(), bn_ctx_.get(), nullptr))
+        UVG_LOG_ERROR("Failed to generate Diffie-Hellman keys");
+}
+
+void uvgrtp::crypto::dh::get_pk(uint8_t *pk, size_t len)
+{
+    BN_bn2binpad(pk_.get(), pk, (int)len);
+}
+
+void uvgrtp::crypto::dh::set_remote_pk(uint8_t *pk, size_t len)
+{
+    BN_bin2bn(pk, (int)len, rpk_.get());
+}
+
+void uvgrtp::crypto::dh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    openssl::ptr<BIGNUM> res(BN_secure_new());
+
+    if (!res || !BN_mod_exp_mont_consttime(res.get(), rpk_.get(), sk_.get(), p_.get(), bn_ctx_.get(), nullptr)) {
+        UVG_LOG_ERROR("Failed to compute the Diffie-Hellman result");
+        memset(ss, 0, len);
+        return;
+    }
+
+    BN_bn2binpad(res.get(), ss, (int)len);
+}
+
+/* ***************** elliptic curve diffie-hellman ***************** */
+
+/* P-256 public keys are exchanged without the leading point format byte */
+constexpr uint8_t EC_POINT_UNCOMPRESSED = 0x04;
+constexpr size_t  EC_P256_POINT_SIZE    = 65;
+
+uvgrtp::crypto::ecdh::ecdh(curve c):
+    curve_(c),
+    key_(),
+    rpk_()
+{
+}
+
+uvgrtp::crypto::ecdh::~ecdh()
+{
+}
+
+size_t uvgrtp::crypto::ecdh::pk_len() const
+{
+    return (curve_ == P256) ? EC_P256_POINT_SIZE - 1 : 32;
+}
+
+size_t uvgrtp::crypto::ecdh::ss_len() const
+{
+    return 32;
+}
+
+void uvgrtp::crypto::ecdh::generate_keys()
+{
+    if (curve_ == P256)
+        key_.reset(EVP_PKEY_Q_keygen(nullptr, nullptr, "EC", "P-256"));
+    else
+        key_.reset(EVP_PKEY_Q_keygen(nullptr, nullptr, "X25519"));
+
+    if (!key_)
+        UVG_LOG_ERROR("Failed to generate ECDH keys");
+}
+
+void uvgrtp::crypto::ecdh::get_pk(uint8_t *pk, size_t len)
+{
+    uint8_t point[EC_P256_POINT_SIZE];
+    size_t point_len = len;
+
+    memset(pk, 0, len);
+
+    if (!key_ || len < pk_len()) {
+        UVG_LOG_ERROR("Failed to get the ECDH public key");
+        return;
+    }
+
+    if (curve_ == X25519) {
+        if (!EVP_PKEY_get_raw_public_key(key_.get(), pk, &point_len))
+            UVG_LOG_ERROR("Failed to get the ECDH public key");
+        return;
+    }
+
+    if (!EVP_PKEY_get_octet_string_param(key_.get(), OSSL_PKEY_PARAM_PUB_KEY, point, sizeof(point), &point_len) ||
+        point_len != sizeof(point) || point[0] != EC_POINT_UNCOMPRESSED) {
+        UVG_LOG_ERROR("Failed to get the ECDH public key");
+        return;
+    }
+
+    memcpy(pk, point + 1, sizeof(point) - 1);
+}
+
+void uvgrtp::crypto::ecdh::set_remote_pk(const uint8_t *pk, size_t len)
+{
+    rpk_.reset();
+
+    if (len != pk_len())
+        return;
+
+    if (curve_ == X25519) {
+        rpk_.reset(EVP_PKEY_new_raw_public_key_ex(nullptr, "X25519", nullptr, pk, len));
+        return;
+    }
+
+    uint8_t point[EC_P256_POINT_SIZE];
+    char group[] = "P-256";
+    EVP_PKEY *key = nullptr;
+
+    point[0] = EC_POINT_UNCOMPRESSED;
+    memcpy(point + 1, pk, len);
+
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, group, 0),
+        OSSL_PARAM_construct_octet_string(OSSL_PKEY_PARAM_PUB_KEY, point, sizeof(point)),
+        OSSL_PARAM_construct_end()
+    };
+    openssl::ptr<EVP_PKEY_CTX> ctx(EVP_PKEY_CTX_new_from_name(nullptr, "EC", nullptr));
+
+    if (ctx && EVP_PKEY_fromdata_init(ctx.get()) > 0 &&
+        EVP_PKEY_fromdata(ctx.get(), &key, EVP_PKEY_PUBLIC_KEY, params) > 0)
+        rpk_.reset(key);
+}
+
+bool uvgrtp::crypto::ecdh::get_shared_secret(uint8_t *ss, size_t len)
+{
+    size_t ss_size = len;
+
+    if (!key_ || !rpk_ || len < ss_len())
+        return false;
+
+    openssl::ptr<EVP_PKEY_CTX> ctx(EVP_PKEY_CTX_new_from_pkey(nullptr, key_.get(), nullptr));
+
+    /* the remote public key is validated when it is set as the peer */
+    return ctx && EVP_PKEY_derive_init(ctx.get()) > 0 &&
+        EVP_PKEY_derive_set_peer_ex(ctx.get(), rpk_.get(), 1) > 0 &&
+        EVP_PKEY_derive(ctx.get(), ss, &ss_size) > 0 && ss_size == ss_len();
+}
+
+/* ***************** base32 ***************** */
+
+uvgrtp::crypto::b32::b32()
+{
+}
+
+uvgrtp::crypto::b32::~b32()
+{
+}
+
+void uvgrtp::crypto::b32::encode(const uint8_t *input, uint8_t *output, size_t len)
+{
+    /* default alphabet of Crypto++ so that both backends produce the same strings */
+    static const char alphabet[] = "ABCDEFGHIJKMNPQRSTUVWXYZ23456789";
+
+    uint32_t acc = 0;
+    size_t bits  = 0;
+    size_t out   = 0;
+
+    for (size_t i = 0; i < len && out < len; ++i) {
+        acc   = (acc << 8) | input[i];
+        bits += 8;
+
+        while (bits >= 5 && out < len) {
+            output[out++] = alphabet[(acc >> (bits - 5)) & 0x1f];
+            bits -= 5;
+        }
+    }
+
+    if (bits && out < len)
+        output[out++] = alphabet[(acc << (5 - bits)) & 0x1f];
+}
+
+/* ***************** random ***************** */
+
+void uvgrtp::crypto::random::generate_random(uint8_t *out, size_t len)
+{
+    if (RAND_bytes(out, (int)len) != 1)
+        UVG_LOG_ERROR("Failed to generate %zu random bytes", len);
+}
+
+/* ***************** crc32 ***************** */
+
+/* CRC-32 of IEEE 802.3 as computed by CryptoPP::CRC32. libcrypto does not provide one */
+static uint32_t crc32_ieee(const uint8_t *input, size_t len)
+{
+    static const struct table {
+        uint32_t entries[256];
+
+        table() : entries()
+        {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+
+                for (int k = 0; k < 8; ++k)
+                    c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+                entries[i] = c;
+            }
+        }
+    } t;
+
+    uint32_t crc = 0xffffffff;
+
+    for (size_t i = 0; i < len; ++i)
+        crc = t.entries[(crc ^ input[i]) & 0xff] ^ (crc >> 8);
+
+    return crc ^ 0xffffffff;
+}
+
+/* Crypto++ outputs the least significant byte of the CRC first */
+static void crc32_bytes(uint32_t crc, uint8_t *out)
+{
+    for (int i = 0; i < 4; ++i)
+        out[i] = (uint8_t)(crc >> (8 * i));
+}
+
+void uvgrtp::crypto::crc32::get_crc32(const uint8_t *input, size_t len, uint32_t *output)
+{
+    crc32_bytes(crc32_ieee(input, len), (uint8_t *)output);
+}
+
+uint32_t uvgrtp::crypto::crc32::calculate_crc32(const uint8_t *input, size_t len)
+{
+    uint32_t out;
+
+    get_crc32(input, len, &out);
+    return out;
+}
+
+bool uvgrtp::crypto::crc32::verify_crc32(const uint8_t *input, size_t len, uint32_t old_crc)
+{
+    return calculate_crc32(input, len) == old_crc;
+}
+
+bool uvgrtp::crypto::enabled()
+{
+    return true;
+}
+
+const char *uvgrtp::crypto::backend()
+{
+    return "OpenSSL";
+}
+
+#endif // __RTP_CRYPTO_OPENSSL__
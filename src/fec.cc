@@ -0,0 +1,628 @@
+#include "fec.hh"
+
+#include "rtp.hh"
+#include "global.hh"
+#include "debug.hh"
+#include "random.hh"
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define UVG_FEC_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define UVG_FEC_NEON
+#endif
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <cstring>
+
+/* Offsets of the fields in the FlexFEC header (RFC 8627 Sec. 4.2.2.1) */
+constexpr size_t FEC_SN_BASE_OFFSET = 8;
+constexpr size_t FEC_MASK_OFFSET    = 10;
+
+/* Mask chunks are 15, 31 and 64 bits long, the first two are preceded by a k-bit */
+constexpr size_t FEC_MASK_CHUNK_1   = 15;
+constexpr size_t FEC_MASK_CHUNK_2   = 46;
+
+void uvgrtp::fec_xor::xor_into(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)&src[i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_xor_si256(a, b));
+    }
+#endif
+
+#if defined(UVG_FEC_SSE2)
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i b = _mm_loadu_si128((const __m128i *)&src[i]);
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_xor_si128(a, b));
+    }
+#elif defined(UVG_FEC_NEON)
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(&dst[i], veorq_u8(vld1q_u8(&dst[i]), vld1q_u8(&src[i])));
+    }
+#endif
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, &dst[i], sizeof(uint64_t));
+        memcpy(&b, &src[i], sizeof(uint64_t));
+        a ^= b;
+        memcpy(&dst[i], &a, sizeof(uint64_t));
+    }
+
+    for (; i < len; ++i) {
+        dst[i] ^= src[i];
+    }
+}
+
+/* Position of mask bit "index" in the on-wire mask field, skipping the k-bits */
+static inline size_t mask_wire_position(size_t index)
+{
+    if (index < FEC_MASK_CHUNK_1)
+        return 1 + index;
+    else if (index < FEC_MASK_CHUNK_2)
+        return 17 + (index - FEC_MASK_CHUNK_1);
+
+    return 48 + (index - FEC_MASK_CHUNK_2);
+}
+
+static inline void set_bit(uint8_t *field, size_t bit)
+{
+    field[bit / 8] |= (0x80 >> (bit % 8));
+}
+
+static inline bool get_bit(const uint8_t *field, size_t bit)
+{
+    return field[bit / 8] & (0x80 >> (bit % 8));
+}
+
+uvgrtp::fec::fec(std::shared_ptr<uvgrtp::rtp> rtp):
+    rtp_(rtp),
+    row_length_(FEC_DEFAULT_ROW_LEN),
+    column_depth_(0),
+    payload_(FEC_DEFAULT_PAYLOAD),
+    ssrc_(uvgrtp::random::generate_32()),
+    seq_((uint16_t)uvgrtp::random::generate_32()),
+    row_(),
+    columns_(),
+    block_pos_(0),
+    store_(FEC_STORE_SIZE),
+    store_initialized_(false),
+    highest_seq_(0),
+    pending_(),
+    recovered_(),
+    current_(),
+    recovered_pkts_(0),
+    unrecoverable_(0)
+{
+    if (rtp_->get_dynamic_payload() == payload_)
+        ++payload_;
+
+    while (ssrc_ == 0 || ssrc_ == rtp_->get_ssrc()) {
+        ssrc_ = uvgrtp::random::generate_32();
+    }
+}
+
+uvgrtp::fec::~fec()
+{
+    if (store_initialized_) {
+        UVG_LOG_DEBUG("FEC recovered %zu packets, %zu repair packets could not be used",
+            recovered_pkts_, unrecoverable_);
+    }
+}
+
+rtp_error_t uvgrtp::fec::set_row_length(ssize_t length)
+{
+    if (length < 0 || length > (ssize_t)FEC_MASK_BITS ||
+        (column_depth_ > 1 && (length == 0 || (column_depth_ - 1) * length >= (ssize_t)FEC_MASK_BITS))) {
+        UVG_LOG_ERROR("Invalid FEC row length %zd", length);
+        return RTP_INVALID_VALUE;
+    }
+
+    row_length_ = length;
+    row_.count  = 0;
+    block_pos_  = 0;
+    columns_.resize(row_length_);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::fec::set_column_depth(ssize_t depth)
+{
+    if (depth < 0 || depth == 1 ||
+        (depth > 1 && (row_length_ == 0 || (depth - 1) * row_length_ >= (ssize_t)FEC_MASK_BITS))) {
+        UVG_LOG_ERROR("Invalid FEC column depth %zd, columns require a row length and must fit in %zu packets",
+            depth, FEC_MASK_BITS);
+        return RTP_INVALID_VALUE;
+    }
+
+    column_depth_ = depth;
+    block_pos_    = 0;
+    columns_.resize(row_length_);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::fec::set_payload_type(ssize_t payload)
+{
+    if (payload < 0 || payload > 0x7f)
+        return RTP_INVALID_VALUE;
+
+    if ((uint8_t)payload == rtp_->get_dynamic_payload()) {
+        UVG_LOG_ERROR("FEC payload type must differ from the payload type of the media");
+        return RTP_INVALID_VALUE;
+    }
+
+    payload_ = (uint8_t)payload;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::fec::set_ssrc(ssize_t ssrc)
+{
+    if (ssrc <= 0 || ssrc > (ssize_t)UINT32_MAX)
+        return RTP_INVALID_VALUE;
+
+    if ((uint32_t)ssrc == rtp_->get_ssrc()) {
+        UVG_LOG_ERROR("FEC SSRC must differ from the SSRC of the media");
+        return RTP_INVALID_VALUE;
+    }
+
+    ssrc_ = (uint32_t)ssrc;
+    return RTP_OK;
+}
+
+ssize_t uvgrtp::fec::get_row_length() const
+{
+    return row_length_;
+}
+
+ssize_t uvgrtp::fec::get_column_depth() const
+{
+    return column_depth_;
+}
+
+uint8_t uvgrtp::fec::get_payload_type() const
+{
+    return payload_;
+}
+
+uint32_t uvgrtp::fec::get_ssrc() const
+{
+    return ssrc_;
+}
+
+size_t uvgrtp::fec::get_recovered_packets() const
+{
+    return recovered_pkts_;
+}
+
+size_t uvgrtp::fec::get_unrecoverable_repairs() const
+{
+    return unrecoverable_;
+}
+
+void uvgrtp::fec::reset_group(group& g, uint16_t sn_base)
+{
+    g.sn_base     = sn_base;
+    g.count       = 0;
+    g.payload_len = 0;
+
+    memset(g.mask,      0, sizeof(g.mask));
+    memset(g.bitstring, 0, sizeof(g.bitstring));
+}
+
+void uvgrtp::fec::add_to_group(group& g, uint16_t seq, uvgrtp::buf_vec& packet, size_t packet_len)
+{
+    uint8_t *header = packet.at(0).second;
+    size_t offset   = (uint16_t)(seq - g.sn_base);
+    size_t len      = packet_len - RTP_HDR_SIZE;
+    uint16_t length = htons((uint16_t)len);
+
+    set_bit(g.mask, offset);
+    ++g.count;
+
+    /* The FEC bit string consists of the first 64 bits of the RTP header
+     * where the sequence number is replaced with the length of the packet (RFC 8627 Sec. 6.3.1) */
+    g.bitstring[0] ^= header[0];
+    g.bitstring[1] ^= header[1];
+    g.bitstring[2] ^= ((uint8_t *)&length)[0];
+    g.bitstring[3] ^= ((uint8_t *)&length)[1];
+
+    for (int i = 4; i < 8; ++i) {
+        g.bitstring[i] ^= header[i];
+    }
+
+    if (g.payload.size() < len)
+        g.payload.resize(len);
+
+    /* shorter packets are padded with zeros */
+    if (len > g.payload_len) {
+        memset(&g.payload[g.payload_len], 0, len - g.payload_len);
+        g.payload_len = len;
+    }
+
+    size_t skip = RTP_HDR_SIZE;
+    size_t pos  = 0;
+
+    for (auto& buffer : packet) {
+        if (skip >= buffer.first) {
+            skip -= buffer.first;
+            continue;
+        }
+
+        uvgrtp::fec_xor::xor_into(&g.payload[pos], buffer.second + skip, buffer.first - skip);
+        pos += buffer.first - skip;
+        skip = 0;
+    }
+}
+
+void uvgrtp::fec::emit_group(group& g, uint8_t *media_header, uvgrtp::pkt_vec& packets, std::vector<uint8_t *>& storage)
+{
+    size_t highest = 0;
+
+    for (size_t i = 0; i < FEC_MASK_BITS; ++i) {
+        if (get_bit(g.mask, i))
+            highest = i;
+    }
+
+    size_t mask_len = 2;
+
+    if (highest >= FEC_MASK_CHUNK_2)
+        mask_len = 14;
+    else if (highest >= FEC_MASK_CHUNK_1)
+        mask_len = 6;
+
+    size_t hdr_len = FEC_MASK_OFFSET + mask_len;
+    size_t total   = RTP_HDR_SIZE + sizeof(uint32_t) + hdr_len + g.payload_len;
+    uint8_t *mem   = new uint8_t[total];
+
+    /* RTP header of the repair stream with the protected SSRC as the only CSRC */
+    mem[0] = (2 << 6) | 1;
+    mem[1] = payload_ & 0x7f;
+    *(uint16_t *)&mem[2] = htons(seq_++);
+    memcpy(&mem[4],  &media_header[4], sizeof(uint32_t));
+    *(uint32_t *)&mem[8] = htonl(ssrc_);
+    memcpy(&mem[12], &media_header[8], sizeof(uint32_t));
+
+    uint8_t *fh = &mem[RTP_HDR_SIZE + sizeof(uint32_t)];
+
+    memcpy(fh, g.bitstring, sizeof(g.bitstring));
+    fh[0] &= 0x3f; // R = 0, F = 0: flexible mask
+    *(uint16_t *)&fh[FEC_SN_BASE_OFFSET] = htons(g.sn_base);
+
+    uint8_t *mask = &fh[FEC_MASK_OFFSET];
+    memset(mask, 0, mask_len);
+
+    if (mask_len == 2)
+        set_bit(mask, 0);
+    else if (mask_len == 6)
+        set_bit(mask, 16);
+
+    for (size_t i = 0; i <= highest; ++i) {
+        if (get_bit(g.mask, i))
+            set_bit(mask, mask_wire_position(i));
+    }
+
+    memcpy(&fh[hdr_len], g.payload.data(), g.payload_len);
+
+    storage.push_back(mem);
+    packets.push_back({ { total, mem } });
+
+    g.count = 0;
+}
+
+rtp_error_t uvgrtp::fec::protect(uvgrtp::pkt_vec& packets, std::vector<uint8_t *>& storage)
+{
+    bool rows    = row_length_ > 0;
+    bool columns = column_depth_ > 1 && rows;
+
+    if (!rows)
+        return RTP_OK;
+
+    /* repair packets are appended after the media packets of the transaction */
+    uvgrtp::pkt_vec repairs;
+
+    for (auto& packet : packets) {
+        uint8_t *header   = packet.at(0).second;
+        uint16_t seq      = ntohs(*(uint16_t *)&header[2]);
+        size_t packet_len = 0;
+
+        for (auto& buffer : packet) {
+            packet_len += buffer.first;
+        }
+
+        if (row_.count == 0)
+            reset_group(row_, seq);
+
+        add_to_group(row_, seq, packet, packet_len);
+
+        if (row_.count == (size_t)row_length_)
+            emit_group(row_, header, repairs, storage);
+
+        if (columns) {
+            group& column = columns_[block_pos_ % row_length_];
+
+            if (block_pos_ < (size_t)row_length_)
+                reset_group(column, seq);
+
+            add_to_group(column, seq, packet, packet_len);
+
+            if (++block_pos_ == (size_t)(row_length_ * column_depth_)) {
+                for (auto& c : columns_) {
+                    emit_group(c, header, repairs, storage);
+                }
+                block_pos_ = 0;
+            }
+        }
+    }
+
+    for (auto& repair : repairs) {
+        packets.push_back(repair);
+    }
+
+    return RTP_OK;
+}
+
+void uvgrtp::fec::store_packet(uint16_t seq, uint8_t *data, size_t size, bool recovered)
+{
+    if (!store_initialized_) {
+        highest_seq_       = seq;
+        store_initialized_ = true;
+    }
+    else if ((uint16_t)(seq - highest_seq_) < 0x8000) {
+        highest_seq_ = seq;
+    }
+
+    stored_packet& slot = store_[seq % FEC_STORE_SIZE];
+
+    slot.seq       = seq;
+    slot.valid     = true;
+    slot.recovered = recovered;
+    slot.data.assign(data, data + size);
+}
+
+bool uvgrtp::fec::is_stored(uint16_t seq) const
+{
+    const stored_packet& slot = store_[seq % FEC_STORE_SIZE];
+    return slot.valid && slot.seq == seq;
+}
+
+bool uvgrtp::fec::is_expired(uint16_t seq) const
+{
+    uint16_t age = highest_seq_ - seq;
+    return store_initialized_ && age < 0x8000 && age >= FEC_STORE_SIZE;
+}
+
+rtp_error_t uvgrtp::fec::try_recover(const std::vector<uint8_t>& repair)
+{
+    size_t size = repair.size();
+    size_t off  = RTP_HDR_SIZE + (repair[0] & 0x0f) * sizeof(uint32_t);
+
+    /* the protected SSRC is carried in the CSRC list of the repair packet */
+    if ((repair[0] & 0x0f) == 0 || size < off + FEC_MASK_OFFSET + 2)
+        return RTP_GENERIC_ERROR;
+
+    const uint8_t *fh = &repair[off];
+
+    if (fh[0] & 0x80) {
+        UVG_LOG_DEBUG("FlexFEC retransmission packets are not supported");
+        return RTP_NOT_FOUND;
+    }
+
+    uint16_t sn_base = ntohs(*(uint16_t *)&fh[FEC_SN_BASE_OFFSET]);
+    uint16_t seqs[FEC_MASK_BITS];
+    size_t nseqs   = 0;
+    size_t hdr_len = FEC_MASK_OFFSET + 2;
+
+    if (fh[0] & 0x40) {
+        /* fixed L x D mask: a row when D <= 1, otherwise a column */
+        uint8_t l = fh[FEC_MASK_OFFSET];
+        uint8_t d = fh[FEC_MASK_OFFSET + 1];
+
+        if (l == 0)
+            return RTP_GENERIC_ERROR;
+
+        size_t count = (d <= 1) ? l : d;
+        size_t step  = (d <= 1) ? 1 : l;
+
+        for (size_t i = 0; i < count && nseqs < FEC_MASK_BITS; ++i) {
+            seqs[nseqs++] = (uint16_t)(sn_base + i * step);
+        }
+    }
+    else {
+        const uint8_t *mask = &fh[FEC_MASK_OFFSET];
+        size_t bits = FEC_MASK_CHUNK_1;
+
+        if (!get_bit(mask, 0)) {
+            hdr_len = FEC_MASK_OFFSET + 6;
+            bits    = FEC_MASK_CHUNK_2;
+
+            if (size < off + hdr_len)
+                return RTP_GENERIC_ERROR;
+
+            if (!get_bit(mask, 16)) {
+                hdr_len = FEC_MASK_OFFSET + 14;
+                bits    = FEC_MASK_BITS;
+            }
+        }
+
+        if (size < off + hdr_len)
+            return RTP_GENERIC_ERROR;
+
+        for (size_t i = 0; i < bits; ++i) {
+            if (get_bit(mask, mask_wire_position(i)))
+                seqs[nseqs++] = (uint16_t)(sn_base + i);
+        }
+    }
+
+    size_t missing       = 0;
+    uint16_t missing_seq = 0;
+
+    for (size_t i = 0; i < nseqs; ++i) {
+        if (is_stored(seqs[i]))
+            continue;
+
+        if (is_expired(seqs[i])) {
+            ++unrecoverable_;
+            return RTP_NOT_FOUND;
+        }
+
+        ++missing;
+        missing_seq = seqs[i];
+    }
+
+    if (missing == 0)
+        return RTP_NOT_FOUND;
+    else if (missing > 1)
+        return RTP_NOT_READY;
+
+    uint8_t bitstring[8];
+    memcpy(bitstring, fh, sizeof(bitstring));
+
+    for (size_t i = 0; i < nseqs; ++i) {
+        if (seqs[i] == missing_seq)
+            continue;
+
+        const std::vector<uint8_t>& pkt = store_[seqs[i] % FEC_STORE_SIZE].data;
+        uint16_t length = htons((uint16_t)(pkt.size() - RTP_HDR_SIZE));
+
+        bitstring[0] ^= pkt[0];
+        bitstring[1] ^= pkt[1];
+        bitstring[2] ^= ((uint8_t *)&length)[0];
+        bitstring[3] ^= ((uint8_t *)&length)[1];
+
+        for (int k = 4; k < 8; ++k) {
+            bitstring[k] ^= pkt[k];
+        }
+    }
+
+    size_t length = ntohs(*(uint16_t *)&bitstring[2]);
+
+    if (length > size - off - hdr_len) {
+        UVG_LOG_DEBUG("FlexFEC recovered length %zu is larger than the repair payload", length);
+        return RTP_GENERIC_ERROR;
+    }
+
+    std::vector<uint8_t> recovered(RTP_HDR_SIZE + length);
+
+    recovered[0] = (2 << 6) | (bitstring[0] & 0x3f);
+    recovered[1] = bitstring[1];
+    *(uint16_t *)&recovered[2] = htons(missing_seq);
+    memcpy(&recovered[4], &bitstring[4], sizeof(uint32_t));
+
+    memcpy(&recovered[8], &repair[RTP_HDR_SIZE], sizeof(uint32_t));
+
+    memcpy(&recovered[RTP_HDR_SIZE], &fh[hdr_len], length);
+
+    for (size_t i = 0; i < nseqs; ++i) {
+        if (seqs[i] == missing_seq)
+            continue;
+
+        const std::vector<uint8_t>& pkt = store_[seqs[i] % FEC_STORE_SIZE].data;
+        size_t len = pkt.size() - RTP_HDR_SIZE;
+
+        uvgrtp::fec_xor::xor_into(&recovered[RTP_HDR_SIZE], &pkt[RTP_HDR_SIZE], len < length ? len : length);
+    }
+
+    store_packet(missing_seq, recovered.data(), recovered.size(), true);
+    recovered_.push_back(std::move(recovered));
+    ++recovered_pkts_;
+
+    return RTP_OK;
+}
+
+void uvgrtp::fec::retry_pending()
+{
+    bool progress = true;
+
+    while (progress) {
+        progress = false;
+
+        for (auto it = pending_.begin(); it != pending_.end();) {
+            rtp_error_t ret = try_recover(*it);
+
+            if (ret == RTP_NOT_READY) {
+                ++it;
+                continue;
+            }
+
+            if (ret == RTP_OK)
+                progress = true;
+
+            it = pending_.erase(it);
+        }
+    }
+}
+
+rtp_error_t uvgrtp::fec::packet_handler(void *args, int rce_flags, uint8_t *read_ptr, size_t size, frame::rtp_frame **out)
+{
+    (void)args;
+    (void)rce_flags;
+    (void)out;
+
+    if (size < RTP_HDR_SIZE)
+        return RTP_PKT_NOT_HANDLED;
+
+    if ((read_ptr[1] & 0x7f) != payload_) {
+        uint16_t seq = ntohs(*(uint16_t *)&read_ptr[2]);
+        stored_packet& slot = store_[seq % FEC_STORE_SIZE];
+
+        /* the packet has already been recovered and returned, this is a late original */
+        if (slot.valid && slot.seq == seq && slot.recovered)
+            return RTP_OK;
+
+        store_packet(seq, read_ptr, size, false);
+
+        /* a late media packet may be the one a held repair packet was waiting for */
+        if (!pending_.empty())
+            retry_pending();
+
+        return RTP_PKT_NOT_HANDLED;
+    }
+
+    std::vector<uint8_t> repair(read_ptr, read_ptr + size);
+    rtp_error_t ret = try_recover(repair);
+
+    if (ret == RTP_OK) {
+        retry_pending();
+    }
+    else if (ret == RTP_NOT_READY) {
+        pending_.push_back(std::move(repair));
+
+        if (pending_.size() > FEC_MAX_PENDING) {
+            pending_.pop_front();
+            ++unrecoverable_;
+        }
+    }
+    else if (ret == RTP_GENERIC_ERROR) {
+        UVG_LOG_DEBUG("Received a malformed FlexFEC repair packet");
+        return ret;
+    }
+
+    return recovered_.empty() ? RTP_OK : RTP_MULTIPLE_PKTS_READY;
+}
+
+rtp_error_t uvgrtp::fec::recovered_getter(uint8_t **packet, size_t *size)
+{
+    if (recovered_.empty())
+        return RTP_NOT_FOUND;
+
+    current_ = std::move(recovered_.front());
+    recovered_.pop_front();
+
+    *packet = current_.data();
+    *size   = current_.size();
+
+    return RTP_PKT_READY;
+}
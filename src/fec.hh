@@ -0,0 +1,179 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include "socket.hh"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    class rtp;
+
+    /* FlexFEC header: 8 bytes of recovery fields, SN base and the longest (110-bit) flexible mask */
+    constexpr size_t FEC_HEADER_SIZE_MAX    = 8 + 2 + 14;
+
+    /* Repair packets list the protected SSRC as their only CSRC (RFC 8627 Sec. 4.2.1) */
+    constexpr size_t FEC_OVERHEAD_MAX       = sizeof(uint32_t) + FEC_HEADER_SIZE_MAX;
+
+    /* Flexible mask can cover packets at offsets 0..109 from the SN base */
+    constexpr size_t FEC_MASK_BITS          = 110;
+
+    /* How many received media packets are kept in memory for recovery */
+    constexpr size_t FEC_STORE_SIZE         = 512;
+
+    /* How many repair packets that could not yet be used are kept in memory */
+    constexpr size_t FEC_MAX_PENDING        = 64;
+
+    constexpr uint8_t FEC_DEFAULT_PAYLOAD   = 110;
+    constexpr ssize_t FEC_DEFAULT_ROW_LEN   = 10;
+
+    namespace fec_xor {
+        /* XOR "len" bytes of "src" into "dst" using the widest vector instructions
+         * the library was compiled for */
+        void xor_into(uint8_t *dst, const uint8_t *src, size_t len);
+    }
+
+    /* Forward error correction of RTP media streams as specified in RFC 8627 (FlexFEC).
+     *
+     * The sender XORs every outgoing media packet into row and column groups and
+     * sends a repair packet when a group is complete. Rows consist of L consecutive packets
+     * and columns of D packets spaced L sequence numbers apart. Together they form an L x D
+     * block where rows protect against random loss and columns against burst loss.
+     * All repair packets use the flexible mask so rows and columns share the same header format.
+     *
+     * The receiver keeps a copy of the recently received media packets. When a repair packet
+     * arrives and exactly one of the packets it protects is missing, that packet is recovered
+     * and fed back to the reception flow as if it had been received from the network.
+     * Repair packets with more than one missing packet are held until some other repair packet
+     * recovers enough packets for them, which makes row/column recovery iterative.
+     *
+     * Repair packets form a stream of their own with a separate SSRC (RCC_FEC_SSRC), payload type
+     * (RCC_FEC_PAYLOAD_TYPE) and sequence number space. The SSRC of the protected stream is carried
+     * only in the CSRC field. reception_flow maps the repair SSRC to the stream it protects. */
+    class fec {
+        public:
+            fec(std::shared_ptr<uvgrtp::rtp> rtp);
+            ~fec();
+
+            /* Set the number of consecutive packets protected by one row repair packet, 0 disables rows
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the value is out of range */
+            rtp_error_t set_row_length(ssize_t length);
+
+            /* Set the number of packets protected by one column repair packet, 0 disables columns
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the value is out of range */
+            rtp_error_t set_column_depth(ssize_t depth);
+
+            /* Return RTP_INVALID_VALUE if the payload type is not a valid 7-bit value or it is used by the media */
+            rtp_error_t set_payload_type(ssize_t payload);
+
+            /* Set the SSRC of the repair packets
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the SSRC is zero, out of range or the SSRC of the media */
+            rtp_error_t set_ssrc(ssize_t ssrc);
+
+            ssize_t get_row_length() const;
+            ssize_t get_column_depth() const;
+            uint8_t get_payload_type() const;
+            uint32_t get_ssrc() const;
+
+            /* XOR the packets of a transaction into the open row and column groups and append
+             * the repair packets of the completed groups to "packets".
+             *
+             * The memory of the repair packets is pushed to "storage" and released together with the transaction
+             *
+             * Return RTP_OK on success */
+            rtp_error_t protect(uvgrtp::pkt_vec& packets, std::vector<uint8_t *>& storage);
+
+            /* Receiver side packet handler, called before any other RTP handler
+             *
+             * Return RTP_PKT_NOT_HANDLED if the packet is a media packet that should be processed normally.
+             *   The packets it completed a held repair packet for are then available from recovered_getter()
+             * Return RTP_OK if the packet was consumed (repair packet or duplicate of a recovered packet)
+             * Return RTP_MULTIPLE_PKTS_READY if one or more media packets were recovered
+             * Return RTP_GENERIC_ERROR if the repair packet is malformed */
+            rtp_error_t packet_handler(void *args, int rce_flags, uint8_t *read_ptr, size_t size, frame::rtp_frame **out);
+
+            /* Fetch the next recovered media packet. The datagram is valid until the next call
+             *
+             * Return RTP_PKT_READY if "packet" points to a recovered datagram
+             * Return RTP_NOT_FOUND if there are no more recovered packets */
+            rtp_error_t recovered_getter(uint8_t **packet, size_t *size);
+
+            size_t get_recovered_packets() const;
+            size_t get_unrecoverable_repairs() const;
+
+        private:
+            struct group {
+                uint16_t sn_base = 0;
+                size_t   count   = 0;
+                uint8_t  mask[14] = {};
+                uint8_t  bitstring[8] = {};
+                std::vector<uint8_t> payload;
+                size_t   payload_len = 0;
+            };
+
+            struct stored_packet {
+                uint16_t seq = 0;
+                bool valid = false;
+                bool recovered = false;
+                std::vector<uint8_t> data;
+            };
+
+            void reset_group(group& g, uint16_t sn_base);
+            void add_to_group(group& g, uint16_t seq, uvgrtp::buf_vec& packet, size_t packet_len);
+            void emit_group(group& g, uint8_t *media_header, uvgrtp::pkt_vec& packets, std::vector<uint8_t *>& storage);
+
+            void store_packet(uint16_t seq, uint8_t *data, size_t size, bool recovered);
+            bool is_stored(uint16_t seq) const;
+            bool is_expired(uint16_t seq) const;
+
+            /* Try to recover the single missing packet of "repair"
+             *
+             * Return RTP_OK if a packet was recovered
+             * Return RTP_NOT_READY if more than one packet is missing
+             * Return RTP_NOT_FOUND if the repair packet is no longer useful
+             * Return RTP_GENERIC_ERROR if the repair packet is malformed */
+            rtp_error_t try_recover(const std::vector<uint8_t>& repair);
+            void retry_pending();
+
+            std::shared_ptr<uvgrtp::rtp> rtp_;
+
+            /* sender */
+            ssize_t row_length_;
+            ssize_t column_depth_;
+            uint8_t payload_;
+            uint32_t ssrc_;
+            uint16_t seq_;
+
+            group row_;
+            std::vector<group> columns_;
+            size_t block_pos_;
+
+            /* receiver */
+            std::vector<stored_packet> store_;
+            bool store_initialized_;
+            uint16_t highest_seq_;
+
+            std::deque<std::vector<uint8_t>> pending_;
+            std::deque<std::vector<uint8_t>> recovered_;
+            std::vector<uint8_t> current_;
+
+            size_t recovered_pkts_;
+            size_t unrecoverable_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
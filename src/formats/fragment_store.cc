@@ -0,0 +1,242 @@
+#include "fragment_store.hh"
+
+#include "uvgrtp/frame.hh"
+
+#include "debug.hh"
+
+#include <algorithm>
+
+uvgrtp::formats::fragment_store::fragment_store(size_t size):
+    slots_(),
+    mask_(0),
+    evicted_(0)
+{
+    size_t slots = 1;
+    while (slots < size && slots < (size_t(UINT16_MAX) + 1))
+        slots <<= 1;
+
+    slots_.resize(slots);
+    mask_ = slots - 1;
+}
+
+uvgrtp::formats::fragment_store::~fragment_store()
+{
+    for (auto& s : slots_)
+    {
+        if (s.frame)
+            (void)uvgrtp::frame::dealloc_frame(s.frame);
+    }
+}
+
+bool uvgrtp::formats::fragment_store::is_duplicate(uint32_t ts, uint16_t seq)
+{
+    slot& s = slots_[seq & mask_];
+
+    if ((s.state & FS_SEEN) && s.seq == seq && s.ts == ts)
+        return true;
+
+    if (s.state & FS_PRESENT)
+    {
+        UVG_LOG_DEBUG("Evicting fragment %u of timestamp %u, it was never reconstructed", s.seq, s.ts);
+        free_slot(s);
+        ++evicted_;
+    }
+
+    s.ts = ts;
+    s.seq = seq;
+    s.head = seq;
+    s.state = FS_SEEN;
+
+    return false;
+}
+
+bool uvgrtp::formats::fragment_store::insert(uvgrtp::frame::rtp_frame* frame, uint32_t ts, uint16_t seq,
+    bool start, bool end, link_result& linked)
+{
+    slot& s = slots_[seq & mask_];
+
+    if (s.seq != seq || s.ts != ts || (s.state & FS_PRESENT))
+        (void)is_duplicate(ts, seq);
+
+    s.frame = frame;
+    s.arrival = uvgrtp::clock::hrc::now();
+    s.state |= FS_PRESENT | (start ? FS_START : 0) | (end ? FS_END : 0);
+
+    if (start)
+    {
+        s.head = seq;
+        s.state |= FS_LINKED;
+    }
+    else
+    {
+        slot *prev = find(ts, uint16_t(seq - 1));
+
+        if (!prev || !(prev->state & FS_LINKED) || (prev->state & FS_END))
+            return false;
+
+        s.head = prev->head;
+        s.state |= FS_LINKED;
+    }
+
+    link_forward(s, ts, linked);
+    return true;
+}
+
+bool uvgrtp::formats::fragment_store::link_start(uint32_t ts, uint16_t seq, link_result& linked)
+{
+    slot *s = find(ts, seq);
+
+    if (!s || (s->state & FS_LINKED))
+        return false;
+
+    s->head = seq;
+    s->state |= FS_START | FS_LINKED;
+
+    link_forward(*s, ts, linked);
+    return true;
+}
+
+const uvgrtp::formats::fragment_store::slot* uvgrtp::formats::fragment_store::lookup(uint16_t seq) const
+{
+    const slot& s = slots_[seq & mask_];
+
+    if (!(s.state & FS_SEEN) || s.seq != seq)
+        return nullptr;
+
+    return &s;
+}
+
+uvgrtp::frame::rtp_frame* uvgrtp::formats::fragment_store::take(uint16_t seq)
+{
+    slot& s = slots_[seq & mask_];
+
+    if (!(s.state & FS_PRESENT) || s.seq != seq)
+        return nullptr;
+
+    uvgrtp::frame::rtp_frame* frame = s.frame;
+    s.frame = nullptr;
+
+    return frame;
+}
+
+void uvgrtp::formats::fragment_store::release(uint16_t seq)
+{
+    slot& s = slots_[seq & mask_];
+
+    if (!(s.state & FS_PRESENT) || s.seq != seq)
+    {
+        UVG_LOG_ERROR("Tried to free an already freed fragment with seq: %u", seq);
+        return;
+    }
+
+    free_slot(s);
+    s.state |= FS_RECONSTRUCTED;
+}
+
+size_t uvgrtp::formats::fragment_store::drop(uint32_t ts)
+{
+    size_t total_cleaned = 0;
+
+    for (auto& s : slots_)
+    {
+        if ((s.state & FS_PRESENT) && s.ts == ts)
+        {
+            if (s.frame)
+                total_cleaned += s.frame->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+
+            free_slot(s);
+        }
+    }
+
+    return total_cleaned;
+}
+
+void uvgrtp::formats::fragment_store::link_after_dropped(const std::vector<uint32_t>& dropped,
+    std::vector<link_result>& linked)
+{
+    for (auto& s : slots_)
+    {
+        if (!(s.state & FS_PRESENT) || (s.state & FS_LINKED))
+            continue;
+
+        /* the closest packet received before the fragment */
+        const slot *prev = nullptr;
+
+        for (size_t i = 1; i < slots_.size() && !prev; ++i)
+            prev = lookup(uint16_t(s.seq - i));
+
+        if (!prev || prev->ts == s.ts || (prev->state & FS_END) ||
+            std::find(dropped.begin(), dropped.end(), prev->ts) == dropped.end())
+        {
+            continue;
+        }
+
+        link_result result;
+
+        if (link_start(s.ts, s.seq, result) && result.complete)
+            linked.push_back(result);
+    }
+}
+
+void uvgrtp::formats::fragment_store::find_expired(size_t timeout, std::vector<uint32_t>& expired) const
+{
+    for (auto& s : slots_)
+    {
+        if ((s.state & FS_PRESENT) && uvgrtp::clock::hrc::diff_now(s.arrival) > timeout &&
+            std::find(expired.begin(), expired.end(), s.ts) == expired.end())
+        {
+            expired.push_back(s.ts);
+        }
+    }
+}
+
+uint64_t uvgrtp::formats::fragment_store::get_evicted() const
+{
+    return evicted_;
+}
+
+uvgrtp::formats::fragment_store::slot* uvgrtp::formats::fragment_store::find(uint32_t ts, uint16_t seq)
+{
+    slot& s = slots_[seq & mask_];
+
+    if (!(s.state & FS_PRESENT) || s.seq != seq || s.ts != ts)
+        return nullptr;
+
+    return &s;
+}
+
+void uvgrtp::formats::fragment_store::link_forward(slot& s, uint32_t ts, link_result& linked)
+{
+    linked.head = s.head;
+    linked.first = s.seq;
+    linked.last = s.seq;
+    linked.complete = false;
+
+    /* fragments after this one may have been waiting for it */
+    slot *cur = &s;
+
+    while (!(cur->state & FS_END))
+    {
+        slot *next = find(ts, uint16_t(linked.last + 1));
+
+        if (!next || (next->state & (FS_START | FS_LINKED)))
+            return;
+
+        next->head = s.head;
+        next->state |= FS_LINKED;
+
+        cur = next;
+        ++linked.last;
+    }
+
+    linked.complete = true;
+}
+
+void uvgrtp::formats::fragment_store::free_slot(slot& s)
+{
+    if (s.frame)
+        (void)uvgrtp::frame::dealloc_frame(s.frame);
+
+    s.frame = nullptr;
+    s.state &= ~(FS_PRESENT | FS_LINKED);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+#include "uvgrtp/clock.hh"
+
+#include <cstdint>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    namespace formats {
+
+        /* State bits of a fragment store slot */
+        enum FRAGMENT_SLOT_STATE {
+            FS_SEEN          = 1 << 0, /* the packet has been received, used for duplicate detection */
+            FS_PRESENT       = 1 << 1, /* the slot holds a fragment waiting for reconstruction */
+            FS_START         = 1 << 2, /* first fragment of a NAL unit or frame */
+            FS_END           = 1 << 3, /* last fragment of a NAL unit or frame */
+            FS_LINKED        = 1 << 4, /* all fragments from "head" to this one have been received */
+            FS_RECONSTRUCTED = 1 << 5  /* the fragment has been used for reconstruction */
+        };
+
+        /* Circular store of received fragments indexed by the low bits of the RTP sequence number.
+         *
+         * Each slot remembers which packet last used it so that duplicates are detected and
+         * fragments of one NAL unit or frame are found without any searching. Fragments that
+         * are still waiting when their slot is needed for a newer packet are evicted.
+         *
+         * Every fragment records the sequence number of the first fragment of its run once all
+         * fragments before it have been received. The head is propagated forward when a missing
+         * fragment arrives so each slot is linked only once and insertion is O(1) amortized */
+        class fragment_store {
+            public:
+                struct slot {
+                    uvgrtp::frame::rtp_frame *frame = nullptr;
+                    uvgrtp::clock::hrc::hrc_t arrival;
+                    uint32_t ts = 0;
+                    uint16_t seq = 0;
+                    uint16_t head = 0;
+                    uint8_t state = 0;
+                };
+
+                /* "size" is rounded up to a power of two */
+                fragment_store(size_t size);
+                ~fragment_store();
+
+                /* Return true if a packet with the same timestamp and sequence number
+                 * has already been received. Otherwise the slot of "seq" is claimed for the
+                 * packet and a fragment still waiting in it is evicted */
+                bool is_duplicate(uint32_t ts, uint16_t seq);
+
+                /* Fragments that were linked to a start fragment by insert() */
+                struct link_result {
+                    uint16_t head = 0;      /* sequence number of the start fragment */
+                    uint16_t first = 0;     /* first fragment that was linked */
+                    uint16_t last = 0;      /* last fragment that was linked */
+                    bool complete = false;  /* "last" is an end fragment */
+                };
+
+                /* Store "frame" to the slot claimed by is_duplicate()
+                 *
+                 * Return true if the fragment and possibly fragments after it that were waiting
+                 * for it were linked to a start fragment. "linked" is then set to describe them.
+                 * Fragments are always linked in sequence number order */
+                bool insert(uvgrtp::frame::rtp_frame *frame, uint32_t ts, uint16_t seq, bool start, bool end,
+                    link_result& linked);
+
+                /* Mark the waiting fragment "seq" of "ts" as a start fragment once it is known to be one,
+                 * for example after the end of the previous frame has been received
+                 *
+                 * Return true and set "linked" like insert() if the fragment was not linked before */
+                bool link_start(uint32_t ts, uint16_t seq, link_result& linked);
+
+                /* Return the slot of "seq" if that packet has been received, even if the fragment
+                 * has already been reconstructed or dropped. Return nullptr otherwise */
+                const slot *lookup(uint16_t seq) const;
+
+                /* Hand the fragment stored for "seq" over to the caller.
+                 * The slot keeps its state so that later fragments can still be linked through it
+                 *
+                 * Return nullptr if there is no fragment */
+                uvgrtp::frame::rtp_frame *take(uint16_t seq);
+
+                /* Free the fragment stored for "seq", if it has not been taken, and mark it reconstructed */
+                void release(uint16_t seq);
+
+                /* Free all fragments with timestamp "ts"
+                 *
+                 * Return the number of bytes freed */
+                size_t drop(uint32_t ts);
+
+                /* Mark the first waiting fragment after each unfinished frame of "dropped" as a start fragment.
+                 * The frames were dropped with their ends lost, so the packets lost between them and the fragment
+                 * are taken to be those ends. The complete frames that were linked are added to "linked" */
+                void link_after_dropped(const std::vector<uint32_t>& dropped, std::vector<link_result>& linked);
+
+                /* Add the timestamps of fragments that have waited more than "timeout" milliseconds to "expired" */
+                void find_expired(size_t timeout, std::vector<uint32_t>& expired) const;
+
+                /* Return the number of fragments evicted before they could be reconstructed */
+                uint64_t get_evicted() const;
+
+            private:
+                slot *find(uint32_t ts, uint16_t seq);
+
+                /* Link the fragments following the linked fragment "s" */
+                void link_forward(slot& s, uint32_t ts, link_result& linked);
+
+                void free_slot(slot& s);
+
+                std::vector<slot> slots_;
+                size_t mask_;
+                uint64_t evicted_;
+        };
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
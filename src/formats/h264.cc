@@ -90,6 +90,31 @@ uint8_t uvgrtp::formats::h264::get_nal_type(uint8_t* data) const
     return data[0] & 0x1f;
 }
 
+int uvgrtp::formats::h264::get_parameter_set_type(uint8_t* data) const
+{
+    switch (get_nal_type(data)) {
+        case H264_SPS: return uvgrtp::formats::PS_SPS;
+        case H264_PPS: return uvgrtp::formats::PS_PPS;
+    }
+
+    return -1;
+}
+
+uvgrtp::formats::nal_importance uvgrtp::formats::h264::classify_nal(uint8_t* data) const
+{
+    uvgrtp::formats::nal_importance importance;
+    uint8_t nal_type = get_nal_type(data);
+
+    // see ITU-T H.264 section 7.4.1, nal_ref_idc of zero means the slice is not used for reference
+    if (nal_type == H264_IDR) {
+        importance.priority = RTP_NAL_PRIORITY_INTRA;
+    } else if (nal_type >= H264_NON_IDR && nal_type < H264_IDR) {
+        importance.priority = ((data[0] >> 5) & 0x3) ? RTP_NAL_PRIORITY_REFERENCE : RTP_NAL_PRIORITY_NON_REFERENCE;
+    }
+
+    return importance;
+}
+
 void uvgrtp::formats::h264::clear_aggregation_info()
 {
     aggr_pkt_info_.nalus.clear();
@@ -24,6 +24,8 @@ namespace uvgrtp {
         enum H264_NAL_TYPES {
             H264_NON_IDR = 1,
             H264_IDR = 5,
+            H264_SPS = 7,
+            H264_PPS = 8,
             H264_STAP_A = 24,
             H264_STAP_B   = 25,
             H264_PKT_FRAG = 28
@@ -75,6 +77,10 @@ namespace uvgrtp {
                 virtual uvgrtp::formats::FRAG_TYPE get_fragment_type(uvgrtp::frame::rtp_frame* frame) const;
                 virtual uvgrtp::formats::NAL_TYPE  get_nal_type(uvgrtp::frame::rtp_frame* frame) const;
 
+                virtual uvgrtp::formats::nal_importance classify_nal(uint8_t* data) const;
+
+                virtual int get_parameter_set_type(uint8_t* data) const;
+
                 virtual void get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload);
 
                 virtual uvgrtp::frame::rtp_frame* allocate_rtp_frame_with_startcode(bool add_start_code,
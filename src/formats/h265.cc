@@ -66,6 +66,37 @@ uint8_t uvgrtp::formats::h265::get_nal_type(uint8_t* data) const
     return (data[0] >> 1) & 0x3f;
 }
 
+int uvgrtp::formats::h265::get_parameter_set_type(uint8_t* data) const
+{
+    switch (get_nal_type(data)) {
+        case H265_VPS: return uvgrtp::formats::PS_VPS;
+        case H265_SPS: return uvgrtp::formats::PS_SPS;
+        case H265_PPS: return uvgrtp::formats::PS_PPS;
+    }
+
+    return -1;
+}
+
+uvgrtp::formats::nal_importance uvgrtp::formats::h265::classify_nal(uint8_t* data) const
+{
+    uvgrtp::formats::nal_importance importance;
+    uint8_t nal_type = get_nal_type(data);
+    uint8_t tid_plus1 = data[1] & 0x7;
+
+    importance.temporal_id = tid_plus1 ? tid_plus1 - 1 : 0;
+
+    // see ITU-T H.265 table 7-1
+    if (nal_type >= H265_BLA_W_LP && nal_type <= H265_RSV_IRAP_23) {
+        importance.priority = RTP_NAL_PRIORITY_INTRA;
+    } else if (nal_type < H265_BLA_W_LP) {
+        /* even types are sub-layer non-reference pictures */
+        importance.priority = (nal_type & 0x1) ? RTP_NAL_PRIORITY_REFERENCE : RTP_NAL_PRIORITY_NON_REFERENCE;
+        importance.sublayer_switch = nal_type >= H265_TSA_N && nal_type <= H265_STSA_R;
+    }
+
+    return importance;
+}
+
 uvgrtp::formats::FRAG_TYPE uvgrtp::formats::h265::get_fragment_type(uvgrtp::frame::rtp_frame* frame) const
 {
     bool first_frag = frame->payload[2] & 0x80; // S bit
@@ -24,7 +24,14 @@ namespace uvgrtp {
 
         enum H265_NAL_TYPES {
             H265_TRAIL_R = 1,
+            H265_TSA_N = 2,
+            H265_STSA_R = 5,
+            H265_BLA_W_LP = 16,
             H265_IDR_W_RADL = 19,
+            H265_RSV_IRAP_23 = 23,
+            H265_VPS = 32,
+            H265_SPS = 33,
+            H265_PPS = 34,
             H265_PKT_AGGR = 48,
             H265_PKT_FRAG = 49
         };
@@ -73,6 +80,10 @@ namespace uvgrtp {
                 virtual uvgrtp::formats::FRAG_TYPE get_fragment_type(uvgrtp::frame::rtp_frame* frame) const;
                 virtual uvgrtp::formats::NAL_TYPE  get_nal_type(uvgrtp::frame::rtp_frame* frame) const;
 
+                virtual uvgrtp::formats::nal_importance classify_nal(uint8_t* data) const;
+
+                virtual int get_parameter_set_type(uint8_t* data) const;
+
                 virtual void get_nal_header_from_fu_headers(size_t fptr, uint8_t* frame_payload, uint8_t* complete_payload);
 
             private:
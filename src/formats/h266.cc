@@ -68,6 +68,36 @@ uint8_t uvgrtp::formats::h266::get_nal_type(uint8_t* data) const
     return (data[1] >> 3) & 0x1f;
 }
 
+int uvgrtp::formats::h266::get_parameter_set_type(uint8_t* data) const
+{
+    switch (get_nal_type(data)) {
+        case H266_VPS: return uvgrtp::formats::PS_VPS;
+        case H266_SPS: return uvgrtp::formats::PS_SPS;
+        case H266_PPS: return uvgrtp::formats::PS_PPS;
+    }
+
+    return -1;
+}
+
+uvgrtp::formats::nal_importance uvgrtp::formats::h266::classify_nal(uint8_t* data) const
+{
+    uvgrtp::formats::nal_importance importance;
+    uint8_t nal_type = get_nal_type(data);
+    uint8_t tid_plus1 = data[1] & 0x7;
+
+    importance.temporal_id = tid_plus1 ? tid_plus1 - 1 : 0;
+
+    // see ITU-T H.266 table 5, the NAL unit header does not tell whether the picture is used for reference
+    if (nal_type >= H266_IDR_W_RADL && nal_type <= H266_GDR) {
+        importance.priority = RTP_NAL_PRIORITY_INTRA;
+    } else if (nal_type < H266_IDR_W_RADL) {
+        importance.priority = RTP_NAL_PRIORITY_REFERENCE;
+        importance.sublayer_switch = nal_type == H266_STSA_NUT;
+    }
+
+    return importance;
+}
+
 uvgrtp::formats::FRAG_TYPE uvgrtp::formats::h266::get_fragment_type(uvgrtp::frame::rtp_frame* frame) const
 {
     bool first_frag = frame->payload[2] & 0x80;
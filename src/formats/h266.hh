@@ -22,7 +22,12 @@ namespace uvgrtp {
 
         enum H266_NAL_TYPES {
             H266_TRAIL_NUT = 0,
+            H266_STSA_NUT = 1,
             H266_IDR_W_RADL = 7,
+            H266_GDR = 10,
+            H266_VPS = 14,
+            H266_SPS = 15,
+            H266_PPS = 16,
             H266_PKT_AGGR = 28,
             H266_PKT_FRAG = 29
         };
@@ -71,6 +76,10 @@ namespace uvgrtp {
                 virtual uint8_t get_start_code_range() const;
                 virtual uvgrtp::formats::FRAG_TYPE get_fragment_type(uvgrtp::frame::rtp_frame* frame) const;
                 virtual uvgrtp::formats::NAL_TYPE  get_nal_type(uvgrtp::frame::rtp_frame* frame) const;
+
+                virtual uvgrtp::formats::nal_importance classify_nal(uint8_t* data) const;
+
+                virtual int get_parameter_set_type(uint8_t* data) const;
         
             private:
                 h266_aggregation_packet aggr_pkt_info_;
@@ -1,12 +1,15 @@
 #include "h26x.hh"
 
+#include "uvgrtp/rtcp.hh"
+
+#include "start_code.hh"
 #include "socket.hh"
+#include "thread_pool.hh"
 
 #include "rtp.hh"
 #include "frame_queue.hh"
 #include "debug.hh"
 
-
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -43,8 +46,20 @@
 
 constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
 
-// any value less than 30 minutes is ok here, since that is how long it takes to go through all timestamps
-constexpr int TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS = 5000;
+/* Number of sequence numbers the fragment store keeps track of. Fragments of a NAL unit
+ * must arrive within this many packets from each other to be reconstructed */
+constexpr size_t FRAGMENT_STORE_SIZE = 1 << 14;
+
+/* Fragment count the output buffer of the first reassembled NAL unit is sized for */
+constexpr size_t INITIAL_EXPECTED_FRAGMENTS = 8;
+
+/* Upper limit for the fragment count the output buffer is sized for. One large NAL unit
+ * (such as an IDR slice) must not inflate the allocations of all the following ones,
+ * larger NAL units grow their buffer while they are being reassembled */
+constexpr size_t MAX_EXPECTED_FRAGMENTS = 32;
+
+/* No temporal sub-layer is being shed */
+constexpr uint8_t NO_SHED_TID = UINT8_MAX;
 
 static inline uint8_t determine_start_prefix_precense(uint32_t value, bool& additional_byte)
 {
@@ -95,36 +110,44 @@ static inline uint8_t determine_start_prefix_precense(uint32_t value, bool& addi
 
 uvgrtp::formats::h26x::h26x(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp, int rce_flags) :
     media(socket, rtp, rce_flags),
-    queued_(), 
+    fragments_(FRAGMENT_STORE_SIZE),
+    assemblies_(),
+    expected_fragments_(INITIAL_EXPECTED_FRAGMENTS),
     access_units_(),
-    seen_order_(),
-    seen_packets_(),
-    fragments_(),
+    marker_seq_(0),
+    marker_seq_valid_(false),
     dropped_ts_(),
     dropped_in_order_(),
     rtp_ctx_(rtp),
     last_garbage_collection_(uvgrtp::clock::hrc::now()),
-    discard_until_key_frame_(true)
+    discard_until_key_frame_(true),
+    media_ssrc_(0),
+    chunk_hook_(nullptr),
+    slice_frame_open_(false),
+    slice_frame_started_(false),
+    slice_packet_held_(false),
+    shed_tid_(NO_SHED_TID),
+    frame_packets_sent_(false),
+    parameter_sets_sent_(uvgrtp::clock::hrc::now()),
+    delivered_parameter_sets_(0),
+    keyframe_delivered_(false)
 {}
 
 uvgrtp::formats::h26x::~h26x()
 {
-    for (auto& frame : queued_)
+    for (auto& assembly : assemblies_)
     {
-        (void)uvgrtp::frame::dealloc_frame(frame);
+        (void)uvgrtp::frame::dealloc_frame(assembly.second.frame);
     }
 
-    queued_.clear();
+    assemblies_.clear();
 
-    for (auto& fragment : fragments_)
+    for (auto& au : access_units_)
     {
-        if (fragment.second != nullptr)
-        {
-            (void)uvgrtp::frame::dealloc_frame(fragment.second);
-        }
+        free_access_unit(au);
     }
 
-    fragments_.clear();
+    access_units_.clear();
 }
 
 /* NOTE: the area 0 - len (ie data[0] - data[len - 1]) must be addressable
@@ -134,6 +157,28 @@ ssize_t uvgrtp::formats::h26x::find_h26x_start_code(
     size_t len,
     size_t offset,
     uint8_t& start_len)
+{
+    static const uvgrtp::formats::start_code_finder simd_finder = uvgrtp::formats::get_start_code_finder();
+
+    if (!simd_finder)
+    {
+        return find_h26x_start_code_scalar(data, len, offset, start_len);
+    }
+
+    if (data == nullptr || len < offset || len < 1)
+    {
+        UVG_LOG_WARN("Invalid parameter found for start code lookup");
+        return -1;
+    }
+
+    return simd_finder(data, len, offset, start_len);
+}
+
+ssize_t uvgrtp::formats::h26x::find_h26x_start_code_scalar(
+    uint8_t *data,
+    size_t len,
+    size_t offset,
+    uint8_t& start_len)
 {
     if (data == nullptr || len < offset || len < 1)
     {
@@ -299,30 +344,96 @@ ssize_t uvgrtp::formats::h26x::find_h26x_start_code(
         }
     }
 
+    /* The dwords above do not cover a prefix that ends the buffer */
+    if (len >= offset + 3 && data[len - 3] == 0 && data[len - 2] == 0 && data[len - 1] == 1) {
+        start_len = (len - 3 > offset && data[len - 4] == 0) ? 4 : 3;
+        return len;
+    }
+
     return -1;
 }
 
-rtp_error_t uvgrtp::formats::h26x::frame_getter(uvgrtp::frame::rtp_frame** frame)
+rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data, size_t data_len, int rtp_flags, uint32_t ssrc)
 {
-    if (queued_.size()) {
-        *frame = queued_.front();
-        queued_.pop_front();
-        return RTP_PKT_READY;
+    return push_nal_data(addr, addr6, data, data_len, rtp_flags, ssrc, false, true, false);
+}
+
+rtp_error_t uvgrtp::formats::h26x::begin_frame()
+{
+    if (slice_packet_held_) {
+        UVG_LOG_WARN("The previous frame was not ended, its last packet is discarded");
+        (void)fqueue_->deinit_transaction();
     }
 
-    return RTP_NOT_FOUND;
+    slice_frame_open_    = true;
+    slice_frame_started_ = false;
+    slice_packet_held_   = false;
+
+    return RTP_OK;
 }
 
-rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data, size_t data_len, int rtp_flags, uint32_t ssrc)
+rtp_error_t uvgrtp::formats::h26x::push_slice(sockaddr_in& addr, sockaddr_in6& addr6,
+    uint8_t* data, size_t data_len, int rtp_flags, uint32_t ssrc)
 {
     rtp_error_t ret = RTP_OK;
 
     if (!data || !data_len)
         return RTP_INVALID_VALUE;
 
-    /* This is the first call of init_transaction. It generates a new RTP timestamp. The init_transaction() calls
-       below will use the same RTP timestamp. */
-    if ((ret = fqueue_->init_transaction(data)) != RTP_OK) {
+    if (!slice_frame_open_) {
+        UVG_LOG_ERROR("begin_frame() must be called before pushing slices");
+        return RTP_NOT_READY;
+    }
+
+    /* the packet held back from the previous slice does not end the frame */
+    if (slice_packet_held_)
+    {
+        slice_packet_held_ = false;
+
+        if ((ret = fqueue_->flush_queue(addr, addr6, ssrc, false)) != RTP_OK)
+            return ret;
+    }
+
+    ret = push_nal_data(addr, addr6, data, data_len, rtp_flags, ssrc, slice_frame_started_, false, true);
+    slice_frame_started_ = true;
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::formats::h26x::end_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc)
+{
+    if (!slice_frame_open_) {
+        UVG_LOG_ERROR("begin_frame() must be called before ending a frame");
+        return RTP_NOT_READY;
+    }
+
+    slice_frame_open_ = false;
+
+    if (!slice_frame_started_) {
+        UVG_LOG_ERROR("No slices were pushed for the frame");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* every NAL unit of the last slice was shed to meet the latency budget */
+    if (!slice_packet_held_)
+        return RTP_OK;
+
+    slice_packet_held_ = false;
+
+    return fqueue_->flush_queue(addr, addr6, ssrc, true);
+}
+
+rtp_error_t uvgrtp::formats::h26x::push_nal_data(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t* data, size_t data_len,
+    int rtp_flags, uint32_t ssrc, bool old_rtp_ts, bool end_of_frame, bool hold_last)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (!data || !data_len)
+        return RTP_INVALID_VALUE;
+
+    /* This is the first call of init_transaction. It generates a new RTP timestamp unless the frame
+       is sent in parts. The init_transaction() calls below will use the same RTP timestamp. */
+    if ((ret = fqueue_->init_transaction(data, old_rtp_ts)) != RTP_OK) {
         UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
         return ret;
     }
@@ -337,6 +448,7 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
 
     if ((rtp_flags & RTP_NO_H26X_SCL) || (fmt == RTP_FORMAT_ATLAS)) {
         nal_info nal;
+        nal.data = data;
         nal.offset = 0;
         nal.prefix_len = 0;
         nal.size = data_len;
@@ -355,6 +467,81 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
         return RTP_INVALID_VALUE;
     }
 
+    return send_nal_units(addr, addr6, nals, should_aggregate, rtp_flags, ssrc, !old_rtp_ts, end_of_frame, hold_last);
+}
+
+rtp_error_t uvgrtp::formats::h26x::push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6,
+    const uvgrtp::frame::nal_unit* nals, size_t count, int rtp_flags, uint32_t ssrc)
+{
+    rtp_error_t ret = RTP_OK;
+
+    if (!nals || !count)
+        return RTP_INVALID_VALUE;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!nals[i].data || !nals[i].len)
+        {
+            UVG_LOG_ERROR("NAL unit %zu of %zu is empty", i, count);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    if ((ret = fqueue_->init_transaction(nals[0].data)) != RTP_OK) {
+        UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
+        return ret;
+    }
+
+    std::vector<nal_info> units(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        units[i].data = nals[i].data;
+        units[i].size = nals[i].len;
+    }
+
+    bool should_aggregate = false;
+    mark_aggregatable(units, rtp_ctx_->get_payload_size(), should_aggregate);
+
+    return send_nal_units(addr, addr6, units, should_aggregate, rtp_flags, ssrc, true, true, false);
+}
+
+rtp_error_t uvgrtp::formats::h26x::send_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, std::vector<nal_info>& nals,
+    bool should_aggregate, int rtp_flags, uint32_t ssrc, bool start_of_frame, bool end_of_frame, bool hold_last)
+{
+    rtp_error_t ret = RTP_OK;
+    size_t payload_size = rtp_ctx_->get_payload_size();
+
+    if ((rce_flags_ & RCE_H26X_PARAMETER_SETS) && insert_parameter_sets(nals, start_of_frame))
+    {
+        for (auto& nal : nals)
+            nal.aggregate = false;
+
+        mark_aggregatable(nals, payload_size, should_aggregate);
+    }
+
+    if (start_of_frame)
+        frame_packets_sent_ = false;
+
+    if (fqueue_->get_latency_budget().count() > 0)
+    {
+        /* once packets of the frame have been sent, the last part must be sent to end the access unit */
+        shed_nal_units(nals, (end_of_frame || hold_last) && frame_packets_sent_);
+
+        if (nals.empty())
+        {
+            fqueue_->deinit_transaction();
+            return RTP_OK;
+        }
+
+        /* the aggregation packet is built from the leading NAL units marked for aggregation */
+        size_t aggregated = 0;
+        while (aggregated < nals.size() && nals[aggregated].aggregate)
+            ++aggregated;
+
+        should_aggregate = should_aggregate && aggregated >= 2;
+    }
+
     bool do_not_aggr = (rtp_flags & RTP_H26X_DO_NOT_AGGR);
 
     if (should_aggregate && !do_not_aggr) // an aggregate packet is possible
@@ -368,7 +555,7 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
             if (nal.aggregate)
             {
                 nal.was_aggregated = true;
-                if ((ret = add_aggregate_packet(data + nal.offset, nal.size)) != RTP_OK)
+                if ((ret = add_aggregate_packet(nal.data, nal.size)) != RTP_OK)
                 {
                     clear_aggregation_info();
                     fqueue_->deinit_transaction();
@@ -381,16 +568,23 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
         }
 
         (void)finalize_aggregation_pkt();
-        // actually send the packets
-        ret = fqueue_->flush_queue(addr, addr6, ssrc);
+        // actually send the packets, the marker bit ends the access unit if every NAL unit was aggregated
+        if (hold_last && nals.back().was_aggregated) {
+            ret = fqueue_->flush_queue_except_last(addr, addr6, ssrc);
+            slice_packet_held_ = (ret == RTP_OK);
+        } else {
+            ret = fqueue_->flush_queue(addr, addr6, ssrc, end_of_frame && nals.back().was_aggregated);
+        }
         clear_aggregation_info();
     }
 
     for (auto& nal : nals) // non-aggregatable NAL units
     {
+        bool last = end_of_frame && (&nal == &nals.back());
+
         if (do_not_aggr || !nal.was_aggregated || !should_aggregate)
         {
-            if ((ret = fqueue_->init_transaction(data + nal.offset, true)) != RTP_OK) {
+            if ((ret = fqueue_->init_transaction(nal.data, true)) != RTP_OK) {
                 UVG_LOG_ERROR("Invalid frame queue or failed to initialize transaction!");
                 return ret;
             }
@@ -398,11 +592,11 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
             // add anything extra to the packet and we can just compare the NAL size with the payload size allowed
             if (nal.size <= payload_size) // send as a single NAL unit packet
             {
-                ret = single_nal_unit(data + nal.offset, nal.size);
+                ret = single_nal_unit(nal.data, nal.size, last);
             }
             else // send divided based on payload_size
             {
-                ret = fu_division(&data[nal.offset], nal.size, payload_size);
+                ret = fu_division(nal.data, nal.size, payload_size);
             }
 
             if (ret != RTP_OK)
@@ -411,16 +605,251 @@ rtp_error_t uvgrtp::formats::h26x::push_media_frame(sockaddr_in& addr, sockaddr_
                 fqueue_->deinit_transaction();
                 return ret;
             }
-            ret = fqueue_->flush_queue(addr, addr6, ssrc);
+            // the marker bit is set only in the last packet of the access unit
+            if (hold_last && &nal == &nals.back()) {
+                ret = fqueue_->flush_queue_except_last(addr, addr6, ssrc);
+                slice_packet_held_ = (ret == RTP_OK);
+            } else {
+                ret = fqueue_->flush_queue(addr, addr6, ssrc, last);
+            }
         }
     }
+
+    frame_packets_sent_ = true;
     return ret;
 }
 
+uvgrtp::formats::nal_importance uvgrtp::formats::h26x::classify_nal(uint8_t* data) const
+{
+    (void)data;
+    return nal_importance();
+}
+
+int uvgrtp::formats::h26x::get_parameter_set_type(uint8_t* data) const
+{
+    (void)data;
+    return -1;
+}
+
+bool uvgrtp::formats::h26x::insert_parameter_sets(std::vector<nal_info>& nals, bool start_of_frame)
+{
+    bool present[PS_COUNT] = { false, false, false };
+    bool intra = false;
+
+    for (auto& nal : nals)
+    {
+        int type = get_parameter_set_type(nal.data);
+
+        if (type >= 0) {
+            parameter_sets_[type].assign(nal.data, nal.data + nal.size);
+            present[type] = true;
+        }
+        else if (classify_nal(nal.data).priority == RTP_NAL_PRIORITY_INTRA) {
+            intra = true;
+        }
+    }
+
+    bool interval_passed = parameter_set_interval_ &&
+        uvgrtp::clock::hrc::diff_now(parameter_sets_sent_) >= parameter_set_interval_;
+
+    std::vector<nal_info> missing;
+
+    for (int i = 0; i < PS_COUNT; ++i)
+    {
+        if (present[i]) {
+            parameter_sets_sent_ = uvgrtp::clock::hrc::now();
+        }
+        else if (!parameter_sets_[i].empty()) {
+            nal_info ps;
+            ps.data = parameter_sets_[i].data();
+            ps.size = parameter_sets_[i].size();
+            missing.push_back(ps);
+        }
+    }
+
+    /* the later parts of a frame sent with push_slice() only update the cache */
+    if (!start_of_frame || missing.empty() || (!intra && !interval_passed))
+        return false;
+
+    UVG_LOG_DEBUG("Inserting %zu cached parameter sets to the frame", missing.size());
+
+    for (auto& ps : missing)
+    {
+        int type = get_parameter_set_type(ps.data);
+        auto pos = std::find_if(nals.begin(), nals.end(), [&](const nal_info& nal) {
+            return is_parameter_set_position(nal.data, type);
+        });
+        nals.insert(pos, ps);
+    }
+    parameter_sets_sent_ = uvgrtp::clock::hrc::now();
+
+    return true;
+}
+
+bool uvgrtp::formats::h26x::is_parameter_set_position(uint8_t* nal, int type) const
+{
+    return get_parameter_set_type(nal) > type || classify_nal(nal).priority != RTP_NAL_PRIORITY_NON_VCL;
+}
+
+int uvgrtp::formats::h26x::cache_received_parameter_set(uint8_t* nal, size_t len)
+{
+    int type = get_parameter_set_type(nal);
+
+    if (type >= 0)
+        received_parameter_sets_[type].assign(nal, nal + len);
+
+    return type;
+}
+
+void uvgrtp::formats::h26x::prepend_parameter_sets(access_unit& au)
+{
+    bool intra = false;
+
+    for (auto& nal : au.nals)
+    {
+        int type = get_parameter_set_type(nal.second->payload);
+
+        if (type >= 0)
+            delivered_parameter_sets_ |= 1 << type;
+        else if (classify_nal(nal.second->payload).priority == RTP_NAL_PRIORITY_INTRA)
+            intra = true;
+    }
+
+    if (!intra)
+        return;
+
+    for (int i = 0; i < PS_COUNT; ++i)
+    {
+        if (received_parameter_sets_[i].empty() || (delivered_parameter_sets_ & (1 << i)))
+            continue;
+
+        uvgrtp::frame::rtp_frame* ps = uvgrtp::frame::alloc_rtp_frame(received_parameter_sets_[i].size());
+        ps->header = au.header;
+        std::memcpy(ps->payload, received_parameter_sets_[i].data(), received_parameter_sets_[i].size());
+
+        auto pos = std::find_if(au.nals.begin(), au.nals.end(), [&](const std::pair<uint16_t, uvgrtp::frame::rtp_frame*>& nal) {
+            return is_parameter_set_position(nal.second->payload, i);
+        });
+        au.nals.insert(pos, std::pair<uint16_t, uvgrtp::frame::rtp_frame*>(au.nals.front().first, ps));
+        au.size += ps->payload_len;
+        delivered_parameter_sets_ |= 1 << i;
+    }
+
+    keyframe_delivered_ = true;
+}
+
+static bool is_sheddable(const uvgrtp::formats::nal_importance& nal)
+{
+    return nal.priority == RTP_NAL_PRIORITY_REFERENCE || nal.priority == RTP_NAL_PRIORITY_NON_REFERENCE;
+}
+
+/* Non-reference slices go first and within a class the highest temporal sub-layer goes first */
+static bool is_less_important(const uvgrtp::formats::nal_importance& a, const uvgrtp::formats::nal_importance& b)
+{
+    if (a.priority != b.priority)
+        return a.priority > b.priority;
+
+    return a.temporal_id > b.temporal_id;
+}
+
+void uvgrtp::formats::h26x::shed_nal_units(std::vector<nal_info>& nals, bool keep_last)
+{
+    std::vector<nal_importance> importance(nals.size());
+    std::vector<bool> shed(nals.size(), false);
+
+    for (size_t i = 0; i < nals.size(); ++i)
+    {
+        importance[i] = classify_nal(nals[i].data);
+
+        /* an intra NAL unit starts a new reference chain and a switching point restarts its own sub-layer */
+        if (importance[i].priority == RTP_NAL_PRIORITY_INTRA)
+        {
+            shed_tid_ = NO_SHED_TID;
+        }
+        else if (importance[i].sublayer_switch && importance[i].temporal_id == shed_tid_)
+        {
+            shed_tid_ = importance[i].temporal_id + 1;
+        }
+    }
+
+    size_t total_size = 0;
+
+    for (size_t i = 0; i < nals.size(); ++i)
+    {
+        if (is_sheddable(importance[i]) && importance[i].temporal_id >= shed_tid_)
+        {
+            shed[i] = true;
+        }
+        else
+        {
+            total_size += nals[i].size;
+        }
+    }
+
+    while (fqueue_->estimate_send_time(total_size) > fqueue_->get_latency_budget())
+    {
+        ssize_t least = -1;
+
+        for (size_t i = 0; i < nals.size(); ++i)
+        {
+            if (!shed[i] && is_sheddable(importance[i]) &&
+                (least < 0 || is_less_important(importance[i], importance[least])))
+            {
+                least = (ssize_t)i;
+            }
+        }
+
+        if (least < 0)
+            break;
+
+        nal_importance level = importance[least];
+
+        /* Pictures of higher sub-layers may reference a sub-layer non-reference picture
+         * so they are shed as well, a reference picture breaks its own sub-layer too */
+        uint8_t broken_tid = (level.priority == RTP_NAL_PRIORITY_NON_REFERENCE) ? level.temporal_id + 1 : level.temporal_id;
+        shed_tid_ = std::min(shed_tid_, broken_tid);
+
+        for (size_t i = 0; i < nals.size(); ++i)
+        {
+            if (shed[i] || !is_sheddable(importance[i]))
+                continue;
+
+            if ((importance[i].priority == level.priority && importance[i].temporal_id == level.temporal_id) ||
+                importance[i].temporal_id >= shed_tid_)
+            {
+                shed[i] = true;
+                total_size -= nals[i].size;
+            }
+        }
+    }
+
+    if (keep_last && !nals.empty() && std::find(shed.begin(), shed.end(), false) == shed.end())
+    {
+        UVG_LOG_DEBUG("Keeping the last NAL unit of the frame so that its access unit is ended");
+        shed.back() = false;
+    }
+
+    size_t kept = 0;
+
+    for (size_t i = 0; i < nals.size(); ++i)
+    {
+        if (!shed[i])
+            nals[kept++] = nals[i];
+        else
+            fqueue_->add_shed_bytes(importance[i].priority, nals[i].size);
+    }
+
+    if (kept < nals.size())
+    {
+        UVG_LOG_DEBUG("Shed %zu of %zu NAL units to stay within the latency budget", nals.size() - kept, nals.size());
+        nals.resize(kept);
+    }
+}
+
 rtp_error_t uvgrtp::formats::h26x::add_aggregate_packet(uint8_t* data, size_t data_len)
 {
     // the default implementation is to just use single NAL units and don't do the aggregate packet
-    return single_nal_unit(data, data_len);
+    return single_nal_unit(data, data_len, false);
 }
 
 rtp_error_t uvgrtp::formats::h26x::finalize_aggregation_pkt()
@@ -431,12 +860,12 @@ rtp_error_t uvgrtp::formats::h26x::finalize_aggregation_pkt()
 void uvgrtp::formats::h26x::clear_aggregation_info()
 {}
 
-rtp_error_t uvgrtp::formats::h26x::single_nal_unit(uint8_t* data, size_t data_len)
+rtp_error_t uvgrtp::formats::h26x::single_nal_unit(uint8_t* data, size_t data_len, bool set_marker)
 {
     // single NAL unit packets use NAL header directly as payload header so the packet is
     // correct as is
     rtp_error_t ret = RTP_OK;
-    if ((ret = fqueue_->enqueue_message(data, data_len)) != RTP_OK) {
+    if ((ret = fqueue_->enqueue_message(data, data_len, set_marker)) != RTP_OK) {
         UVG_LOG_ERROR("Failed to enqueue single h26x NAL Unit packet!");
     }
 
@@ -554,28 +983,56 @@ void uvgrtp::formats::h26x::prepend_start_code(int rce_flags, uvgrtp::frame::rtp
 
 size_t uvgrtp::formats::h26x::drop_access_unit(uint32_t ts)
 {
-    size_t total_cleaned = 0;
-    if (access_units_.find(ts) == access_units_.end())
+    size_t total_cleaned = fragments_.drop(ts);
+
+    for (auto it = assemblies_.begin(); it != assemblies_.end();)
     {
-        UVG_LOG_ERROR("Tried to drop a non-existing frame");
-        return total_cleaned;
+        if (it->second.ts == ts)
+        {
+            if (it->second.delivered) {
+                (void)deliver_chunk(it->first, it->second, RTP_NAL_CHUNK_LOST);
+            }
+
+            total_cleaned += it->second.frame->payload_len + sizeof(uvgrtp::frame::rtp_frame);
+            (void)uvgrtp::frame::dealloc_frame(it->second.frame);
+            it = assemblies_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
     }
 
-    /*
-    uint16_t s_seq = frames_.at(ts).s_seq;
-    uint16_t e_seq = frames_.at(ts).e_seq;
+    for (auto it = access_units_.begin(); it != access_units_.end(); ++it)
+    {
+        if (it->ts == ts)
+        {
+            if (it->marker) {
+                marker_seq_ = it->header.seq;
+                marker_seq_valid_ = true;
+            }
+
+            total_cleaned += it->size;
+            free_access_unit(*it);
+            access_units_.erase(it);
+            break;
+        }
+    }
 
-    UVG_LOG_INFO("Dropping frame. Ts: %lu, Seq: %u <-> %u, received/expected: %lli/%lli",
-        ts, s_seq, e_seq, frames_[ts].received_packet_seqs.size(), calculate_expected_fus(ts));
-    */
+    close_access_unit(ts);
+    discard_until_key_frame_ = true;
 
-    for (auto& fragment_seq : access_units_[ts].incomplete_packet_seqs)
-    {
-        total_cleaned += fragments_[fragment_seq]->payload_len + sizeof(uvgrtp::frame::rtp_frame);
-        free_fragment(fragment_seq);
+    // the following frames cannot be decoded before the sender sends a keyframe
+    if (rtcp_) {
+        (void)rtcp_->request_keyframe(media_ssrc_);
     }
 
-    dropped_ts_[ts] = access_units_.at(ts).sframe_time;
+    return total_cleaned;
+}
+
+void uvgrtp::formats::h26x::close_access_unit(uint32_t ts)
+{
+    dropped_ts_[ts] = uvgrtp::clock::hrc::now();
     dropped_in_order_.insert(ts);
 
     if (dropped_ts_.size() > 600) {
@@ -583,12 +1040,6 @@ size_t uvgrtp::formats::h26x::drop_access_unit(uint32_t ts)
         dropped_ts_.erase(oldest_ts);
         dropped_in_order_.erase(oldest_ts);
     }
-
-    access_units_.erase(ts);
-
-    discard_until_key_frame_ = true;
-
-    return total_cleaned;
 }
 
 rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_frame** out, 
@@ -636,34 +1087,213 @@ rtp_error_t uvgrtp::formats::h26x::handle_aggregation_packet(uvgrtp::frame::rtp_
     return RTP_MULTIPLE_PKTS_READY;
 }
 
-bool uvgrtp::formats::h26x::is_duplicate_frame(uint32_t timestamp, uint16_t seq_num)
+rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out)
 {
-    while (!seen_order_.empty() &&
-           uvgrtp::clock::hrc::diff_now(seen_order_.front().arrival) > TIME_TO_KEEP_TRACK_OF_PREVIOUS_FRAMES_MS)
-    {
-        seen_packets_.erase(seen_order_.front().key);
-        seen_order_.pop_front();
+    (void)args;
+    (void)read_ptr;
+    (void)size;
+
+    if (rce_flags & RCE_H26X_ACCESS_UNITS)
+        return collect_access_units(rce_flags, out);
+
+    return depacketize(rce_flags, out);
+}
+
+rtp_error_t uvgrtp::formats::h26x::collect_access_units(int rce_flags, uvgrtp::frame::rtp_frame** out)
+{
+    uvgrtp::frame::rtp_header header = (*out)->header;
+    std::vector<uvgrtp::frame::rtp_frame*> ready;
+
+    // access units that have waited too long are delivered as they are before garbage collection drops them
+    size_t expired = 0;
+    for (size_t i = 0; i < access_units_.size(); ++i) {
+        if (uvgrtp::clock::hrc::diff_now(access_units_[i].started) > rtp_ctx_->get_pkt_max_delay())
+            expired = i + 1;
     }
 
-    const uint64_t key = (uint64_t(timestamp) << 16) | uint64_t(seq_num);
-    if (seen_packets_.find(key) != seen_packets_.end()) {
-        UVG_LOG_WARN("duplicate ts and seq num received, discarding frame");
+    finish_access_units(expired, rce_flags, ready);
+
+    // the start codes are added when the NAL units are merged
+    rtp_error_t ret = depacketize(rce_flags | RCE_NO_H26X_PREPEND_SC, out);
+
+    if (ret == RTP_OK || ret == RTP_PKT_READY || ret == RTP_MULTIPLE_PKTS_READY) {
+        access_unit& au = get_access_unit(header);
+
+        ++au.packets;
+
+        if (header.marker) {
+            au.marker = true;
+            au.header = header;
+        }
+
+        std::vector<uvgrtp::frame::rtp_frame*> nals;
+
+        if (ret == RTP_PKT_READY) {
+            nals.push_back(*out);
+        }
+
+        while (ret == RTP_MULTIPLE_PKTS_READY && !queued_.empty()) {
+            nals.push_back(queued_.front());
+            queued_.pop_front();
+        }
+
+        for (auto nal : nals) {
+            // parameter sets are cached even if their access unit is never delivered
+            if ((rce_flags & RCE_H26X_PARAMETER_SETS) && !keyframe_delivered_)
+                (void)cache_received_parameter_set(nal->payload, nal->payload_len);
+
+            au.nals.push_back(std::pair<uint16_t, uvgrtp::frame::rtp_frame*>((uint16_t)nal->header.seq, nal));
+            au.size += nal->payload_len;
+        }
+
+        *out = nullptr;
+
+        // a complete access unit also finishes the older ones, their missing packets are not coming anymore
+        size_t complete = 0;
+        for (size_t i = 0; i < access_units_.size(); ++i) {
+            if (is_complete(access_units_[i]))
+                complete = i + 1;
+        }
+
+        finish_access_units(complete, rce_flags, ready);
+        ret = RTP_OK;
+    }
+
+    if (ready.empty())
+        return ret;
+
+    if (ready.size() == 1) {
+        *out = ready.front();
+        return RTP_PKT_READY;
+    }
+
+    queued_.insert(queued_.end(), ready.begin(), ready.end());
+    *out = nullptr;
+
+    return RTP_MULTIPLE_PKTS_READY;
+}
+
+uvgrtp::formats::access_unit& uvgrtp::formats::h26x::get_access_unit(const uvgrtp::frame::rtp_header& header)
+{
+    for (auto& au : access_units_) {
+        if (au.ts == header.timestamp)
+            return au;
+    }
+
+    access_units_.emplace_back();
+
+    access_unit& au = access_units_.back();
+    au.ts = header.timestamp;
+    au.header = header;
+    au.started = uvgrtp::clock::hrc::now();
+
+    return au;
+}
+
+bool uvgrtp::formats::h26x::is_complete(const access_unit& au) const
+{
+    if (!au.marker)
+        return false;
+
+    // without a previous access unit there is no way to know where this one started
+    if (!marker_seq_valid_)
         return true;
+
+    return au.packets == uint16_t(au.header.seq - marker_seq_);
+}
+
+void uvgrtp::formats::h26x::finish_access_units(size_t count, int rce_flags,
+    std::vector<uvgrtp::frame::rtp_frame*>& ready)
+{
+    for (size_t i = 0; i < count; ++i) {
+        access_unit& au = access_units_.front();
+
+        if (!is_complete(au)) {
+            UVG_LOG_DEBUG("Delivering an incomplete access unit. Timestamp: %u, packets: %u", au.ts, au.packets);
+        }
+
+        if (au.marker) {
+            marker_seq_ = au.header.seq;
+            marker_seq_valid_ = true;
+        }
+
+        if (!au.nals.empty())
+            ready.push_back(merge_access_unit(au, rce_flags));
+
+        close_access_unit(au.ts);
+        access_units_.pop_front();
+    }
+}
+
+uvgrtp::frame::rtp_frame* uvgrtp::formats::h26x::merge_access_unit(access_unit& au, int rce_flags)
+{
+    bool start_code = !(rce_flags & RCE_NO_H26X_PREPEND_SC) && rtp_ctx_->get_payload() != RTP_FORMAT_ATLAS;
+    size_t start_code_len = start_code ? 4 : 0;
+
+    // NAL units of aggregation packets share the sequence number so their order must be kept
+    uint16_t first = au.nals.front().first;
+    std::stable_sort(au.nals.begin(), au.nals.end(),
+        [first](const std::pair<uint16_t, uvgrtp::frame::rtp_frame*>& a,
+                const std::pair<uint16_t, uvgrtp::frame::rtp_frame*>& b) {
+            return int16_t(a.first - first) < int16_t(b.first - first);
+        });
+
+    if ((rce_flags & RCE_H26X_PARAMETER_SETS) && !keyframe_delivered_)
+        prepend_parameter_sets(au);
+
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame();
+
+    frame->header      = au.header;
+    frame->payload_len = au.size + au.nals.size() * start_code_len;
+    frame->payload     = new uint8_t[frame->payload_len];
+    frame->nal_count   = au.nals.size();
+    frame->nals        = new uvgrtp::frame::nal_location[frame->nal_count];
+
+    size_t fptr = 0;
+
+    for (size_t i = 0; i < au.nals.size(); ++i) {
+        uvgrtp::frame::rtp_frame* nal = au.nals[i].second;
+
+        if (start_code) {
+            frame->payload[fptr++] = 0;
+            frame->payload[fptr++] = 0;
+            frame->payload[fptr++] = 0;
+            frame->payload[fptr++] = 1;
+        }
+
+        frame->nals[i].offset = fptr;
+        frame->nals[i].len    = nal->payload_len;
+
+        std::memcpy(&frame->payload[fptr], nal->payload, nal->payload_len);
+        fptr += nal->payload_len;
+
+        (void)uvgrtp::frame::dealloc_frame(nal);
     }
 
-    seen_packets_.insert(key);
-    seen_order_.push_back({ key, uvgrtp::clock::hrc::now() });
-    return false;
+    au.nals.clear();
+    au.size = 0;
+
+    return frame;
 }
 
-rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out)
+void uvgrtp::formats::h26x::free_access_unit(access_unit& au)
+{
+    for (auto& nal : au.nals)
+    {
+        (void)uvgrtp::frame::dealloc_frame(nal.second);
+    }
+
+    au.nals.clear();
+    au.size = 0;
+}
+
+rtp_error_t uvgrtp::formats::h26x::depacketize(int rce_flags, uvgrtp::frame::rtp_frame** out)
 {
-    (void)args;
-    (void)read_ptr;
-    (void)size;
     uvgrtp::frame::rtp_frame* frame = *out;
+    media_ssrc_ = frame->header.ssrc;
 
-    if (is_duplicate_frame(frame->header.timestamp, frame->header.seq)) {
+    if (fragments_.is_duplicate(frame->header.timestamp, frame->header.seq)) {
+        UVG_LOG_WARN("duplicate ts and seq num received, discarding frame");
         (void)uvgrtp::frame::dealloc_frame(*out);
         *out = nullptr;
         return RTP_GENERIC_ERROR;
@@ -725,142 +1355,209 @@ rtp_error_t uvgrtp::formats::h26x::packet_handler(void* args, int rce_flags, uin
     
     //UVG_LOG_DEBUG("Received FU, ts: %lu, Seq: %u", fragment_ts, fragment_seq);
 
-    // Initialize new access unit if this is the first packet with this timestamp
-    if (access_units_.find(fragment_ts) == access_units_.end()) {
-        initialize_new_access_unit(fragment_ts);
-        //UVG_LOG_DEBUG("intialized new access unit, ts %u, seq %u", fragment_ts, fragment_seq);
-    }
-    else if (access_units_[fragment_ts].received_packet_seqs.find(fragment_seq) !=
-        access_units_[fragment_ts].received_packet_seqs.end()) {
-        // we have already received this seq
-        UVG_LOG_DEBUG("Detected duplicate fragment, dropping! Fragment ts: %lu, Seq: %u",
-            fragment_ts, fragment_seq);
-        (void)uvgrtp::frame::dealloc_frame(frame); // free fragment memory
-        *out = nullptr;
-        return RTP_GENERIC_ERROR;
-    }
-
     const uint8_t sizeof_fu_headers = (uint8_t)get_payload_header_size() + 
                                                get_fu_header_size();
-    access_unit_info &au = access_units_[fragment_ts];
-    // keep track of fragments belonging to this frame
-    au.received_packet_seqs.insert(fragment_seq);
-    au.incomplete_packet_seqs.insert(fragment_seq);
-    au.fragments_info[fragment_seq] = {false, false, false};
-
-    au.total_size += (frame->payload_len - sizeof_fu_headers);
 
-    // This may not be necessary, as new duplicate fragments should get dropped already above
-    if (fragments_[fragment_seq] != nullptr) {
-        UVG_LOG_WARN("Found an existing fragment with same sequence number %u! Fragment ts: %lu, current ts: %lu",
-            fragment_seq, fragments_[fragment_seq]->header.timestamp, fragment_ts);
+    /* Save the fragment. Once all fragments from the start fragment up to it have been received,
+     * their payloads are copied straight to their place in the reassembled NAL unit */
+    uvgrtp::formats::fragment_store::link_result linked;
+    *out = nullptr; // the fragment store owns the fragment from now on
 
-        free_fragment(fragment_seq);
+    if (!fragments_.insert(frame, fragment_ts, fragment_seq, frag_type == uvgrtp::formats::FRAG_TYPE::FT_START,
+        frag_type == uvgrtp::formats::FRAG_TYPE::FT_END, linked))
+    {
+        // make sure uvgRTP does not reserve increasing amounts of memory by deleting old access unit information
+        garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+        return RTP_OK;
     }
 
-    // save the fragment for later reconstruction
-    fragments_[fragment_seq] = frame;
+    nal_assembly *assembly = place_fragments(linked, rce_flags, sizeof_fu_headers);
 
-    // if this is first or last, save it to help with reconstruction
-    if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_START) {
-        au.fragments_info[fragment_seq].start = true;
+    // the decoder can start on the beginning of a large NAL unit while the rest is still arriving
+    if (assembly && !linked.complete && assembly->size - assembly->delivered >= std::max(nal_chunk_size_, (size_t)1)) {
+        (void)deliver_chunk(linked.head, *assembly, RTP_NAL_CHUNK_PARTIAL);
     }
-    else if (frag_type == uvgrtp::formats::FRAG_TYPE::FT_END) {
-        //au.end_seqs.push_back(fragment_seq);
-        au.fragments_info[fragment_seq].end = true;
+
+    if (!linked.complete || !assembly)
+    {
+        if (linked.complete)
+        {
+            for (uint16_t i = linked.head; i != next_seq_num(linked.last); ++i) {
+                fragments_.release(i);
+            }
+        }
+
+        garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+        return RTP_OK;
     }
 
-    /* Used to keep track of fragments that can be used for reconstruction.
-    If a NAL unit is reconstructed, these can be removed from incomplete_packet_seqs after the loop below. */
-    std::unordered_map<uint16_t, nal>reconstructed_fragments = {}; 
+    /* Work in progress feature: here we discard inter frames if their references were not received correctly */
+    bool enable_reference_discarding = (rce_flags & RCE_H26X_DEPENDENCY_ENFORCEMENT);
+    if (discard_until_key_frame_ && enable_reference_discarding) {
+        if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTER) {
+            UVG_LOG_WARN("Dropping h26x access unit because of missing reference. Timestamp: %lu. Seq: %u - %u",
+                fragment_ts, linked.head, linked.last);
 
-    // figure out if we have the start sequence number and which seq it is (usually first, but not always)
-    rtp_error_t ret = RTP_OK;
-    uint16_t start_seq = 0;
-    bool start_found = false;
-    for (const uint16_t& fragment : au.incomplete_packet_seqs) {
-        if (au.fragments_info[fragment].start)
-        {
-            start_seq = fragment;
-            start_found = true;
-            reconstructed_fragments[fragment] = {}; // If this is start FU, initialize a new map for it
-            reconstructed_fragments.at(start_seq).seqs.insert(start_seq);
-            break;
+            drop_access_unit(fragment_ts);
+            return RTP_GENERIC_ERROR;
+        }
+        else if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTRA) {
+
+            // we don't have to discard anymore
+            UVG_LOG_INFO("Found a key frame at ts %lu", fragment_ts);
+            discard_until_key_frame_ = false;
         }
     }
 
-    if (!start_found)
-    {
-        return ret;
+    for (uint16_t i = linked.head; i != next_seq_num(linked.last); ++i) {
+        fragments_.release(i);
     }
 
-    /* Check all the incomplete fragments of this access unit, by looking for a set of fragments with consecutive
-   sequence numbers that starts with a start fragment and ends in an end fragment. If this is found,
-   a NAL unit can be reconstructed. */
-    uint16_t next_seq = next_seq_num(start_seq);
-    uint16_t current_fragment = nextSeq(start_seq, au.incomplete_packet_seqs);
+    expected_fragments_ = std::min(size_t(uint16_t(linked.last - linked.head)) + 1, MAX_EXPECTED_FRAGMENTS);
 
-    while (current_fragment != start_seq) { // go until we reconstruct or find the start again
+    if (deliver_chunk(linked.head, *assembly, RTP_NAL_CHUNK_COMPLETE)) {
+        free_assembly(linked.head);
+        garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+        return RTP_OK;
+    }
 
-        bool is_end = au.fragments_info[current_fragment].end;
+    *out = assembly->frame;
+    (*out)->payload_len = assembly->size;
+    assemblies_.erase(linked.head);
 
-        // check that this frament is continuous 
-        if (current_fragment != next_seq) {
-            break;
-        }
-        else {
-            reconstructed_fragments.at(start_seq).seqs.insert(current_fragment);
-        }
+    // make sure uvgRTP does not reserve increasing amounts of memory by deleting old access unit information
+    garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+    return RTP_PKT_READY;
+}
 
-        /* A continuous set of fragments with a start and end has been found. NAL unit can be reconstructed */
-        if (is_end) {
-            size_t nal_size = 0; // Find size of the complete reconstructed NAL unit       
-            for (auto p : reconstructed_fragments.at(start_seq).seqs) {
-                nal_size += (fragments_[p]->payload_len - sizeof_fu_headers);
-                au.fragments_info[p].reconstructed = true;
-            }
+uvgrtp::formats::nal_assembly* uvgrtp::formats::h26x::place_fragments(
+    const uvgrtp::formats::fragment_store::link_result& linked, int rce_flags, const uint8_t sizeof_fu_headers)
+{
+    nal_assembly *assembly = nullptr;
+    auto it = assemblies_.find(linked.head);
 
-            /* Work in progress feature: here we discard inter frames if their references were not received correctly */
-            bool enable_reference_discarding = (rce_flags & RCE_H26X_DEPENDENCY_ENFORCEMENT);
-            if (discard_until_key_frame_ && enable_reference_discarding) {
-                if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTER) {
-                    UVG_LOG_WARN("Dropping h26x access unit because of missing reference. Timestamp: %lu. Seq: %u - %u",
-                        fragment_ts, *access_units_[fragment_ts].received_packet_seqs.begin(), 
-                        *access_units_[fragment_ts].received_packet_seqs.rbegin());
+    if (it != assemblies_.end())
+        assembly = &it->second;
 
-                    drop_access_unit(fragment_ts);
-                    return RTP_GENERIC_ERROR;
-                }
-                else if (nal_type == uvgrtp::formats::NAL_TYPE::NT_INTRA) {
+    for (uint16_t i = linked.first; i != next_seq_num(linked.last); ++i)
+    {
+        uvgrtp::frame::rtp_frame* fragment = fragments_.take(i);
 
-                    // we don't have to discard anymore
-                    UVG_LOG_INFO("Found a key frame at ts %lu", fragment_ts);
-                    discard_until_key_frame_ = false;
-                }
+        if (i == linked.head)
+        {
+            if (assembly)
+            {
+                if (assembly->delivered)
+                    (void)deliver_chunk(linked.head, *assembly, RTP_NAL_CHUNK_LOST);
+
+                free_assembly(linked.head);
             }
-            if ((reconstruction(out, nal_size, rce_flags, start_seq, current_fragment, sizeof_fu_headers)) == RTP_PKT_READY) {
-                ret = RTP_PKT_READY;
+
+            // allocating the frame with start code ready saves a copy operation for the frame
+            bool start_code = !(rce_flags & RCE_NO_H26X_PREPEND_SC);
+            if (rtp_ctx_->get_payload() == RTP_FORMAT_ATLAS) {
+                start_code = false;
             }
-            reconstructed_fragments.at(start_seq).complete = true;
+
+            // the sender fills every fragment but the last one so the size of the NAL unit can be estimated
+            size_t fptr = 0;
+            size_t estimate = (fragment->payload_len - sizeof_fu_headers) * expected_fragments_;
+
+            assembly = &assemblies_[linked.head];
+            assembly->ts = fragment->header.timestamp;
+            assembly->started = uvgrtp::clock::hrc::now();
+            assembly->frame = allocate_rtp_frame_with_startcode(start_code,
+                fragment->header, get_nal_header_size() + estimate, fptr);
+
+            // construct the NAL header from fragment header of current fragment
+            get_nal_header_from_fu_headers(fptr, fragment->payload, assembly->frame->payload);
+            assembly->size = fptr + get_nal_header_size();
         }
 
+        if (!assembly)
+        {
+            (void)uvgrtp::frame::dealloc_frame(fragment);
+            continue;
+        }
 
-        next_seq = next_seq_num(next_seq);
-        current_fragment = nextSeq(current_fragment, au.incomplete_packet_seqs);
-    }
+        size_t len = fragment->payload_len - sizeof_fu_headers;
 
+        if (assembly->size + len > assembly->frame->payload_len)
+        {
+            size_t capacity = std::max(assembly->frame->payload_len * 2, assembly->size + len);
+            uint8_t *payload = new uint8_t[capacity];
 
-    for (auto& p : reconstructed_fragments) {
-        if (p.second.complete) {
-            for (auto &print : p.second.seqs) {
-                //UVG_LOG_DEBUG("reconstructed from fragment %u", print);
-                au.incomplete_packet_seqs.erase(print);
-            }
+            std::memcpy(payload, assembly->frame->payload, assembly->size);
+            delete[] assembly->frame->payload;
+
+            assembly->frame->payload = payload;
+            assembly->frame->payload_len = capacity;
         }
+
+        // copy everything expect fu headers (which repeat for every fu)
+        std::memcpy(&assembly->frame->payload[assembly->size], &fragment->payload[sizeof_fu_headers], len);
+        assembly->size += len;
+
+        // the marker bit is set in the last packet of an access unit
+        if (i == linked.last && linked.complete)
+            assembly->frame->header = fragment->header;
+
+        (void)uvgrtp::frame::dealloc_frame(fragment);
     }
-    // make sure uvgRTP does not reserve increasing amounts of memory by deleting old access unit information
-    garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
-    return ret;
+
+    if (!assembly) {
+        UVG_LOG_DEBUG("The start of NAL unit %u has been dropped, discarding its fragments", linked.head);
+    }
+
+    return assembly;
+}
+
+void uvgrtp::formats::h26x::free_assembly(uint16_t head)
+{
+    auto it = assemblies_.find(head);
+
+    if (it != assemblies_.end())
+    {
+        (void)uvgrtp::frame::dealloc_frame(it->second.frame);
+        assemblies_.erase(it);
+    }
+}
+
+rtp_error_t uvgrtp::formats::h26x::install_nal_chunk_hook(std::function<void(const uvgrtp::frame::nal_chunk&)> hook)
+{
+    if (rce_flags_ & RCE_H26X_ACCESS_UNITS) {
+        UVG_LOG_ERROR("NAL units cannot be received in chunks when they are collected to access units");
+        return RTP_NOT_SUPPORTED;
+    }
+
+    std::lock_guard<std::mutex> lock(chunk_mutex_);
+    chunk_hook_ = hook;
+
+    return RTP_OK;
+}
+
+bool uvgrtp::formats::h26x::deliver_chunk(uint16_t head, nal_assembly& assembly, int state)
+{
+    std::lock_guard<std::mutex> lock(chunk_mutex_);
+
+    if (!chunk_hook_)
+        return false;
+
+    uvgrtp::frame::nal_chunk chunk;
+    chunk.timestamp = assembly.ts;
+    chunk.seq = head;
+    chunk.offset = assembly.delivered;
+    chunk.state = state;
+
+    if (state != RTP_NAL_CHUNK_LOST) {
+        chunk.data = assembly.frame->payload + assembly.delivered;
+        chunk.len = assembly.size - assembly.delivered;
+    }
+
+    chunk_hook_(chunk);
+    assembly.delivered = assembly.size;
+
+    return true;
 }
 
 void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
@@ -868,16 +1565,14 @@ void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
     if (uvgrtp::clock::hrc::diff_now(last_garbage_collection_) >= GARBAGE_COLLECTION_INTERVAL_MS) {
         size_t total_cleaned = 0;
         std::vector<uint32_t> to_remove;
+
         // first find all access units that have been waiting for too long
-        for (auto& gc_frame : access_units_) {
-            if (uvgrtp::clock::hrc::diff_now(gc_frame.second.sframe_time) > timout) {
-#ifndef __RTP_SILENT__
-                //uint16_t s_seq = *gc_frame.second.received_packet_seqs.begin();
-                //uint16_t e_seq = *gc_frame.second.received_packet_seqs.rbegin();
-                //UVG_LOG_DEBUG("Found an old access unit. Ts: %lu, Seq: %u <-> %u, received: %lli",
-                    //gc_frame.first, s_seq, e_seq, gc_frame.second.received_packet_seqs.size());
-#endif
-                to_remove.push_back(gc_frame.first);
+        fragments_.find_expired(timout, to_remove);
+
+        for (auto& assembly : assemblies_) {
+            if (uvgrtp::clock::hrc::diff_now(assembly.second.started) > timout &&
+                std::find(to_remove.begin(), to_remove.end(), assembly.second.ts) == to_remove.end()) {
+                to_remove.push_back(assembly.second.ts);
             }
         }
 
@@ -885,6 +1580,7 @@ void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
         for (auto& old_frame : to_remove) {
             //UVG_LOG_DEBUG("Dropping old access unit. Ts: %lu", old_frame);
             total_cleaned += drop_access_unit(old_frame);
+            ++lost_frames_;
         }
 
         if (total_cleaned > 0) {
@@ -895,15 +1591,6 @@ void uvgrtp::formats::h26x::garbage_collect_lost_frames(size_t timout)
     }
 }
 
-void uvgrtp::formats::h26x::initialize_new_access_unit(uint32_t ts)
-{
-    access_units_[ts].received_packet_seqs = {};
-    access_units_[ts].fragments_info = {};
-
-    access_units_[ts].sframe_time = uvgrtp::clock::hrc::now();
-    access_units_[ts].total_size = 0;
-}
-
 uint16_t uvgrtp::formats::h26x::next_seq_num(uint16_t seq)
 {
     if (seq == UINT16_MAX) {
@@ -915,29 +1602,61 @@ uint16_t uvgrtp::formats::h26x::next_seq_num(uint16_t seq)
     }
 }
 
-void uvgrtp::formats::h26x::free_fragment(uint16_t sequence_number)
+void uvgrtp::formats::h26x::find_nal_units(uint8_t* data, size_t data_len, std::vector<nal_info>& nals)
 {
-    if (fragments_[sequence_number] == nullptr)
+    size_t chunk_count = 1;
+    auto& pool = scl_pool_ ? *scl_pool_ : uvgrtp::thread_pool::shared();
+
+    if (parallel_scl_threshold_ && data_len > parallel_scl_threshold_)
+    {
+        chunk_count = pool.get_worker_count() + 1;
+    }
+
+    if (chunk_count == 1)
     {
-        UVG_LOG_ERROR("Tried to free an already freed fragment with seq: %u", sequence_number);
+        find_nal_units_in_range(data, data_len, 0, data_len, nals);
         return;
     }
 
-    (void)uvgrtp::frame::dealloc_frame(fragments_[sequence_number]); // free fragment memory
-    fragments_[sequence_number] = nullptr;
-    fragments_.erase(sequence_number);
+    size_t chunk_size = (data_len + chunk_count - 1) / chunk_count;
+    std::vector<std::vector<nal_info>> chunk_nals(chunk_count);
+
+    pool.parallel_for(chunk_count, [&](size_t i) {
+        size_t begin = std::min(i * chunk_size, data_len);
+        size_t end   = std::min(begin + chunk_size, data_len);
+
+        find_nal_units_in_range(data, data_len, begin, end, chunk_nals[i]);
+    });
+
+    for (auto& chunk : chunk_nals)
+    {
+        nals.insert(nals.end(), chunk.begin(), chunk.end());
+    }
+
+    /* A prefix at the start of a chunk could not see the zero byte before it */
+    for (auto& nal : nals)
+    {
+        size_t prefix_start = nal.offset - 3;
+
+        if (prefix_start > 0 && data[prefix_start - 1] == 0)
+            nal.prefix_len = 4;
+    }
 }
 
-void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_size, 
-    std::vector<nal_info>& nals, bool& can_be_aggregated)
+void uvgrtp::formats::h26x::find_nal_units_in_range(uint8_t* data, size_t data_len, size_t begin, size_t end,
+    std::vector<nal_info>& nals)
 {
-    uint8_t start_len = 0;
-    ssize_t offset = find_h26x_start_code(data, data_len, 0, start_len);
+    /* The prefix starting from the last byte of the range and its first NAL unit byte are still read */
+    size_t len = std::min(end + 3, data_len);
 
-    packet_size -= get_payload_header_size(); // aggregate packet has a payload header
+    uint8_t start_len = 0;
+    ssize_t offset = find_h26x_start_code(data, len, begin, start_len);
 
-    while (offset > -1) {
+    /* only prefixes that start within the range belong to it,
+     * a prefix that ends the frame starts no NAL unit */
+    while (offset > -1 && size_t(offset) - 3 < end && size_t(offset) < data_len) {
         nal_info nal;
+        nal.data = data + offset;
         nal.offset = size_t(offset);
         nal.prefix_len = start_len;
         nal.size = 0; // set after all NALs have been found
@@ -945,11 +1664,14 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
 
 
         nals.push_back(nal);
-        offset = find_h26x_start_code(data, data_len, offset, start_len);
+        offset = find_h26x_start_code(data, len, offset, start_len);
     }
+}
 
-    size_t aggregate_size = 0;
-    int aggregatable_packets = 0;
+void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_size, 
+    std::vector<nal_info>& nals, bool& can_be_aggregated)
+{
+    find_nal_units(data, data_len, nals);
 
     // calculate the sizes of NAL units
     for (size_t i = 0; i < nals.size(); ++i)
@@ -965,76 +1687,30 @@ void uvgrtp::formats::h26x::scl(uint8_t* data, size_t data_len, size_t packet_si
             // last NAL unit, the length is offset to end
             nals.at(i).size = data_len - nals[i].offset;
         }
-
-        // each NAL unit added to aggregate packet needs the size added which has to be taken into account
-        // when calculating the aggregate packet 
-        // (NOTE: This is not enough for MTAP in h264, but I doubt uvgRTP will support it)
-        if (aggregate_size + nals.at(i).size + sizeof(uint16_t) <= packet_size)
-        {
-            aggregate_size += nals.at(i).size + sizeof(uint16_t);
-            nals.at(i).aggregate = true;
-            ++aggregatable_packets;
-        }
     }
 
-    can_be_aggregated = (aggregatable_packets >= 2);
+    mark_aggregatable(nals, packet_size, can_be_aggregated);
 }
 
-rtp_error_t uvgrtp::formats::h26x::reconstruction(uvgrtp::frame::rtp_frame** out, size_t nal_size, 
-    int rce_flags, uint16_t s_seq, uint16_t e_seq, const uint8_t sizeof_fu_headers)
+void uvgrtp::formats::h26x::mark_aggregatable(std::vector<nal_info>& nals, size_t packet_size, bool& can_be_aggregated)
 {
-    uvgrtp::frame::rtp_frame* frame = *out;
-    //UVG_LOG_DEBUG("Reconstructing frame. Ts: %lu, Seq: %u -> %u", ts, s_seq, e_seq);
-
-    // Reconstruction of frame from fragments
-    size_t fptr = 0;
-
-    // allocating the frame with start code ready saves a copy operation for the frame
-    bool start_code = !(rce_flags & RCE_NO_H26X_PREPEND_SC);
-    if (rtp_ctx_->get_payload() == RTP_FORMAT_ATLAS) {
-        start_code = false;
-    }
-    uvgrtp::frame::rtp_frame* complete = allocate_rtp_frame_with_startcode(start_code,
-        frame->header, get_nal_header_size() + nal_size, fptr);
+    packet_size -= get_payload_header_size(); // aggregate packet has a payload header
 
-    // construct the NAL header from fragment header of current fragment
-    get_nal_header_from_fu_headers(fptr, frame->payload, complete->payload); // NAL header
-    fptr += get_nal_header_size();
+    size_t aggregate_size = 0;
+    int aggregatable_packets = 0;
 
-    //uint16_t next_from_last = frames_.at(frame_timestamp).e_seq + 1;
-    uint16_t next_from_last = uint16_t(next_seq_num(e_seq));
-    for (uint16_t i = s_seq; i != next_from_last; ++i)
+    for (auto& nal : nals)
     {
-        if (fragments_[i] == nullptr)
+        // each NAL unit added to aggregate packet needs the size added which has to be taken into account
+        // when calculating the aggregate packet 
+        // (NOTE: This is not enough for MTAP in h264, but I doubt uvgRTP will support it)
+        if (aggregate_size + nal.size + sizeof(uint16_t) <= packet_size)
         {
-            UVG_LOG_ERROR("Missing fragment in reconstruction. Seq range: %u - %u. Missing seq %u",
-                s_seq, e_seq, i);
-            return RTP_GENERIC_ERROR;
+            aggregate_size += nal.size + sizeof(uint16_t);
+            nal.aggregate = true;
+            ++aggregatable_packets;
         }
-
-        // copy everything expect fu headers (which repeat for every fu)
-        std::memcpy(
-            &complete->payload[fptr],
-            &fragments_[i]->payload[sizeof_fu_headers],
-            fragments_[i]->payload_len - sizeof_fu_headers
-        );
-        fptr += fragments_[i]->payload_len - sizeof_fu_headers;
-        free_fragment(i);
-    }
-
-    *out = complete;      // save result to output
-    return RTP_PKT_READY; // indicate that we have a frame ready
-}
-
-
-uint16_t uvgrtp::formats::h26x::nextSeq(uint16_t currentSeq, std::set<uint16_t>& fragments)
-{
-    auto currentIterator = fragments.find(currentSeq);
-
-    if (*currentIterator == *(fragments.rbegin()))
-    {
-        return *(fragments.begin());
     }
 
-    return *(++currentIterator);
+    can_be_aggregated = (aggregatable_packets >= 2);
 }
@@ -5,12 +5,15 @@
 #include "uvgrtp/frame.hh"
 
 #include "media.hh"
+#include "fragment_store.hh"
 #include "../socket.hh"
 
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <set>
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 #ifdef _WIN32
 #include <ws2def.h>
 #include <ws2ipdef.h>
@@ -41,35 +44,45 @@ namespace uvgrtp {
             NT_OTHER = 0xff
         };
 
-        struct frag_info {
-            bool start = false;
-            bool end = false;
-            bool reconstructed = false;
+        /* Parameter sets cached with RCE_H26X_PARAMETER_SETS, in the order they are sent */
+        enum PARAMETER_SET_TYPE {
+            PS_VPS   = 0,
+            PS_SPS   = 1,
+            PS_PPS   = 2,
+            PS_COUNT = 3
         };
 
-        /* Used for determining if the NAL unit can be reconstructed */
-        struct nal {
-            bool complete = false;
-            std::set<uint16_t> seqs = {};
+        /* NAL unit that is being reassembled from fragments */
+        struct nal_assembly {
+            uvgrtp::frame::rtp_frame *frame = nullptr; /* payload_len is the allocated size until the end fragment */
+            size_t size = 0;                           /* bytes of the payload written so far */
+            size_t delivered = 0;                      /* bytes given to the NAL chunk hook so far */
+            uint32_t ts = 0;
+            uvgrtp::clock::hrc::hrc_t started;
         };
 
-        struct access_unit_info {
-            /* clock reading when the first fragment is received */
-            uvgrtp::clock::hrc::hrc_t sframe_time;
-
-            /* total size of all fragments */
-            size_t total_size = 0;
-
-            /* Keep track of all sequence numbers for an access unit, as well as the ones that have not been yet used for reconstruction */
-            std::set<uint16_t> received_packet_seqs;
-            std::set<uint16_t> incomplete_packet_seqs;
+        /* NAL units of one access unit collected for RCE_H26X_ACCESS_UNITS */
+        struct access_unit {
+            uint32_t ts = 0;
+            uvgrtp::frame::rtp_header header;  /* header of the packet with the marker bit or of the first packet */
+            std::vector<std::pair<uint16_t, uvgrtp::frame::rtp_frame*>> nals; /* NAL units and the sequence numbers of their last packets */
+            size_t size = 0;                   /* total size of the NAL units */
+            uint16_t packets = 0;              /* packets of the access unit received so far */
+            bool marker = false;               /* the packet with the marker bit has been received */
+            uvgrtp::clock::hrc::hrc_t started;
+        };
 
-            /* Save frag_info for each fragment in an access unit */
-            std::unordered_map<uint16_t, frag_info> fragments_info;
+        /* Importance of a NAL unit when NAL units are shed to keep the send latency within budget */
+        struct nal_importance
+        {
+            int priority = RTP_NAL_PRIORITY_NON_VCL; /* RTP_NAL_PRIORITY */
+            uint8_t temporal_id = 0;
+            bool sublayer_switch = false;            /* decoding of this temporal sub-layer can start here */
         };
 
         struct nal_info
         {
+            uint8_t *data = nullptr; /* NAL unit header */
             size_t offset = 0;
             size_t prefix_len = 0;
             size_t size = 0;
@@ -85,10 +98,21 @@ namespace uvgrtp {
                 /* Find H26x start code from "data"
                  * This process is the same for H26{4,5,6}
                  *
+                 * The fastest vectorized implementation supported by the CPU is used
+                 * and find_h26x_start_code_scalar() if there is none
+                 *
                  * Return the offset of the start code on success
                  * Return -1 if no start code was found */
                 ssize_t find_h26x_start_code(uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
 
+                /* Portable implementation of find_h26x_start_code() */
+                ssize_t find_h26x_start_code_scalar(uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
+
+                /* Find the offsets and start code lengths of all NAL units in "data".
+                 * Frames larger than the parallel SCL threshold are split into chunks
+                 * that are searched concurrently on the thread pool, see set_scl_thread_pool() */
+                void find_nal_units(uint8_t *data, size_t data_len, std::vector<nal_info>& nals);
+
                 /* Top-level push_frame() called by the Media class
                  * Sets up the frame queue for the send operation
                  *
@@ -96,14 +120,41 @@ namespace uvgrtp {
                  * Return RTP_INVALID_VALUE if one of the parameters is invalid */
                 rtp_error_t push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags, uint32_t ssrc);
 
-                /* If the packet handler must return more than one frame, it can install a frame getter
-                 * that is called by the auxiliary handler caller if packet_handler() returns RTP_MULTIPLE_PKTS_READY
+                /* Send NAL units that the caller has already separated from each other.
+                 * No start code lookup is done and the NAL units are packetized straight from "nals"
                  *
-                 * "arg" is the same that is passed to packet_handler
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if one of the parameters is invalid */
+                rtp_error_t push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, const uvgrtp::frame::nal_unit *nals, size_t count,
+                    int rtp_flags, uint32_t ssrc);
+
+                /* Start a frame that is sent slice by slice with push_slice()
                  *
-                 * Return RTP_PKT_READY if "frame" contains a frame that can be returned to user
-                 * Return RTP_NOT_FOUND if there are no more frames */
-                rtp_error_t frame_getter(frame::rtp_frame** frame);
+                 * Return RTP_OK on success */
+                rtp_error_t begin_frame();
+
+                /* Send the packets of "data" right away except the last one, which is held back with
+                 * a copy of its payload until the next slice or end_frame() shows whether it ends the frame
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if "data" is empty
+                 * Return RTP_NOT_READY if begin_frame() has not been called */
+                rtp_error_t push_slice(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len,
+                    int rtp_flags, uint32_t ssrc);
+
+                /* Send the packet held back from the last slice of the frame with the marker bit set
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_INVALID_VALUE if no slices were pushed
+                 * Return RTP_NOT_READY if begin_frame() has not been called */
+                rtp_error_t end_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc);
+
+                /* Give the part of each fragmented NAL unit received in order to "hook" as it grows.
+                 * The NAL units are then not returned as frames
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_NOT_SUPPORTED if access units are collected with RCE_H26X_ACCESS_UNITS */
+                rtp_error_t install_nal_chunk_hook(std::function<void(const uvgrtp::frame::nal_chunk&)> hook);
 
                 /* Packet handler for RTP frames that transport HEVC bitstream
                  *
@@ -133,7 +184,7 @@ namespace uvgrtp {
                 virtual rtp_error_t finalize_aggregation_pkt();
                 virtual void clear_aggregation_info();
 
-                rtp_error_t single_nal_unit(uint8_t* data, size_t data_len);
+                rtp_error_t single_nal_unit(uint8_t* data, size_t data_len, bool set_marker);
 
                 // constructs format specific RTP header with correct values
                 virtual rtp_error_t fu_division(uint8_t* data, size_t data_len, size_t payload_size) = 0;
@@ -163,40 +214,135 @@ namespace uvgrtp {
 
                 virtual void prepend_start_code(int rce_flags, uvgrtp::frame::rtp_frame** out);
 
+                /* Classify the NAL unit starting at "data" (NAL unit header) for shedding.
+                 * The default implementation never sheds anything */
+                virtual nal_importance classify_nal(uint8_t* data) const;
+
+                /* Return the PARAMETER_SET_TYPE of the NAL unit starting at "data" (NAL unit header)
+                 * or -1 if it is not a parameter set. The default implementation finds none */
+                virtual int get_parameter_set_type(uint8_t* data) const;
+
         private:
             size_t drop_access_unit(uint32_t ts);
 
+            /* Discard packets of access unit "ts" that arrive later */
+            void close_access_unit(uint32_t ts);
+
+            /* Packet handler without access unit delivery, returns NAL units one at a time */
+            rtp_error_t depacketize(int rce_flags, uvgrtp::frame::rtp_frame** out);
+
+            /* Packet handler for RCE_H26X_ACCESS_UNITS. The NAL units returned by depacketize() are
+             * collected by their timestamp and a frame is returned for every finished access unit
+             *
+             * Return RTP_OK if no access unit was finished
+             * Return RTP_PKT_READY if "out" contains an access unit
+             * Return RTP_MULTIPLE_PKTS_READY if more than one access unit was finished
+             * Return RTP_GENERIC_ERROR if the packet was discarded */
+            rtp_error_t collect_access_units(int rce_flags, uvgrtp::frame::rtp_frame** out);
+
+            access_unit& get_access_unit(const uvgrtp::frame::rtp_header& header);
+
+            /* The access unit has all packets up to the one with the marker bit */
+            bool is_complete(const access_unit& au) const;
+
+            /* Move the "count" oldest access units to "ready" */
+            void finish_access_units(size_t count, int rce_flags, std::vector<uvgrtp::frame::rtp_frame*>& ready);
+
+            /* Copy the NAL units of "au" to one frame in sequence number order and free them */
+            uvgrtp::frame::rtp_frame* merge_access_unit(access_unit& au, int rce_flags);
+
+            void free_access_unit(access_unit& au);
+
             inline uint16_t next_seq_num(uint16_t seq);
-            inline void initialize_new_access_unit(uint32_t ts);
 
-            void free_fragment(uint16_t sequence_number);
+            /* Find the NAL units whose start code prefix begins within "begin" - "end - 1" */
+            void find_nal_units_in_range(uint8_t* data, size_t data_len, size_t begin, size_t end,
+                std::vector<nal_info>& nals);
 
             void scl(uint8_t* data, size_t data_len, size_t packet_size, 
                 std::vector<nal_info>& nals, bool& can_be_aggregated);
 
+            /* Mark the leading NAL units that fit into an aggregation packet of "packet_size" bytes */
+            void mark_aggregatable(std::vector<nal_info>& nals, size_t packet_size, bool& can_be_aggregated);
+
+            /* Find the NAL units of "data" and send them. The RTP timestamp of the previous
+             * transaction is reused if "old_rtp_ts" is true and the last packet is left
+             * queued in the transaction if "hold_last" is true
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if one of the parameters is invalid */
+            rtp_error_t push_nal_data(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len,
+                int rtp_flags, uint32_t ssrc, bool old_rtp_ts, bool end_of_frame, bool hold_last);
+
+            /* Packetize and send the NAL units of a frame whose transaction has already been initialized.
+             * Parameter sets are inserted only if "start_of_frame" is true and the marker bit
+             * is set in the last packet only if "end_of_frame" is true. If "hold_last" is true,
+             * the last packet is left queued in the transaction instead of being sent
+             *
+             * Return RTP_OK on success */
+            rtp_error_t send_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, std::vector<nal_info>& nals,
+                bool should_aggregate, int rtp_flags, uint32_t ssrc, bool start_of_frame, bool end_of_frame, bool hold_last);
+
+            /* Remove the least important NAL units from "nals" until the frame can be
+             * delivered within the latency budget. NAL units that may reference an already
+             * shed NAL unit are removed too so that the receiver gets an intact reference chain.
+             * If "keep_last" is true, the last NAL unit is kept when all of them would be removed */
+            void shed_nal_units(std::vector<nal_info>& nals, bool keep_last);
+
             void garbage_collect_lost_frames(size_t timout);
 
-            rtp_error_t reconstruction(uvgrtp::frame::rtp_frame** out, size_t nal_size,
-                int rce_flags, uint16_t s_seq, uint16_t e_seq, const uint8_t sizeof_fu_headers);
+            /* Cache the parameter sets of the frame and, if "nals" starts the frame, insert the cached
+             * ones that the frame does not carry in front of "nals" if the frame is an intra picture
+             * or the parameter set interval has passed
+             *
+             * Return true if parameter sets were inserted */
+            bool insert_parameter_sets(std::vector<nal_info>& nals, bool start_of_frame);
+
+            /* Parameter sets are inserted after the access unit delimiter and SEI messages at the start
+             * of the access unit, in VPS, SPS, PPS order with the parameter sets it already carries
+             *
+             * Return true if a parameter set of PARAMETER_SET_TYPE "type" goes in front of "nal" */
+            bool is_parameter_set_position(uint8_t* nal, int type) const;
+
+            /* Cache a received parameter set so that it can be delivered in front of the first intra picture
+             *
+             * Return the PARAMETER_SET_TYPE of "nal" or -1 if it is not a parameter set */
+            int cache_received_parameter_set(uint8_t* nal, size_t len);
 
-            bool is_duplicate_frame(uint32_t timestamp, uint16_t seq_num);
+            /* If "au" is the first intra picture delivered, put the cached parameter sets that have
+             * not been delivered in front of it. Access units with parameter sets may have been
+             * dropped before the first intra picture, for example by RCE_H26X_DEPENDENCY_ENFORCEMENT */
+            void prepend_parameter_sets(access_unit& au);
 
-            uint16_t nextSeq(uint16_t currentSeq, std::set<uint16_t>& fragments);
+            /* Copy the payloads of newly linked fragments to their place in the NAL unit they belong to.
+             * The output frame is allocated when the start fragment is linked
+             *
+             * Return the NAL unit being reassembled or nullptr if it has been dropped */
+            nal_assembly *place_fragments(const uvgrtp::formats::fragment_store::link_result& linked,
+                int rce_flags, const uint8_t sizeof_fu_headers);
 
-            std::deque<uvgrtp::frame::rtp_frame*> queued_;
-            std::unordered_map<uint32_t, access_unit_info> access_units_;
+            void free_assembly(uint16_t head);
 
-            struct seen_packet {
-                uint64_t key;
-                uvgrtp::clock::hrc::hrc_t arrival;
-            };
+            /* Give the bytes of "assembly" not yet delivered to the NAL chunk hook, or only tell that it was lost
+             *
+             * Return false if no hook has been installed */
+            bool deliver_chunk(uint16_t head, nal_assembly& assembly, int state);
 
-            // Time-window duplicate tracking (key = (timestamp << 16) | seq)
-            std::deque<seen_packet> seen_order_;
-            std::unordered_set<uint64_t> seen_packets_;
+            // Holds the fragments waiting for reconstruction and detects duplicate packets
+            uvgrtp::formats::fragment_store fragments_;
 
-            // Holds all possible fragments with sequence number
-            std::unordered_map<uint16_t, uvgrtp::frame::rtp_frame*> fragments_;
+            // NAL units being reassembled, by the sequence number of their start fragment
+            std::unordered_map<uint16_t, nal_assembly> assemblies_;
+
+            // Number of fragments in the latest reassembled NAL unit (at most MAX_EXPECTED_FRAGMENTS), used for sizing the next one
+            size_t expected_fragments_;
+
+            // Access units being collected in the order of their first packet, only used with RCE_H26X_ACCESS_UNITS
+            std::deque<access_unit> access_units_;
+
+            // Sequence number of the marker bit packet of the latest finished access unit
+            uint16_t marker_seq_;
+            bool marker_seq_valid_;
 
             // keep track of old, dropped access units so we don't accept invalid fragments
             std::unordered_map<uint32_t, uvgrtp::clock::hrc::hrc_t> dropped_ts_;
@@ -209,6 +355,34 @@ namespace uvgrtp {
             uvgrtp::clock::hrc::hrc_t last_garbage_collection_;
 
             bool discard_until_key_frame_ = true;
+
+            // SSRC of the latest received packet, keyframes are requested from it
+            uint32_t media_ssrc_;
+
+            std::function<void(const uvgrtp::frame::nal_chunk&)> chunk_hook_;
+            std::mutex chunk_mutex_;
+
+            /* State of the frame sent with push_slice(). The last packet of the latest slice stays
+             * queued in the transaction because only end_frame() tells that it must carry the marker bit */
+            bool slice_frame_open_;
+            bool slice_frame_started_;
+            bool slice_packet_held_;
+
+            /* Temporal sub-layers from this one up are shed until the chain is restarted */
+            uint8_t shed_tid_;
+
+            /* Packets of the frame being sent have left, its last packet must then carry the marker bit */
+            bool frame_packets_sent_;
+
+            // Latest parameter sets sent and when they were last sent, only used with RCE_H26X_PARAMETER_SETS
+            std::vector<uint8_t> parameter_sets_[PS_COUNT];
+            uvgrtp::clock::hrc::hrc_t parameter_sets_sent_;
+
+            // Latest parameter sets received, a bit of PARAMETER_SET_TYPE is set in
+            // "delivered_parameter_sets_" once that parameter set has been delivered
+            std::vector<uint8_t> received_parameter_sets_[PS_COUNT];
+            uint8_t delivered_parameter_sets_;
+            bool keyframe_delivered_;
         };
     }
 }
@@ -1,23 +1,50 @@
 #include "media.hh"
 
+#include "uvgrtp/frame.hh"
+
 #include "../socket.hh"
 #include "../rtp.hh"
 #include "../frame_queue.hh"
 #include "debug.hh"
 
-#include <map>
-#include <unordered_map>
+#include <cstring>
+#include <vector>
+
+constexpr int GARBAGE_COLLECTION_INTERVAL_MS = 100;
 
+/* Number of sequence numbers the fragment store keeps track of. Fragments of a generic frame
+ * must arrive within this many packets from each other to be reconstructed */
+constexpr size_t GENERIC_FRAGMENT_STORE_SIZE = 1 << 14;
 
+/* Return true if a generic fragment of timestamp "ts" starts a frame when the closest packet received
+ * before it has timestamp "prev_ts" and "lost" packets between them are missing */
+static bool starts_frame(uint32_t prev_ts, bool prev_ended, uint32_t ts, size_t lost)
+{
+    if (lost == 0)
+        return prev_ts != ts || prev_ended;
 
-#define INVALID_SEQ 0xffffffff
+    /* the frame before has not ended, so a single lost packet must have been its end */
+    return lost == 1 && prev_ts != ts && !prev_ended;
+}
 
 uvgrtp::formats::media::media(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp_ctx, int rce_flags):
-    socket_(socket), rtp_ctx_(rtp_ctx), rce_flags_(rce_flags), fqueue_(new uvgrtp::frame_queue(socket, rtp_ctx, rce_flags)), minfo_()
-{}
+    socket_(socket), rtp_ctx_(rtp_ctx), rce_flags_(rce_flags), fqueue_(new uvgrtp::frame_queue(socket, rtp_ctx, rce_flags)),
+    parallel_scl_threshold_(0), scl_pool_(nullptr), parameter_set_interval_(0), rtcp_(nullptr), nal_chunk_size_(0),
+    queued_(), lost_frames_(0), fragments_(nullptr), receiving_(false),
+    last_garbage_collection_(uvgrtp::clock::hrc::now())
+{
+    if (rce_flags & RCE_FRAGMENT_GENERIC)
+        fragments_.reset(new uvgrtp::formats::fragment_store(GENERIC_FRAGMENT_STORE_SIZE));
+}
 
 uvgrtp::formats::media::~media()
 {
+    for (auto& frame : queued_)
+    {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    queued_.clear();
     fqueue_ = nullptr;
 }
 
@@ -39,6 +66,46 @@ rtp_error_t uvgrtp::formats::media::push_frame(sockaddr_in& addr, sockaddr_in6&
     return push_media_frame(addr, addr6, data.get(), data_len, rtp_flags, ssrc);
 }
 
+rtp_error_t uvgrtp::formats::media::push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6,
+    const uvgrtp::frame::nal_unit *nals, size_t count, int rtp_flags, uint32_t ssrc)
+{
+    (void)addr, (void)addr6, (void)nals, (void)count, (void)rtp_flags, (void)ssrc;
+
+    UVG_LOG_ERROR("Only H.264, H.265 and H.266 streams can be sent as separate NAL units");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::begin_frame()
+{
+    UVG_LOG_ERROR("Only H.264, H.265 and H.266 streams can be sent slice by slice");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::push_slice(sockaddr_in& addr, sockaddr_in6& addr6,
+    uint8_t *data, size_t data_len, int rtp_flags, uint32_t ssrc)
+{
+    (void)addr, (void)addr6, (void)data, (void)data_len, (void)rtp_flags, (void)ssrc;
+
+    UVG_LOG_ERROR("Only H.264, H.265 and H.266 streams can be sent slice by slice");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::end_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc)
+{
+    (void)addr, (void)addr6, (void)ssrc;
+
+    UVG_LOG_ERROR("Only H.264, H.265 and H.266 streams can be sent slice by slice");
+    return RTP_NOT_SUPPORTED;
+}
+
+rtp_error_t uvgrtp::formats::media::install_nal_chunk_hook(std::function<void(const uvgrtp::frame::nal_chunk&)> hook)
+{
+    (void)hook;
+
+    UVG_LOG_ERROR("Only H.264, H.265 and H.266 streams can be received in chunks");
+    return RTP_NOT_SUPPORTED;
+}
+
 rtp_error_t uvgrtp::formats::media::push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6,
     uint8_t *data, size_t data_len, int rtp_flags, uint32_t ssrc)
 {
@@ -98,98 +165,162 @@ rtp_error_t uvgrtp::formats::media::push_media_frame(sockaddr_in& addr, sockaddr
     return fqueue_->flush_queue(addr, addr6, ssrc);
 }
 
-uvgrtp::formats::media_frame_info_t *uvgrtp::formats::media::get_media_frame_info()
-{
-    return &minfo_;
-}
-
 rtp_error_t uvgrtp::formats::media::packet_handler(void* arg, int rce_flags, uint8_t* read_ptr, size_t size, frame::rtp_frame** out)
 {
-    (void)rce_flags;
+    (void)arg;
     (void)read_ptr;
     (void)size;
-    auto minfo   = (uvgrtp::formats::media_frame_info_t *)arg;
+
+    /* If fragmentation of generic frame has not been enabled, we can just return the frame
+     * in "out" because RTP packet handler has done all the necessasry stuff for small RTP packets */
+    if (!(rce_flags & RCE_FRAGMENT_GENERIC) || !fragments_)
+    {
+        return RTP_PKT_READY;
+    }
+
     auto frame   = *out;
     uint32_t ts  = frame->header.timestamp;
-    uint32_t seq = frame->header.seq;
-    uint32_t recv  = 0;
+    uint16_t seq = frame->header.seq;
+    bool end     = frame->header.marker;
 
-    bool fragmentation = (rce_flags & RCE_FRAGMENT_GENERIC);
+    if (fragments_->is_duplicate(ts, seq)) {
+        UVG_LOG_WARN("duplicate ts and seq num received, discarding frame");
+        (void)uvgrtp::frame::dealloc_frame(*out);
+        *out = nullptr;
+        return RTP_GENERIC_ERROR;
+    }
 
-    /* If fragmentation of generic frame has not been enabled, we can just return the frame
-     * in "out" because RTP packet handler has done all the necessasry stuff for small RTP packets */
-    if (!fragmentation)
+    /* Generic frames do not mark their first packet. A packet starts a frame if the packet
+     * before it belongs to another frame or ends a frame, or if only the end of the frame before it
+     * was lost. Otherwise the fragment waits in the store until the packets before it arrive
+     * or the frame before it is garbage collected */
+    const uvgrtp::formats::fragment_store::slot *prev = fragments_->lookup(uint16_t(seq - 1));
+    size_t lost = 0;
+    bool start  = !receiving_;
+
+    if (!prev) {
+        prev = fragments_->lookup(uint16_t(seq - 2));
+        lost = 1;
+    }
+
+    if (prev)
+        start = starts_frame(prev->ts, prev->state & uvgrtp::formats::FS_END, ts, lost);
+
+    receiving_ = true;
+
+    uvgrtp::formats::fragment_store::link_result linked;
+    *out = nullptr; // the fragment store owns the fragment from now on
+
+    if (fragments_->insert(frame, ts, seq, start, end, linked) && linked.complete)
+        queued_.push_back(merge_fragments(linked));
+
+    /* the packet after this one, or after the lost end of this frame, may have been waiting
+     * to learn that it starts a frame */
+    const uvgrtp::formats::fragment_store::slot *next = fragments_->lookup(uint16_t(seq + 1));
+    lost = 0;
+
+    if (!next) {
+        next = fragments_->lookup(uint16_t(seq + 2));
+        lost = 1;
+    }
+
+    if (next && (next->state & uvgrtp::formats::FS_PRESENT) && starts_frame(ts, end, next->ts, lost) &&
+        fragments_->link_start(next->ts, next->seq, linked) && linked.complete)
     {
+        queued_.push_back(merge_fragments(linked));
+    }
+
+    // make sure uvgRTP does not reserve increasing amounts of memory by deleting old frame information
+    garbage_collect_lost_frames(rtp_ctx_->get_pkt_max_delay());
+
+    if (queued_.empty())
+        return RTP_OK;
+
+    if (queued_.size() == 1) {
+        *out = queued_.front();
+        queued_.pop_front();
         return RTP_PKT_READY;
     }
 
-    if (minfo->frames.find(ts) != minfo->frames.end()) {
-        minfo->frames[ts].npkts++;
-        minfo->frames[ts].size += frame->payload_len;
+    return RTP_MULTIPLE_PKTS_READY;
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::formats::media::merge_fragments(
+    const uvgrtp::formats::fragment_store::link_result& linked)
+{
+    uint16_t past_last = uint16_t(linked.last + 1);
+    size_t frame_size = 0;
+
+    for (uint16_t i = linked.head; i != past_last; ++i) {
+        frame_size += fragments_->lookup(i)->frame->payload_len;
+    }
+
+    /* the frame is allocated only once all of its fragments are present so its size is exact */
+    auto retframe = uvgrtp::frame::alloc_rtp_frame(frame_size);
+    size_t ptr    = 0;
 
-        if (seq < minfo->frames[ts].s_seq)
-            minfo->frames[ts].fragments[seq + 0x10000] = frame;
-        else
-            minfo->frames[ts].fragments[seq] = frame;
+    for (uint16_t i = linked.head; i != past_last; ++i) {
+        const uvgrtp::frame::rtp_frame *fragment = fragments_->lookup(i)->frame;
 
-        *out = nullptr;
+        std::memcpy(retframe->payload + ptr, fragment->payload, fragment->payload_len);
+        ptr += fragment->payload_len;
 
-        if (frame->header.marker)
-        {
-            minfo->frames[ts].e_seq = seq;
-        }
-        else if (seq == minfo->frames[ts].s_seq - 1)
-        {
-            // try to detect if the start seq was ordered wrong
-            minfo->frames[ts].s_seq = seq;
+        // the marker bit is set in the last packet of a frame
+        if (i == linked.last)
+            retframe->header = fragment->header;
+
+        fragments_->release(i);
+    }
+
+    return retframe;
+}
+
+void uvgrtp::formats::media::garbage_collect_lost_frames(size_t timeout)
+{
+    if (uvgrtp::clock::hrc::diff_now(last_garbage_collection_) >= GARBAGE_COLLECTION_INTERVAL_MS) {
+        size_t total_cleaned = 0;
+        std::vector<uint32_t> to_remove;
+
+        fragments_->find_expired(timeout, to_remove);
+
+        for (auto& old_frame : to_remove) {
+            UVG_LOG_DEBUG("Dropping incomplete generic frame. Ts: %u", old_frame);
+            total_cleaned += fragments_->drop(old_frame);
+            ++lost_frames_;
         }
 
-        if (minfo->frames[ts].e_seq != INVALID_SEQ && minfo->frames[ts].s_seq != INVALID_SEQ) {
-            if (minfo->frames[ts].s_seq > minfo->frames[ts].e_seq)
-            {
-                recv = UINT16_MAX - minfo->frames[ts].s_seq + minfo->frames[ts].e_seq + (uint32_t)2;
-            }
-            else
-            {
-                recv = minfo->frames[ts].e_seq - minfo->frames[ts].s_seq + (uint32_t)1;
-            }
+        /* the frames after the dropped ones no longer wait for the lost ends of the dropped frames */
+        if (!to_remove.empty()) {
+            std::vector<uvgrtp::formats::fragment_store::link_result> linked;
+            fragments_->link_after_dropped(to_remove, linked);
 
-            if (recv == minfo->frames[ts].npkts) {
-                auto retframe = uvgrtp::frame::alloc_rtp_frame(minfo->frames[ts].size);
-                size_t ptr    = 0;
-
-                std::memcpy(&retframe->header, &frame->header, sizeof(frame->header));
-
-                for (auto& frag : minfo->frames[ts].fragments) {
-                    std::memcpy(
-                        retframe->payload + ptr,
-                        frag.second->payload,
-                        frag.second->payload_len
-                    );
-                    ptr += frag.second->payload_len;
-                    (void)uvgrtp::frame::dealloc_frame(frag.second);
-                }
-
-                minfo->frames.erase(ts);
-                (void)uvgrtp::frame::dealloc_frame(*out);
-                *out = retframe;
-                return RTP_PKT_READY;
+            for (auto& frame : linked) {
+                queued_.push_back(merge_fragments(frame));
             }
         }
-    } else {
-        if (!(frame->header.marker)) {
-            minfo->frames[ts].npkts          = 1;
-            minfo->frames[ts].s_seq          = seq;
-            minfo->frames[ts].e_seq          = INVALID_SEQ;
-            minfo->frames[ts].fragments[seq] = frame;
-            minfo->frames[ts].size           = frame->payload_len;
-            *out                             = nullptr;
-        } else {
-            return RTP_PKT_READY; // fragmentation is used, but there was only one packet for this frame
+
+        if (total_cleaned > 0) {
+            UVG_LOG_DEBUG("Garbage collection cleaned %zu bytes!", total_cleaned);
         }
+
+        last_garbage_collection_ = uvgrtp::clock::hrc::now();
+    }
+}
+
+rtp_error_t uvgrtp::formats::media::frame_getter(uvgrtp::frame::rtp_frame** frame)
+{
+    if (queued_.size()) {
+        *frame = queued_.front();
+        queued_.pop_front();
+        return RTP_PKT_READY;
     }
 
-    return RTP_OK;
+    return RTP_NOT_FOUND;
+}
+
+uint64_t uvgrtp::formats::media::get_lost_frames() const
+{
+    return lost_frames_;
 }
 
 void uvgrtp::formats::media::set_fps(ssize_t numerator, ssize_t denominator)
@@ -201,3 +332,53 @@ void uvgrtp::formats::media::set_pace(ssize_t numerator, ssize_t denominator)
 {
     fqueue_->set_pace(numerator, denominator);
 }
+
+void uvgrtp::formats::media::set_fec(std::shared_ptr<uvgrtp::fec> fec)
+{
+    fqueue_->set_fec(fec);
+}
+
+void uvgrtp::formats::media::set_header_extensions(std::shared_ptr<uvgrtp::header_extensions> ext)
+{
+    fqueue_->set_header_extensions(ext);
+}
+
+void uvgrtp::formats::media::set_transport_cc(std::shared_ptr<uvgrtp::transport_cc> tcc)
+{
+    fqueue_->set_transport_cc(tcc);
+}
+
+void uvgrtp::formats::media::set_latency_budget(ssize_t ms)
+{
+    fqueue_->set_latency_budget(ms);
+}
+
+uint64_t uvgrtp::formats::media::get_shed_bytes(int priority) const
+{
+    return fqueue_->get_shed_bytes(priority);
+}
+
+void uvgrtp::formats::media::set_parallel_scl_threshold(size_t bytes)
+{
+    parallel_scl_threshold_ = bytes;
+}
+
+void uvgrtp::formats::media::set_scl_thread_pool(std::shared_ptr<uvgrtp::thread_pool> pool)
+{
+    scl_pool_ = pool;
+}
+
+void uvgrtp::formats::media::set_parameter_set_interval(size_t ms)
+{
+    parameter_set_interval_ = ms;
+}
+
+void uvgrtp::formats::media::set_rtcp(std::shared_ptr<uvgrtp::rtcp> rtcp)
+{
+    rtcp_ = rtcp;
+}
+
+void uvgrtp::formats::media::set_nal_chunk_size(size_t bytes)
+{
+    nal_chunk_size_ = bytes;
+}
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "uvgrtp/util.hh"
+#include "uvgrtp/clock.hh"
 
-#include <map>
+#include "fragment_store.hh"
+
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <memory>
-#include <unordered_map>
-#include <unordered_set>
 
 #ifdef _WIN32
 #include <ws2def.h>
@@ -18,32 +21,23 @@ namespace uvgrtp {
 
     class socket;
     class rtp;
+    class fec;
+    class header_extensions;
+    class transport_cc;
+    class rtcp;
     class frame_queue;
+    class thread_pool;
 
     namespace frame {
         struct rtp_frame;
+        struct nal_unit;
+        struct nal_chunk;
     }
 
     namespace formats {
 
         #define INVALID_TS            0xffffffff
 
-        /* TODO: This functionality has much in common with h26x fragmentation and 
-         * they could use same structures */ 
-
-        typedef struct media_info {
-            uint32_t s_seq = 0;
-            uint32_t e_seq = 0;
-            size_t npkts = 0;
-            size_t size = 0;
-            std::map<uint32_t, uvgrtp::frame::rtp_frame *> fragments;
-        } media_info_t;
-
-        typedef struct media_frame_info {
-            std::unordered_map<uint32_t, media_info> frames;
-            std::unordered_set<uint32_t> dropped;
-        } media_frame_info_t;
-
         class media {
             public:
                 media(std::shared_ptr<uvgrtp::socket> socket, std::shared_ptr<uvgrtp::rtp> rtp_ctx, int rce_flags);
@@ -57,6 +51,34 @@ namespace uvgrtp {
                 rtp_error_t push_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags, uint32_t ssrc);
                 rtp_error_t push_frame(sockaddr_in& addr, sockaddr_in6& addr6, std::unique_ptr<uint8_t[]> data, size_t data_len, int rtp_flags, uint32_t ssrc);
 
+                /* Send the NAL units of one frame without start code lookup. Only media formats
+                 * that carry NAL units implement this
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_NOT_SUPPORTED if the media format does not consist of NAL units */
+                virtual rtp_error_t push_nal_units(sockaddr_in& addr, sockaddr_in6& addr6, const uvgrtp::frame::nal_unit *nals, size_t count,
+                    int rtp_flags, uint32_t ssrc);
+
+                /* Send one frame slice by slice while the encoder is still producing it. All slices
+                 * between begin_frame() and end_frame() share one RTP timestamp and the marker bit is
+                 * set in the last packet sent by end_frame(). Only media formats that carry NAL units
+                 * implement these
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_NOT_READY if push_slice() or end_frame() is called without begin_frame()
+                 * Return RTP_NOT_SUPPORTED if the media format does not consist of NAL units */
+                virtual rtp_error_t begin_frame();
+                virtual rtp_error_t push_slice(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len,
+                    int rtp_flags, uint32_t ssrc);
+                virtual rtp_error_t end_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc);
+
+                /* Give fragmented NAL units to "hook" progressively instead of returning them as complete frames.
+                 * Only media formats that carry NAL units implement this
+                 *
+                 * Return RTP_OK on success
+                 * Return RTP_NOT_SUPPORTED if the media format does not consist of NAL units */
+                virtual rtp_error_t install_nal_chunk_hook(std::function<void(const uvgrtp::frame::nal_chunk&)> hook);
+
                 /* Media-specific packet handler. The default handler, depending on what "rce_flags_" contains,
                  * may only return the received RTP packet or it may merge multiple packets together before
                  * returning a complete frame to the user.
@@ -69,11 +91,40 @@ namespace uvgrtp {
                  * Return RTP_GENERIC_ERROR if the packet was corrupted in some way */
                 rtp_error_t packet_handler(void* arg, int rce_flags, uint8_t* read_ptr, size_t size, frame::rtp_frame** out);
 
-                /* Return pointer to the internal frame info structure which is relayed to packet handler */
-                media_frame_info_t *get_media_frame_info();
+                /* If the packet handler must return more than one frame, it can install a frame getter
+                 * that is called by the auxiliary handler caller if packet_handler() returns RTP_MULTIPLE_PKTS_READY
+                 *
+                 * Return RTP_PKT_READY if "frame" contains a frame that can be returned to user
+                 * Return RTP_NOT_FOUND if there are no more frames */
+                rtp_error_t frame_getter(frame::rtp_frame** frame);
+
+                /* Return the number of received frames that were discarded because some of their packets were lost */
+                uint64_t get_lost_frames() const;
 
                 void set_fps(ssize_t numerator, ssize_t denominator);
                 void set_pace(ssize_t numerator, ssize_t denominator);
+                void set_fec(std::shared_ptr<uvgrtp::fec> fec);
+                void set_header_extensions(std::shared_ptr<uvgrtp::header_extensions> ext);
+                void set_transport_cc(std::shared_ptr<uvgrtp::transport_cc> tcc);
+                void set_latency_budget(ssize_t ms);
+
+                /* Return the number of bytes of NAL units of class "priority" (RTP_NAL_PRIORITY) that have been shed */
+                uint64_t get_shed_bytes(int priority) const;
+
+                /* Frames larger than "bytes" are searched for start codes using the shared thread pool, 0 disables */
+                void set_parallel_scl_threshold(size_t bytes);
+
+                /* Search for start codes using "pool" instead of the shared thread pool, nullptr restores the shared one */
+                void set_scl_thread_pool(std::shared_ptr<uvgrtp::thread_pool> pool);
+
+                /* The cached parameter sets are sent at least every "ms" milliseconds, 0 sends them only before intra pictures */
+                void set_parameter_set_interval(size_t ms);
+
+                /* Keyframes are requested from the sender through "rtcp" when received frames are dropped */
+                void set_rtcp(std::shared_ptr<uvgrtp::rtcp> rtcp);
+
+                /* The NAL chunk hook is called once "bytes" new bytes of a NAL unit have been received, 0 calls it on every change */
+                void set_nal_chunk_size(size_t bytes);
 
             protected:
                 virtual rtp_error_t push_media_frame(sockaddr_in& addr, sockaddr_in6& addr6, uint8_t *data, size_t data_len, int rtp_flags, uint32_t ssrc);
@@ -82,9 +133,30 @@ namespace uvgrtp {
                 std::shared_ptr<uvgrtp::rtp> rtp_ctx_;
                 int rce_flags_;
                 std::unique_ptr<uvgrtp::frame_queue> fqueue_;
+                size_t parallel_scl_threshold_;
+                std::shared_ptr<uvgrtp::thread_pool> scl_pool_;
+                size_t parameter_set_interval_;
+                std::shared_ptr<uvgrtp::rtcp> rtcp_;
+                size_t nal_chunk_size_;
+
+                // Frames waiting to be returned by frame_getter()
+                std::deque<uvgrtp::frame::rtp_frame*> queued_;
+
+                std::atomic<uint64_t> lost_frames_;
 
             private:
-                media_frame_info_t minfo_;
+                /* Copy the payloads of a complete generic frame to one frame and free the fragments */
+                uvgrtp::frame::rtp_frame *merge_fragments(const uvgrtp::formats::fragment_store::link_result& linked);
+
+                void garbage_collect_lost_frames(size_t timeout);
+
+                // Fragments of generic frames waiting for reassembly, only allocated with RCE_FRAGMENT_GENERIC
+                std::unique_ptr<uvgrtp::formats::fragment_store> fragments_;
+
+                // Set once the first fragment has been received, the first fragment starts a frame
+                bool receiving_;
+
+                uvgrtp::clock::hrc::hrc_t last_garbage_collection_;
         };
     }
 }
@@ -0,0 +1,259 @@
+#include "start_code.hh"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define UVG_SCL_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define UVG_SCL_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/* The vectorized implementations are compiled for their instruction set even if the rest
+ * of the library is not, get_start_code_variants() makes sure they are only called if the CPU supports them */
+#if defined(__GNUC__) || defined(__clang__)
+#define UVG_SCL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define UVG_SCL_TARGET(isa)
+#endif
+
+static inline unsigned lowest_set_bit(uint64_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    if (_BitScanForward(&index, (unsigned long)value))
+        return index;
+
+    _BitScanForward(&index, (unsigned long)(value >> 32));
+    return 32 + index;
+#else
+    return (unsigned)__builtin_ctzll(value);
+#endif
+}
+
+/* Prefix starts at "pos", the zero byte before it only counts if it is within the searched area */
+static inline ssize_t start_code_at(const uint8_t *data, size_t offset, size_t pos, uint8_t& start_len)
+{
+    start_len = (pos > offset && data[pos - 1] == 0) ? 4 : 3;
+    return (ssize_t)(pos + 3);
+}
+
+static ssize_t scan_bytewise(const uint8_t *data, size_t len, size_t pos, size_t offset, uint8_t& start_len)
+{
+    while (pos + 3 <= len) {
+        /* Third byte of the prefix must be 0x01. Anything larger means that a prefix cannot
+         * start from any of the three positions and if it is 0x01, only "pos" is possible */
+        if (data[pos + 2] > 1) {
+            pos += 3;
+        } else if (data[pos + 2] == 1) {
+            if (data[pos] == 0 && data[pos + 1] == 0)
+                return start_code_at(data, offset, pos, start_len);
+
+            pos += 3;
+        } else {
+            ++pos;
+        }
+    }
+
+    return -1;
+}
+
+ssize_t uvgrtp::formats::find_start_code_bytewise(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    return scan_bytewise(data, len, offset, offset, start_len);
+}
+
+/* Each vectorized implementation compares the bytes at "pos", "pos + 1" and "pos + 2" against
+ * 00, 00 and 01 for a whole register at a time so the prefix is found regardless of its alignment
+ * and no state has to be carried between registers. Registers without any zeros, which is almost
+ * all of them in slice data, are skipped after the first comparison.
+ * The last bytes are handled by scan_bytewise() */
+
+#if defined(UVG_SCL_X86)
+
+UVG_SCL_TARGET("sse2")
+static ssize_t find_start_code_sse2(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one  = _mm_set1_epi8(1);
+    size_t pos = offset;
+
+    for (; pos + 16 + 3 <= len; pos += 16) {
+        __m128i z0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + pos)), zero);
+
+        if (!_mm_movemask_epi8(z0))
+            continue;
+
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(data + pos + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *)(data + pos + 2));
+
+        __m128i match = _mm_and_si128(
+            _mm_and_si128(z0, _mm_cmpeq_epi8(b1, zero)),
+            _mm_cmpeq_epi8(b2, one)
+        );
+
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(match);
+
+        if (mask)
+            return start_code_at(data, offset, pos + lowest_set_bit(mask), start_len);
+    }
+
+    return scan_bytewise(data, len, pos, offset, start_len);
+}
+
+UVG_SCL_TARGET("avx2")
+static ssize_t find_start_code_avx2(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one  = _mm256_set1_epi8(1);
+    size_t pos = offset;
+
+    for (; pos + 32 + 3 <= len; pos += 32) {
+        __m256i z0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(data + pos)), zero);
+
+        if (!_mm256_movemask_epi8(z0))
+            continue;
+
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(data + pos + 1));
+        __m256i b2 = _mm256_loadu_si256((const __m256i *)(data + pos + 2));
+
+        __m256i match = _mm256_and_si256(
+            _mm256_and_si256(z0, _mm256_cmpeq_epi8(b1, zero)),
+            _mm256_cmpeq_epi8(b2, one)
+        );
+
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(match);
+
+        if (mask)
+            return start_code_at(data, offset, pos + lowest_set_bit(mask), start_len);
+    }
+
+    return scan_bytewise(data, len, pos, offset, start_len);
+}
+
+UVG_SCL_TARGET("avx512f,avx512bw")
+static ssize_t find_start_code_avx512(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one  = _mm512_set1_epi8(1);
+    size_t pos = offset;
+
+    for (; pos + 64 + 3 <= len; pos += 64) {
+        __mmask64 mask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((const void *)(data + pos)), zero);
+
+        if (!mask)
+            continue;
+
+        mask = _mm512_mask_cmpeq_epi8_mask(mask, _mm512_loadu_si512((const void *)(data + pos + 1)), zero);
+        mask = _mm512_mask_cmpeq_epi8_mask(mask, _mm512_loadu_si512((const void *)(data + pos + 2)), one);
+
+        if (mask)
+            return start_code_at(data, offset, pos + lowest_set_bit((uint64_t)mask), start_len);
+    }
+
+    return scan_bytewise(data, len, pos, offset, start_len);
+}
+
+struct x86_features {
+    bool sse2 = false;
+    bool avx2 = false;
+    bool avx512bw = false;
+};
+
+static x86_features detect_x86_features()
+{
+    x86_features features;
+
+#if defined(_MSC_VER)
+    int info[4] = { 0 };
+
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    features.sse2 = (info[3] & (1 << 26)) != 0;
+
+    /* the OS must also save the AVX and AVX-512 registers on context switch */
+    bool osxsave  = (info[2] & (1 << 27)) != 0;
+    uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+
+    if (max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        features.avx2     = (info[1] & (1 << 5)) && (xcr0 & 0x06) == 0x06;
+        features.avx512bw = (info[1] & (1 << 16)) && (info[1] & (1 << 30)) && (xcr0 & 0xe6) == 0xe6;
+    }
+#else
+    __builtin_cpu_init();
+    features.sse2     = __builtin_cpu_supports("sse2");
+    features.avx2     = __builtin_cpu_supports("avx2");
+    features.avx512bw = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+
+    return features;
+}
+
+#elif defined(UVG_SCL_NEON)
+
+static ssize_t find_start_code_neon(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one  = vdupq_n_u8(1);
+    size_t pos = offset;
+
+    for (; pos + 16 + 3 <= len; pos += 16) {
+        uint8x16_t z0 = vceqq_u8(vld1q_u8(data + pos), zero);
+
+        if (!vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(z0), 4)), 0))
+            continue;
+
+        uint8x16_t match = vandq_u8(
+            vandq_u8(z0, vceqq_u8(vld1q_u8(data + pos + 1), zero)),
+            vceqq_u8(vld1q_u8(data + pos + 2), one)
+        );
+
+        /* NEON has no movemask, narrow each byte of the result to four bits instead */
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(match), 4)), 0);
+
+        if (mask)
+            return start_code_at(data, offset, pos + lowest_set_bit(mask) / 4, start_len);
+    }
+
+    return scan_bytewise(data, len, pos, offset, start_len);
+}
+
+#endif
+
+std::vector<uvgrtp::formats::start_code_variant> uvgrtp::formats::get_start_code_variants()
+{
+    std::vector<uvgrtp::formats::start_code_variant> variants;
+
+#if defined(UVG_SCL_X86)
+    x86_features cpu = detect_x86_features();
+
+    if (cpu.sse2)
+        variants.push_back({ "SSE2", find_start_code_sse2 });
+
+    if (cpu.avx2)
+        variants.push_back({ "AVX2", find_start_code_avx2 });
+
+    if (cpu.avx512bw)
+        variants.push_back({ "AVX-512", find_start_code_avx512 });
+#elif defined(UVG_SCL_NEON)
+    variants.push_back({ "NEON", find_start_code_neon });
+#endif
+
+    return variants;
+}
+
+uvgrtp::formats::start_code_finder uvgrtp::formats::get_start_code_finder()
+{
+    static const start_code_finder finder = []() -> start_code_finder {
+        std::vector<start_code_variant> variants = get_start_code_variants();
+        return variants.empty() ? nullptr : variants.back().find;
+    }();
+
+    return finder;
+}
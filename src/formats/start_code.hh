@@ -0,0 +1,40 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <cstdint>
+#include <vector>
+
+namespace uvgrtp {
+    namespace formats {
+
+        /* Find the first "00 00 01" start code prefix from "data[offset]" - "data[len - 1]".
+         * A prefix that ends the buffer is also found, the returned offset is then "len"
+         *
+         * "start_len" is set to 4 if the prefix is preceded by a zero byte that
+         * is also within the searched area, otherwise it is set to 3
+         *
+         * Return the offset of the byte following the prefix on success
+         * Return -1 if no start code was found */
+        typedef ssize_t (*start_code_finder)(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
+
+        struct start_code_variant {
+            const char *name;
+            start_code_finder find;
+        };
+
+        /* Byte-by-byte implementation, used for the tails of the vectorized ones */
+        ssize_t find_start_code_bytewise(const uint8_t *data, size_t len, size_t offset, uint8_t& start_len);
+
+        /* Return the vectorized implementations the CPU supports, fastest last */
+        std::vector<start_code_variant> get_start_code_variants();
+
+        /* Return the fastest vectorized implementation the CPU supports.
+         * The CPU is only queried on the first call
+         *
+         * Return nullptr if the CPU does not support any of them */
+        start_code_finder get_start_code_finder();
+    }
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -55,12 +55,30 @@ rtp_error_t uvgrtp::frame::dealloc_frame(uvgrtp::frame::rtp_frame *frame)
     if (frame->payload)
         delete[] frame->payload;
 
+    if (frame->nals)
+        delete[] frame->nals;
+
     //UVG_LOG_DEBUG("Deallocating frame, type %u", frame->type);
 
     delete frame;
     return RTP_OK;
 }
 
+const uint8_t *uvgrtp::frame::get_header_extension(const uvgrtp::frame::rtp_frame *frame, uint8_t id, size_t *len)
+{
+    if (!frame || !len)
+        return nullptr;
+
+    for (size_t i = 0; i < frame->ext_count; ++i) {
+        if (frame->ext_elements[i].id == id) {
+            *len = frame->ext_elements[i].len;
+            return &frame->ext_data[frame->ext_elements[i].offset];
+        }
+    }
+
+    return nullptr;
+}
+
 void* uvgrtp::frame::alloc_zrtp_frame(size_t size)
 {
     if (size == 0) {
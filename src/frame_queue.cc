@@ -6,10 +6,14 @@
 #include "formats/v3c.hh"
 
 #include "rtp.hh"
+#include "fec.hh"
+#include "header_extensions.hh"
+#include "transport_cc.hh"
 #include "srtp/base.hh"
 
 #include "random.hh"
 #include "debug.hh"
+#include <algorithm>
 #include <thread>
 
 #ifdef _WIN32
@@ -33,11 +37,23 @@ uvgrtp::frame_queue::frame_queue(std::shared_ptr<uvgrtp::socket> socket, std::sh
     rtp_(rtp), 
     socket_(socket),
     rce_flags_(rce_flags),
+    auth_tag_len_(uvgrtp::get_srtp_tag_length(rce_flags)),
+    encrypt_payload_((rce_flags & RCE_SRTP) && !(rce_flags & RCE_SRTP_NULL_CIPHER)),
+    srtp_pool_(),
+    srtp_block_(0),
+    srtp_offset_(0),
     fps_(false),
     frame_interval_(),
     fps_sync_point_(),
-    frames_since_sync_(0)
-{}
+    frames_since_sync_(0),
+    tcc_(nullptr),
+    transport_seqs_(),
+    pacer_next_(),
+    latency_budget_(0)
+{
+    for (auto& bytes : shed_bytes_)
+        bytes = 0;
+}
 
 uvgrtp::frame_queue::~frame_queue()
 {
@@ -94,11 +110,22 @@ rtp_error_t uvgrtp::frame_queue::init_transaction(bool use_old_rtp_ts)
     active_->data_smart   = nullptr;
     active_->dealloc_hook = dealloc_hook_;
 
-    if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-        active_->rtp_auth_tags = new uint8_t[10 * max_mcount_];
+    if (auth_tag_len_)
+        active_->rtp_auth_tags = new uint8_t[auth_tag_len_ * max_mcount_];
     else
         active_->rtp_auth_tags = nullptr;
 
+    active_->rtpext_ptr  = 0;
+    active_->rtpext_size = ext_ ? ext_->get_size() : 0;
+
+    srtp_block_  = 0;
+    srtp_offset_ = 0;
+
+    if (active_->rtpext_size)
+        active_->rtp_exts = new uint8_t[active_->rtpext_size * max_mcount_];
+    else
+        active_->rtp_exts = nullptr;
+
     rtp_->fill_header((uint8_t *)&active_->rtp_common, use_old_rtp_ts);
     active_->buffers.clear();
 
@@ -156,6 +183,9 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction()
     if (active_->rtp_auth_tags)
         delete[] active_->rtp_auth_tags;
 
+    if (active_->rtp_exts)
+        delete[] active_->rtp_exts;
+
     for (unsigned int i = 0; i < active_->tmp.size(); ++i)
     {
         delete[] active_->tmp[i];
@@ -167,6 +197,7 @@ rtp_error_t uvgrtp::frame_queue::deinit_transaction()
     active_->chunks = nullptr;
     active_->rtp_headers = nullptr;
     active_->rtp_auth_tags = nullptr;
+    active_->rtp_exts = nullptr;
 
     if (active_->media_headers)
     {
@@ -214,21 +245,12 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(uint8_t *message, size_t messag
      * and which is then pushed to "active_"'s pkt_vec structure */
     uvgrtp::buf_vec tmp;
 
-    /* update the RTP header at "rtpheaders_ptr_" */
-    update_rtp_header();
-
-    if (set_m_bit)
-        ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr])[1] |= (1 << 7);
-
     /* Push RTP header first and then push all payload buffers */
-    tmp.push_back({
-        sizeof(active_->rtp_headers[active_->rtphdr_ptr]),
-        (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]
-    });
+    enqueue_rtp_header(tmp, set_m_bit);
 
     tmp.push_back({ message_len, message });
 
-    enqueue_finalize(tmp);
+    enqueue_finalize(tmp, message_len);
     return RTP_OK;
 }
 
@@ -245,50 +267,30 @@ rtp_error_t uvgrtp::frame_queue::enqueue_message(buf_vec& buffers)
         return RTP_INVALID_VALUE;
     }
 
-    /* update the RTP header at "rtpheaders_ptr_" */
-    update_rtp_header();
-
     /* Create buffer vector where the full packet is constructed
      * and which is then pushed to "active_"'s pkt_vec structure */
     uvgrtp::buf_vec tmp;
 
     /* Push RTP header first and then push all payload buffers */
-    tmp.push_back({     sizeof(active_->rtp_headers[active_->rtphdr_ptr]), 
-                   (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++]});
+    enqueue_rtp_header(tmp, false);
 
-    /* If SRTP with proper encryption is used and there are more than one buffer,
-     * frame queue must be a copy of the input and ... */
-    if ((rce_flags_ & RCE_SRTP) && !(rce_flags_ & RCE_SRTP_NULL_CIPHER) && buffers.size() > 1) {
-        
-        size_t total = 0;
+    size_t total = 0;
 
-        for (auto& buffer : buffers) {
-            total += buffer.first;
-        }
-
-        uint8_t* mem = new uint8_t[total];
-        uint8_t* ptr = mem;
-
-        // copy buffers to a single pointer
-        for (auto& buffer : buffers) {
-            memcpy(ptr, buffer.second, buffer.first);
-            ptr += buffer.first;
-        }
-
-        tmp.push_back({ total, mem });
-        active_->tmp.push_back(mem);
-
-    } else {
-        for (auto& buffer : buffers) {
-            tmp.push_back({ buffer.first, buffer.second });
-        }
+    for (auto& buffer : buffers) {
+        tmp.push_back({ buffer.first, buffer.second });
+        total += buffer.first;
     }
 
-    enqueue_finalize(tmp);
+    enqueue_finalize(tmp, total);
     return RTP_OK;
 }
 
 rtp_error_t uvgrtp::frame_queue::flush_queue(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc)
+{
+    return flush_queue(addr, addr6, ssrc, active_->packets.size() > 1);
+}
+
+rtp_error_t uvgrtp::frame_queue::flush_queue(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc, bool set_m_bit)
 {
     if (active_->packets.empty()) {
         UVG_LOG_ERROR("Cannot send an empty packet!");
@@ -297,8 +299,77 @@ rtp_error_t uvgrtp::frame_queue::flush_queue(sockaddr_in& addr, sockaddr_in6& ad
     }
 
     /* set the marker bit of the last packet to 1 */
-    if (active_->packets.size() > 1)
+    if (set_m_bit)
         ((uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr - 1])[1] |= (1 << 7);
+
+    if (send_queue(addr, addr6, ssrc) != RTP_OK) {
+        (void)deinit_transaction();
+        return RTP_SEND_ERROR;
+    }
+
+    //UVG_LOG_DEBUG("full message took %zu chunks and %zu messages", active_->chunk_ptr, active_->hdr_ptr);
+    return deinit_transaction();
+}
+
+rtp_error_t uvgrtp::frame_queue::flush_queue_except_last(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc)
+{
+    if (active_->packets.empty()) {
+        UVG_LOG_ERROR("Cannot send an empty packet!");
+        (void)deinit_transaction();
+        return RTP_INVALID_VALUE;
+    }
+
+    uvgrtp::buf_vec held = active_->packets.back();
+    active_->packets.pop_back();
+
+    /* the payload is copied between the RTP header and extensions and the buffers of SRTP */
+    size_t first = active_->rtp_exts ? 2 : 1;
+    size_t last  = held.size() - (encrypt_payload_ ? 1 : 0) - (auth_tag_len_ ? 1 : 0);
+    size_t len   = 0;
+
+    for (size_t i = first; i < last; ++i) {
+        len += held[i].first;
+    }
+
+    uint8_t *payload = new uint8_t[len];
+    size_t offset    = 0;
+
+    for (size_t i = first; i < last; ++i) {
+        memcpy(payload + offset, held[i].second, held[i].first);
+        offset += held[i].first;
+    }
+
+    active_->tmp.push_back(payload);
+    held.erase(held.begin() + first, held.begin() + last);
+    held.insert(held.begin() + first, { len, payload });
+
+    if (!active_->packets.empty() && send_queue(addr, addr6, ssrc) != RTP_OK) {
+        (void)deinit_transaction();
+        return RTP_SEND_ERROR;
+    }
+
+    /* the extensions of a flush are written to the blocks from the first one on */
+    if (active_->rtp_exts)
+        held[1].second = active_->rtp_exts;
+
+    active_->packets.clear();
+    active_->packets.push_back(held);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::frame_queue::send_queue(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc)
+{
+    /* frame marking follows the marker bit so the extensions are written after it has been set */
+    transport_seqs_.clear();
+
+    if (active_->rtp_exts)
+        ext_->write(active_->packets, active_->rtp_exts, active_->rtpext_size, tcc_ ? &transport_seqs_ : nullptr);
+
+    /* repair packets are computed over the final media packets so this must be done after the marker is set */
+    if (fec_ && fec_->protect(active_->packets, active_->tmp) != RTP_OK) {
+        UVG_LOG_WARN("Failed to generate FEC repair packets");
+    }
     
     std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
 
@@ -362,20 +433,90 @@ rtp_error_t uvgrtp::frame_queue::flush_queue(sockaddr_in& addr, sockaddr_in6& ad
             //  send pkt vects
             if (socket_->sendto(ssrc, addr, addr6, active_->packets[i], 0) != RTP_OK) {
                 UVG_LOG_ERROR("Failed to send packet: %li", errno);
-                (void)deinit_transaction();
                 return RTP_SEND_ERROR;
             }
+
+            report_sent_packet(i);
         }
 
     }
+    else if (tcc_) {
+        return send_paced(addr, addr6, ssrc);
+    }
     else if (socket_->sendto(ssrc, addr, addr6, active_->packets, 0) != RTP_OK) {
         UVG_LOG_ERROR("Failed to flush the message queue: %li", errno);
-        (void)deinit_transaction();
         return RTP_SEND_ERROR;
     }
 
-    //UVG_LOG_DEBUG("full message took %zu chunks and %zu messages", active_->chunk_ptr, active_->hdr_ptr);
-    return deinit_transaction();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::frame_queue::send_paced(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc)
+{
+    uint32_t rate = tcc_->get_pacing_rate();
+
+    for (size_t i = 0; i < active_->packets.size(); ++i)
+    {
+        std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+
+        /* an idle sender does not accumulate budget for a burst */
+        if (pacer_next_ > now)
+            std::this_thread::sleep_for(pacer_next_ - now);
+        else
+            pacer_next_ = now;
+
+        if (socket_->sendto(ssrc, addr, addr6, active_->packets[i], 0) != RTP_OK) {
+            UVG_LOG_ERROR("Failed to send packet: %li", errno);
+            return RTP_SEND_ERROR;
+        }
+
+        size_t size = report_sent_packet(i);
+        pacer_next_ += std::chrono::nanoseconds((uint64_t)(size * 8 * 1000000000.0 / rate));
+    }
+
+    return RTP_OK;
+}
+
+std::chrono::microseconds uvgrtp::frame_queue::estimate_send_time(size_t bytes)
+{
+    if (!tcc_)
+        return std::chrono::microseconds(0);
+
+    std::chrono::microseconds backlog = std::chrono::duration_cast<std::chrono::microseconds>(
+        pacer_next_ - std::chrono::high_resolution_clock::now());
+
+    if (backlog.count() < 0)
+        backlog = std::chrono::microseconds(0);
+
+    return backlog + std::chrono::microseconds((uint64_t)(bytes * 8 * 1000000.0 / tcc_->get_target_bitrate()));
+}
+
+void uvgrtp::frame_queue::add_shed_bytes(int priority, size_t bytes)
+{
+    if (priority >= 0 && priority < RTP_NAL_PRIORITY_COUNT)
+        shed_bytes_[priority] += bytes;
+}
+
+uint64_t uvgrtp::frame_queue::get_shed_bytes(int priority) const
+{
+    if (priority < 0 || priority >= RTP_NAL_PRIORITY_COUNT)
+        return 0;
+
+    return shed_bytes_[priority];
+}
+
+size_t uvgrtp::frame_queue::report_sent_packet(size_t index)
+{
+    size_t size = 0;
+
+    for (auto& buffer : active_->packets[index])
+        size += buffer.first;
+
+    /* FEC repair packets do not carry header extensions */
+    if (tcc_ && index < transport_seqs_.size())
+        tcc_->packet_sent(transport_seqs_[index], size);
+
+    return size;
 }
 
 inline std::chrono::high_resolution_clock::time_point uvgrtp::frame_queue::this_frame_time()
@@ -414,12 +555,40 @@ void uvgrtp::frame_queue::install_dealloc_hook(void (*dealloc_hook)(void *))
     dealloc_hook_ = dealloc_hook;
 }
 
-void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp)
+void uvgrtp::frame_queue::enqueue_rtp_header(uvgrtp::buf_vec& tmp, bool set_m_bit)
 {
-    if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
+    /* update the RTP header at "rtpheaders_ptr_" */
+    update_rtp_header();
+
+    uint8_t *header = (uint8_t *)&active_->rtp_headers[active_->rtphdr_ptr++];
+
+    if (set_m_bit)
+        header[1] |= (1 << 7);
+
+    tmp.push_back({ sizeof(uvgrtp::frame::rtp_header), header });
+
+    if (active_->rtp_exts) {
+        header[0] |= (1 << 4);
+
+        tmp.push_back({
+            active_->rtpext_size,
+            &active_->rtp_exts[active_->rtpext_size * active_->rtpext_ptr++]
+        });
+    }
+}
+
+void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp, size_t payload_len)
+{
+    /* SRTP reads the payload from the buffers above and writes the encrypted payload here
+     * so the memory given by the caller is not modified. The buffer is empty until then,
+     * see srtp::send_packet_handler() */
+    if (encrypt_payload_)
+        tmp.push_back({ 0, reserve_srtp_payload(payload_len) });
+
+    if (auth_tag_len_) {
         tmp.push_back({
-            UVG_AUTH_TAG_LENGTH,
-            (uint8_t*)&active_->rtp_auth_tags[10 * active_->rtpauth_ptr++]
+            auth_tag_len_,
+            (uint8_t*)&active_->rtp_auth_tags[auth_tag_len_ * active_->rtpauth_ptr++]
             });
     }
 
@@ -428,6 +597,24 @@ void uvgrtp::frame_queue::enqueue_finalize(uvgrtp::buf_vec& tmp)
     rtp_->inc_sent_pkts();
 }
 
+uint8_t *uvgrtp::frame_queue::reserve_srtp_payload(size_t len)
+{
+    while (srtp_block_ < srtp_pool_.size() && srtp_offset_ + len > srtp_pool_[srtp_block_].first) {
+        ++srtp_block_;
+        srtp_offset_ = 0;
+    }
+
+    if (srtp_block_ == srtp_pool_.size()) {
+        size_t size = std::max(SRTP_POOL_BLOCK_SIZE, len);
+        srtp_pool_.push_back({ size, std::unique_ptr<uint8_t[]>(new uint8_t[size]) });
+    }
+
+    uint8_t *ptr  = srtp_pool_[srtp_block_].second.get() + srtp_offset_;
+    srtp_offset_ += len;
+
+    return ptr;
+}
+
 inline void uvgrtp::frame_queue::update_sync_point()
 {
     //UVG_LOG_DEBUG("Updating framerate sync point");
@@ -24,8 +24,14 @@ const int MAX_MSG_COUNT   = 5000;
 const int MAX_QUEUED_MSGS =  10;
 const int MAX_CHUNK_COUNT =   4;
 
+/* Encrypted payloads are written to blocks of this size, see frame_queue::reserve_srtp_payload() */
+const size_t SRTP_POOL_BLOCK_SIZE = 64 * 1024;
+
 namespace uvgrtp {
     class rtp;
+    class fec;
+    class header_extensions;
+    class transport_cc;
 
     typedef struct transaction {
 
@@ -64,9 +70,15 @@ namespace uvgrtp {
         /* Pointer to RTP authentication (if enabled) */
         uint8_t *rtp_auth_tags = nullptr;
 
+        /* Space reserved for the RTP header extension block of each packet (if enabled).
+         * The blocks are written when the transaction is flushed */
+        uint8_t *rtp_exts = nullptr;
+        size_t rtpext_size = 0;
+
         size_t hdr_ptr = 0;
         size_t rtphdr_ptr = 0;
         size_t rtpauth_ptr = 0;
+        size_t rtpext_ptr = 0;
 
         /* The flag "RTP_COPY" means that uvgRTP has a made a copy of the original chunk 
          * and it can be safely freed */
@@ -119,6 +131,19 @@ namespace uvgrtp {
              * return RTP_SEND_ERROR if send fails */
             rtp_error_t flush_queue(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc);
 
+            /* Flush the message queue and set the marker bit of the last packet only if "set_m_bit" is true.
+             * Used when a frame is sent in more than one transaction */
+            rtp_error_t flush_queue(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc, bool set_m_bit);
+
+            /* Send every packet of the transaction except the last one, which stays queued until the
+             * transaction is flushed. Used when only a later call tells whether that packet ends the frame.
+             * The payload of the held packet is copied so the memory of the caller can be reused
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the message buffer is empty
+             * Return RTP_SEND_ERROR if send fails */
+            rtp_error_t flush_queue_except_last(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc);
+
             /* Media may have extra headers (f.ex. NAL and FU headers for HEVC).
              * These headers must be valid until the message is sent (ie. they cannot be saved to
              * caller's stack).
@@ -165,10 +190,70 @@ namespace uvgrtp {
                 pace_denominator_ = denominator;
             }
 
+            /* Generate FlexFEC repair packets for each flushed transaction */
+            void set_fec(std::shared_ptr<uvgrtp::fec> fec)
+            {
+                fec_ = fec;
+            }
+
+            /* Add RFC 8285 header extensions to each packet */
+            void set_header_extensions(std::shared_ptr<uvgrtp::header_extensions> ext)
+            {
+                ext_ = ext;
+            }
+
+            /* Report sent packets to the congestion controller and pace them to its target bitrate */
+            void set_transport_cc(std::shared_ptr<uvgrtp::transport_cc> tcc)
+            {
+                tcc_ = tcc;
+            }
+
+            /* Shed low-priority NAL units when delivering a frame would take longer than "ms" */
+            void set_latency_budget(ssize_t ms)
+            {
+                latency_budget_ = std::chrono::milliseconds(ms);
+            }
+
+            std::chrono::microseconds get_latency_budget() const
+            {
+                return latency_budget_;
+            }
+
+            /* Estimate how long delivering "bytes" takes at the target bitrate of the congestion
+             * controller, including the packets still waiting in the pacer.
+             * Return 0 if there is no congestion controller */
+            std::chrono::microseconds estimate_send_time(size_t bytes);
+
+            void add_shed_bytes(int priority, size_t bytes);
+            uint64_t get_shed_bytes(int priority) const;
+
         private:
 
 
-            void enqueue_finalize(uvgrtp::buf_vec& tmp);
+            /* Push the RTP header of the current packet and the space reserved for its header extensions to "tmp" */
+            void enqueue_rtp_header(uvgrtp::buf_vec& tmp, bool set_m_bit);
+
+            /* Push the output buffer of SRTP encryption and the authentication tag to "tmp" and add it to the transaction */
+            void enqueue_finalize(uvgrtp::buf_vec& tmp, size_t payload_len);
+
+            /* Reserve "len" bytes for an encrypted payload. The memory is valid until the next transaction
+             * is initialized and it is reused by it so sending a frame does not allocate memory after the first ones */
+            uint8_t *reserve_srtp_payload(size_t len);
+
+            /* Report the size and transport-wide sequence number of the "index"th packet
+             * of the active transaction to the congestion controller
+             *
+             * Return the size of the packet in bytes */
+            size_t report_sent_packet(size_t index);
+
+            /* Write the header extensions, add the FEC repair packets and send the packets of the active transaction
+             *
+             * Return RTP_OK on success
+             * Return RTP_SEND_ERROR if send fails */
+            rtp_error_t send_queue(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc);
+
+            /* Send the packets of the active transaction no faster than the pacing rate of the congestion controller */
+            rtp_error_t send_paced(sockaddr_in& addr, sockaddr_in6& addr6, uint32_t ssrc);
 
             inline std::chrono::high_resolution_clock::time_point this_frame_time();
 
@@ -187,6 +272,16 @@ namespace uvgrtp {
 
             int rce_flags_;
 
+            /* Length of the SRTP authentication tag appended to every packet, 0 if there is none */
+            size_t auth_tag_len_;
+
+            /* Is the payload encrypted with SRTP? The encrypted payloads are written to "srtp_pool_" */
+            bool encrypt_payload_;
+
+            std::vector<std::pair<size_t, std::unique_ptr<uint8_t[]>>> srtp_pool_;
+            size_t srtp_block_;
+            size_t srtp_offset_;
+
             bool fps_ = false;
             std::chrono::nanoseconds frame_interval_;
             ssize_t pace_numerator_;
@@ -196,6 +291,16 @@ namespace uvgrtp {
             uint64_t frames_since_sync_ = 0;
 
             bool force_sync_ = false;
+
+            std::shared_ptr<uvgrtp::fec> fec_;
+            std::shared_ptr<uvgrtp::header_extensions> ext_;
+
+            std::shared_ptr<uvgrtp::transport_cc> tcc_;
+            std::vector<uint16_t> transport_seqs_;
+            std::chrono::high_resolution_clock::time_point pacer_next_;
+
+            std::chrono::microseconds latency_budget_;
+            std::atomic<uint64_t> shed_bytes_[RTP_NAL_PRIORITY_COUNT];
     };
 }
 
@@ -0,0 +1,240 @@
+#include "header_extensions.hh"
+
+#include "uvgrtp/clock.hh"
+
+#include "debug.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <cstring>
+
+/* Frame marking bits of the short (non-scalable) form */
+constexpr uint8_t FRAME_MARKING_START = 0x80;
+constexpr uint8_t FRAME_MARKING_END   = 0x40;
+
+uvgrtp::header_extensions::header_extensions():
+    elements_(),
+    two_byte_(false),
+    size_(0),
+    transport_seq_(0),
+    frame_ended_(true),
+    mutex_()
+{
+}
+
+uvgrtp::header_extensions::~header_extensions()
+{
+}
+
+rtp_error_t uvgrtp::header_extensions::register_extension(int type, uint8_t id)
+{
+    if (id == 0) {
+        UVG_LOG_ERROR("Header extension ID 0 is reserved for padding");
+        return RTP_INVALID_VALUE;
+    }
+
+    switch (type) {
+        case RTP_EXT_TRANSPORT_WIDE_SEQ:
+        case RTP_EXT_ABS_SEND_TIME:
+        case RTP_EXT_FRAME_MARKING:
+        case RTP_EXT_VIDEO_LAYERS_ALLOCATION:
+        case RTP_EXT_APPLICATION:
+            break;
+
+        default:
+            UVG_LOG_ERROR("Unknown header extension type %d", type);
+            return RTP_INVALID_VALUE;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& e : elements_) {
+        if (e.id == id) {
+            UVG_LOG_ERROR("Header extension ID %u is already in use", id);
+            return RTP_INVALID_VALUE;
+        }
+
+        /* each generated extension can only be sent once per packet */
+        if (e.type == type && type != RTP_EXT_APPLICATION) {
+            UVG_LOG_ERROR("Header extension type %d has already been registered", type);
+            return RTP_INVALID_VALUE;
+        }
+    }
+
+    element e;
+    e.type = type;
+    e.id   = id;
+    elements_.push_back(e);
+
+    update_layout();
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::header_extensions::set_extension_data(uint8_t id, const uint8_t *data, size_t len)
+{
+    if (len > UINT8_MAX || (len && !data))
+        return RTP_INVALID_VALUE;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& e : elements_) {
+        if (e.id != id)
+            continue;
+
+        if (e.type != RTP_EXT_VIDEO_LAYERS_ALLOCATION && e.type != RTP_EXT_APPLICATION) {
+            UVG_LOG_ERROR("The contents of header extension %u are generated by uvgRTP", id);
+            return RTP_NOT_SUPPORTED;
+        }
+
+        e.data.assign(data, data + len);
+        update_layout();
+        return RTP_OK;
+    }
+
+    UVG_LOG_ERROR("Header extension %u has not been registered", id);
+    return RTP_NOT_FOUND;
+}
+
+size_t uvgrtp::header_extensions::get_size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+uint8_t uvgrtp::header_extensions::get_id(int type)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& e : elements_) {
+        if (e.type == type)
+            return e.id;
+    }
+
+    return 0;
+}
+
+size_t uvgrtp::header_extensions::element_size(const element& e) const
+{
+    switch (e.type) {
+        case RTP_EXT_TRANSPORT_WIDE_SEQ:
+            return 2;
+
+        case RTP_EXT_ABS_SEND_TIME:
+            return 3;
+
+        case RTP_EXT_FRAME_MARKING:
+            return 1;
+
+        default:
+            return e.data.size();
+    }
+}
+
+void uvgrtp::header_extensions::update_layout()
+{
+    size_t data_len = 0;
+    size_t count    = 0;
+
+    two_byte_ = false;
+
+    for (auto& e : elements_) {
+        size_t len = element_size(e);
+
+        /* application elements without contents are not sent */
+        if (!len)
+            continue;
+
+        if (e.id > RTP_EXT_ONE_BYTE_MAX_ID || len > RTP_EXT_ONE_BYTE_MAX_LEN)
+            two_byte_ = true;
+
+        data_len += len;
+        ++count;
+    }
+
+    if (!count) {
+        size_ = 0;
+        return;
+    }
+
+    /* each element has a one or two byte header and the block is padded to 32 bits */
+    size_t block = data_len + count * (two_byte_ ? 2 : 1);
+    size_ = 4 + ((block + 3) & ~(size_t)3);
+}
+
+size_t uvgrtp::header_extensions::write_element(uint8_t *ptr, const element& e, bool marker,
+    std::vector<uint16_t> *transport_seqs)
+{
+    size_t len = element_size(e);
+
+    if (!len)
+        return 0;
+
+    if (two_byte_) {
+        *ptr++ = e.id;
+        *ptr++ = (uint8_t)len;
+    } else {
+        *ptr++ = (uint8_t)((e.id << 4) | (len - 1));
+    }
+
+    switch (e.type) {
+        case RTP_EXT_TRANSPORT_WIDE_SEQ:
+            if (transport_seqs)
+                transport_seqs->push_back(transport_seq_);
+
+            *(uint16_t *)ptr = htons(transport_seq_++);
+            break;
+
+        case RTP_EXT_ABS_SEND_TIME: {
+            /* 6.18 fixed point seconds, i.e. bits 14..37 of the NTP timestamp */
+            uint32_t abs_time = (uint32_t)(uvgrtp::clock::ntp::now() >> 14) & 0xffffff;
+            ptr[0] = (uint8_t)(abs_time >> 16);
+            ptr[1] = (uint8_t)(abs_time >>  8);
+            ptr[2] = (uint8_t)(abs_time >>  0);
+            break;
+        }
+
+        case RTP_EXT_FRAME_MARKING:
+            ptr[0] = (frame_ended_ ? FRAME_MARKING_START : 0) | (marker ? FRAME_MARKING_END : 0);
+            break;
+
+        default:
+            memcpy(ptr, e.data.data(), len);
+            break;
+    }
+
+    return len + (two_byte_ ? 2 : 1);
+}
+
+void uvgrtp::header_extensions::write(uvgrtp::pkt_vec& packets, uint8_t *blocks, size_t block_size,
+    std::vector<uint16_t> *transport_seqs)
+{
+    if (!blocks || block_size < 4)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (size_t i = 0; i < packets.size(); ++i) {
+        uint8_t *block = blocks + i * block_size;
+        bool marker    = packets[i][0].second[1] & 0x80;
+
+        memset(block, 0, block_size);
+
+        *(uint16_t *)&block[0] = htons(two_byte_ ? RTP_EXT_TWO_BYTE_PROFILE : RTP_EXT_ONE_BYTE_PROFILE);
+        *(uint16_t *)&block[2] = htons((uint16_t)((block_size - 4) / 4));
+
+        /* if the extensions were changed during this transaction, send only padding */
+        if (block_size == size_) {
+            uint8_t *ptr = block + 4;
+
+            for (auto& e : elements_) {
+                ptr += write_element(ptr, e, marker, transport_seqs);
+            }
+        }
+
+        frame_ended_ = marker;
+    }
+}
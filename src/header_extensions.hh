@@ -0,0 +1,93 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include "socket.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* "defined by profile" values of the RFC 8285 extension header */
+    constexpr uint16_t RTP_EXT_ONE_BYTE_PROFILE = 0xbede;
+    constexpr uint16_t RTP_EXT_TWO_BYTE_PROFILE = 0x1000;
+
+    /* The one-byte form can carry IDs 1..14 with 1..16 bytes of data */
+    constexpr uint8_t RTP_EXT_ONE_BYTE_MAX_ID   = 14;
+    constexpr uint8_t RTP_EXT_ONE_BYTE_MAX_LEN  = 16;
+
+    /* Builds the RFC 8285 header extension block of outgoing RTP packets.
+     *
+     * The set of registered extensions determines the size of the block, which
+     * frame_queue reserves for every packet of a transaction next to the RTP header.
+     * When the transaction is flushed, the blocks are written in place so the
+     * extensions cost no extra copies or allocations per packet.
+     *
+     * The one-byte form is used if every registered element fits it, otherwise
+     * the whole block is written using the two-byte form. */
+    class header_extensions {
+        public:
+            header_extensions();
+            ~header_extensions();
+
+            /* Register extension of type "type" (RTP_HEADER_EXTENSION) with local identifier "id"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "type" or "id" is invalid or "id" is already in use */
+            rtp_error_t register_extension(int type, uint8_t id);
+
+            /* Set the contents of an application-defined extension element.
+             * Setting length to 0 removes the element from the outgoing packets
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if length is over 255 bytes
+             * Return RTP_NOT_FOUND if "id" has not been registered
+             * Return RTP_NOT_SUPPORTED if the contents of "id" are generated by uvgRTP */
+            rtp_error_t set_extension_data(uint8_t id, const uint8_t *data, size_t len);
+
+            /* Return the size of the extension block (including the 4-byte extension header)
+             * that must be reserved for each packet, 0 if there are no extensions to send */
+            size_t get_size();
+
+            /* Return the identifier of the extension of type "type", 0 if it has not been registered */
+            uint8_t get_id(int type);
+
+            /* Write the extension blocks of "packets" to the memory reserved for them.
+             * Packet "i" uses the "block_size" bytes starting at "blocks + i * block_size"
+             *
+             * If the registered extensions changed after the memory was reserved
+             * and they no longer fit, the blocks are filled with padding
+             *
+             * If "transport_seqs" is given, the transport-wide sequence number of
+             * each packet is appended to it in the order of "packets" */
+            void write(uvgrtp::pkt_vec& packets, uint8_t *blocks, size_t block_size,
+                std::vector<uint16_t> *transport_seqs = nullptr);
+
+        private:
+            struct element {
+                int type = 0;
+                uint8_t id = 0;
+                std::vector<uint8_t> data;
+            };
+
+            size_t element_size(const element& e) const;
+            void update_layout();
+
+            size_t write_element(uint8_t *ptr, const element& e, bool marker, std::vector<uint16_t> *transport_seqs);
+
+            std::vector<element> elements_;
+            bool two_byte_;
+            size_t size_;
+
+            uint16_t transport_seq_;
+
+            /* The previous packet had the marker bit set, so the next one starts a frame */
+            bool frame_ended_;
+
+            std::mutex mutex_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
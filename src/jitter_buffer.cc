@@ -0,0 +1,280 @@
+#include "jitter_buffer.hh"
+
+#include "uvgrtp/frame.hh"
+#include "uvgrtp/rtcp.hh"
+
+#include "rtp.hh"
+#include "debug.hh"
+
+#include <algorithm>
+#include <cstdlib>
+
+uvgrtp::jitter_buffer::jitter_buffer(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<uvgrtp::rtcp> rtcp):
+    rtp_(rtp),
+    rtcp_(rtcp),
+    start_(uvgrtp::clock::hrc::now()),
+    frames_(),
+    immediate_(),
+    initialized_(false),
+    ssrc_(0),
+    clock_rate_(0),
+    highest_ts_(0),
+    highest_seq_(0),
+    ref_transit_us_(0),
+    jitter_us_(0),
+    prev_transit_us_(0),
+    played_(false),
+    last_played_(),
+    min_delay_ms_(JITTER_BUFFER_DEFAULT_MIN_DELAY_MS),
+    max_delay_ms_(JITTER_BUFFER_DEFAULT_MAX_DELAY_MS),
+    late_policy_(RTP_JITTER_DROP_LATE),
+    target_delay_ms_(JITTER_BUFFER_DEFAULT_MIN_DELAY_MS),
+    late_frames_(0)
+{}
+
+uvgrtp::jitter_buffer::~jitter_buffer()
+{
+    for (auto& f : frames_)
+    {
+        (void)uvgrtp::frame::dealloc_frame(f.second.frame);
+    }
+
+    for (auto& frame : immediate_)
+    {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+}
+
+int64_t uvgrtp::jitter_buffer::now_us() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(uvgrtp::clock::hrc::now() - start_).count();
+}
+
+void uvgrtp::jitter_buffer::push(uvgrtp::frame::rtp_frame *frame)
+{
+    push(frame, now_us());
+}
+
+void uvgrtp::jitter_buffer::push(uvgrtp::frame::rtp_frame *frame, int64_t now_us)
+{
+    if (!frame)
+        return;
+
+    uint32_t clock_rate = rtp_ ? rtp_->get_clock_rate() : 0;
+
+    /* without a clock rate the timestamps cannot be mapped to local time */
+    if (!clock_rate) {
+        immediate_.push_back(frame);
+        return;
+    }
+
+    bool restarted = false;
+
+    if (!initialized_ || frame->header.ssrc != ssrc_ || clock_rate != clock_rate_ ||
+        std::abs((int64_t)(int32_t)(frame->header.timestamp - (uint32_t)highest_ts_)) >
+            JITTER_BUFFER_MAX_TS_JUMP_S * clock_rate)
+    {
+        restart(frame, clock_rate);
+        restarted = true;
+    }
+
+    int64_t ts  = highest_ts_ + (int32_t)(frame->header.timestamp - (uint32_t)highest_ts_);
+    int64_t seq = highest_seq_ + (int16_t)(frame->header.seq - (uint16_t)highest_seq_);
+
+    highest_ts_  = std::max(highest_ts_, ts);
+    highest_seq_ = std::max(highest_seq_, seq);
+
+    int64_t transit_us = now_us - ts * 1000000 / clock_rate_;
+
+    if (restarted) {
+        ref_transit_us_  = (double)transit_us;
+        prev_transit_us_ = transit_us;
+    }
+
+    /* the fastest frame defines the timeline, slower ones move it only slowly */
+    if (transit_us < ref_transit_us_)
+        ref_transit_us_ = (double)transit_us;
+    else
+        ref_transit_us_ += (transit_us - ref_transit_us_) * JITTER_BUFFER_TRANSIT_DRIFT;
+
+    update_delay(transit_us, frame->header.ssrc);
+
+    frame_key key(ts, seq);
+
+    if (played_ && key < last_played_) {
+        ++late_frames_;
+
+        if (late_policy_ == RTP_JITTER_DELIVER_LATE) {
+            immediate_.push_back(frame);
+        }
+        else {
+            UVG_LOG_DEBUG("Dropping a late frame. Timestamp: %u, seq: %u", frame->header.timestamp, frame->header.seq);
+            (void)uvgrtp::frame::dealloc_frame(frame);
+        }
+        return;
+    }
+
+    entry e;
+    e.frame = frame;
+    e.arrival_us = now_us;
+
+    if (!frames_.emplace(key, e).second) {
+        UVG_LOG_DEBUG("Dropping a duplicate frame. Timestamp: %u, seq: %u", frame->header.timestamp, frame->header.seq);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::jitter_buffer::pop()
+{
+    return pop(now_us());
+}
+
+uvgrtp::frame::rtp_frame *uvgrtp::jitter_buffer::pop(int64_t now_us)
+{
+    if (!immediate_.empty()) {
+        uvgrtp::frame::rtp_frame *frame = immediate_.front();
+        immediate_.pop_front();
+        return frame;
+    }
+
+    if (frames_.empty())
+        return nullptr;
+
+    auto next = frames_.begin();
+
+    if (playout_us(next->first, next->second) > now_us)
+        return nullptr;
+
+    uvgrtp::frame::rtp_frame *frame = next->second.frame;
+
+    played_ = true;
+    last_played_ = next->first;
+    frames_.erase(next);
+
+    return frame;
+}
+
+int64_t uvgrtp::jitter_buffer::time_to_next_playout() const
+{
+    return time_to_next_playout(now_us());
+}
+
+int64_t uvgrtp::jitter_buffer::time_to_next_playout(int64_t now_us) const
+{
+    if (!immediate_.empty())
+        return 0;
+
+    if (frames_.empty())
+        return -1;
+
+    auto next = frames_.begin();
+    return std::max(playout_us(next->first, next->second) - now_us, (int64_t)0);
+}
+
+rtp_error_t uvgrtp::jitter_buffer::set_min_delay(ssize_t ms)
+{
+    if (ms < 0 || ms > max_delay_ms_) {
+        UVG_LOG_ERROR("The smallest playout delay must be between 0 and the largest delay");
+        return RTP_INVALID_VALUE;
+    }
+
+    min_delay_ms_ = ms;
+    target_delay_ms_ = std::max(target_delay_ms_.load(), ms);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::jitter_buffer::set_max_delay(ssize_t ms)
+{
+    if (ms < min_delay_ms_) {
+        UVG_LOG_ERROR("The largest playout delay cannot be smaller than the smallest delay");
+        return RTP_INVALID_VALUE;
+    }
+
+    max_delay_ms_ = ms;
+    target_delay_ms_ = std::min(target_delay_ms_.load(), ms);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::jitter_buffer::set_late_policy(int policy)
+{
+    if (policy != RTP_JITTER_DROP_LATE && policy != RTP_JITTER_DELIVER_LATE) {
+        UVG_LOG_ERROR("Unknown late frame policy %d", policy);
+        return RTP_INVALID_VALUE;
+    }
+
+    late_policy_ = policy;
+    return RTP_OK;
+}
+
+ssize_t uvgrtp::jitter_buffer::get_min_delay() const
+{
+    return min_delay_ms_;
+}
+
+ssize_t uvgrtp::jitter_buffer::get_max_delay() const
+{
+    return max_delay_ms_;
+}
+
+int uvgrtp::jitter_buffer::get_late_policy() const
+{
+    return late_policy_;
+}
+
+ssize_t uvgrtp::jitter_buffer::get_target_delay() const
+{
+    return target_delay_ms_;
+}
+
+uint64_t uvgrtp::jitter_buffer::get_late_frames() const
+{
+    return late_frames_;
+}
+
+void uvgrtp::jitter_buffer::restart(const uvgrtp::frame::rtp_frame *frame, uint32_t clock_rate)
+{
+    if (initialized_) {
+        UVG_LOG_DEBUG("Restarting the jitter buffer, SSRC: %u, timestamp: %u", frame->header.ssrc, frame->header.timestamp);
+    }
+
+    for (auto& f : frames_)
+    {
+        immediate_.push_back(f.second.frame);
+    }
+
+    frames_.clear();
+
+    initialized_  = true;
+    ssrc_         = frame->header.ssrc;
+    clock_rate_   = clock_rate;
+    highest_ts_   = frame->header.timestamp;
+    highest_seq_  = frame->header.seq;
+    jitter_us_    = 0;
+    played_       = false;
+}
+
+void uvgrtp::jitter_buffer::update_delay(int64_t transit_us, uint32_t ssrc)
+{
+    /* RFC 3550 A.8 */
+    jitter_us_ += (std::abs(transit_us - prev_transit_us_) - jitter_us_) / 16;
+    prev_transit_us_ = transit_us;
+
+    double jitter_us = jitter_us_;
+
+    if (rtcp_) {
+        double rtcp_jitter = rtcp_->get_jitter(ssrc);
+
+        if (rtcp_jitter >= 0)
+            jitter_us = rtcp_jitter * 1000000 / clock_rate_;
+    }
+
+    ssize_t target = (ssize_t)(JITTER_BUFFER_JITTER_FACTOR * jitter_us / 1000);
+    target_delay_ms_ = std::min(std::max(target, min_delay_ms_.load()), max_delay_ms_.load());
+}
+
+int64_t uvgrtp::jitter_buffer::playout_us(const frame_key& key, const entry& e) const
+{
+    int64_t playout = key.first * 1000000 / clock_rate_ + (int64_t)ref_transit_us_ + target_delay_ms_ * 1000;
+
+    return std::min(playout, e.arrival_us + max_delay_ms_ * 1000);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "uvgrtp/clock.hh"
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    class rtp;
+    class rtcp;
+
+    constexpr ssize_t JITTER_BUFFER_DEFAULT_MIN_DELAY_MS = 10;
+    constexpr ssize_t JITTER_BUFFER_DEFAULT_MAX_DELAY_MS = 200;
+
+    /* The playout delay covers this many times the interarrival jitter */
+    constexpr double JITTER_BUFFER_JITTER_FACTOR         = 3.0;
+
+    /* How much of the difference the reference transit time moves towards a frame that
+     * arrived later than it. This lets the buffer follow a clock drift or a route change */
+    constexpr double JITTER_BUFFER_TRANSIT_DRIFT         = 1.0 / 256;
+
+    /* A larger timestamp jump than this restarts the buffer, the sender has most likely restarted */
+    constexpr int64_t JITTER_BUFFER_MAX_TS_JUMP_S        = 10;
+
+    /* Jitter buffer between the depacketizer and the application.
+     *
+     * Frames are ordered by their RTP timestamp and sequence number and each frame is played
+     * out at the local time its timestamp maps to plus the playout delay. The mapping uses
+     * the smallest transit time seen so far, so the frame that arrived the fastest defines
+     * the timeline and slower frames are waited for by the playout delay.
+     *
+     * The playout delay is a multiple of the RFC 3550 interarrival jitter, taken from RTCP
+     * if it is enabled and estimated from the frame arrivals otherwise, limited between
+     * the smallest and the largest delay. No frame waits longer than the largest delay.
+     *
+     * A frame that arrives after a frame with a later timestamp has been played out is late
+     * and it is either freed or delivered immediately depending on the late policy.
+     *
+     * Frames are pushed and popped by the reception flow thread, the configuration can be
+     * changed from any thread. All functions taking a time in microseconds exist for testing,
+     * the other variants use the local clock. */
+    class jitter_buffer {
+        public:
+            jitter_buffer(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<uvgrtp::rtcp> rtcp);
+            ~jitter_buffer();
+
+            /* Store "frame" until its playout time. The jitter buffer owns the frame from now on */
+            void push(uvgrtp::frame::rtp_frame *frame);
+            void push(uvgrtp::frame::rtp_frame *frame, int64_t now_us);
+
+            /* Return the next frame whose playout time has come or nullptr if there is none */
+            uvgrtp::frame::rtp_frame *pop();
+            uvgrtp::frame::rtp_frame *pop(int64_t now_us);
+
+            /* Return how many microseconds there is until the next frame is due
+             * Return -1 if the buffer is empty */
+            int64_t time_to_next_playout() const;
+            int64_t time_to_next_playout(int64_t now_us) const;
+
+            /* Return RTP_INVALID_VALUE if the delays would not be in order 0 <= min <= max */
+            rtp_error_t set_min_delay(ssize_t ms);
+            rtp_error_t set_max_delay(ssize_t ms);
+
+            /* Return RTP_INVALID_VALUE if "policy" is not one of ::RTP_JITTER_LATE_POLICY */
+            rtp_error_t set_late_policy(int policy);
+
+            ssize_t get_min_delay() const;
+            ssize_t get_max_delay() const;
+            int get_late_policy() const;
+
+            /* Return the current playout delay in milliseconds */
+            ssize_t get_target_delay() const;
+
+            /* Return the number of frames that arrived too late */
+            uint64_t get_late_frames() const;
+
+        private:
+            struct entry {
+                uvgrtp::frame::rtp_frame *frame = nullptr;
+                int64_t arrival_us = 0;
+            };
+
+            /* Unwrapped RTP timestamp and sequence number */
+            typedef std::pair<int64_t, int64_t> frame_key;
+
+            int64_t now_us() const;
+
+            /* Start a new timeline from "frame", the waiting frames are delivered immediately */
+            void restart(const uvgrtp::frame::rtp_frame *frame, uint32_t clock_rate);
+
+            void update_delay(int64_t transit_us, uint32_t ssrc);
+
+            int64_t playout_us(const frame_key& key, const entry& e) const;
+
+            std::shared_ptr<uvgrtp::rtp> rtp_;
+            std::shared_ptr<uvgrtp::rtcp> rtcp_;
+            uvgrtp::clock::hrc::hrc_t start_;
+
+            std::map<frame_key, entry> frames_;
+            std::deque<uvgrtp::frame::rtp_frame *> immediate_;
+
+            bool initialized_;
+            uint32_t ssrc_;
+            uint32_t clock_rate_;
+            int64_t highest_ts_;
+            int64_t highest_seq_;
+
+            double ref_transit_us_;
+            double jitter_us_;
+            int64_t prev_transit_us_;
+
+            bool played_;
+            frame_key last_played_;
+
+            std::atomic<ssize_t> min_delay_ms_;
+            std::atomic<ssize_t> max_delay_ms_;
+            std::atomic<int> late_policy_;
+            std::atomic<ssize_t> target_delay_ms_;
+            std::atomic<uint64_t> late_frames_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
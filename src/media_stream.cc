@@ -17,6 +17,10 @@
 #include "reception_flow.hh"
 #include "srtp/srtcp.hh"
 #include "srtp/srtp.hh"
+#include "fec.hh"
+#include "header_extensions.hh"
+#include "transport_cc.hh"
+#include "jitter_buffer.hh"
 #include "formats/media.hh"
 #include "global.hh"
 #include "socketfactory.hh"
@@ -42,6 +46,10 @@ uvgrtp::media_stream::media_stream(std::string cname, std::string remote_addr,
     rtp_(nullptr),
     rtcp_(nullptr),
     zrtp_(nullptr),
+    fec_(nullptr),
+    header_ext_(nullptr),
+    tcc_(nullptr),
+    jitter_buffer_(nullptr),
     sfp_(sfp),
     remote_sockaddr_(),
     remote_sockaddr_ip6_(),
@@ -272,7 +280,9 @@ rtp_error_t uvgrtp::media_stream::create_media(rtp_format_t fmt)
             reception_flow_->install_handler(
                 5, remote_ssrc_,
                 std::bind(&uvgrtp::formats::media::packet_handler, media_.get(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
-                    std::placeholders::_4, std::placeholders::_5), media_->get_media_frame_info());
+                    std::placeholders::_4, std::placeholders::_5), nullptr);
+            reception_flow_->install_getter(remote_ssrc_,
+                std::bind(&uvgrtp::formats::media::frame_getter, media_.get(), std::placeholders::_1));
             break;
         }
         default:
@@ -286,6 +296,27 @@ rtp_error_t uvgrtp::media_stream::create_media(rtp_format_t fmt)
     // set default values for fps
     media_->set_fps(fps_numerator_, fps_denominator_);
     media_->set_pace(pace_numerator_, pace_denominator_);
+
+    if (fec_) {
+        media_->set_fec(fec_);
+    }
+
+    media_->set_header_extensions(header_ext_);
+
+    if (tcc_) {
+        media_->set_transport_cc(tcc_);
+        media_->set_latency_budget(latency_budget_);
+    }
+
+    media_->set_parallel_scl_threshold(parallel_scl_threshold_);
+    media_->set_parameter_set_interval(parameter_set_interval_);
+
+    if (rce_flags_ & RCE_H26X_KEYFRAME_REQUESTS) {
+        media_->set_rtcp(rtcp_);
+    }
+
+    media_->set_nal_chunk_size(nal_chunk_size_);
+
     return RTP_OK;
 }
 
@@ -300,6 +331,10 @@ rtp_error_t uvgrtp::media_stream::free_resources(rtp_error_t ret)
     rtp_            = nullptr;
     srtp_           = nullptr;
     srtcp_          = nullptr;
+    fec_            = nullptr;
+    header_ext_     = nullptr;
+    tcc_            = nullptr;
+    jitter_buffer_  = nullptr;
     //reception_flow_ = nullptr;
     holepuncher_    = nullptr;
     media_          = nullptr;
@@ -332,12 +367,23 @@ rtp_error_t uvgrtp::media_stream::install_packet_handlers()
                     std::placeholders::_4, std::placeholders::_5), nullptr);
         }
     if (rce_flags_ & RCE_SRTP) {
-        socket_->install_handler(ssrc_, srtp_.get(), srtp_->send_packet_handler);
+        socket_->install_handler(ssrc_, srtp_.get(), srtp_->send_packet_handler, srtp_->send_packets_handler);
         reception_flow_->install_handler(
             4, remote_ssrc_,
             std::bind(&uvgrtp::srtp::recv_packet_handler, srtp_, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
                 std::placeholders::_4, std::placeholders::_5), srtp_.get());
     }
+    if (jitter_buffer_) {
+        reception_flow_->install_jitter_buffer(remote_ssrc_, jitter_buffer_);
+    }
+    if (fec_) {
+        reception_flow_->install_handler(
+            7, remote_ssrc_,
+            std::bind(&uvgrtp::fec::packet_handler, fec_, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3,
+                std::placeholders::_4, std::placeholders::_5), nullptr);
+        reception_flow_->install_fec_getter(remote_ssrc_, remote_fec_ssrc_,
+            std::bind(&uvgrtp::fec::recovered_getter, fec_, std::placeholders::_1, std::placeholders::_2));
+    }
     return RTP_OK;
 }
 
@@ -355,11 +401,52 @@ rtp_error_t uvgrtp::media_stream::init(std::shared_ptr<uvgrtp::zrtp> zrtp)
         return RTP_GENERIC_ERROR;
     }
 
+    if ((rce_flags_ & RCE_SRTP_AEAD_GCM) && (rce_flags_ & (RCE_SRTP_NULL_CIPHER | RCE_SRTP_AUTHENTICATE_RTP))) {
+        /* AES-GCM always encrypts and authenticates the packets */
+        UVG_LOG_WARN("RCE_SRTP_NULL_CIPHER and RCE_SRTP_AUTHENTICATE_RTP have no effect with RCE_SRTP_AEAD_GCM");
+        rce_flags_ &= ~(RCE_SRTP_NULL_CIPHER | RCE_SRTP_AUTHENTICATE_RTP);
+    }
+
     rtp_ = std::shared_ptr<uvgrtp::rtp>(new uvgrtp::rtp(fmt_, ssrc_, ipv6_));
     rtcp_ = std::shared_ptr<uvgrtp::rtcp>(new uvgrtp::rtcp(rtp_, ssrc_, remote_ssrc_, cname_, sfp_, rce_flags_));
     srtp_ = std::shared_ptr<uvgrtp::srtp>(new uvgrtp::srtp(rce_flags_));
     srtcp_ = std::shared_ptr<uvgrtp::srtcp>(new uvgrtp::srtcp());
 
+    if (rce_flags_ & RCE_FEC) {
+        /* SRTP handlers modify the packets after FEC has been computed over them */
+        if (rce_flags_ & RCE_SRTP) {
+            UVG_LOG_WARN("FEC is not supported together with SRTP, disabling FEC");
+        }
+        else {
+            fec_ = std::shared_ptr<uvgrtp::fec>(new uvgrtp::fec(rtp_));
+        }
+    }
+
+    header_ext_ = std::shared_ptr<uvgrtp::header_extensions>(new uvgrtp::header_extensions());
+
+    if (rce_flags_ & RCE_TRANSPORT_CC) {
+        /* the feedback is carried in RTCP */
+        if (!(rce_flags_ & RCE_RTCP)) {
+            UVG_LOG_WARN("Transport-wide congestion control requires RCE_RTCP, disabling it");
+        }
+        else {
+            tcc_ = std::shared_ptr<uvgrtp::transport_cc>(new uvgrtp::transport_cc(header_ext_));
+            rtcp_->set_transport_cc(tcc_);
+        }
+    }
+
+    if ((rce_flags_ & RCE_H26X_KEYFRAME_REQUESTS) && !(rce_flags_ & RCE_RTCP)) {
+        /* the requests are RTCP feedback messages */
+        UVG_LOG_WARN("Keyframe requests require RCE_RTCP, disabling them");
+        rce_flags_ &= ~RCE_H26X_KEYFRAME_REQUESTS;
+    }
+
+    if (rce_flags_ & RCE_JITTER_BUFFER) {
+        /* the playout delay follows the jitter computed by RTCP if it is enabled */
+        jitter_buffer_ = std::shared_ptr<uvgrtp::jitter_buffer>(
+            new uvgrtp::jitter_buffer(rtp_, (rce_flags_ & RCE_RTCP) ? rtcp_ : nullptr));
+    }
+
     socket_->install_handler(ssrc_, rtcp_.get(), rtcp_->send_packet_handler_vec);
 
     /* If we are using ZRTP, we only install the ZRTP handler first. Rest of the handlers are installed after ZRTP is
@@ -529,15 +616,22 @@ rtp_error_t uvgrtp::media_stream::start_components()
         }
     }
 
-    if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP) {
+    if (size_t tag_len = uvgrtp::get_srtp_tag_length(rce_flags_)) {
         if (ipv6_) {
-            rtp_->set_payload_size(MAX_IPV6_MEDIA_PAYLOAD - UVG_AUTH_TAG_LENGTH);
+            rtp_->set_payload_size(MAX_IPV6_MEDIA_PAYLOAD - tag_len);
         }
         else {
-            rtp_->set_payload_size(MAX_IPV4_MEDIA_PAYLOAD - UVG_AUTH_TAG_LENGTH);
+            rtp_->set_payload_size(MAX_IPV4_MEDIA_PAYLOAD - tag_len);
         }
     }
 
+    /* Leave room for the FlexFEC headers so that the repair packets fit in the MTU */
+    if (fec_) {
+        rtp_->set_payload_size(rtp_->get_payload_size() - FEC_OVERHEAD_MAX);
+    }
+
+    rtp_->set_payload_size(rtp_->get_payload_size() - header_ext_->get_size());
+
     initialized_ = true;
     return reception_flow_->start(socket_, rce_flags_);
 }
@@ -659,6 +753,98 @@ rtp_error_t uvgrtp::media_stream::push_frame(std::unique_ptr<uint8_t[]> data, si
 
     return ret;
 }
+
+rtp_error_t uvgrtp::media_stream::push_nal_units(const uvgrtp::frame::nal_unit *nals, size_t count, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        holepuncher();
+
+        // the NAL units are sent before returning so copying them would not help
+        ret = media_->push_nal_units(remote_sockaddr_, remote_sockaddr_ip6_, nals, count, rtp_flags, ssrc_.get()->load());
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_nal_units(const uvgrtp::frame::nal_unit *nals, size_t count, uint32_t ts, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        holepuncher();
+
+        rtp_->set_timestamp(ts);
+        ret = media_->push_nal_units(remote_sockaddr_, remote_sockaddr_ip6_, nals, count, rtp_flags, ssrc_.get()->load());
+        rtp_->set_timestamp(INVALID_TS);
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::begin_frame()
+{
+    rtp_error_t ret = check_push_preconditions(RTP_NO_FLAGS, false);
+    if (ret == RTP_OK)
+    {
+        slice_frame_ts_ = UINT64_MAX;
+        ret = media_->begin_frame();
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::begin_frame(uint32_t ts)
+{
+    rtp_error_t ret = check_push_preconditions(RTP_NO_FLAGS, false);
+    if (ret == RTP_OK)
+    {
+        slice_frame_ts_ = ts;
+        ret = media_->begin_frame();
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::push_slice(uint8_t *data, size_t data_len, int rtp_flags)
+{
+    rtp_error_t ret = check_push_preconditions(rtp_flags, false);
+    if (ret == RTP_OK)
+    {
+        holepuncher();
+
+        if (slice_frame_ts_ != UINT64_MAX)
+            rtp_->set_timestamp(slice_frame_ts_);
+
+        ret = media_->push_slice(remote_sockaddr_, remote_sockaddr_ip6_, data, data_len, rtp_flags, ssrc_.get()->load());
+
+        if (slice_frame_ts_ != UINT64_MAX)
+            rtp_->set_timestamp(INVALID_TS);
+    }
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::end_frame()
+{
+    rtp_error_t ret = check_push_preconditions(RTP_NO_FLAGS, false);
+    if (ret == RTP_OK)
+    {
+        holepuncher();
+
+        if (slice_frame_ts_ != UINT64_MAX)
+            rtp_->set_timestamp(slice_frame_ts_);
+
+        ret = media_->end_frame(remote_sockaddr_, remote_sockaddr_ip6_, ssrc_.get()->load());
+
+        if (slice_frame_ts_ != UINT64_MAX)
+            rtp_->set_timestamp(INVALID_TS);
+    }
+
+    return ret;
+}
+
 /* Disabled for now
 rtp_error_t uvgrtp::media_stream::push_user_packet(uint8_t* data, uint32_t len)
 {
@@ -787,6 +973,20 @@ rtp_error_t uvgrtp::media_stream::install_receive_hook(void *arg, void (*hook)(v
     return reception_flow_->install_receive_hook(arg, hook, remote_ssrc_.get()->load());
 }
 
+rtp_error_t uvgrtp::media_stream::install_nal_chunk_hook(std::function<void(const uvgrtp::frame::nal_chunk&)> hook)
+{
+    if (!initialized_ || !media_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook) {
+        return RTP_INVALID_VALUE;
+    }
+
+    return media_->install_nal_chunk_hook(hook);
+}
+
 rtp_error_t uvgrtp::media_stream::configure_ctx(int rcc_flag, ssize_t value)
 {
     rtp_error_t ret = RTP_OK;
@@ -844,8 +1044,12 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int rcc_flag, ssize_t value)
         }
         case RCC_MTU_SIZE: {
             ssize_t hdr      = IPV4_HDR_SIZE + UDP_HDR_SIZE + RTP_HDR_SIZE;
-            if (rce_flags_ & RCE_SRTP_AUTHENTICATE_RTP)
-                hdr += UVG_AUTH_TAG_LENGTH;
+            hdr += uvgrtp::get_srtp_tag_length(rce_flags_);
+
+            if (fec_)
+                hdr += FEC_OVERHEAD_MAX;
+
+            hdr += header_ext_->get_size();
 
             if (value <= hdr)
                 return RTP_INVALID_VALUE;
@@ -938,6 +1142,231 @@ rtp_error_t uvgrtp::media_stream::configure_ctx(int rcc_flag, ssize_t value)
                 media_->set_pace(pace_numerator_, pace_denominator_);
                 break;
         }
+        case RCC_FEC_ROW_LENGTH: {
+            if (!fec_) {
+                UVG_LOG_ERROR("FEC has not been enabled, use RCE_FEC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = fec_->set_row_length(value);
+            break;
+        }
+        case RCC_FEC_COLUMN_DEPTH: {
+            if (!fec_) {
+                UVG_LOG_ERROR("FEC has not been enabled, use RCE_FEC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = fec_->set_column_depth(value);
+            break;
+        }
+        case RCC_FEC_PAYLOAD_TYPE: {
+            if (!fec_) {
+                UVG_LOG_ERROR("FEC has not been enabled, use RCE_FEC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = fec_->set_payload_type(value);
+            break;
+        }
+        case RCC_FEC_SSRC: {
+            if (!fec_) {
+                UVG_LOG_ERROR("FEC has not been enabled, use RCE_FEC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = fec_->set_ssrc(value);
+            break;
+        }
+        case RCC_FEC_REMOTE_SSRC: {
+            if (!fec_) {
+                UVG_LOG_ERROR("FEC has not been enabled, use RCE_FEC");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value <= 0 || value > (ssize_t)UINT32_MAX)
+                return RTP_INVALID_VALUE;
+
+            remote_fec_ssrc_ = (uint32_t)value;
+            reception_flow_->install_fec_getter(remote_ssrc_, remote_fec_ssrc_,
+                std::bind(&uvgrtp::fec::recovered_getter, fec_, std::placeholders::_1, std::placeholders::_2));
+            break;
+        }
+        case RCC_TWCC_MIN_BITRATE: {
+            if (!tcc_) {
+                UVG_LOG_ERROR("Congestion control has not been enabled, use RCE_TRANSPORT_CC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = tcc_->set_min_bitrate(value);
+            break;
+        }
+        case RCC_TWCC_START_BITRATE: {
+            if (!tcc_) {
+                UVG_LOG_ERROR("Congestion control has not been enabled, use RCE_TRANSPORT_CC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = tcc_->set_start_bitrate(value);
+            break;
+        }
+        case RCC_TWCC_MAX_BITRATE: {
+            if (!tcc_) {
+                UVG_LOG_ERROR("Congestion control has not been enabled, use RCE_TRANSPORT_CC");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = tcc_->set_max_bitrate(value);
+            break;
+        }
+        case RCC_SEND_LATENCY_BUDGET: {
+            if (!tcc_) {
+                UVG_LOG_ERROR("Congestion control has not been enabled, use RCE_TRANSPORT_CC");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0) {
+                UVG_LOG_ERROR("Latency budget cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            latency_budget_ = value;
+
+            if (media_)
+                media_->set_latency_budget(latency_budget_);
+            break;
+        }
+        case RCC_PARALLEL_SCL_THRESHOLD: {
+            if (value < 0) {
+                UVG_LOG_ERROR("Parallel SCL threshold cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            parallel_scl_threshold_ = value;
+
+            if (media_)
+                media_->set_parallel_scl_threshold(parallel_scl_threshold_);
+            break;
+        }
+        case RCC_PARAMETER_SET_INTERVAL: {
+            if (!(rce_flags_ & RCE_H26X_PARAMETER_SETS)) {
+                UVG_LOG_ERROR("Parameter set caching has not been enabled, use RCE_H26X_PARAMETER_SETS");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0) {
+                UVG_LOG_ERROR("Parameter set interval cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            parameter_set_interval_ = value;
+
+            if (media_)
+                media_->set_parameter_set_interval(parameter_set_interval_);
+            break;
+        }
+        case RCC_JITTER_BUFFER_MIN_DELAY: {
+            if (!jitter_buffer_) {
+                UVG_LOG_ERROR("Jitter buffer has not been enabled, use RCE_JITTER_BUFFER");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = jitter_buffer_->set_min_delay(value);
+            break;
+        }
+        case RCC_JITTER_BUFFER_MAX_DELAY: {
+            if (!jitter_buffer_) {
+                UVG_LOG_ERROR("Jitter buffer has not been enabled, use RCE_JITTER_BUFFER");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = jitter_buffer_->set_max_delay(value);
+            break;
+        }
+        case RCC_JITTER_BUFFER_LATE_POLICY: {
+            if (!jitter_buffer_) {
+                UVG_LOG_ERROR("Jitter buffer has not been enabled, use RCE_JITTER_BUFFER");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = jitter_buffer_->set_late_policy((int)value);
+            break;
+        }
+        case RCC_KEYFRAME_REQUEST_INTERVAL: {
+            if (!(rce_flags_ & RCE_H26X_KEYFRAME_REQUESTS)) {
+                UVG_LOG_ERROR("Keyframe requests have not been enabled, use RCE_H26X_KEYFRAME_REQUESTS");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0) {
+                UVG_LOG_ERROR("Keyframe request interval cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            rtcp_->set_keyframe_request_interval((uint32_t)value);
+            break;
+        }
+        case RCC_KEYFRAME_REQUEST_TYPE: {
+            if (!(rce_flags_ & RCE_H26X_KEYFRAME_REQUESTS)) {
+                UVG_LOG_ERROR("Keyframe requests have not been enabled, use RCE_H26X_KEYFRAME_REQUESTS");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = rtcp_->set_keyframe_request_type((int)value);
+            break;
+        }
+        case RCC_NAL_CHUNK_SIZE: {
+            if (value < 0) {
+                UVG_LOG_ERROR("NAL chunk size cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            nal_chunk_size_ = value;
+
+            if (media_)
+                media_->set_nal_chunk_size(nal_chunk_size_);
+            break;
+        }
+        case RCC_SRTP_REPLAY_WINDOW_SIZE: {
+            if (!(rce_flags_ & RCE_SRTP_REPLAY_PROTECTION) || !srtp_ || !srtcp_) {
+                UVG_LOG_ERROR("Replay protection has not been enabled, use RCE_SRTP_REPLAY_PROTECTION");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0 || (ret = srtp_->set_replay_window_size((size_t)value)) != RTP_OK)
+                return RTP_INVALID_VALUE;
+
+            ret = srtcp_->set_replay_window_size((size_t)value);
+            break;
+        }
+        case RCC_PARALLEL_SRTP_THRESHOLD: {
+            if (!(rce_flags_ & RCE_SRTP) || !srtp_) {
+                UVG_LOG_ERROR("SRTP has not been enabled, use RCE_SRTP");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0) {
+                UVG_LOG_ERROR("Parallel SRTP threshold cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            srtp_->set_parallel_threshold((size_t)value);
+            break;
+        }
+        case RCC_SRTP_KEYSTREAM_LOOKAHEAD: {
+            if (!(rce_flags_ & RCE_SRTP) || !srtp_) {
+                UVG_LOG_ERROR("SRTP has not been enabled, use RCE_SRTP");
+                return RTP_INVALID_VALUE;
+            }
+
+            if (value < 0) {
+                UVG_LOG_ERROR("Keystream lookahead cannot be negative");
+                return RTP_INVALID_VALUE;
+            }
+
+            ret = srtp_->set_keystream_lookahead((size_t)value, rtp_->get_payload_size());
+            break;
+        }
         default:
             return RTP_INVALID_VALUE;
     }
@@ -1004,12 +1433,145 @@ int uvgrtp::media_stream::get_configuration_value(int rcc_flag)
         case RCC_PACE_FRAG_DENOMINATOR: {
             return (int)pace_denominator_;
         }
+        case RCC_FEC_ROW_LENGTH: {
+            return fec_ ? (int)fec_->get_row_length() : -1;
+        }
+        case RCC_FEC_COLUMN_DEPTH: {
+            return fec_ ? (int)fec_->get_column_depth() : -1;
+        }
+        case RCC_FEC_PAYLOAD_TYPE: {
+            return fec_ ? (int)fec_->get_payload_type() : -1;
+        }
+        case RCC_FEC_SSRC: {
+            return fec_ ? (int)fec_->get_ssrc() : -1;
+        }
+        case RCC_FEC_REMOTE_SSRC: {
+            return fec_ ? (int)remote_fec_ssrc_ : -1;
+        }
+        case RCC_TWCC_MIN_BITRATE: {
+            return tcc_ ? (int)tcc_->get_min_bitrate() : -1;
+        }
+        case RCC_TWCC_START_BITRATE: {
+            return tcc_ ? (int)tcc_->get_start_bitrate() : -1;
+        }
+        case RCC_TWCC_MAX_BITRATE: {
+            return tcc_ ? (int)tcc_->get_max_bitrate() : -1;
+        }
+        case RCC_SEND_LATENCY_BUDGET: {
+            return tcc_ ? (int)latency_budget_ : -1;
+        }
+        case RCC_PARALLEL_SCL_THRESHOLD: {
+            return (int)parallel_scl_threshold_;
+        }
+        case RCC_PARAMETER_SET_INTERVAL: {
+            return (rce_flags_ & RCE_H26X_PARAMETER_SETS) ? (int)parameter_set_interval_ : -1;
+        }
+        case RCC_JITTER_BUFFER_MIN_DELAY: {
+            return jitter_buffer_ ? (int)jitter_buffer_->get_min_delay() : -1;
+        }
+        case RCC_JITTER_BUFFER_MAX_DELAY: {
+            return jitter_buffer_ ? (int)jitter_buffer_->get_max_delay() : -1;
+        }
+        case RCC_JITTER_BUFFER_LATE_POLICY: {
+            return jitter_buffer_ ? jitter_buffer_->get_late_policy() : -1;
+        }
+        case RCC_KEYFRAME_REQUEST_INTERVAL: {
+            return (rce_flags_ & RCE_H26X_KEYFRAME_REQUESTS) ? (int)rtcp_->get_keyframe_request_interval() : -1;
+        }
+        case RCC_KEYFRAME_REQUEST_TYPE: {
+            return (rce_flags_ & RCE_H26X_KEYFRAME_REQUESTS) ? rtcp_->get_keyframe_request_type() : -1;
+        }
+        case RCC_NAL_CHUNK_SIZE: {
+            return (int)nal_chunk_size_;
+        }
+        case RCC_SRTP_REPLAY_WINDOW_SIZE: {
+            return ((rce_flags_ & RCE_SRTP_REPLAY_PROTECTION) && srtp_) ? (int)srtp_->get_remote_ctx()->replay_size : -1;
+        }
+        case RCC_PARALLEL_SRTP_THRESHOLD: {
+            return ((rce_flags_ & RCE_SRTP) && srtp_) ? (int)srtp_->get_parallel_threshold() : -1;
+        }
+        case RCC_SRTP_KEYSTREAM_LOOKAHEAD: {
+            return ((rce_flags_ & RCE_SRTP) && srtp_) ? (int)srtp_->get_keystream_lookahead() : -1;
+        }
         default:
             ret = -1;
     }
     return ret;
 }
 
+rtp_error_t uvgrtp::media_stream::register_header_extension(int type, uint8_t id)
+{
+    if (!header_ext_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    size_t old_size = header_ext_->get_size();
+    rtp_error_t ret = header_ext_->register_extension(type, id);
+
+    if (ret == RTP_OK)
+        update_header_extension_size(old_size);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::set_header_extension_data(uint8_t id, uint8_t *data, size_t len)
+{
+    if (!header_ext_) {
+        UVG_LOG_ERROR("RTP context has not been initialized fully, cannot continue!");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    size_t old_size = header_ext_->get_size();
+    rtp_error_t ret = header_ext_->set_extension_data(id, data, len);
+
+    if (ret == RTP_OK)
+        update_header_extension_size(old_size);
+
+    return ret;
+}
+
+rtp_error_t uvgrtp::media_stream::install_target_bitrate_hook(std::function<void(uint32_t)> hook)
+{
+    if (!tcc_) {
+        UVG_LOG_ERROR("Congestion control has not been enabled, use RCE_TRANSPORT_CC");
+        return RTP_NOT_INITIALIZED;
+    }
+
+    if (!hook)
+        return RTP_INVALID_VALUE;
+
+    tcc_->install_target_bitrate_hook(hook);
+    return RTP_OK;
+}
+
+uint32_t uvgrtp::media_stream::get_target_bitrate() const
+{
+    return tcc_ ? tcc_->get_target_bitrate() : 0;
+}
+
+uint64_t uvgrtp::media_stream::get_shed_bytes(int priority) const
+{
+    if (!media_ || priority < 0 || priority >= RTP_NAL_PRIORITY_COUNT)
+        return 0;
+
+    return media_->get_shed_bytes(priority);
+}
+
+uint64_t uvgrtp::media_stream::get_lost_frames() const
+{
+    return media_ ? media_->get_lost_frames() : 0;
+}
+
+void uvgrtp::media_stream::update_header_extension_size(size_t old_size)
+{
+    /* before the components have been started, the size is taken into account in start_components() */
+    if (!initialized_)
+        return;
+
+    rtp_->set_payload_size(rtp_->get_payload_size() + old_size - header_ext_->get_size());
+}
+
 uint32_t uvgrtp::media_stream::get_key() const
 {
     return key_;
@@ -4,6 +4,7 @@
 #include "uvgrtp/frame.hh"
 
 #include "socket.hh"
+#include "jitter_buffer.hh"
 #include "debug.hh"
 #include "random.hh"
 #include "uvgrtp/rtcp.hh"
@@ -345,8 +346,13 @@ rtp_error_t uvgrtp::reception_flow::install_handler(int type, std::shared_ptr<st
             packet_handlers_[ssrc].rtcp_common.args = args;
             break;
         }
+        case 7: {
+            packet_handlers_[ssrc].fec.handler = handler;
+            packet_handlers_[ssrc].fec.args = args;
+            break;
+        }
         default: {
-            UVG_LOG_ERROR("Invalid type, only types 1-5 are allowed");
+            UVG_LOG_ERROR("Invalid type, only types 1-7 are allowed");
             break;
         }
     }
@@ -363,9 +369,43 @@ rtp_error_t uvgrtp::reception_flow::install_getter(std::shared_ptr<std::atomic<s
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::reception_flow::install_fec_getter(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, uint32_t fec_ssrc,
+    std::function<rtp_error_t(uint8_t**, size_t*)> getter)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].fec_getter = getter;
+    remove_fec_ssrcs(remote_ssrc);
+
+    if (fec_ssrc != 0) {
+        fec_ssrcs_[fec_ssrc] = remote_ssrc;
+    }
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
+void uvgrtp::reception_flow::remove_fec_ssrcs(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
+{
+    for (auto it = fec_ssrcs_.begin(); it != fec_ssrcs_.end();) {
+        if (it->second == remote_ssrc)
+            it = fec_ssrcs_.erase(it);
+        else
+            ++it;
+    }
+}
+
+rtp_error_t uvgrtp::reception_flow::install_jitter_buffer(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+    std::shared_ptr<uvgrtp::jitter_buffer> jitter_buffer)
+{
+    handlers_mutex_.lock();
+    packet_handlers_[remote_ssrc.get()->load()].jitter_buffer = jitter_buffer;
+    handlers_mutex_.unlock();
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::reception_flow::remove_handlers(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc)
 {
     std::lock_guard<std::mutex> lg(handlers_mutex_);
+    remove_fec_ssrcs(remote_ssrc);
     size_t removed = packet_handlers_.erase(remote_ssrc.get()->load());
     if (removed == 1) {
         return RTP_OK;
@@ -400,6 +440,87 @@ void uvgrtp::reception_flow::return_frame(uvgrtp::frame::rtp_frame *frame)
         frames_mtx_.unlock();
     }
 }
+
+void uvgrtp::reception_flow::deliver_frame(handler* handlers, uvgrtp::frame::rtp_frame *frame)
+{
+    if (handlers->jitter_buffer) {
+        handlers->jitter_buffer->push(frame);
+    }
+    else {
+        return_frame(frame);
+    }
+}
+
+int64_t uvgrtp::reception_flow::play_out_frames()
+{
+    int64_t next_playout_us = -1;
+
+    for (auto& handlers : packet_handlers_) {
+        std::shared_ptr<uvgrtp::jitter_buffer> jitter_buffer = handlers.second.jitter_buffer;
+
+        if (!jitter_buffer)
+            continue;
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        while ((frame = jitter_buffer->pop()) != nullptr) {
+            return_frame(frame);
+        }
+
+        int64_t wait_us = jitter_buffer->time_to_next_playout();
+        if (wait_us >= 0 && (next_playout_us < 0 || wait_us < next_playout_us))
+            next_playout_us = wait_us;
+    }
+
+    return next_playout_us;
+}
+void uvgrtp::reception_flow::process_rtp_packet(handler* handlers, int rce_flags, uint8_t* ptr, size_t size)
+{
+    rtp_error_t retval = RTP_PKT_MODIFIED;
+    uvgrtp::frame::rtp_frame* frame = nullptr;
+
+    /* Create RTP header */
+    if (handlers->rtp.handler != nullptr) {
+        retval = handlers->rtp.handler(nullptr, rce_flags, ptr, size, &frame);
+    }
+    else {
+        /* Received a packet but RTP handler is not installed.
+         * This should only happen when ZRTP is enabled. If the remote stream is done first, they start sending
+         * media already before we have handled the last ZRTP ConfACK packet. This should not be a problem
+         * as we only lose the first frame or a few at worst. If this causes issues, the sender
+         * may, for example, sleep for 50 or so milliseconds to give us time to complete ZRTP negotiation. */
+        UVG_LOG_DEBUG("RTP handler is not (yet?) installed");
+    }
+
+    /* If SRTP is enabled -> send through SRTP handler */
+    if (rce_flags & RCE_SRTP && retval == RTP_PKT_MODIFIED) {
+        if (handlers->srtp.handler != nullptr) {
+            retval = handlers->srtp.handler(handlers->srtp.args, rce_flags, ptr, size, &frame);
+        }
+    }
+    /* Update RTCP session statistics */
+    if (rce_flags & RCE_RTCP) {
+        if (handlers->rtcp_common.handler != nullptr) {
+            retval = handlers->rtcp_common.handler(handlers->rtcp_common.args, rce_flags, ptr, size, &frame);
+        }
+    }
+
+    /* If packet is ok, hand over to media handler */
+    if (retval == RTP_PKT_MODIFIED || retval == RTP_PKT_NOT_HANDLED) {
+        if (handlers->media.handler && frame) {
+            retval = handlers->media.handler(handlers->media.args, rce_flags, ptr, size, &frame);
+        }
+        /* Last, if one or more packets are ready, return them to the user */
+        if (retval == RTP_PKT_READY) {
+            deliver_frame(handlers, frame);
+        }
+        else if (retval == RTP_MULTIPLE_PKTS_READY && handlers->getter != nullptr) {
+            while (handlers->getter(&frame) == RTP_PKT_READY) {
+                deliver_frame(handlers, frame);
+            }
+        }
+    }
+}
+
 /* User packets disabled for now
 rtp_error_t uvgrtp::reception_flow::install_user_hook(void* arg, void (*hook)(void*, uint8_t* data, uint32_t len))
 {
@@ -498,11 +619,17 @@ void uvgrtp::reception_flow::process_packet(int rce_flags)
     std::unique_lock<std::mutex> lk(wait_mtx_);
 
     int processed_packets = 0;
+    int64_t next_playout_us = -1;
 
     while (!should_stop_)
     {
-        // go to sleep waiting for something to process
-        process_cond_.wait(lk); 
+        // go to sleep waiting for something to process or for the next frame in a jitter buffer to be due
+        if (next_playout_us < 0) {
+            process_cond_.wait(lk);
+        }
+        else {
+            process_cond_.wait_for(lk, std::chrono::microseconds(next_playout_us));
+        }
 
         if (should_stop_)
         {
@@ -550,6 +677,11 @@ void uvgrtp::reception_flow::process_packet(int rce_flags)
                     /* Socket multiplexing: RTP/ZRTP packet */
                     handlers = &packet_handlers_[rtp_ssrc];
                 }
+                else if (fec_ssrcs_.find(rtp_ssrc) != fec_ssrcs_.end() &&
+                         packet_handlers_.find(fec_ssrcs_[rtp_ssrc]->load()) != packet_handlers_.end()) {
+                    /* Socket multiplexing: FEC repair packet of a stream */
+                    handlers = &packet_handlers_[fec_ssrcs_[rtp_ssrc]->load()];
+                }
                 size_t size = (size_t)ring_buffer_[ring_read_index_].read;
                 uint8_t version = (*(uint8_t*)&ptr[0] >> 6) & 0x3;
 
@@ -580,49 +712,30 @@ void uvgrtp::reception_flow::process_packet(int rce_flags)
                         }
                     }
                     else if (version == 0x2) {
-                        retval = RTP_PKT_MODIFIED;
 
-                        /* Create RTP header */
-                        if (handlers->rtp.handler != nullptr) {
-                            retval = handlers->rtp.handler(nullptr, rce_flags, &ptr[0], size, &frame);
-                        }
-                        else {
-                            /* Received a packet but RTP handler is not installed.
-                             * This should only happen when ZRTP is enabled. If the remote stream is done first, they start sending
-                             * media already before we have handled the last ZRTP ConfACK packet. This should not be a problem
-                             * as we only lose the first frame or a few at worst. If this causes issues, the sender
-                             * may, for example, sleep for 50 or so milliseconds to give us time to complete ZRTP negotiation. */
-                            UVG_LOG_DEBUG("RTP handler is not (yet?) installed");
-                        }
+                        /* If FEC is enabled, media packets are stored for recovery and repair packets are consumed
+                         * by the FEC handler. Recovered packets are processed as if they came from the socket */
+                        if (handlers->fec.handler != nullptr) {
+                            retval = handlers->fec.handler(handlers->fec.args, rce_flags, &ptr[0], size, &frame);
 
-                        /* If SRTP is enabled -> send through SRTP handler */
-                        if (rce_flags & RCE_SRTP && retval == RTP_PKT_MODIFIED) {
-                            if (handlers->srtp.handler != nullptr) {
-                                retval = handlers->srtp.handler(handlers->srtp.args, rce_flags, &ptr[0], size, &frame);
+                            if (retval == RTP_PKT_NOT_HANDLED) {
+                                process_rtp_packet(handlers, rce_flags, &ptr[0], size);
                             }
-                        }
-                        /* Update RTCP session statistics */
-                        if (rce_flags & RCE_RTCP) {
-                            if (handlers->rtcp_common.handler != nullptr) {
-                                retval = handlers->rtcp_common.handler(handlers->rtcp_common.args, rce_flags, &ptr[0], size, &frame);
-                            }
-                        }
 
-                        /* If packet is ok, hand over to media handler */
-                        if (retval == RTP_PKT_MODIFIED || retval == RTP_PKT_NOT_HANDLED) {
-                            if (handlers->media.handler && frame) {
-                                retval = handlers->media.handler(handlers->media.args, rce_flags, &ptr[0], size, &frame);
-                            }
-                            /* Last, if one or more packets are ready, return them to the user */
-                            if (retval == RTP_PKT_READY) {
-                                return_frame(frame);
-                            }
-                            else if (retval == RTP_MULTIPLE_PKTS_READY && handlers->getter != nullptr) {
-                                while (handlers->getter(&frame) == RTP_PKT_READY) {
-                                    return_frame(frame);
+                            /* a media packet may also complete a repair packet that was waiting for it */
+                            if ((retval == RTP_PKT_NOT_HANDLED || retval == RTP_MULTIPLE_PKTS_READY) &&
+                                handlers->fec_getter != nullptr) {
+                                uint8_t* recovered = nullptr;
+                                size_t recovered_size = 0;
+
+                                while (handlers->fec_getter(&recovered, &recovered_size) == RTP_PKT_READY) {
+                                    process_rtp_packet(handlers, rce_flags, recovered, recovered_size);
                                 }
                             }
                         }
+                        else {
+                            process_rtp_packet(handlers, rce_flags, &ptr[0], size);
+                        }
                     }
                     /* No SSRC match found -> Holepuncher or user packet */
                     else if (version == 0x3) {
@@ -657,6 +770,8 @@ void uvgrtp::reception_flow::process_packet(int rce_flags)
 #endif
             }
         }
+
+        next_playout_us = play_out_frames();
     }
 
     UVG_LOG_DEBUG("Total processed packets: %li", processed_packets);
@@ -28,6 +28,7 @@ namespace uvgrtp {
 
     class socket;
     class rtcp;
+    class jitter_buffer;
 
     typedef void (*recv_hook)(void* arg, uvgrtp::frame::rtp_frame* frame);
 
@@ -51,7 +52,10 @@ namespace uvgrtp {
         packet_handler srtp;
         packet_handler media;
         packet_handler rtcp_common;
+        packet_handler fec;
         std::function<rtp_error_t(uvgrtp::frame::rtp_frame ** out)> getter;
+        std::function<rtp_error_t(uint8_t** packet, size_t* size)> fec_getter;
+        std::shared_ptr<uvgrtp::jitter_buffer> jitter_buffer;
     };
 
     /* This class handles the reception processing of received RTP packets. It 
@@ -95,7 +99,8 @@ namespace uvgrtp {
                3 ZRTP
                4 SRTP
                5 Media
-               6 RTCP common: Updates RTCP stats from RTP packets */
+               6 RTCP common: Updates RTCP stats from RTP packets
+               7 FEC: Stores media packets and recovers lost ones from FlexFEC repair packets */
             rtp_error_t install_handler(int type, std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, 
                 std::function<rtp_error_t(void*, int, uint8_t*, size_t, frame::rtp_frame** out)> handler,
                 void* args);
@@ -104,6 +109,18 @@ namespace uvgrtp {
             rtp_error_t install_getter(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
                 std::function<rtp_error_t(uvgrtp::frame::rtp_frame**)> getter);
 
+            /* Install a getter for media packets recovered by the FEC handler. The recovered
+             * packets are processed as if they had been received from the socket.
+             *
+             * Repair packets with the SSRC "fec_ssrc" are given to the handlers of "remote_ssrc".
+             * If "fec_ssrc" is 0, repair packets are only matched when the socket is not multiplexed */
+            rtp_error_t install_fec_getter(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc, uint32_t fec_ssrc,
+                std::function<rtp_error_t(uint8_t**, size_t*)> getter);
+
+            /* Install a jitter buffer. Ready frames are stored in it and returned to user at their playout time */
+            rtp_error_t install_jitter_buffer(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc,
+                std::shared_ptr<uvgrtp::jitter_buffer> jitter_buffer);
+
             /* Remove all handlers associated with this SSRC */
             rtp_error_t remove_handlers(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
 
@@ -168,9 +185,23 @@ namespace uvgrtp {
             /* RTP packet dispatcher thread */
             void process_packet(int rce_flags);
 
+            /* Pass an RTP packet through the RTP, SRTP, RTCP and media handlers */
+            void process_rtp_packet(handler* handlers, int rce_flags, uint8_t* ptr, size_t size);
+
             /* Return a processed RTP frame to user either through frame queue or receive hook */
             void return_frame(uvgrtp::frame::rtp_frame *frame);
 
+            /* Store a ready frame to the jitter buffer of "handlers" or return it right away if there is none */
+            void deliver_frame(handler* handlers, uvgrtp::frame::rtp_frame *frame);
+
+            /* Return the frames of all jitter buffers whose playout time has come
+             *
+             * Return the number of microseconds until the next frame is due or -1 if no frames are waiting */
+            int64_t play_out_frames();
+
+            /* Forget the FEC repair streams mapped to "remote_ssrc". The caller holds handlers_mutex_ */
+            void remove_fec_ssrcs(std::shared_ptr<std::atomic<std::uint32_t>> remote_ssrc);
+
             //void return_user_pkt(uint8_t* pkt, uint32_t len);
 
             inline void increase_buffer_size(ssize_t next_write_index);
@@ -213,6 +244,9 @@ namespace uvgrtp {
             // Map different types of handlers by remote SSRC
             std::unordered_map<uint32_t, handler> packet_handlers_;
 
+            // Remote SSRC of the stream protected by each FEC repair stream
+            std::unordered_map<uint32_t, std::shared_ptr<std::atomic<std::uint32_t>>> fec_ssrcs_;
+
             int poll_timeout_ms_;
 
             std::vector<Buffer> ring_buffer_;
@@ -12,6 +12,7 @@
 #include "rtcp_packets.hh"
 #include "socketfactory.hh"
 #include "rtcp_reader.hh"
+#include "transport_cc.hh"
 
 #include "global.hh"
 
@@ -25,6 +26,7 @@
 #endif
 
 #include <cassert>
+#include <cinttypes>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
@@ -45,6 +47,12 @@ constexpr int ESTIMATED_MAX_RECEPTION_TIME_MS = 10;
 
 const uint32_t MAX_SUPPORTED_PARTICIPANTS = 31;
 
+/* Keyframe requests are repeated at most this often if the round-trip time is shorter */
+constexpr uint32_t DEFAULT_KEYFRAME_REQUEST_INTERVAL_MS = 200;
+
+/* Round-trip times longer than this are calculated from stale or bogus report blocks */
+constexpr uint32_t MAX_RTT_MS = 60000;
+
 uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<std::atomic_uint> ssrc, std::shared_ptr<std::atomic<uint32_t>> remote_ssrc,
     std::string cname, std::shared_ptr<uvgrtp::socketfactory> sfp, int rce_flags) :
     rce_flags_(rce_flags), our_role_(RECEIVER),
@@ -71,8 +79,17 @@ uvgrtp::rtcp::rtcp(std::shared_ptr<uvgrtp::rtp> rtp, std::shared_ptr<std::atomic
     app_hook_f_(nullptr),
     app_hook_u_(nullptr),
     fb_hook_u_(nullptr),
+    kf_hook_(nullptr),
     sfp_(sfp),
     rtcp_reader_(nullptr),
+    tcc_(nullptr),
+    kf_request_type_(uvgrtp::frame::RTCP_PSFB_PLI),
+    kf_request_interval_ms_(DEFAULT_KEYFRAME_REQUEST_INTERVAL_MS),
+    last_kf_request_(),
+    kf_requested_(false),
+    fir_seq_(0),
+    received_fir_seqs_(),
+    rtt_ms_(0),
     active_(false),
     interval_ms_(DEFAULT_RTCP_INTERVAL_MS),
     rtp_ptr_(rtp),
@@ -473,6 +490,10 @@ rtp_error_t uvgrtp::rtcp::remove_all_hooks()
     fb_hook_u_ = nullptr;
     fb_mutex_.unlock();
 
+    kf_mutex_.lock();
+    kf_hook_ = nullptr;
+    kf_mutex_.unlock();
+
     return RTP_OK;
 }
 
@@ -692,6 +713,20 @@ rtp_error_t uvgrtp::rtcp::install_app_hook(std::function<void(std::unique_ptr<uv
     return RTP_OK;
 }
 
+rtp_error_t uvgrtp::rtcp::install_keyframe_request_hook(std::function<void(uint32_t)> kf_handler)
+{
+    if (!kf_handler)
+    {
+        return RTP_INVALID_VALUE;
+    }
+
+    kf_mutex_.lock();
+    kf_hook_ = kf_handler;
+    kf_mutex_.unlock();
+
+    return RTP_OK;
+}
+
 uvgrtp::frame::rtcp_sender_report* uvgrtp::rtcp::get_sender_packet(uint32_t ssrc)
 {
     std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
@@ -1002,6 +1037,17 @@ rtp_error_t uvgrtp::rtcp::reset_rtcp_state(uint32_t ssrc)
     return RTP_OK;
 }
 
+double uvgrtp::rtcp::get_jitter(uint32_t ssrc) const
+{
+    std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
+
+    auto participant = participants_.find(ssrc);
+    if (participant == participants_.end())
+        return -1;
+
+    return participant->second->stats.jitter;
+}
+
 bool uvgrtp::rtcp::collision_detected(uint32_t ssrc) const
 {
     std::lock_guard<std::mutex> prtcp_lock(participants_mutex_);
@@ -1067,6 +1113,10 @@ rtp_error_t uvgrtp::rtcp::recv_packet_handler_common(void *arg, int rce_flags, u
     uvgrtp::frame::rtp_frame *frame = *out;
     uvgrtp::rtcp *rtcp              = (uvgrtp::rtcp *)arg;
 
+    /* Arrival times are recorded for every packet, including the ones received during probation */
+    if (rtcp->tcc_ && rtcp->tcc_->packet_received(frame))
+        (void)rtcp->send_transport_feedback(frame->header.ssrc);
+
     /* If this is the first packet from remote, move the participant from initial_participants_
      * to participants_, initialize its state and put it on probation until enough valid
      * packets from them have been received
@@ -1154,7 +1204,7 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
         sender_ssrc = ntohl(*(uint32_t*)& buffer[read_ptr + RTCP_HEADER_SIZE]);
         
         if (srtcp_ && (ret = srtcp_->handle_rtcp_decryption(rce_flags_, sender_ssrc, 
-            buffer + RTCP_HEADER_SIZE + SSRC_CSRC_SIZE, size)) != RTP_OK)
+            buffer, size)) != RTP_OK)
         {
             UVG_LOG_ERROR("Failed at decryption");
             return ret;
@@ -1210,7 +1260,7 @@ rtp_error_t uvgrtp::rtcp::handle_incoming_packet(void* args, int rce_flags, uint
         else {            
             ms_since_last_rep_.insert({ sender_ssrc, 0 });
         }
-        if (header.pkt_type > uvgrtp::frame::RTCP_FT_APP ||
+        if (header.pkt_type > uvgrtp::frame::RTCP_FT_PSFB ||
             header.pkt_type < uvgrtp::frame::RTCP_FT_SR)
         {
             UVG_LOG_ERROR("Invalid packet type (%u)!", header.pkt_type);
@@ -1356,6 +1406,7 @@ rtp_error_t uvgrtp::rtcp::handle_receiver_report_packet(uint8_t* buffer, size_t&
     }
     
     read_reports(buffer, read_ptr, packet_end, frame->header.count, frame->report_blocks);
+    update_rtt(frame->report_blocks);
 
     rr_mutex_.lock();
     if (receiver_hook_) {
@@ -1410,6 +1461,7 @@ rtp_error_t uvgrtp::rtcp::handle_sender_report_packet(uint8_t* buffer, size_t& r
     participants_mutex_.unlock();
 
     read_reports(buffer, read_ptr, packet_end, frame->header.count, frame->report_blocks);
+    update_rtt(frame->report_blocks);
 
     sr_mutex_.lock();
     if (sender_hook_) {
@@ -1605,22 +1657,36 @@ rtp_error_t uvgrtp::rtcp::handle_app_packet(uint8_t* packet, size_t& read_ptr,
 rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
     size_t packet_end, uvgrtp::frame::rtcp_header& header)
 {
-    (void)packet_end;
     auto frame = new uvgrtp::frame::rtcp_fb_packet;
     frame->header = header;
     read_ssrc(packet, read_ptr, frame->sender_ssrc);
 
+    if (read_ptr + SSRC_CSRC_SIZE > packet_end)
+    {
+        UVG_LOG_ERROR("RTCP FB packet is too short");
+        delete frame;
+        return RTP_INVALID_VALUE;
+    }
+    read_ssrc(packet, read_ptr, frame->media_ssrc);
+
     if (!is_participant(frame->sender_ssrc))
     {
         UVG_LOG_INFO("Got an RTCP FB packet from a previously unknown participant SSRC %lu", frame->sender_ssrc);
         add_participant(frame->sender_ssrc);
     }
+    /* Keyframe requests are handled even if nobody wants the feedback packets */
+    bool kf_request = false;
+
     /* Payload-Specific Feedback Messages */
     if (header.pkt_type == uvgrtp::frame::RTCP_FT_PSFB) {
         /* Handle rest of the packet depending on the Feedback Message Type */
         switch (header.fmt)
         {
             case uvgrtp::frame::RTCP_PSFB_PLI:
+                if (frame->media_ssrc == *ssrc_.get()) {
+                    handle_keyframe_request(uvgrtp::frame::RTCP_PSFB_PLI, frame->sender_ssrc, 0);
+                    kf_request = true;
+                }
                 break;
 
             case uvgrtp::frame::RTCP_PSFB_SLI:
@@ -1630,6 +1696,21 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
                 break;
 
             case uvgrtp::frame::RTCP_PSFB_FIR:
+                /* the FIR may address several media senders, one FCI entry each */
+                while (read_ptr + FIR_FCI_SIZE <= packet_end)
+                {
+                    uvgrtp::frame::rtcp_fb_fci fci;
+                    read_ssrc(packet, read_ptr, fci.fir.ssrc);
+                    fci.fir.seq = packet[read_ptr];
+                    read_ptr += FIR_FCI_SIZE - SSRC_CSRC_SIZE;
+
+                    if (fci.fir.ssrc == *ssrc_.get()) {
+                        handle_keyframe_request(uvgrtp::frame::RTCP_PSFB_FIR, frame->sender_ssrc, fci.fir.seq);
+                        kf_request = true;
+                    }
+
+                    frame->items.push_back(fci);
+                }
                 break;
 
             case uvgrtp::frame::RTCP_PSFB_TSTR:
@@ -1650,6 +1731,18 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
         case uvgrtp::frame::RTCP_RTPFB_NACK:
             break;
 
+        case uvgrtp::frame::RTCP_RTPFB_TWCC:
+            /* transport-wide feedback is consumed by the congestion controller */
+            if (tcc_) {
+                if (tcc_->handle_feedback(packet + read_ptr, packet_end - read_ptr) != RTP_OK) {
+                    UVG_LOG_WARN("Failed to process transport-wide feedback");
+                }
+
+                delete frame;
+                return RTP_OK;
+            }
+            break;
+
         default:
             UVG_LOG_WARN("Unknown RTCP RTPFB packet received, type %d", header.fmt);
             break;
@@ -1662,7 +1755,9 @@ rtp_error_t uvgrtp::rtcp::handle_fb_packet(uint8_t* packet, size_t& read_ptr,
     }
     else
     {
-        UVG_LOG_WARN("Discarding received RTCP PSFB packet without a hook");
+        if (!kf_request) {
+            UVG_LOG_WARN("Discarding received RTCP PSFB packet without a hook");
+        }
         delete frame;
     }
     fb_mutex_.unlock();
@@ -1708,6 +1803,179 @@ rtp_error_t uvgrtp::rtcp::send_rtcp_packet_to_participants(uint8_t* frame, uint3
     return ret;
 }
 
+rtp_error_t uvgrtp::rtcp::send_transport_feedback(uint32_t media_ssrc)
+{
+    /* RTCP packets must be compound packets starting with a report, see RFC 3550 section 6.1 */
+    size_t rr_size    = RTCP_HEADER_SIZE + SSRC_CSRC_SIZE;
+    size_t frame_size = rr_size + TWCC_MAX_FEEDBACK_SIZE;
+
+    if (rce_flags_ & RCE_SRTP)
+        frame_size += UVG_SRTCP_INDEX_LENGTH + uvgrtp::get_srtcp_tag_length(rce_flags_);
+
+    uint8_t *frame   = new uint8_t[frame_size];
+    size_t write_ptr = 0;
+    uint32_t ssrc    = *ssrc_.get();
+
+    memset(frame, 0, frame_size);
+
+    if (!construct_rtcp_header(frame, write_ptr, rr_size, 0, uvgrtp::frame::RTCP_FT_RR) ||
+        !construct_ssrc(frame, write_ptr, ssrc))
+    {
+        UVG_LOG_ERROR("Failed to construct RR");
+        delete[] frame;
+        return RTP_GENERIC_ERROR;
+    }
+
+    size_t fb_size = tcc_->create_feedback(frame + write_ptr, ssrc, media_ssrc);
+
+    if (!fb_size)
+    {
+        delete[] frame;
+        return RTP_OK;
+    }
+
+    frame_size = write_ptr + fb_size;
+
+    if (rce_flags_ & RCE_SRTP)
+        frame_size += UVG_SRTCP_INDEX_LENGTH + uvgrtp::get_srtcp_tag_length(rce_flags_);
+
+    /* Each SRTCP packet needs its own index, and the encryption must not overlap
+     * with the reports which are encrypted and sent under the same lock */
+    std::lock_guard<std::mutex> lock(packet_mutex_);
+    rtcp_pkt_sent_count_++;
+
+    return send_rtcp_packet_to_participants(frame, (uint32_t)frame_size, true);
+}
+
+rtp_error_t uvgrtp::rtcp::send_psfb_packet(uvgrtp::frame::RTCP_PSFB_FMT fmt, uint32_t media_ssrc)
+{
+    /* RTCP packets must be compound packets starting with a report, see RFC 3550 section 6.1 */
+    size_t rr_size    = RTCP_HEADER_SIZE + SSRC_CSRC_SIZE;
+    size_t fb_size    = get_psfb_packet_size(fmt);
+    size_t frame_size = rr_size + fb_size;
+
+    if (rce_flags_ & RCE_SRTP)
+        frame_size += UVG_SRTCP_INDEX_LENGTH + uvgrtp::get_srtcp_tag_length(rce_flags_);
+
+    uint8_t *frame   = new uint8_t[frame_size];
+    size_t write_ptr = 0;
+    uint32_t ssrc    = *ssrc_.get();
+
+    memset(frame, 0, frame_size);
+
+    if (!construct_rtcp_header(frame, write_ptr, rr_size, 0, uvgrtp::frame::RTCP_FT_RR) ||
+        !construct_ssrc(frame, write_ptr, ssrc) ||
+        !construct_rtcp_header(frame, write_ptr, fb_size, fmt, uvgrtp::frame::RTCP_FT_PSFB) ||
+        !construct_ssrc(frame, write_ptr, ssrc))
+    {
+        UVG_LOG_ERROR("Failed to construct RTCP PSFB packet");
+        delete[] frame;
+        return RTP_GENERIC_ERROR;
+    }
+
+    /* FIR carries the media sender in the FCI and the media source SSRC is zero, RFC 5104 section 4.3.1.2 */
+    if (fmt == uvgrtp::frame::RTCP_PSFB_FIR)
+    {
+        construct_ssrc(frame, write_ptr, 0);
+        construct_fir_fci(frame, write_ptr, media_ssrc, fir_seq_++);
+    }
+    else
+    {
+        construct_ssrc(frame, write_ptr, media_ssrc);
+    }
+
+    /* Like the transport feedback, PLI and FIR are sent outside the RTCP runner
+     * and need an SRTCP index of their own */
+    std::lock_guard<std::mutex> lock(packet_mutex_);
+    rtcp_pkt_sent_count_++;
+
+    return send_rtcp_packet_to_participants(frame, (uint32_t)frame_size, true);
+}
+
+rtp_error_t uvgrtp::rtcp::send_pli_packet(uint32_t media_ssrc)
+{
+    return send_psfb_packet(uvgrtp::frame::RTCP_PSFB_PLI, media_ssrc);
+}
+
+rtp_error_t uvgrtp::rtcp::send_fir_packet(uint32_t media_ssrc)
+{
+    return send_psfb_packet(uvgrtp::frame::RTCP_PSFB_FIR, media_ssrc);
+}
+
+rtp_error_t uvgrtp::rtcp::request_keyframe(uint32_t media_ssrc)
+{
+    {
+        std::lock_guard<std::mutex> lock(kf_request_mutex_);
+
+        /* the answer to the previous request cannot have arrived within one round-trip */
+        uint32_t min_interval = std::max(kf_request_interval_ms_.load(), rtt_ms_.load());
+
+        if (kf_requested_ && uvgrtp::clock::hrc::diff_now(last_kf_request_) < min_interval)
+            return RTP_NOT_READY;
+
+        kf_requested_    = true;
+        last_kf_request_ = uvgrtp::clock::hrc::now();
+    }
+
+    UVG_LOG_DEBUG("Requesting a keyframe from SSRC %u", media_ssrc);
+
+    return send_psfb_packet((uvgrtp::frame::RTCP_PSFB_FMT)kf_request_type_.load(), media_ssrc);
+}
+
+void uvgrtp::rtcp::handle_keyframe_request(uvgrtp::frame::RTCP_PSFB_FMT fmt, uint32_t requester, uint8_t fir_seq)
+{
+    std::lock_guard<std::mutex> lock(kf_mutex_);
+
+    if (fmt == uvgrtp::frame::RTCP_PSFB_FIR)
+    {
+        auto previous = received_fir_seqs_.find(requester);
+
+        if (previous != received_fir_seqs_.end() && previous->second == fir_seq)
+        {
+            UVG_LOG_DEBUG("Ignoring a retransmitted FIR from SSRC %u", requester);
+            return;
+        }
+
+        received_fir_seqs_[requester] = fir_seq;
+    }
+
+    if (kf_hook_)
+    {
+        kf_hook_(requester);
+    }
+    else
+    {
+        UVG_LOG_DEBUG("Keyframe requested by SSRC %u without a hook", requester);
+    }
+}
+
+rtp_error_t uvgrtp::rtcp::set_keyframe_request_type(int type)
+{
+    if (type != uvgrtp::frame::RTCP_PSFB_PLI && type != uvgrtp::frame::RTCP_PSFB_FIR)
+    {
+        UVG_LOG_ERROR("Keyframes can only be requested with PLI or FIR, not with PSFB type %d", type);
+        return RTP_INVALID_VALUE;
+    }
+
+    kf_request_type_ = type;
+    return RTP_OK;
+}
+
+void uvgrtp::rtcp::set_keyframe_request_interval(uint32_t ms)
+{
+    kf_request_interval_ms_ = ms;
+}
+
+int uvgrtp::rtcp::get_keyframe_request_type() const
+{
+    return kf_request_type_;
+}
+
+uint32_t uvgrtp::rtcp::get_keyframe_request_interval() const
+{
+    return kf_request_interval_ms_;
+}
+
 uint32_t uvgrtp::rtcp::size_of_ready_app_packets() const
 {
     uint32_t app_size = 0;
@@ -2073,6 +2341,36 @@ rtp_error_t uvgrtp::rtcp::send_app_packet(const char* name, uint8_t subtype,
     return RTP_OK;
 }
 
+void uvgrtp::rtcp::update_rtt(const std::vector<uvgrtp::frame::rtcp_report_block>& reports)
+{
+    uint32_t ssrc = *ssrc_.get();
+
+    for (auto& report : reports)
+    {
+        /* LSR is zero until the participant has received a Sender Report from us */
+        if (report.ssrc != ssrc || report.lsr == 0)
+            continue;
+
+        /* RTT = A - LSR - DLSR, all in units of 1/65536 seconds */
+        uint32_t now = (uint32_t)(uvgrtp::clock::ntp::now() >> 16);
+        uint32_t rtt = now - report.lsr - report.dlsr;
+        uint64_t rtt_ms = (uint64_t)rtt * 1000 / 65536;
+
+        if (rtt_ms > MAX_RTT_MS)
+        {
+            UVG_LOG_DEBUG("Ignoring an invalid round-trip time of %" PRIu64 " ms", rtt_ms);
+            continue;
+        }
+
+        rtt_ms_ = (uint32_t)rtt_ms;
+    }
+}
+
+uint32_t uvgrtp::rtcp::get_rtt() const
+{
+    return rtt_ms_;
+}
+
 uint32_t uvgrtp::rtcp::get_rtcp_interval_ms() const 
 {
     return interval_ms_.load();
@@ -2198,6 +2496,11 @@ void uvgrtp::rtcp::set_payload_size(size_t mtu_size)
     mtu_size_ = mtu_size;
 }
 
+void uvgrtp::rtcp::set_transport_cc(std::shared_ptr<uvgrtp::transport_cc> tcc)
+{
+    tcc_ = tcc;
+}
+
 void uvgrtp::rtcp::set_socket(std::shared_ptr<uvgrtp::socket> socket)
 {
     rtcp_socket_ = socket;
@@ -19,7 +19,7 @@ uint32_t uvgrtp::get_rr_packet_size(int rce_flags, uint16_t reports)
         + (size_t)REPORT_BLOCK_SIZE * reports;
     if (rce_flags & RCE_SRTP)
     {
-        size += UVG_SRTCP_INDEX_LENGTH + UVG_AUTH_TAG_LENGTH;
+        size += UVG_SRTCP_INDEX_LENGTH + (uint32_t)uvgrtp::get_srtcp_tag_length(rce_flags);
     }
 
     return size;
@@ -53,6 +53,19 @@ uint32_t uvgrtp::get_bye_packet_size(const std::vector<uint32_t>& ssrcs)
     return RTCP_HEADER_SIZE + (uint32_t)ssrcs.size() * SSRC_CSRC_SIZE;
 }
 
+uint32_t uvgrtp::get_psfb_packet_size(uvgrtp::frame::RTCP_PSFB_FMT fmt)
+{
+    /* sender SSRC and media source SSRC, FIR requests are addressed in the FCI instead */
+    uint32_t size = RTCP_HEADER_SIZE + 2 * SSRC_CSRC_SIZE;
+
+    if (fmt == uvgrtp::frame::RTCP_PSFB_FIR)
+    {
+        size += FIR_FCI_SIZE;
+    }
+
+    return size;
+}
+
 bool uvgrtp::construct_rtcp_header(uint8_t* frame, size_t& ptr, size_t packet_size,
     uint8_t secondField, uvgrtp::frame::RTCP_FRAME_TYPE frame_type)
 {
@@ -164,6 +177,16 @@ bool uvgrtp::construct_bye_packet(uint8_t* frame, size_t& ptr, const std::vector
     return true;
 }
 
+bool uvgrtp::construct_fir_fci(uint8_t* frame, size_t& ptr, uint32_t ssrc, uint8_t seq)
+{
+    // |                              SSRC                             |
+    // | Seq nr.       |    Reserved                                   |
+    SET_NEXT_FIELD_32(frame, ptr, htonl(ssrc));
+    SET_NEXT_FIELD_32(frame, ptr, htonl(uint32_t(seq) << 24));
+
+    return true;
+}
+
 bool uvgrtp::construct_app_block(uint8_t* frame, size_t& write_ptr, uint8_t sec_field, uint32_t ssrc, const char* name, std::unique_ptr<uint8_t[]> payload, size_t payload_len)
 {
     uint32_t packet_size = get_app_packet_size((uint32_t)payload_len);
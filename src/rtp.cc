@@ -7,6 +7,7 @@
 #include "memory.hh"
 
 #include "global.hh"
+#include "header_extensions.hh"
 
 #ifndef _WIN32
 #include <arpa/inet.h>
@@ -14,6 +15,7 @@
 #endif
 
 #include <chrono>
+#include <cstring>
 #include <iostream>
 
 #define INVALID_TS UINT64_MAX
@@ -308,13 +310,34 @@ rtp_error_t uvgrtp::rtp::packet_handler(void* args, int rce_flags, uint8_t* pack
 
     if ((*out)->header.ext) {
         UVG_LOG_DEBUG("Frame contains extension information");
-        (*out)->ext = new uvgrtp::frame::ext_header;
 
-        (*out)->ext->type    = ntohs(*(uint16_t *)&ptr[0]);
-        (*out)->ext->len     = ntohs(*(uint16_t *)&ptr[2]) * sizeof(uint32_t);
-        (*out)->ext->data    = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), (*out)->ext->len);
-        (*out)->payload_len -= 2 * sizeof(uint16_t) + (*out)->ext->len;
-        ptr                 += 2 * sizeof(uint16_t) + (*out)->ext->len;
+        if ((*out)->payload_len < 2 * sizeof(uint16_t)) {
+            UVG_LOG_DEBUG("Invalid frame length, cannot contain extension header");
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        uint16_t profile = ntohs(*(uint16_t *)&ptr[0]);
+        size_t ext_len   = ntohs(*(uint16_t *)&ptr[2]) * sizeof(uint32_t);
+
+        if ((*out)->payload_len < 2 * sizeof(uint16_t) + ext_len) {
+            UVG_LOG_DEBUG("Invalid frame length, extension length %zu, total length %zu", ext_len, (*out)->payload_len);
+            (void)uvgrtp::frame::dealloc_frame(*out);
+            return RTP_GENERIC_ERROR;
+        }
+
+        if (profile == RTP_EXT_ONE_BYTE_PROFILE || (profile & 0xfff0) == RTP_EXT_TWO_BYTE_PROFILE) {
+            parse_extension_elements(*out, ptr + 2 * sizeof(uint16_t), ext_len, profile == RTP_EXT_ONE_BYTE_PROFILE);
+        } else {
+            (*out)->ext = new uvgrtp::frame::ext_header;
+
+            (*out)->ext->type = profile;
+            (*out)->ext->len  = (uint16_t)ext_len;
+            (*out)->ext->data = (uint8_t *)memdup(ptr + 2 * sizeof(uint16_t), ext_len);
+        }
+
+        (*out)->payload_len -= 2 * sizeof(uint16_t) + ext_len;
+        ptr                 += 2 * sizeof(uint16_t) + ext_len;
     }
 
     /* If padding is set to 1, the last byte of the payload indicates
@@ -339,3 +362,61 @@ rtp_error_t uvgrtp::rtp::packet_handler(void* args, int rce_flags, uint8_t* pack
 
     return RTP_PKT_MODIFIED;
 }
+
+void uvgrtp::rtp::parse_extension_elements(uvgrtp::frame::rtp_frame *frame, uint8_t *ptr, size_t len, bool one_byte)
+{
+    size_t i    = 0;
+    size_t used = 0;
+
+    while (i < len) {
+        /* padding between and after the elements */
+        if (ptr[i] == 0) {
+            ++i;
+            continue;
+        }
+
+        uint8_t id   = 0;
+        size_t  size = 0;
+
+        if (one_byte) {
+            id   = ptr[i] >> 4;
+            size = (ptr[i] & 0x0f) + 1;
+
+            /* ID 15 is reserved and ID 0 is only valid as padding,
+             * both stop the processing of the block */
+            if (id == 15 || id == 0)
+                return;
+
+            i += 1;
+        } else {
+            if (i + 1 >= len)
+                return;
+
+            id   = ptr[i];
+            size = ptr[i + 1];
+            i   += 2;
+        }
+
+        if (i + size > len) {
+            UVG_LOG_DEBUG("Header extension element %u overflows the extension block", id);
+            return;
+        }
+
+        if (frame->ext_count < uvgrtp::frame::RTP_EXT_MAX_ELEMENTS &&
+            used + size <= uvgrtp::frame::RTP_EXT_INLINE_SIZE)
+        {
+            uvgrtp::frame::rtp_ext_element& e = frame->ext_elements[frame->ext_count++];
+
+            e.id     = id;
+            e.len    = (uint8_t)size;
+            e.offset = (uint8_t)used;
+
+            memcpy(&frame->ext_data[used], &ptr[i], size);
+            used += size;
+        } else {
+            UVG_LOG_DEBUG("No room for header extension element %u, element discarded", id);
+        }
+
+        i += size;
+    }
+}
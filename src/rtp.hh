@@ -48,6 +48,9 @@ namespace uvgrtp {
 
         private:
 
+            /* Copy the RFC 8285 extension elements of the "len"-byte block at "ptr" to the inline table of "frame" */
+            void parse_extension_elements(uvgrtp::frame::rtp_frame *frame, uint8_t *ptr, size_t len, bool one_byte);
+
             void set_default_clock_rate(rtp_format_t fmt);
 
             std::shared_ptr<std::atomic<std::uint32_t>> ssrc_;
@@ -7,7 +7,8 @@
 #include "debug.hh"
 
 
-uvgrtp::session::session(std::string cname, std::string addr, std::shared_ptr<uvgrtp::socketfactory> sfp) :
+uvgrtp::session::session(std::string cname, std::string addr, std::shared_ptr<uvgrtp::socketfactory> sfp,
+    std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool) :
 #ifdef __RTP_CRYPTO__
     zrtp_(nullptr),
 #endif
@@ -15,12 +16,14 @@ uvgrtp::session::session(std::string cname, std::string addr, std::shared_ptr<uv
     remote_address_(""),
     local_address_(""),
     cname_(cname),
-    sf_(sfp)
+    sf_(sfp),
+    key_pool_(key_pool)
 {
     sf_->set_local_interface(generic_address_);
 }
 
-uvgrtp::session::session(std::string cname, std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::socketfactory> sfp):
+uvgrtp::session::session(std::string cname, std::string remote_addr, std::string local_addr, std::shared_ptr<uvgrtp::socketfactory> sfp,
+    std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool):
 #ifdef __RTP_CRYPTO__
     zrtp_(nullptr),
 #endif
@@ -28,7 +31,8 @@ uvgrtp::session::session(std::string cname, std::string remote_addr, std::string
     remote_address_(remote_addr),
     local_address_(local_addr),
     cname_(cname),
-    sf_(sfp)
+    sf_(sfp),
+    key_pool_(key_pool)
 {
     sf_->set_local_interface(local_addr);
 }
@@ -125,7 +129,7 @@ uvgrtp::media_stream* uvgrtp::session::create_stream(uint16_t src_port, uint16_t
 
         session_mtx_.lock();
         if (zrtp_ == nullptr) {
-            zrtp_ = std::shared_ptr<uvgrtp::zrtp>(new uvgrtp::zrtp());
+            zrtp_ = std::shared_ptr<uvgrtp::zrtp>(new uvgrtp::zrtp(key_pool_));
         }
         session_mtx_.unlock();
 
@@ -417,14 +417,20 @@ socket_t& uvgrtp::socket::get_raw_socket()
 
 rtp_error_t uvgrtp::socket::install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void* arg, packet_handler_vec handler)
 {
-    handlers_mutex_.lock();
+    return install_handler(local_ssrc, arg, handler, nullptr);
+}
+
+rtp_error_t uvgrtp::socket::install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void* arg, packet_handler_vec handler,
+    packet_handler_pkt_vec batch_handler)
+{
     if (!handler)
         return RTP_INVALID_VALUE;
 
-
+    handlers_mutex_.lock();
     socket_packet_handler hndlr;
     hndlr.arg = arg;
     hndlr.handler = handler;
+    hndlr.batch_handler = batch_handler;
     vec_handlers_.insert({local_ssrc, hndlr});
     handlers_mutex_.unlock();
 
@@ -783,33 +789,31 @@ send_:
 
 rtp_error_t uvgrtp::socket::sendto(uint32_t ssrc, sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags)
 {
-    rtp_error_t ret = RTP_OK;
-    for (auto& buffer : buffers) {
-        std::lock_guard<std::mutex> lg(handlers_mutex_);
-        for (auto& handler : vec_handlers_) {
-            if (handler.first.get()->load() != ssrc) {
-                continue;
-            }
-            if ((ret = (*handler.second.handler)(handler.second.arg, buffer)) != RTP_OK) {
-                UVG_LOG_ERROR("Malformed packet");
-                return ret;
-            }
-        }
-    }
-    return __sendtov(addr, addr6, ipv6_, buffers, send_flags, nullptr);
+    return sendto(ssrc, addr, addr6, buffers, send_flags, nullptr);
 }
 
 rtp_error_t uvgrtp::socket::sendto(uint32_t ssrc, sockaddr_in& addr, sockaddr_in6& addr6, pkt_vec& buffers, int send_flags, int *bytes_sent)
 {
     rtp_error_t ret = RTP_OK;
 
-    for (auto& buffer : buffers) {
+    {
         std::lock_guard<std::mutex> lg(handlers_mutex_);
         for (auto& handler : vec_handlers_) {
             if (handler.first.get()->load() != ssrc) {
                 continue;
             }
-            if ((ret = (*handler.second.handler)(handler.second.arg, buffer)) != RTP_OK) {
+
+            if (handler.second.batch_handler) {
+                ret = (*handler.second.batch_handler)(handler.second.arg, buffers);
+            }
+            else {
+                for (auto& buffer : buffers) {
+                    if ((ret = (*handler.second.handler)(handler.second.arg, buffer)) != RTP_OK)
+                        break;
+                }
+            }
+
+            if (ret != RTP_OK) {
                 UVG_LOG_ERROR("Malformed packet");
                 return ret;
             }
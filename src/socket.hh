@@ -67,10 +67,14 @@ namespace uvgrtp {
     typedef std::vector<std::vector<std::pair<size_t, uint8_t *>>> pkt_vec;
 
     typedef rtp_error_t (*packet_handler_vec)(void *, buf_vec&);
+    typedef rtp_error_t (*packet_handler_pkt_vec)(void *, pkt_vec&);
 
     struct socket_packet_handler {
         void *arg = nullptr;
         packet_handler_vec handler = nullptr;
+
+        /* If set, called once with all packets of a pkt_vec send instead of calling "handler" for each */
+        packet_handler_pkt_vec batch_handler = nullptr;
     };
 
     class socket {
@@ -180,6 +184,11 @@ namespace uvgrtp {
              * "arg" is an optional parameter that can be passed to the handler when it's called */
             rtp_error_t install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void *arg, packet_handler_vec handler);
 
+            /* Same as above but "batch_handler" is given all packets of a pkt_vec send at once
+             * so that it can process them together. "handler" is used for buf_vec sends */
+            rtp_error_t install_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc, void *arg, packet_handler_vec handler,
+                packet_handler_pkt_vec batch_handler);
+
             rtp_error_t remove_handler(std::shared_ptr<std::atomic<std::uint32_t>> local_ssrc);
 
             static bool is_multicast(sockaddr_in& local_address);
@@ -9,7 +9,8 @@
 uvgrtp::base_srtp::base_srtp():
     local_srtp_ctx_(std::shared_ptr<srtp_ctx_t>(new srtp_ctx_t)),
     remote_srtp_ctx_(std::shared_ptr<srtp_ctx_t>(new srtp_ctx_t)),
-    use_null_cipher_(false)
+    use_null_cipher_(false),
+    use_aead_(false)
 {}
 
 uvgrtp::base_srtp::~base_srtp()
@@ -24,6 +25,27 @@ bool uvgrtp::base_srtp::use_null_cipher()
     return use_null_cipher_;
 }
 
+bool uvgrtp::base_srtp::use_aead() const
+{
+    return use_aead_;
+}
+
+size_t uvgrtp::get_srtp_tag_length(int rce_flags)
+{
+    if ((rce_flags & RCE_SRTP) && (rce_flags & RCE_SRTP_AEAD_GCM))
+        return UVG_AEAD_TAG_LENGTH;
+
+    if (rce_flags & RCE_SRTP_AUTHENTICATE_RTP)
+        return UVG_AUTH_TAG_LENGTH;
+
+    return 0;
+}
+
+size_t uvgrtp::get_srtcp_tag_length(int rce_flags)
+{
+    return (rce_flags & RCE_SRTP_AEAD_GCM) ? UVG_AEAD_TAG_LENGTH : UVG_AUTH_TAG_LENGTH;
+}
+
 std::shared_ptr<uvgrtp::srtp_ctx_t> uvgrtp::base_srtp::get_local_ctx()
 {
     return local_srtp_ctx_;
@@ -77,34 +99,112 @@ rtp_error_t uvgrtp::base_srtp::create_iv(uint8_t *out, uint32_t ssrc, uint64_t i
     return RTP_OK;
 }
 
-bool uvgrtp::base_srtp::is_replayed_packet(uint8_t *digest)
+rtp_error_t uvgrtp::base_srtp::create_aead_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt)
+{
+    if (!out || !salt)
+        return RTP_INVALID_VALUE;
+
+    /* RFC 7714 Sec. 8.1 and 9.1: 2 zero bytes, SSRC and a 48-bit index in network byte order */
+    memset(out, 0, UVG_AEAD_IV_LENGTH);
+
+    for (int i = 0; i < 4; ++i)
+        out[2 + i] = (uint8_t)(ssrc >> (24 - 8 * i));
+
+    for (int i = 0; i < 6; ++i)
+        out[6 + i] = (uint8_t)(index >> (40 - 8 * i));
+
+    for (int i = 0; i < UVG_AEAD_SALT_LENGTH; ++i)
+        out[i] ^= salt[i];
+
+    return RTP_OK;
+}
+
+bool uvgrtp::base_srtp::is_replayed_packet(uint64_t index)
 {
-    if (!(remote_srtp_ctx_->rce_flags & RCE_SRTP_REPLAY_PROTECTION))
+    auto ctx = remote_srtp_ctx_;
+
+    if (!(ctx->rce_flags & RCE_SRTP_REPLAY_PROTECTION) || !ctx->replay)
         return false;
 
-    uint64_t truncated;
-    memcpy(&truncated, digest, sizeof(uint64_t));
+    size_t bit = index & (ctx->replay_size - 1);
+
+    if (ctx->r_init && index <= ctx->r_l) {
+        if (ctx->r_l - index >= ctx->replay_size) {
+            UVG_LOG_DEBUG("Packet index %llu is behind the replay window", (unsigned long long)index);
+            return true;
+        }
+
+        if (ctx->replay[bit / 8] & (1 << (bit % 8)))
+            return true;
+
+        ctx->replay[bit / 8] |= (1 << (bit % 8));
+        return false;
+    }
 
-    if (replay_list_.find(truncated) != replay_list_.end()) {
-        UVG_LOG_ERROR("Replayed packet received, discarding!");
-        return true;
+    /* the window moves forward, forget the indices that fall out of it */
+    if (!ctx->r_init || index - ctx->r_l >= ctx->replay_size) {
+        memset(ctx->replay, 0, ctx->replay_size / 8);
+    }
+    else {
+        for (uint64_t i = ctx->r_l + 1; i < index; ++i) {
+            size_t b = i & (ctx->replay_size - 1);
+            ctx->replay[b / 8] &= ~(1 << (b % 8));
+        }
     }
 
-    replay_list_.insert(truncated);
+    ctx->replay[bit / 8] |= (1 << (bit % 8));
+    ctx->r_l    = index;
+    ctx->s_l    = (uint16_t)index;
+    ctx->r_init = true;
+
     return false;
 }
 
+rtp_error_t uvgrtp::base_srtp::set_replay_window_size(size_t size)
+{
+    if (size < UVG_REPLAY_WINDOW_MIN || size > UVG_REPLAY_WINDOW_MAX || (size & (size - 1))) {
+        UVG_LOG_ERROR("Replay window size must be a power of two between %d and %d",
+            UVG_REPLAY_WINDOW_MIN, UVG_REPLAY_WINDOW_MAX);
+        return RTP_INVALID_VALUE;
+    }
+
+    auto ctx = remote_srtp_ctx_;
+
+    delete[] ctx->replay;
+    ctx->replay      = nullptr;
+    ctx->replay_size = size;
+    ctx->r_l         = 0;
+    ctx->r_init      = false;
+
+    if (ctx->rce_flags & RCE_SRTP_REPLAY_PROTECTION)
+        ctx->replay = new uint8_t[size / 8]();
+
+    return RTP_OK;
+}
+
 rtp_error_t uvgrtp::base_srtp::init(int type, int rce_flags, uint8_t* local_key, uint8_t* remote_key,
                                     uint8_t* local_salt, uint8_t* remote_salt)
 {
     if (!local_key || !remote_key || !local_salt || !remote_salt)
         return RTP_INVALID_VALUE;
 
-    use_null_cipher_ = (rce_flags & RCE_SRTP_NULL_CIPHER);
+    use_aead_        = (rce_flags & RCE_SRTP_AEAD_GCM);
+    use_null_cipher_ = (rce_flags & RCE_SRTP_NULL_CIPHER) && !use_aead_;
+
+    if (use_aead_ && get_key_size(rce_flags) == AES192_KEY_SIZE) {
+        UVG_LOG_ERROR("AES-GCM supports only 128 and 256-bit keys");
+        return RTP_INVALID_VALUE;
+    }
 
     init_srtp_context(local_srtp_ctx_,  type, rce_flags, local_key,  local_salt);
     init_srtp_context(remote_srtp_ctx_, type, rce_flags, remote_key, remote_salt);
 
+    /* only the receiving side keeps a replay window */
+    if (rce_flags & RCE_SRTP_REPLAY_PROTECTION)
+        remote_srtp_ctx_->replay = new uint8_t[remote_srtp_ctx_->replay_size / 8]();
+
+    keys_changed();
+
     return RTP_OK;
 }
 
@@ -133,9 +233,11 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
 
     size_t key_size = get_key_size(rce_flags);
 
+    bool aead = (rce_flags & RCE_SRTP_AEAD_GCM);
+
     switch (key_size) {
     case AES128_KEY_SIZE:
-        context->enc = AES_128;
+        context->enc = aead ? AEAD_AES_128_GCM : AES_128;
         break;
 
     case AES192_KEY_SIZE:
@@ -143,7 +245,7 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
         break;
 
     case AES256_KEY_SIZE:
-        context->enc = AES_256;
+        context->enc = aead ? AEAD_AES_256_GCM : AES_256;
         break;
     }
 
@@ -156,9 +258,13 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
     context->n_a = UVG_HMAC_BUFFER_LENGTH;
 
     context->s_l = 0;
-    context->replay = nullptr;
+    context->r_l = 0;
+    context->r_init = false;
     context->rce_flags = rce_flags;
 
+    delete[] context->replay;
+    context->replay = nullptr;
+
     int label_enc = 0;
     int label_auth = 0;
     int label_salt = 0;
@@ -177,6 +283,11 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
     context->master_key = new uint8_t[key_size];
     memcpy(context->master_key, key, key_size);
     memcpy(context->master_salt, salt, UVG_SALT_LENGTH);
+
+    /* The AES-GCM master salt is 96 bits. It goes to the key derivation zero-padded
+     * like the 112-bit salt so the labels stay in place (RFC 7714 Sec. 11) */
+    if (aead)
+        memset(context->master_salt + UVG_AEAD_SALT_LENGTH, 0, UVG_SALT_LENGTH - UVG_AEAD_SALT_LENGTH);
     context->enc_key = new uint8_t[key_size]; // session key
 
     /* Derive session keys */
@@ -205,6 +316,14 @@ rtp_error_t uvgrtp::base_srtp::init_srtp_context(std::shared_ptr<uvgrtp::srtp_ct
         UVG_SALT_LENGTH
     );
 
+    if (aead) {
+        context->aead = std::make_shared<uvgrtp::crypto::aes::gcm>(context->enc_key, key_size);
+    }
+    else {
+        context->cipher = std::make_shared<uvgrtp::crypto::aes::ctr>(context->enc_key, key_size);
+        context->auth   = std::make_shared<uvgrtp::crypto::hmac::sha1>(context->auth_key, UVG_HMAC_KEY_LENGTH);
+    }
+
     return RTP_OK;
 }
 
@@ -216,5 +335,7 @@ void uvgrtp::base_srtp::cleanup_context(std::shared_ptr<srtp_ctx_t> context)
             delete[] context->master_key;
         if (context->enc_key)
             delete[] context->enc_key;
+        if (context->replay)
+            delete[] context->replay;
     }
 }
\ No newline at end of file
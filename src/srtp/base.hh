@@ -12,9 +12,9 @@
 #endif
 
 #include <cstdint>
-#include <unordered_set>
 #include <vector>
 #include <memory>
+#include <mutex>
 
 
 
@@ -31,12 +31,30 @@ enum {
 #define UVG_IV_LENGTH           16 /* 128 bits - RFC3711 Sec. 4.1.1: AES block/IV size = 128 bits */
 #define UVG_AUTH_TAG_LENGTH     10 /* 80 bits - RFC3711 Sec. 5.2: default authentication tag length (n_tag = 80 bits) */
 #define UVG_SRTCP_INDEX_LENGTH   4 /* 31-bit SRTCP index carried in 4 octets (with 1 E-bit) - RFC3711 Sec. 3.4 */
+#define UVG_AEAD_TAG_LENGTH     16 /* 128 bits - RFC7714 Sec. 12: AEAD_AES_128_GCM and AEAD_AES_256_GCM tag length */
+#define UVG_AEAD_SALT_LENGTH    12 /* 96 bits - RFC7714 Sec. 12: master/session salt length */
+#define UVG_AEAD_IV_LENGTH      12 /* 96 bits - RFC7714 Sec. 8.1: GCM IV length */
+#define UVG_REPLAY_WINDOW_MIN   64 /* RFC3711 Sec. 3.3.2: minimum replay window size */
+#define UVG_REPLAY_WINDOW_MAX 1024
 
 namespace uvgrtp {
 
+    namespace crypto {
+        namespace aes {
+            class ctr;
+            class gcm;
+        }
+        namespace hmac {
+            class sha1;
+        }
+    }
+
     /* Vector of buffers that contain a full RTP frame */
     typedef std::vector<std::pair<size_t, uint8_t *>> buf_vec;
 
+    /* Vector of RTP frames constructed from buf_vec entries */
+    typedef std::vector<std::vector<std::pair<size_t, uint8_t *>>> pkt_vec;
+
     enum STYPE {
         SRTP  = 0,
         SRTCP = 1
@@ -45,7 +63,9 @@ namespace uvgrtp {
     enum ETYPE {
         AES_128 = 0,
         AES_192 = 1,
-        AES_256 = 2
+        AES_256 = 2,
+        AEAD_AES_128_GCM = 3,
+        AEAD_AES_256_GCM = 4
     };
 
     enum HTYPE {
@@ -72,6 +92,18 @@ namespace uvgrtp {
         uint8_t auth_key[UVG_HMAC_KEY_LENGTH] = {};
         uint8_t salt_key[UVG_SALT_LENGTH] = {};
 
+        /* Cipher and HMAC keyed with the session keys when the context is initialized.
+         * Only the IV is set per packet so the key setup is not repeated for every packet */
+        std::shared_ptr<uvgrtp::crypto::aes::ctr> cipher;
+        std::shared_ptr<uvgrtp::crypto::hmac::sha1> auth;
+
+        /* Used instead of "cipher" and "auth" with RCE_SRTP_AEAD_GCM */
+        std::shared_ptr<uvgrtp::crypto::aes::gcm> aead;
+
+        /* The ciphers keep state between calls, so only one thread may use them at a time.
+         * For example the SRTCP context is used both by the RTCP runner and the reception thread */
+        std::mutex mutex;
+
         int type = 0;     /* srtp or srtcp */
         uint32_t roc = 0; /* rollover counter */
         uint32_t rts = 0; /* timestamp of the frame that causes ROC update */
@@ -90,11 +122,23 @@ namespace uvgrtp {
 
         /* following fields are receiver-only */
         uint16_t s_l = 0;    /* highest received sequence number */
-        uint8_t *replay = nullptr; /* list of recently received and authenticated SRTP packets */
+        uint64_t r_l = 0;    /* highest received packet index (SRTP index or SRTCP index) */
+        bool r_init = false; /* has a packet been accepted to the replay window yet */
+
+        /* Replay window of RFC 3711 Sec. 3.3.2. Bit "index % replay_size" tells whether a packet
+         * with that index, between "r_l - replay_size + 1" and "r_l", has been received */
+        uint8_t *replay = nullptr;
+        size_t replay_size = UVG_REPLAY_WINDOW_MIN; /* in bits, power of two */
 
         int rce_flags = 0; /* context configuration flags */
     } srtp_ctx_t;
 
+    /* Return the length of the authentication tag at the end of SRTP packets, 0 if they do not have one */
+    size_t get_srtp_tag_length(int rce_flags);
+
+    /* Return the length of the authentication tag at the end of SRTCP packets */
+    size_t get_srtcp_tag_length(int rce_flags);
+
     class base_srtp {
         public:
             base_srtp();
@@ -114,13 +158,25 @@ namespace uvgrtp {
             /* Has RTP packet encryption been disabled? */
             bool use_null_cipher();
 
+            /* Are packets protected with AES-GCM (RCE_SRTP_AEAD_GCM)? */
+            bool use_aead() const;
+
             /* Get reference to the SRTP context (including session keys) */
             std::shared_ptr<srtp_ctx_t> get_local_ctx();
             std::shared_ptr<srtp_ctx_t> get_remote_ctx();
 
-            /* Returns true if the packet having this HMAC digest is replayed
+            /* Returns true if a packet with this SRTP/SRTCP index has already been received
+             * or is too old to be checked, otherwise marks the index as received
+             *
+             * Call only for authenticated packets.
              * Returns false if replay protection has not been enabled */
-            bool is_replayed_packet(uint8_t *digest);
+            bool is_replayed_packet(uint64_t index);
+
+            /* Set the size of the replay window in bits. This also clears the window
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "size" is not a power of two between 64 and 1024 */
+            rtp_error_t set_replay_window_size(size_t size);
 
             uint32_t get_key_size(int rce_flags) const;
 
@@ -132,6 +188,16 @@ namespace uvgrtp {
              * Return RTP_INVALID_VALUE if one of the parameters is invalid */
             rtp_error_t create_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt);
 
+            /* Create the 12-byte AES-GCM IV of RFC 7714 from "ssrc" and the 48 least significant
+             * bits of "index". That is ROC and sequence number for SRTP and the SRTCP index for SRTCP
+             *
+             * Return RTP_OK on success and place the iv to "out"
+             * Return RTP_INVALID_VALUE if one of the parameters is invalid */
+            rtp_error_t create_aead_iv(uint8_t *out, uint32_t ssrc, uint64_t index, uint8_t *salt);
+
+            /* Called by init() after the session keys have been derived */
+            virtual void keys_changed() {}
+
             /* SRTP context containing all session information and keys */
             std::shared_ptr<srtp_ctx_t> local_srtp_ctx_;  // for encryption
             std::shared_ptr<srtp_ctx_t> remote_srtp_ctx_; // for decryption
@@ -140,6 +206,8 @@ namespace uvgrtp {
              * encrypted but other security mechanisms described in RFC 3711 may be used */
             bool use_null_cipher_;
 
+            bool use_aead_;
+
         private:
 
             rtp_error_t init_srtp_context(std::shared_ptr<srtp_ctx_t> context, int type, int rce_flags,
@@ -148,10 +216,6 @@ namespace uvgrtp {
             rtp_error_t derive_key(int label, size_t key_size, uint8_t *key, uint8_t *salt, uint8_t *out, size_t len);
 
             void cleanup_context(std::shared_ptr<srtp_ctx_t> context);
-
-            /* Map containing all authentication tags of received packets (separate for SRTP and SRTCP)
-             * Used to implement replay protection */
-            std::unordered_set<uint64_t> replay_list_;
     };
 }
 
@@ -3,6 +3,12 @@
 #include "../crypto.hh"
 #include "../debug.hh"
 
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
 #include <cstring>
 #include <iostream>
 
@@ -20,6 +26,10 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_encryption(int rce_flags, uint32_t packet
     uint32_t ssrc, uint8_t* frame, uint32_t frame_size)
 {
     auto ret = RTP_OK;
+    std::lock_guard<std::mutex> lock(local_srtp_ctx_->mutex);
+
+    if ((rce_flags & RCE_SRTP) && use_aead_)
+        return encrypt_aead(packet_number, ssrc, frame, frame_size);
 
     /* Encrypt the packet if NULL cipher has not been enabled,
      * calculate authentication tag for the packet and add SRTCP index at the end */
@@ -46,6 +56,11 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_decryption(int rce_flags, uint32_t ssrc,
     uint8_t* packet, size_t packet_size)
 {
     auto ret = RTP_OK;
+    std::lock_guard<std::mutex> lock(remote_srtp_ctx_->mutex);
+
+    if ((rce_flags & RCE_SRTP) && use_aead_)
+        return decrypt_aead(ssrc, packet, packet_size);
+
     auto srtpi = (*(uint32_t*)&packet[packet_size - UVG_SRTCP_INDEX_LENGTH - UVG_AUTH_TAG_LENGTH]);
 
     if (rce_flags & RCE_SRTP) {
@@ -54,6 +69,11 @@ rtp_error_t uvgrtp::srtcp::handle_rtcp_decryption(int rce_flags, uint32_t ssrc,
             return RTP_AUTH_TAG_MISMATCH;
         }
 
+        if (is_replayed_packet(srtpi & 0x7fffffff)) {
+            UVG_LOG_ERROR("Replayed packet received, discarding!");
+            return RTP_INVALID_VALUE;
+        }
+
         if (((srtpi >> 31) & 0x1) && !(rce_flags & RCE_SRTP_NULL_CIPHER)) {
             if (decrypt(ssrc, srtpi & 0x7fffffff, packet, packet_size) != RTP_OK) {
                 UVG_LOG_ERROR("Failed to decrypt RTCP Sender Report");
@@ -77,8 +97,8 @@ rtp_error_t uvgrtp::srtcp::encrypt(uint32_t ssrc, uint64_t seq, uint8_t *buffer,
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(local_srtp_ctx_->enc_key, local_srtp_ctx_->n_e, iv);
-    ctr.encrypt(buffer, buffer, len);
+    local_srtp_ctx_->cipher->set_iv(iv);
+    local_srtp_ctx_->cipher->encrypt(buffer, buffer, len);
 
     return RTP_OK;
 }
@@ -86,11 +106,9 @@ rtp_error_t uvgrtp::srtcp::encrypt(uint32_t ssrc, uint64_t seq, uint8_t *buffer,
 rtp_error_t uvgrtp::srtcp::add_auth_tag(uint8_t *buffer, size_t len)
 {
     //see RFC 3711, section 5.2
-    auto hmac_sha1 = uvgrtp::crypto::hmac::sha1(local_srtp_ctx_->auth_key, UVG_HMAC_KEY_LENGTH);
-
-    hmac_sha1.update(buffer, len - UVG_AUTH_TAG_LENGTH);
-    hmac_sha1.update((uint8_t *)&local_srtp_ctx_->roc, sizeof(local_srtp_ctx_->roc));
-    hmac_sha1.final((uint8_t *)&buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH);
+    local_srtp_ctx_->auth->update(buffer, len - UVG_AUTH_TAG_LENGTH);
+    local_srtp_ctx_->auth->update((uint8_t *)&local_srtp_ctx_->roc, sizeof(local_srtp_ctx_->roc));
+    local_srtp_ctx_->auth->final((uint8_t *)&buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH);
 
     return RTP_OK;
 }
@@ -99,22 +117,16 @@ rtp_error_t uvgrtp::srtcp::verify_auth_tag(uint8_t *buffer, size_t len)
 {
     //see RFC 3711, section 5.2
     uint8_t digest[10] = { 0 };
-    auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(remote_srtp_ctx_->auth_key, UVG_HMAC_KEY_LENGTH);
 
-    hmac_sha1.update(buffer, len - UVG_AUTH_TAG_LENGTH);
-    hmac_sha1.update((uint8_t *)&remote_srtp_ctx_->roc, sizeof(remote_srtp_ctx_->roc));
-    hmac_sha1.final(digest, UVG_AUTH_TAG_LENGTH);
+    remote_srtp_ctx_->auth->update(buffer, len - UVG_AUTH_TAG_LENGTH);
+    remote_srtp_ctx_->auth->update((uint8_t *)&remote_srtp_ctx_->roc, sizeof(remote_srtp_ctx_->roc));
+    remote_srtp_ctx_->auth->final(digest, UVG_AUTH_TAG_LENGTH);
 
     if (memcmp(digest, &buffer[len - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
         UVG_LOG_ERROR("STCP authentication tag mismatch!");
         return RTP_AUTH_TAG_MISMATCH;
     }
 
-    if (is_replayed_packet(digest)) {
-        UVG_LOG_ERROR("Replayed packet received, discarding!");
-        return RTP_INVALID_VALUE;
-    }
-
     return RTP_OK;
 }
 
@@ -127,9 +139,75 @@ rtp_error_t uvgrtp::srtcp::decrypt(uint32_t ssrc, uint32_t seq, uint8_t *buffer,
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(remote_srtp_ctx_->enc_key, remote_srtp_ctx_->n_e, iv);
+    remote_srtp_ctx_->cipher->set_iv(iv);
 
     /* skip header and sender ssrc */
-    ctr.decrypt(&buffer[8], &buffer[8], size - 8 - UVG_AUTH_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH);
+    remote_srtp_ctx_->cipher->decrypt(&buffer[8], &buffer[8], size - 8 - UVG_AUTH_TAG_LENGTH - UVG_SRTCP_INDEX_LENGTH);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtcp::encrypt_aead(uint32_t packet_number, uint32_t ssrc, uint8_t *frame, size_t frame_size)
+{
+    /* see RFC 7714, section 9: the E flag and SRTCP index follow the authentication tag
+     * and, together with the first 8 bytes of the packet, are authenticated but not encrypted */
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    uint8_t *index                 = &frame[frame_size - UVG_SRTCP_INDEX_LENGTH];
+    uint8_t *tag                   = &frame[frame_size - UVG_SRTCP_INDEX_LENGTH - UVG_AEAD_TAG_LENGTH];
+    size_t len                     = frame_size - 8 - UVG_SRTCP_INDEX_LENGTH - UVG_AEAD_TAG_LENGTH;
+
+    SET_FIELD_32(index, 0, htonl((1u << 31) | packet_number));
+
+    if (create_aead_iv(iv, ssrc, packet_number & 0x7fffffff, local_srtp_ctx_->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTCP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    local_srtp_ctx_->aead->encrypt_start(iv);
+    local_srtp_ctx_->aead->encrypt_aad(frame, 8);
+    local_srtp_ctx_->aead->encrypt_aad(index, UVG_SRTCP_INDEX_LENGTH);
+    local_srtp_ctx_->aead->encrypt(&frame[8], &frame[8], len);
+    local_srtp_ctx_->aead->encrypt_final(tag, UVG_AEAD_TAG_LENGTH);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtcp::decrypt_aead(uint32_t ssrc, uint8_t *packet, size_t packet_size)
+{
+    if (packet_size < 8 + UVG_SRTCP_INDEX_LENGTH + UVG_AEAD_TAG_LENGTH) {
+        UVG_LOG_ERROR("Received SRTCP packet that has too small size");
+        return RTP_INVALID_VALUE;
+    }
+
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    uint8_t *index                 = &packet[packet_size - UVG_SRTCP_INDEX_LENGTH];
+    uint8_t *tag                   = &packet[packet_size - UVG_SRTCP_INDEX_LENGTH - UVG_AEAD_TAG_LENGTH];
+    size_t len                     = packet_size - 8 - UVG_SRTCP_INDEX_LENGTH - UVG_AEAD_TAG_LENGTH;
+    uint32_t srtcpi                = ntohl(*(uint32_t *)index);
+
+    if (!((srtcpi >> 31) & 0x1)) {
+        UVG_LOG_ERROR("Unencrypted SRTCP packets are not supported with AES-GCM");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (create_aead_iv(iv, ssrc, srtcpi & 0x7fffffff, remote_srtp_ctx_->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to decrypt the RTCP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    remote_srtp_ctx_->aead->decrypt_start(iv);
+    remote_srtp_ctx_->aead->decrypt_aad(packet, 8);
+    remote_srtp_ctx_->aead->decrypt_aad(index, UVG_SRTCP_INDEX_LENGTH);
+    remote_srtp_ctx_->aead->decrypt(&packet[8], &packet[8], len);
+
+    if (!remote_srtp_ctx_->aead->decrypt_verify(tag, UVG_AEAD_TAG_LENGTH)) {
+        UVG_LOG_ERROR("SRTCP authentication tag mismatch!");
+        return RTP_AUTH_TAG_MISMATCH;
+    }
+
+    if (is_replayed_packet(srtcpi & 0x7fffffff)) {
+        UVG_LOG_ERROR("Replayed packet received, discarding!");
+        return RTP_INVALID_VALUE;
+    }
+
     return RTP_OK;
 }
@@ -31,6 +31,10 @@ namespace uvgrtp {
 
         rtp_error_t add_auth_tag(uint8_t* buffer, size_t len);
         rtp_error_t verify_auth_tag(uint8_t* buffer, size_t len);
+
+        /* AEAD_AES_*_GCM variants of SRTCP protection, see RFC 7714, section 9 */
+        rtp_error_t encrypt_aead(uint32_t packet_number, uint32_t ssrc, uint8_t* frame, size_t frame_size);
+        rtp_error_t decrypt_aead(uint32_t ssrc, uint8_t* packet, size_t packet_size);
     };
 }
 
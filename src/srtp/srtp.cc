@@ -6,26 +6,65 @@
 #include "../crypto.hh"
 #include "base.hh"
 #include "global.hh"
+#include "../thread_pool.hh"
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <new>
 
 
 #define MAX_OFF 10000
 
+/* Upper limit for the number of packets whose keystream is precomputed */
+constexpr size_t MAX_KEYSTREAM_LOOKAHEAD = 1024;
+
+constexpr uint64_t KEYSTREAM_INDEX_UNKNOWN = UINT64_MAX;
+
 uvgrtp::srtp::srtp(int rce_flags):base_srtp(),
-      authenticate_rtp_(rce_flags& RCE_SRTP_AUTHENTICATE_RTP)
+      authenticate_rtp_(rce_flags& RCE_SRTP_AUTHENTICATE_RTP),
+      parallel_threshold_(0),
+      parallel_sets_(),
+      pool_(nullptr),
+      ks_slots_(),
+      ks_len_(0),
+      ks_next_(KEYSTREAM_INDEX_UNKNOWN),
+      ks_ssrc_(0),
+      ks_key_(),
+      ks_salt_(),
+      ks_key_size_(0),
+      ks_epoch_(0),
+      ks_stop_(false),
+      ks_mutex_(),
+      ks_cond_(),
+      ks_thread_(nullptr),
+      ks_hits_(0)
 {}
 
 uvgrtp::srtp::~srtp()
-{}
+{
+    stop_keystream();
+}
 
-rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer, size_t len)
+/* XOR "len" bytes of "input" with "keystream" eight bytes at a time so that the compiler can vectorize the loop */
+static void xor_keystream(uint8_t *output, const uint8_t *input, const uint8_t *keystream, size_t len)
 {
-    if (use_null_cipher_)
-        return RTP_OK;
+    size_t i = 0;
+
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t a, b;
+        memcpy(&a, &input[i], sizeof(a));
+        memcpy(&b, &keystream[i], sizeof(b));
+        a ^= b;
+        memcpy(&output[i], &a, sizeof(a));
+    }
 
-    uint8_t iv[UVG_IV_LENGTH] = { 0 };
+    for (; i < len; ++i)
+        output[i] = input[i] ^ keystream[i];
+}
+
+uint64_t uvgrtp::srtp::next_send_index(uint16_t seq)
+{
     uint64_t index = (((uint64_t)local_srtp_ctx_->roc) << 16) + seq;
 
     // Sequence number has wrapped around, update rollover Counter
@@ -35,13 +74,45 @@ rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint16_t seq, uint8_t *buffer,
         UVG_LOG_DEBUG("SRTP encryption rollover, rollovers so far: %lu", local_srtp_ctx_->roc);
     }
 
+    return index;
+}
+
+rtp_error_t uvgrtp::srtp::encrypt(uint32_t ssrc, uint64_t index, const std::pair<size_t, uint8_t *> *input,
+    size_t count, uint8_t *output, uvgrtp::crypto::aes::ctr& cipher)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i < count; ++i)
+        len += input[i].first;
+
+    if (keystream_slot *slot = take_keystream(ssrc, index, len)) {
+        size_t off = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            xor_keystream(output, input[i].second, &slot->data[off], input[i].first);
+            output += input[i].first;
+            off    += input[i].first;
+        }
+
+        release_keystream(slot);
+        ++ks_hits_;
+        return RTP_OK;
+    }
+
+    uint8_t iv[UVG_IV_LENGTH] = { 0 };
+
     if (create_iv(iv, ssrc, index, local_srtp_ctx_->salt_key) != RTP_OK) {
         UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
         return RTP_INVALID_VALUE;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(local_srtp_ctx_->enc_key, local_srtp_ctx_->n_e, iv);
-    ctr.encrypt(buffer, buffer, len);
+    /* the keystream continues from one buffer to the next */
+    cipher.set_iv(iv);
+
+    for (size_t i = 0; i < count; ++i) {
+        cipher.encrypt(output, input[i].second, input[i].first);
+        output += input[i].first;
+    }
 
     return RTP_OK;
 }
@@ -63,35 +134,56 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void* args, int rce_flags, uint8_t
         return RTP_GENERIC_ERROR;
     }
 
+    std::lock_guard<std::mutex> lock(remote_ctx->mutex);
+
+    if (srtp->use_aead())
+        return srtp->decrypt_aead(frame);
+
+    uint16_t seq          = frame->header.seq;
+    uint32_t ssrc         = frame->header.ssrc;
+    uint32_t ts           = frame->header.timestamp;
+    uint64_t index        = srtp->get_receive_index(seq, ts);
+
     /* Calculate authentication tag for the packet and compare it against the one we received */
     if (srtp->authenticate_rtp()) {
         uint8_t digest[10] = { 0 };
-        auto hmac_sha1     = uvgrtp::crypto::hmac::sha1(remote_ctx->auth_key, UVG_HMAC_KEY_LENGTH);
+        uint32_t roc       = (uint32_t)(index >> 16);
 
-        hmac_sha1.update(frame->dgram, frame->dgram_size - UVG_AUTH_TAG_LENGTH);
-        hmac_sha1.update((uint8_t *)&remote_ctx->roc, sizeof(remote_ctx->roc));
-        hmac_sha1.final((uint8_t *)digest, UVG_AUTH_TAG_LENGTH);
+        remote_ctx->auth->update(frame->dgram, frame->dgram_size - UVG_AUTH_TAG_LENGTH);
+        remote_ctx->auth->update((uint8_t *)&roc, sizeof(roc));
+        remote_ctx->auth->final((uint8_t *)digest, UVG_AUTH_TAG_LENGTH);
 
         if (memcmp(digest, &frame->dgram[frame->dgram_size - UVG_AUTH_TAG_LENGTH], UVG_AUTH_TAG_LENGTH)) {
             UVG_LOG_ERROR("Authentication tag mismatch!");
             return RTP_GENERIC_ERROR;
         }
 
-        if (srtp->is_replayed_packet(digest)) {
+        if (srtp->is_replayed_packet(index)) {
             UVG_LOG_ERROR("Replayed packet received, discarding!");
             return RTP_GENERIC_ERROR;
         }
         frame->payload_len -= UVG_AUTH_TAG_LENGTH;
     }
 
+    srtp->update_receive_roc(seq, ts);
+
     if (srtp->use_null_cipher())
         return RTP_PKT_NOT_HANDLED;
 
-    uint16_t seq          = frame->header.seq;
-    uint32_t ssrc         = frame->header.ssrc;
-    uint32_t ts           = frame->header.timestamp;
-    uint64_t index        = 0;
+    uint8_t iv[UVG_IV_LENGTH] = { 0 };
+    if (srtp->create_iv(iv, ssrc, index, remote_ctx->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+        return RTP_GENERIC_ERROR;
+    }
+
+    remote_ctx->cipher->set_iv(iv);
+    remote_ctx->cipher->decrypt(frame->payload, frame->payload, frame->payload_len);
+
+    return RTP_PKT_MODIFIED;
+}
 
+uint64_t uvgrtp::srtp::get_receive_index(uint16_t seq, uint32_t ts) const
+{
     /* as the sequence number approaches 0xffff and is close to wrapping around,
      * special care must be taken to use correct rollover counter as it's
      * possible that packets come out of order around this overflow boundary
@@ -103,72 +195,427 @@ rtp_error_t uvgrtp::srtp::recv_packet_handler(void* args, int rce_flags, uint8_t
      * because if the difference is more than 1, the input frame would be larger than 90 MB.
      *
      * Here the assumption is that the offset for an incorrectly ordered packet is at most 10k packets*/
-    if (ts == remote_ctx->rts && (uint16_t)(seq + MAX_OFF) < MAX_OFF)
-    {
-        index = (((uint64_t)remote_ctx->roc - 1) << 16) + seq;
-    }
-    else
+    if (ts == remote_srtp_ctx_->rts && (uint16_t)(seq + MAX_OFF) < MAX_OFF)
     {
-        index = (((uint64_t)remote_ctx->roc) << 16) + seq;
+        return (((uint64_t)remote_srtp_ctx_->roc - 1) << 16) + seq;
     }
 
+    return (((uint64_t)remote_srtp_ctx_->roc) << 16) + seq;
+}
+
+void uvgrtp::srtp::update_receive_roc(uint16_t seq, uint32_t ts)
+{
     /* Sequence number has wrapped around, update rollover Counter */
     if (seq == 0xffff) {
-        remote_ctx->roc++;
-        remote_ctx->rts = ts;
-        UVG_LOG_DEBUG("SRTP decryption rollover, rollovers so far: %lu", remote_ctx->roc);
+        remote_srtp_ctx_->roc++;
+        remote_srtp_ctx_->rts = ts;
+        UVG_LOG_DEBUG("SRTP decryption rollover, rollovers so far: %lu", remote_srtp_ctx_->roc);
     }
+}
 
-    uint8_t iv[UVG_IV_LENGTH] = { 0 };
-    if (srtp->create_iv(iv, ssrc, index, remote_ctx->salt_key) != RTP_OK) {
+rtp_error_t uvgrtp::srtp::encrypt_aead(uint32_t ssrc, uint64_t index, const buf_vec& buffers, size_t aad_count,
+    const std::pair<size_t, uint8_t *> *input, size_t count, uint8_t *output, uint8_t *tag,
+    uvgrtp::crypto::aes::gcm& aead)
+{
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+
+    if (create_aead_iv(iv, ssrc, index, local_srtp_ctx_->salt_key) != RTP_OK) {
         UVG_LOG_ERROR("Failed to create IV, unable to encrypt the RTP packet!");
+        return RTP_INVALID_VALUE;
+    }
+
+    /* the header and the header extension are authenticated, the payload is also encrypted */
+    aead.encrypt_start(iv);
+
+    for (size_t i = 0; i < aad_count; ++i)
+        aead.encrypt_aad(buffers[i].second, buffers[i].first);
+
+    for (size_t i = 0; i < count; ++i) {
+        aead.encrypt(output, input[i].second, input[i].first);
+        output += input[i].first;
+    }
+
+    aead.encrypt_final(tag, UVG_AEAD_TAG_LENGTH);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::srtp::decrypt_aead(uvgrtp::frame::rtp_frame* frame)
+{
+    if (frame->payload_len < UVG_AEAD_TAG_LENGTH || frame->dgram_size < frame->payload_len + frame->padding_len)
+    {
+        UVG_LOG_ERROR("Received SRTP packet that has too small size");
+        return RTP_GENERIC_ERROR;
+    }
+
+    uint16_t seq     = frame->header.seq;
+    uint32_t ts      = frame->header.timestamp;
+    uint64_t index   = get_receive_index(seq, ts);
+    size_t hdr_len   = frame->dgram_size - frame->payload_len - frame->padding_len;
+    size_t len       = frame->payload_len - UVG_AEAD_TAG_LENGTH;
+
+    uint8_t iv[UVG_AEAD_IV_LENGTH] = { 0 };
+    if (create_aead_iv(iv, frame->header.ssrc, index, remote_srtp_ctx_->salt_key) != RTP_OK) {
+        UVG_LOG_ERROR("Failed to create IV, unable to decrypt the RTP packet!");
+        return RTP_GENERIC_ERROR;
+    }
+
+    remote_srtp_ctx_->aead->decrypt_start(iv);
+    remote_srtp_ctx_->aead->decrypt_aad(frame->dgram, hdr_len);
+    remote_srtp_ctx_->aead->decrypt(frame->payload, frame->payload, len);
+
+    if (!remote_srtp_ctx_->aead->decrypt_verify(&frame->payload[len], UVG_AEAD_TAG_LENGTH)) {
+        UVG_LOG_ERROR("Authentication tag mismatch!");
         return RTP_GENERIC_ERROR;
     }
 
-    uvgrtp::crypto::aes::ctr ctr(remote_ctx->enc_key, remote_ctx->n_e, iv);
-    ctr.decrypt(frame->payload, frame->payload, frame->payload_len);
+    if (is_replayed_packet(index)) {
+        UVG_LOG_ERROR("Replayed packet received, discarding!");
+        return RTP_GENERIC_ERROR;
+    }
+
+    /* only an authenticated packet may move the rollover counter */
+    update_receive_roc(seq, ts);
+    frame->payload_len = len;
 
     return RTP_PKT_MODIFIED;
 }
 
-rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffers)
+rtp_error_t uvgrtp::srtp::protect(uvgrtp::buf_vec& buffers, uint64_t index, const cipher_set& cs)
 {
-    auto srtp       = (uvgrtp::srtp *)arg;
     auto frame      = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
-    auto local_ctx   = srtp->get_local_ctx();
-    auto off        = srtp->authenticate_rtp() ? 2 : 1;
-    auto data       = buffers.at(buffers.size() - off);
-    auto hmac_sha1  = uvgrtp::crypto::hmac::sha1(local_ctx->auth_key, UVG_HMAC_KEY_LENGTH);
+    size_t off      = (authenticate_rtp_ || use_aead_) ? 2 : 1;
+    uint32_t ssrc   = ntohl(frame->header.ssrc);
+    uint32_t roc    = (uint32_t)(index >> 16);
     rtp_error_t ret = RTP_OK;
 
-    if (srtp->use_null_cipher())
-        goto authenticate;
+    if (buffers.size() < off) {
+        UVG_LOG_ERROR("Invalid RTP packet!");
+        return RTP_INVALID_VALUE;
+    }
 
-    ret = srtp->encrypt(
-        ntohl(frame->header.ssrc),
-        ntohs(frame->header.seq),
-        data.second,
-        data.first
-    );
+    /* If the buffer before the tag is empty, it is the output buffer and the payload buffers are
+     * between it and the RTP header (and header extension). Otherwise it is the payload and it is
+     * encrypted in place. The frame queue reserves an output buffer for every packet, including
+     * single-buffer ones, so only packets built elsewhere take the in-place path */
+    size_t out        = buffers.size() - off;
+    size_t first      = (buffers[0].second[0] & (1 << 4)) ? 2 : 1;
+    bool out_of_place = buffers[out].first == 0 && out > first && !use_null_cipher_;
+    size_t count      = out_of_place ? out - first : 1;
+    auto input        = out_of_place ? &buffers[first] : &buffers[out];
+
+    if (use_aead_) {
+        ret = encrypt_aead(ssrc, index, buffers, out_of_place ? first : out, input, count,
+            buffers[out].second, buffers.back().second, *cs.aead);
+    }
+    else if (!use_null_cipher_) {
+        ret = encrypt(ssrc, index, input, count, buffers[out].second, *cs.cipher);
+    }
 
     if (ret != RTP_OK) {
         UVG_LOG_ERROR("Failed to encrypt RTP packet!");
         return ret;
     }
 
-authenticate:
-    if (!srtp->authenticate_rtp())
+    /* only the encrypted payload is sent */
+    if (out_of_place) {
+        for (size_t i = first; i < out; ++i)
+            buffers[out].first += buffers[i].first;
+
+        buffers.erase(buffers.begin() + first, buffers.begin() + out);
+    }
+
+    if (use_aead_ || !authenticate_rtp_)
         return RTP_OK;
 
+    /* the rollover counter of the packet, not the one after it, is authenticated (RFC 3711 Sec. 4.2) */
     for (size_t i = 0; i < buffers.size() - 1; ++i)
-        hmac_sha1.update((uint8_t *)buffers[i].second, buffers[i].first);
+        cs.auth->update((uint8_t *)buffers[i].second, buffers[i].first);
 
-    hmac_sha1.update((uint8_t *)&local_ctx->roc, sizeof(local_ctx->roc));
-    hmac_sha1.final((uint8_t *)buffers[buffers.size() - 1].second, UVG_AUTH_TAG_LENGTH);
+    cs.auth->update((uint8_t *)&roc, sizeof(roc));
+    cs.auth->final((uint8_t *)buffers[buffers.size() - 1].second, UVG_AUTH_TAG_LENGTH);
 
     return ret;
 }
 
+rtp_error_t uvgrtp::srtp::send_packet_handler(void *arg, uvgrtp::buf_vec& buffers)
+{
+    auto srtp      = (uvgrtp::srtp *)arg;
+    auto local_ctx = srtp->get_local_ctx();
+    auto frame     = (uvgrtp::frame::rtp_frame *)buffers.at(0).second;
+
+    std::lock_guard<std::mutex> lock(local_ctx->mutex);
+
+    return srtp->protect(buffers, srtp->next_send_index(ntohs(frame->header.seq)),
+        { local_ctx->cipher, local_ctx->auth, local_ctx->aead });
+}
+
+rtp_error_t uvgrtp::srtp::send_packets_handler(void *arg, uvgrtp::pkt_vec& packets)
+{
+    auto srtp         = (uvgrtp::srtp *)arg;
+    auto& pool        = srtp->pool_ ? *srtp->pool_ : uvgrtp::thread_pool::shared();
+    size_t threshold  = srtp->parallel_threshold_;
+    size_t slices     = pool.get_worker_count() + 1;
+
+    if (!threshold || packets.size() < threshold || slices == 1) {
+        for (auto& packet : packets) {
+            rtp_error_t ret = send_packet_handler(arg, packet);
+
+            if (ret != RTP_OK)
+                return ret;
+        }
+        return RTP_OK;
+    }
+
+    /* The context is locked until the whole transaction has been protected, so the indices and
+     * the cipher sets cannot change under the worker threads. The workers do not take the lock */
+    auto local_ctx = srtp->get_local_ctx();
+    std::lock_guard<std::mutex> lock(local_ctx->mutex);
+
+    /* The rollover counter depends on the order of the packets so the indices are assigned first */
+    std::vector<uint64_t> indices(packets.size());
+
+    for (size_t i = 0; i < packets.size(); ++i) {
+        auto frame = (uvgrtp::frame::rtp_frame *)packets[i].at(0).second;
+        indices[i] = srtp->next_send_index(ntohs(frame->header.seq));
+    }
+
+    while (srtp->parallel_sets_.size() < slices) {
+        cipher_set cs;
+
+        if (srtp->use_aead_) {
+            cs.aead = std::make_shared<uvgrtp::crypto::aes::gcm>(local_ctx->enc_key, local_ctx->n_e);
+        }
+        else {
+            cs.cipher = std::make_shared<uvgrtp::crypto::aes::ctr>(local_ctx->enc_key, local_ctx->n_e);
+            cs.auth   = std::make_shared<uvgrtp::crypto::hmac::sha1>(local_ctx->auth_key, UVG_HMAC_KEY_LENGTH);
+        }
+        srtp->parallel_sets_.push_back(cs);
+    }
+
+    /* Each thread protects a contiguous slice of the transaction with its own cipher set.
+     * The packets stay in their places so the transaction is sent in order */
+    size_t slice_size = (packets.size() + slices - 1) / slices;
+    std::atomic<bool> failed(false);
+
+    pool.parallel_for(slices, [&](size_t s) {
+        size_t begin = std::min(s * slice_size, packets.size());
+        size_t end   = std::min(begin + slice_size, packets.size());
+
+        for (size_t i = begin; i < end && !failed; ++i) {
+            if (srtp->protect(packets[i], indices[i], srtp->parallel_sets_[s]) != RTP_OK)
+                failed = true;
+        }
+    });
+
+    return failed ? RTP_INVALID_VALUE : RTP_OK;
+}
+
+void uvgrtp::srtp::set_parallel_threshold(size_t packets)
+{
+    parallel_threshold_ = packets;
+}
+
+size_t uvgrtp::srtp::get_parallel_threshold() const
+{
+    return parallel_threshold_;
+}
+
+void uvgrtp::srtp::set_thread_pool(std::shared_ptr<uvgrtp::thread_pool> pool)
+{
+    pool_ = pool;
+}
+
+rtp_error_t uvgrtp::srtp::set_keystream_lookahead(size_t packets, size_t packet_len)
+{
+    if (packets && (use_aead_ || use_null_cipher_)) {
+        UVG_LOG_ERROR("Keystream can only be precomputed for AES-CTR");
+        return RTP_INVALID_VALUE;
+    }
+
+    if (packets > MAX_KEYSTREAM_LOOKAHEAD || (packets && !packet_len)) {
+        UVG_LOG_ERROR("Invalid keystream lookahead: %zu packets of %zu bytes", packets, packet_len);
+        return RTP_INVALID_VALUE;
+    }
+
+    /* encrypt() only uses the slots while the context is locked, and the generator
+     * holds no slot once it has been stopped, so the old slots can then be freed */
+    std::lock_guard<std::mutex> send_lock(local_srtp_ctx_->mutex);
+
+    stop_keystream();
+
+    std::vector<keystream_slot> slots(packets);
+
+    for (auto& slot : slots) {
+        slot.data = std::unique_ptr<uint8_t[]>(new (std::nothrow) uint8_t[packet_len]);
+
+        if (!slot.data) {
+            UVG_LOG_ERROR("Failed to allocate %zu bytes of keystream", packets * packet_len);
+            return RTP_MEMORY_ERROR;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ks_mutex_);
+        ks_slots_ = std::move(slots);
+        ks_len_   = packet_len;
+        ks_next_  = KEYSTREAM_INDEX_UNKNOWN;
+        ks_stop_  = false;
+    }
+
+    if (packets)
+        ks_thread_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::srtp::generate_keystream, this));
+
+    return RTP_OK;
+}
+
+size_t uvgrtp::srtp::get_keystream_lookahead()
+{
+    std::lock_guard<std::mutex> lock(ks_mutex_);
+    return ks_slots_.size();
+}
+
+size_t uvgrtp::srtp::get_keystream_hits() const
+{
+    return ks_hits_;
+}
+
+void uvgrtp::srtp::stop_keystream()
+{
+    {
+        std::lock_guard<std::mutex> lock(ks_mutex_);
+        ks_stop_ = true;
+    }
+    ks_cond_.notify_all();
+
+    if (ks_thread_ && ks_thread_->joinable())
+        ks_thread_->join();
+
+    ks_thread_ = nullptr;
+}
+
+uvgrtp::srtp::keystream_slot *uvgrtp::srtp::take_keystream(uint32_t ssrc, uint64_t index, size_t len)
+{
+    std::lock_guard<std::mutex> lock(ks_mutex_);
+
+    if (ks_slots_.empty())
+        return nullptr;
+
+    /* the generator continues from the packet after this one */
+    if (ks_next_ == KEYSTREAM_INDEX_UNKNOWN || index >= ks_next_ || ssrc != ks_ssrc_) {
+        ks_next_ = index + 1;
+        ks_ssrc_ = ssrc;
+        ks_cond_.notify_one();
+    }
+
+    keystream_slot& slot = ks_slots_[index % ks_slots_.size()];
+
+    if (!slot.ready || slot.busy || slot.index != index || slot.ssrc != ssrc ||
+        slot.epoch != ks_epoch_ || len > ks_len_)
+        return nullptr;
+
+    slot.ready = false;
+    slot.busy  = true;
+
+    return &slot;
+}
+
+void uvgrtp::srtp::release_keystream(keystream_slot *slot)
+{
+    {
+        std::lock_guard<std::mutex> lock(ks_mutex_);
+        slot->busy = false;
+    }
+    ks_cond_.notify_one();
+}
+
+void uvgrtp::srtp::generate_keystream()
+{
+    std::unique_ptr<uvgrtp::crypto::aes::ctr> cipher;
+    uint8_t salt[UVG_SALT_LENGTH] = { 0 };
+    uint64_t cipher_epoch         = 0;
+
+    std::unique_lock<std::mutex> lock(ks_mutex_);
+
+    while (!ks_stop_) {
+        keystream_slot *slot = nullptr;
+
+        /* find the first of the next packets whose keystream is missing */
+        if (ks_key_size_ && ks_next_ != KEYSTREAM_INDEX_UNKNOWN) {
+            for (size_t i = 0; i < ks_slots_.size() && !slot; ++i) {
+                uint64_t index = ks_next_ + i;
+                auto& s        = ks_slots_[index % ks_slots_.size()];
+
+                if (s.busy || (s.ready && s.index == index && s.ssrc == ks_ssrc_ && s.epoch == ks_epoch_))
+                    continue;
+
+                s.index = index;
+                s.ssrc  = ks_ssrc_;
+                s.epoch = ks_epoch_;
+                s.ready = false;
+                s.busy  = true;
+                slot    = &s;
+            }
+        }
+
+        if (!slot) {
+            ks_cond_.wait(lock);
+            continue;
+        }
+
+        if (!cipher || cipher_epoch != ks_epoch_) {
+            cipher       = std::unique_ptr<uvgrtp::crypto::aes::ctr>(new uvgrtp::crypto::aes::ctr(ks_key_, ks_key_size_));
+            cipher_epoch = ks_epoch_;
+            memcpy(salt, ks_salt_, UVG_SALT_LENGTH);
+        }
+
+        size_t len = ks_len_;
+        lock.unlock();
+
+        /* the keystream is the encryption of zeros */
+        uint8_t iv[UVG_IV_LENGTH] = { 0 };
+        bool ok = create_iv(iv, slot->ssrc, slot->index, salt) == RTP_OK;
+
+        if (ok) {
+            memset(slot->data.get(), 0, len);
+            cipher->set_iv(iv);
+            cipher->encrypt(slot->data.get(), slot->data.get(), len);
+        }
+
+        lock.lock();
+        slot->busy  = false;
+        slot->ready = ok && slot->epoch == ks_epoch_;
+
+        if (!ok) {
+            UVG_LOG_ERROR("Failed to create IV, stopping keystream precomputation");
+            break;
+        }
+    }
+}
+
+void uvgrtp::srtp::keys_changed()
+{
+    /* a transaction being protected in parallel holds the lock of the context */
+    std::lock_guard<std::mutex> send_lock(local_srtp_ctx_->mutex);
+    parallel_sets_.clear();
+
+    std::lock_guard<std::mutex> lock(ks_mutex_);
+
+    if (local_srtp_ctx_->enc_key) {
+        ks_key_size_ = std::min(local_srtp_ctx_->n_e, sizeof(ks_key_));
+        memcpy(ks_key_, local_srtp_ctx_->enc_key, ks_key_size_);
+    }
+    memcpy(ks_salt_, local_srtp_ctx_->salt_key, UVG_SALT_LENGTH);
+
+    /* keystream of the old keys is never used */
+    ++ks_epoch_;
+
+    for (auto& slot : ks_slots_)
+        slot.ready = false;
+
+    ks_cond_.notify_one();
+}
+
 bool uvgrtp::srtp::authenticate_rtp() const
 {
     return authenticate_rtp_;
@@ -2,12 +2,19 @@
 
 #include "base.hh"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace uvgrtp {
 
     namespace frame {
         struct rtp_frame;
     }
 
+    class thread_pool;
+
     class srtp : public base_srtp {
         public:
             srtp(int rce_flags);
@@ -16,12 +23,112 @@ namespace uvgrtp {
             /* Decrypt the payload of an RTP packet and verify authentication tag (if enabled) */
             rtp_error_t recv_packet_handler(void* args, int rce_flags, uint8_t* read_ptr, size_t size, uvgrtp::frame::rtp_frame** out);
 
-            /* Encrypt the payload of an RTP packet and add authentication tag (if enabled) */
+            /* Encrypt the payload of an RTP packet and add authentication tag (if enabled)
+             *
+             * "buffers" holds the RTP header, the header extension block if the X bit is set,
+             * the payload and the authentication tag if there is one. If the buffer before the tag
+             * has zero length, it is the output buffer reserved for the payload: the payload buffers
+             * before it are encrypted into it in one pass and removed from "buffers" so the caller's
+             * memory is not modified. Otherwise the last buffer before the tag is encrypted in place */
             static rtp_error_t send_packet_handler(void *arg, buf_vec& buffers);
 
+            /* Same as send_packet_handler() for all packets of a transaction. If there are at least
+             * as many packets as the parallel threshold, they are split between the threads of the
+             * shared thread pool */
+            static rtp_error_t send_packets_handler(void *arg, pkt_vec& packets);
+
+            /* Protect transactions of at least "packets" packets with several threads, 0 disables */
+            void set_parallel_threshold(size_t packets);
+            size_t get_parallel_threshold() const;
+
+            /* Use "pool" instead of the shared thread pool for parallel protection, nullptr restores the shared one */
+            void set_thread_pool(std::shared_ptr<uvgrtp::thread_pool> pool);
+
+            /* Precompute the AES-CTR keystream of the next "packets" sent packets in a background thread
+             * so that encrypting them is only an XOR. Keystream is generated for payloads of at most
+             * "packet_len" bytes so at most "packets * packet_len" bytes are used. 0 packets disables
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the payloads are not encrypted with AES-CTR or the values are invalid
+             * Return RTP_MEMORY_ERROR if allocation fails */
+            rtp_error_t set_keystream_lookahead(size_t packets, size_t packet_len);
+            size_t get_keystream_lookahead();
+
+            /* Return the number of packets encrypted with precomputed keystream */
+            size_t get_keystream_hits() const;
+
+        protected:
+            /* The cipher sets of parallel protection are keyed again when they are needed next
+             * and the precomputed keystream is discarded */
+            void keys_changed() override;
+
         private:
-            /* TODO:  */
-            rtp_error_t encrypt(uint32_t ssrc, uint16_t seq, uint8_t* buffer, size_t len);
+            /* Cipher objects keyed with the local session keys. Each thread protecting packets needs its own */
+            struct cipher_set {
+                std::shared_ptr<uvgrtp::crypto::aes::ctr> cipher;
+                std::shared_ptr<uvgrtp::crypto::hmac::sha1> auth;
+                std::shared_ptr<uvgrtp::crypto::aes::gcm> aead;
+            };
+
+            /* Keystream of one future packet, see set_keystream_lookahead() */
+            struct keystream_slot {
+                uint64_t index  = 0;
+                uint32_t ssrc   = 0;
+                uint64_t epoch  = 0;
+                bool ready      = false; /* keystream has been generated for "index", "ssrc" and "epoch" */
+                bool busy       = false; /* keystream is being generated or used */
+                std::unique_ptr<uint8_t[]> data;
+            };
+
+            /* Return the slot holding the precomputed keystream for "len" bytes of the packet,
+             * or nullptr if it is not available. The slot must be given back with release_keystream() */
+            keystream_slot *take_keystream(uint32_t ssrc, uint64_t index, size_t len);
+            void release_keystream(keystream_slot *slot);
+
+            /* Keep generating keystream for the packets following the last sent one until stopped */
+            void generate_keystream();
+
+            void stop_keystream();
+
+            /* Return the packet index of the next sent packet and update the rollover counter
+             * if the sequence number wraps around. Packets must be given in order */
+            uint64_t next_send_index(uint16_t seq);
+
+            /* Encrypt and authenticate the packet in "buffers" whose packet index is "index" using "cs".
+             * See send_packet_handler() for the layout of "buffers"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the packet is invalid or IV creation fails */
+            rtp_error_t protect(buf_vec& buffers, uint64_t index, const cipher_set& cs);
+
+            /* Encrypt "count" buffers starting from "input" as one payload and write the result to "output",
+             * which may be the same as the input if there is only one buffer
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if IV creation fails */
+            rtp_error_t encrypt(uint32_t ssrc, uint64_t index, const std::pair<size_t, uint8_t *> *input,
+                size_t count, uint8_t *output, uvgrtp::crypto::aes::ctr& cipher);
+
+            /* Same as encrypt() but with AES-GCM. The "aad_count" first buffers of "buffers" are authenticated
+             * only and the authentication tag is written to "tag"
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if IV creation fails */
+            rtp_error_t encrypt_aead(uint32_t ssrc, uint64_t index, const buf_vec& buffers, size_t aad_count,
+                const std::pair<size_t, uint8_t *> *input, size_t count, uint8_t *output, uint8_t *tag,
+                uvgrtp::crypto::aes::gcm& aead);
+
+            /* Decrypt the payload of "frame" with AES-GCM and verify its authentication tag
+             *
+             * Return RTP_PKT_MODIFIED on success
+             * Return RTP_GENERIC_ERROR if the packet is invalid or its authentication tag does not match */
+            rtp_error_t decrypt_aead(uvgrtp::frame::rtp_frame* frame);
+
+            /* Return the packet index (ROC and sequence number) of a received packet */
+            uint64_t get_receive_index(uint16_t seq, uint32_t ts) const;
+
+            /* Update the rollover counter after a received packet has been accepted */
+            void update_receive_roc(uint16_t seq, uint32_t ts);
 
             /* Has RTP packet authentication been enabled? */
             bool authenticate_rtp() const;
@@ -32,6 +139,35 @@ namespace uvgrtp {
              * The authentication tag will occupy the last 8 bytes of the RTP packet */
             bool authenticate_rtp_;
 
+            std::atomic<size_t> parallel_threshold_;
+
+            /* One cipher set for each thread taking part in parallel protection, created when first needed.
+             * Protected by the mutex of the local context */
+            std::vector<cipher_set> parallel_sets_;
+
+            /* Thread pool set with set_thread_pool(), the shared one is used if this is nullptr */
+            std::shared_ptr<uvgrtp::thread_pool> pool_;
+
+            /* Keystream ring indexed by "packet index % ks_slots_.size()". Everything below
+             * is protected by "ks_mutex_" except the contents of busy slots */
+            std::vector<keystream_slot> ks_slots_;
+            size_t ks_len_;
+            uint64_t ks_next_; /* index of the packet following the last sent one, UINT64_MAX if unknown */
+            uint32_t ks_ssrc_;
+
+            /* Copies of the local session keys for the generator. "ks_epoch_" is incremented when they change */
+            uint8_t ks_key_[AES256_KEY_SIZE];
+            uint8_t ks_salt_[UVG_SALT_LENGTH];
+            size_t ks_key_size_;
+            uint64_t ks_epoch_;
+
+            bool ks_stop_;
+            std::mutex ks_mutex_;
+            std::condition_variable ks_cond_;
+            std::unique_ptr<std::thread> ks_thread_;
+
+            /* Packets encrypted with precomputed keystream, atomic because it is not protected by "ks_mutex_" */
+            std::atomic<size_t> ks_hits_;
     };
 }
 
@@ -0,0 +1,116 @@
+#include "thread_pool.hh"
+
+#include <algorithm>
+
+/* More workers do not help with memory-bound work such as start code lookup */
+constexpr size_t MAX_SHARED_WORKERS = 7;
+
+uvgrtp::thread_pool::thread_pool(size_t workers):
+    workers_(),
+    mutex_(),
+    work_cond_(),
+    done_cond_(),
+    batches_(),
+    stop_(false)
+{
+    for (size_t i = 0; i < workers; ++i)
+    {
+        workers_.emplace_back(&uvgrtp::thread_pool::worker, this);
+    }
+}
+
+uvgrtp::thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    work_cond_.notify_all();
+
+    for (auto& worker : workers_)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+}
+
+uvgrtp::thread_pool& uvgrtp::thread_pool::shared()
+{
+    static uvgrtp::thread_pool pool(
+        std::min((size_t)std::max(std::thread::hardware_concurrency(), 1u) - 1, MAX_SHARED_WORKERS)
+    );
+
+    return pool;
+}
+
+size_t uvgrtp::thread_pool::get_worker_count() const
+{
+    return workers_.size();
+}
+
+void uvgrtp::thread_pool::parallel_for(size_t count, const std::function<void(size_t)>& job)
+{
+    if (!count)
+        return;
+
+    auto b = std::make_shared<batch>();
+    b->job   = &job;
+    b->count = count;
+    b->next  = 0;
+    b->done  = 0;
+
+    if (count > 1 && !workers_.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batches_.push_back(b);
+        }
+        work_cond_.notify_all();
+    }
+
+    run_batch(*b);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    batches_.erase(std::remove(batches_.begin(), batches_.end(), b), batches_.end());
+    done_cond_.wait(lock, [&b] { return b->done == b->count; });
+}
+
+void uvgrtp::thread_pool::run_batch(batch& b)
+{
+    size_t index = 0;
+
+    while ((index = b.next++) < b.count)
+    {
+        (*b.job)(index);
+
+        if (++b.done == b.count)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_cond_.notify_all();
+        }
+    }
+}
+
+void uvgrtp::thread_pool::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        work_cond_.wait(lock, [this] { return stop_ || !batches_.empty(); });
+
+        if (stop_)
+            return;
+
+        /* keep a reference so the batch stays valid even if its caller removes it from the queue */
+        std::shared_ptr<batch> b = batches_.front();
+
+        lock.unlock();
+        run_batch(*b);
+        lock.lock();
+
+        /* every index of the batch has been taken */
+        if (!batches_.empty() && batches_.front() == b)
+            batches_.pop_front();
+    }
+}
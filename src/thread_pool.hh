@@ -0,0 +1,56 @@
+#pragma once
+
+#include "uvgrtp/util.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace uvgrtp {
+
+    /* Pool of worker threads for splitting CPU-heavy work of the sending thread.
+     *
+     * The calling thread takes part in the work so a pool without workers
+     * simply runs everything on the caller */
+    class thread_pool {
+        public:
+            thread_pool(size_t workers);
+            ~thread_pool();
+
+            /* Return the pool shared by all media streams of the process.
+             * It is created on the first call with one worker per additional CPU core */
+            static thread_pool& shared();
+
+            size_t get_worker_count() const;
+
+            /* Call "job" for every index 0 - "count - 1" using the workers and the
+             * calling thread. Return when all of them have finished */
+            void parallel_for(size_t count, const std::function<void(size_t)>& job);
+
+        private:
+            struct batch {
+                const std::function<void(size_t)> *job = nullptr;
+                size_t count = 0;
+                std::atomic<size_t> next;
+                std::atomic<size_t> done;
+            };
+
+            void worker();
+            void run_batch(batch& b);
+
+            std::vector<std::thread> workers_;
+
+            std::mutex mutex_;
+            std::condition_variable work_cond_;
+            std::condition_variable done_cond_;
+            std::deque<std::shared_ptr<batch>> batches_;
+            bool stop_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
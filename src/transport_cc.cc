@@ -0,0 +1,702 @@
+#include "transport_cc.hh"
+
+#include "uvgrtp/frame.hh"
+
+#include "header_extensions.hh"
+#include "debug.hh"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+constexpr size_t  HISTORY_MASK            = uvgrtp::TWCC_HISTORY_SIZE - 1;
+
+/* Receive deltas are expressed in multiples of 250 us and the reference time in multiples of 64 ms */
+constexpr int64_t DELTA_TICK_US           = 250;
+constexpr int64_t REFERENCE_TICKS         = 256;
+
+/* packet status symbols */
+constexpr uint8_t STATUS_NOT_RECEIVED     = 0;
+constexpr uint8_t STATUS_SMALL_DELTA      = 1;
+constexpr uint8_t STATUS_LARGE_DELTA      = 2;
+
+constexpr size_t  MAX_RUN_LENGTH          = 0x1fff;
+
+/* Packets sent within 5 ms of the first packet of a group belong to the same group */
+constexpr int64_t BURST_INTERVAL_US       = 5000;
+
+/* trendline estimator */
+constexpr size_t  TRENDLINE_WINDOW        = 20;
+constexpr double  SMOOTHING_COEFF         = 0.9;
+constexpr double  THRESHOLD_GAIN          = 4.0;
+constexpr size_t  MAX_DELTAS              = 60;
+
+/* overuse detector */
+constexpr double  INITIAL_THRESHOLD       = 12.5;
+constexpr double  THRESHOLD_UP            = 0.0087;
+constexpr double  THRESHOLD_DOWN          = 0.039;
+constexpr double  OVERUSE_TIME_MS         = 10;
+
+/* rate control */
+constexpr int64_t ACKED_WINDOW_US         = 500 * 1000;
+constexpr int64_t MIN_ACKED_WINDOW_US     = 100 * 1000;
+constexpr double  DECREASE_FACTOR         = 0.85;
+constexpr double  INCREASE_PER_SECOND     = 1.08;
+constexpr int64_t DECREASE_INTERVAL_US    = 200 * 1000;
+
+constexpr double  HIGH_LOSS               = 0.10;
+constexpr double  LOW_LOSS                = 0.02;
+constexpr int64_t LOSS_DECREASE_INTERVAL_US = 300 * 1000;
+
+uvgrtp::transport_cc::transport_cc(std::shared_ptr<uvgrtp::header_extensions> ext):
+    ext_(ext),
+    start_(uvgrtp::clock::hrc::now()),
+    sender_mutex_(),
+    sent_(TWCC_HISTORY_SIZE),
+    current_group_(),
+    previous_group_(),
+    accumulated_delay_ms_(0),
+    smoothed_delay_ms_(0),
+    first_arrival_us_(-1),
+    delay_history_(),
+    num_deltas_(0),
+    prev_trend_(0),
+    threshold_(INITIAL_THRESHOLD),
+    last_threshold_update_us_(-1),
+    time_over_using_ms_(-1),
+    overuse_counter_(0),
+    usage_(BW_USAGE::NORMAL),
+    acked_(),
+    acked_bytes_(0),
+    acked_bitrate_(0),
+    delay_based_bps_(TWCC_DEFAULT_START_KBPS * 1000.0),
+    loss_based_bps_(TWCC_DEFAULT_MAX_KBPS * 1000.0),
+    last_update_us_(-1),
+    last_decrease_us_(-1),
+    last_loss_decrease_us_(-1),
+    min_bps_(TWCC_DEFAULT_MIN_KBPS * 1000),
+    start_bps_(TWCC_DEFAULT_START_KBPS * 1000),
+    max_bps_(TWCC_DEFAULT_MAX_KBPS * 1000),
+    target_bps_(TWCC_DEFAULT_START_KBPS * 1000),
+    target_hook_(nullptr),
+    receiver_mutex_(),
+    received_(TWCC_HISTORY_SIZE),
+    receiver_initialized_(false),
+    next_report_seq_(0),
+    highest_seq_(0),
+    last_feedback_us_(0),
+    feedback_count_(0)
+{
+}
+
+uvgrtp::transport_cc::~transport_cc()
+{
+}
+
+int64_t uvgrtp::transport_cc::now_us() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(uvgrtp::clock::hrc::now() - start_).count();
+}
+
+void uvgrtp::transport_cc::packet_sent(uint16_t seq, size_t size)
+{
+    packet_sent(seq, size, now_us());
+}
+
+void uvgrtp::transport_cc::packet_sent(uint16_t seq, size_t size, int64_t send_time_us)
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+
+    sent_packet& packet = sent_[seq & HISTORY_MASK];
+    packet.send_us = send_time_us;
+    packet.size    = size;
+    packet.seq     = seq;
+}
+
+uint32_t uvgrtp::transport_cc::get_target_bitrate() const
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    return target_bps_;
+}
+
+uint32_t uvgrtp::transport_cc::get_pacing_rate() const
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    return (uint32_t)(target_bps_ * TWCC_PACING_FACTOR);
+}
+
+void uvgrtp::transport_cc::install_target_bitrate_hook(std::function<void(uint32_t)> hook)
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    target_hook_ = hook;
+}
+
+rtp_error_t uvgrtp::transport_cc::set_min_bitrate(ssize_t kbps)
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+
+    if (kbps <= 0 || (uint64_t)kbps * 1000 > start_bps_)
+        return RTP_INVALID_VALUE;
+
+    min_bps_    = (uint32_t)kbps * 1000;
+    target_bps_ = clamp_bitrate(target_bps_);
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::transport_cc::set_start_bitrate(ssize_t kbps)
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+
+    if (kbps <= 0 || (uint64_t)kbps * 1000 < min_bps_ || (uint64_t)kbps * 1000 > max_bps_)
+        return RTP_INVALID_VALUE;
+
+    start_bps_       = (uint32_t)kbps * 1000;
+    delay_based_bps_ = start_bps_;
+    target_bps_      = start_bps_;
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::transport_cc::set_max_bitrate(ssize_t kbps)
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+
+    if (kbps <= 0 || (uint64_t)kbps * 1000 < start_bps_ || kbps > UINT32_MAX / 1000)
+        return RTP_INVALID_VALUE;
+
+    max_bps_         = (uint32_t)kbps * 1000;
+    loss_based_bps_  = max_bps_;
+    target_bps_      = clamp_bitrate(target_bps_);
+    return RTP_OK;
+}
+
+uint32_t uvgrtp::transport_cc::get_min_bitrate() const
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    return min_bps_ / 1000;
+}
+
+uint32_t uvgrtp::transport_cc::get_start_bitrate() const
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    return start_bps_ / 1000;
+}
+
+uint32_t uvgrtp::transport_cc::get_max_bitrate() const
+{
+    std::lock_guard<std::mutex> lock(sender_mutex_);
+    return max_bps_ / 1000;
+}
+
+uint32_t uvgrtp::transport_cc::clamp_bitrate(double bps) const
+{
+    return (uint32_t)std::min(std::max(bps, (double)min_bps_), (double)max_bps_);
+}
+
+rtp_error_t uvgrtp::transport_cc::handle_feedback(const uint8_t *fci, size_t len)
+{
+    return handle_feedback(fci, len, now_us());
+}
+
+rtp_error_t uvgrtp::transport_cc::handle_feedback(const uint8_t *fci, size_t len, int64_t now)
+{
+    std::vector<packet_result> received;
+    std::function<void(uint32_t)> hook = nullptr;
+    uint32_t target = 0;
+    size_t lost     = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(sender_mutex_);
+
+        rtp_error_t ret = parse_feedback(fci, len, received, lost);
+
+        if (ret != RTP_OK)
+            return ret;
+
+        if (received.empty() && !lost)
+            return RTP_OK;
+
+        for (auto& packet : received) {
+            process_group_delay(packet);
+        }
+
+        update_acked_bitrate(received);
+        update_delay_based(now);
+        update_loss_based((double)lost / (double)(lost + received.size()), now);
+
+        target = clamp_bitrate(std::min(delay_based_bps_, loss_based_bps_));
+
+        if (target != target_bps_) {
+            target_bps_ = target;
+            hook        = target_hook_;
+        }
+    }
+
+    if (hook)
+        hook(target);
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::transport_cc::parse_feedback(const uint8_t *fci, size_t len,
+    std::vector<packet_result>& received, size_t& lost)
+{
+    if (!fci || len < 8)
+        return RTP_INVALID_VALUE;
+
+    uint16_t base  = ntohs(*(uint16_t *)&fci[0]);
+    uint16_t count = ntohs(*(uint16_t *)&fci[2]);
+    int32_t  ref   = (fci[4] << 16) | (fci[5] << 8) | fci[6];
+
+    /* the reference time is a signed 24-bit value */
+    if (ref & 0x800000)
+        ref -= 0x1000000;
+
+    std::vector<uint8_t> symbols;
+    symbols.reserve(count);
+
+    size_t pos = 8;
+
+    while (symbols.size() < count) {
+        if (pos + 2 > len)
+            return RTP_INVALID_VALUE;
+
+        uint16_t chunk = ntohs(*(uint16_t *)&fci[pos]);
+        pos += 2;
+
+        if (!(chunk & 0x8000)) {
+            /* run length chunk */
+            uint8_t symbol = (chunk >> 13) & 0x3;
+            size_t run     = std::min((size_t)(chunk & MAX_RUN_LENGTH), count - symbols.size());
+
+            symbols.insert(symbols.end(), run, symbol);
+        } else if (!(chunk & 0x4000)) {
+            /* status vector chunk with 14 one-bit symbols */
+            for (int i = 13; i >= 0 && symbols.size() < count; --i)
+                symbols.push_back((chunk >> i) & 0x1);
+        } else {
+            /* status vector chunk with 7 two-bit symbols */
+            for (int i = 6; i >= 0 && symbols.size() < count; --i)
+                symbols.push_back((chunk >> (2 * i)) & 0x3);
+        }
+    }
+
+    int64_t ticks = (int64_t)ref * REFERENCE_TICKS;
+
+    for (size_t i = 0; i < count; ++i) {
+        uint16_t seq = (uint16_t)(base + i);
+        const sent_packet& sent = sent_[seq & HISTORY_MASK];
+        bool known = sent.send_us >= 0 && sent.seq == seq;
+
+        switch (symbols[i]) {
+            case STATUS_NOT_RECEIVED:
+                if (known)
+                    ++lost;
+                continue;
+
+            case STATUS_SMALL_DELTA:
+                if (pos + 1 > len)
+                    return RTP_INVALID_VALUE;
+
+                ticks += fci[pos];
+                pos   += 1;
+                break;
+
+            case STATUS_LARGE_DELTA:
+                if (pos + 2 > len)
+                    return RTP_INVALID_VALUE;
+
+                ticks += (int16_t)ntohs(*(uint16_t *)&fci[pos]);
+                pos   += 2;
+                break;
+
+            default:
+                UVG_LOG_DEBUG("Invalid packet status symbol in transport-wide feedback");
+                return RTP_INVALID_VALUE;
+        }
+
+        if (known)
+            received.push_back({ sent.send_us, ticks * DELTA_TICK_US, sent.size });
+    }
+
+    return RTP_OK;
+}
+
+void uvgrtp::transport_cc::process_group_delay(const packet_result& packet)
+{
+    if (current_group_.first_send_us < 0) {
+        current_group_ = { packet.send_us, packet.send_us, packet.arrival_us };
+        return;
+    }
+
+    /* reordered in the network before the current group, ignore */
+    if (packet.send_us < current_group_.first_send_us)
+        return;
+
+    if (packet.send_us - current_group_.first_send_us <= BURST_INTERVAL_US) {
+        current_group_.last_send_us    = std::max(current_group_.last_send_us, packet.send_us);
+        current_group_.last_arrival_us = std::max(current_group_.last_arrival_us, packet.arrival_us);
+        return;
+    }
+
+    if (previous_group_.first_send_us >= 0) {
+        int64_t send_delta    = current_group_.last_send_us    - previous_group_.last_send_us;
+        int64_t arrival_delta = current_group_.last_arrival_us - previous_group_.last_arrival_us;
+
+        update_trendline((arrival_delta - send_delta) / 1000.0, current_group_.last_arrival_us, send_delta);
+    }
+
+    previous_group_ = current_group_;
+    current_group_  = { packet.send_us, packet.send_us, packet.arrival_us };
+}
+
+void uvgrtp::transport_cc::update_trendline(double delay_variation_ms, int64_t arrival_us, int64_t send_delta_us)
+{
+    num_deltas_ = std::min(num_deltas_ + 1, (size_t)1000);
+
+    accumulated_delay_ms_ += delay_variation_ms;
+    smoothed_delay_ms_     = SMOOTHING_COEFF * smoothed_delay_ms_ + (1 - SMOOTHING_COEFF) * accumulated_delay_ms_;
+
+    if (first_arrival_us_ < 0)
+        first_arrival_us_ = arrival_us;
+
+    delay_history_.push_back({ (arrival_us - first_arrival_us_) / 1000.0, smoothed_delay_ms_ });
+
+    if (delay_history_.size() > TRENDLINE_WINDOW)
+        delay_history_.pop_front();
+
+    double trend = prev_trend_;
+
+    /* least squares fit of the smoothed delay as a function of arrival time */
+    if (delay_history_.size() == TRENDLINE_WINDOW) {
+        double mean_x = 0;
+        double mean_y = 0;
+
+        for (auto& point : delay_history_) {
+            mean_x += point.first;
+            mean_y += point.second;
+        }
+
+        mean_x /= delay_history_.size();
+        mean_y /= delay_history_.size();
+
+        double numerator   = 0;
+        double denominator = 0;
+
+        for (auto& point : delay_history_) {
+            numerator   += (point.first - mean_x) * (point.second - mean_y);
+            denominator += (point.first - mean_x) * (point.first - mean_x);
+        }
+
+        if (denominator != 0)
+            trend = numerator / denominator;
+    }
+
+    double modified_trend = std::min(num_deltas_, MAX_DELTAS) * trend * THRESHOLD_GAIN;
+
+    if (modified_trend > threshold_) {
+        if (time_over_using_ms_ < 0)
+            time_over_using_ms_ = send_delta_us / 2000.0;
+        else
+            time_over_using_ms_ += send_delta_us / 1000.0;
+
+        ++overuse_counter_;
+
+        if (time_over_using_ms_ > OVERUSE_TIME_MS && overuse_counter_ > 1 && trend >= prev_trend_) {
+            time_over_using_ms_ = 0;
+            overuse_counter_    = 0;
+            usage_              = BW_USAGE::OVERUSING;
+        }
+    } else if (modified_trend < -threshold_) {
+        time_over_using_ms_ = -1;
+        overuse_counter_    = 0;
+        usage_              = BW_USAGE::UNDERUSING;
+    } else {
+        time_over_using_ms_ = -1;
+        overuse_counter_    = 0;
+        usage_              = BW_USAGE::NORMAL;
+    }
+
+    prev_trend_ = trend;
+    update_threshold(modified_trend, arrival_us);
+}
+
+void uvgrtp::transport_cc::update_threshold(double modified_trend, int64_t now)
+{
+    if (last_threshold_update_us_ < 0)
+        last_threshold_update_us_ = now;
+
+    double abs_trend = std::fabs(modified_trend);
+
+    /* do not let sudden spikes move the threshold */
+    if (abs_trend > threshold_ + 15) {
+        last_threshold_update_us_ = now;
+        return;
+    }
+
+    double k  = abs_trend < threshold_ ? THRESHOLD_DOWN : THRESHOLD_UP;
+    double dt = std::min((now - last_threshold_update_us_) / 1000.0, 100.0);
+
+    threshold_ += k * (abs_trend - threshold_) * dt;
+    threshold_  = std::min(std::max(threshold_, 6.0), 600.0);
+
+    last_threshold_update_us_ = now;
+}
+
+void uvgrtp::transport_cc::update_acked_bitrate(const std::vector<packet_result>& received)
+{
+    int64_t newest = acked_.empty() ? INT64_MIN : acked_.back().first;
+
+    for (auto& packet : received) {
+        acked_.push_back({ packet.arrival_us, packet.size });
+        acked_bytes_ += packet.size;
+        newest        = std::max(newest, packet.arrival_us);
+    }
+
+    while (!acked_.empty() && acked_.front().first < newest - ACKED_WINDOW_US) {
+        acked_bytes_ -= acked_.front().second;
+        acked_.pop_front();
+    }
+
+    if (acked_.size() < 2)
+        return;
+
+    int64_t window = std::max(newest - acked_.front().first, MIN_ACKED_WINDOW_US);
+    acked_bitrate_ = (uint32_t)(acked_bytes_ * 8 * 1000000.0 / window);
+}
+
+void uvgrtp::transport_cc::update_delay_based(int64_t now)
+{
+    if (last_update_us_ < 0)
+        last_update_us_ = now;
+
+    double elapsed = std::min((now - last_update_us_) / 1000000.0, 1.0);
+
+    switch (usage_) {
+        case BW_USAGE::OVERUSING:
+            /* decrease at most once per interval so that one congestion event is not counted many times */
+            if (last_decrease_us_ < 0 || now - last_decrease_us_ >= DECREASE_INTERVAL_US) {
+                double base = acked_bitrate_ ? acked_bitrate_ : delay_based_bps_;
+
+                delay_based_bps_  = std::min(delay_based_bps_, DECREASE_FACTOR * base);
+                last_decrease_us_ = now;
+            }
+            break;
+
+        case BW_USAGE::UNDERUSING:
+            /* the queues are draining, hold the rate until the delay stabilizes */
+            break;
+
+        case BW_USAGE::NORMAL: {
+            double increased = delay_based_bps_ * std::pow(INCREASE_PER_SECOND, elapsed);
+
+            /* do not increase far beyond what the network has actually delivered */
+            if (acked_bitrate_) {
+                double limit = 1.5 * acked_bitrate_ + 10000;
+
+                if (increased > limit)
+                    increased = std::max(limit, delay_based_bps_);
+            }
+
+            delay_based_bps_ = increased;
+            break;
+        }
+    }
+
+    delay_based_bps_ = clamp_bitrate(delay_based_bps_);
+    last_update_us_  = now;
+}
+
+void uvgrtp::transport_cc::update_loss_based(double loss_fraction, int64_t now)
+{
+    if (loss_fraction > HIGH_LOSS) {
+        if (last_loss_decrease_us_ < 0 || now - last_loss_decrease_us_ >= LOSS_DECREASE_INTERVAL_US) {
+            loss_based_bps_        = std::min(loss_based_bps_, (double)target_bps_) * (1 - 0.5 * loss_fraction);
+            last_loss_decrease_us_ = now;
+        }
+    } else if (loss_fraction < LOW_LOSS) {
+        loss_based_bps_ *= 1.05;
+    }
+
+    loss_based_bps_ = clamp_bitrate(loss_based_bps_);
+}
+
+bool uvgrtp::transport_cc::packet_received(const uvgrtp::frame::rtp_frame *frame)
+{
+    uint8_t id = ext_ ? ext_->get_id(RTP_EXT_TRANSPORT_WIDE_SEQ) : 0;
+    size_t len = 0;
+
+    if (!id)
+        return false;
+
+    const uint8_t *data = uvgrtp::frame::get_header_extension(frame, id, &len);
+
+    if (!data || len != 2)
+        return false;
+
+    return packet_received(ntohs(*(uint16_t *)data), now_us());
+}
+
+bool uvgrtp::transport_cc::packet_received(uint16_t seq, int64_t arrival_us)
+{
+    std::lock_guard<std::mutex> lock(receiver_mutex_);
+
+    int64_t unwrapped = seq;
+
+    if (!receiver_initialized_) {
+        receiver_initialized_ = true;
+        next_report_seq_      = seq;
+        highest_seq_          = seq;
+        last_feedback_us_     = arrival_us;
+    } else {
+        unwrapped = highest_seq_ + (int16_t)(seq - (uint16_t)highest_seq_);
+
+        /* already reported as lost */
+        if (unwrapped < next_report_seq_)
+            return false;
+
+        highest_seq_ = std::max(highest_seq_, unwrapped);
+
+        /* packets that no longer fit the history are not reported */
+        if (highest_seq_ - next_report_seq_ >= (int64_t)TWCC_HISTORY_SIZE)
+            next_report_seq_ = highest_seq_ - TWCC_HISTORY_SIZE + 1;
+    }
+
+    received_packet& packet = received_[(uint64_t)unwrapped & HISTORY_MASK];
+    packet.arrival_us = arrival_us;
+    packet.seq        = seq;
+
+    return arrival_us - last_feedback_us_ >= TWCC_FEEDBACK_INTERVAL_US ||
+        highest_seq_ - next_report_seq_ + 1 >= (int64_t)TWCC_MAX_FEEDBACK_PACKETS;
+}
+
+size_t uvgrtp::transport_cc::create_feedback(uint8_t *buffer, uint32_t sender_ssrc, uint32_t media_ssrc)
+{
+    std::lock_guard<std::mutex> lock(receiver_mutex_);
+
+    if (!buffer || !receiver_initialized_ || next_report_seq_ > highest_seq_)
+        return 0;
+
+    int64_t base = next_report_seq_;
+    size_t count = (size_t)std::min(highest_seq_ - base + 1, (int64_t)TWCC_MAX_FEEDBACK_PACKETS);
+
+    std::vector<uint8_t> symbols(count, STATUS_NOT_RECEIVED);
+    std::vector<int64_t> arrivals(count, -1);
+
+    for (size_t i = 0; i < count; ++i) {
+        const received_packet& packet = received_[(uint64_t)(base + i) & HISTORY_MASK];
+
+        if (packet.arrival_us >= 0 && packet.seq == (uint16_t)(base + i))
+            arrivals[i] = packet.arrival_us;
+    }
+
+    /* the first packet of the report has normally been received because the previous
+     * report ended at the highest received packet, unless the history has overflowed */
+    int64_t first_arrival  = -1;
+    int64_t latest_arrival = -1;
+
+    for (auto arrival : arrivals) {
+        if (arrival >= 0 && first_arrival < 0)
+            first_arrival = arrival;
+
+        latest_arrival = std::max(latest_arrival, arrival);
+    }
+
+    if (first_arrival < 0)
+        return 0;
+
+    int64_t reference = first_arrival / (DELTA_TICK_US * REFERENCE_TICKS);
+    int64_t prev      = reference * REFERENCE_TICKS;
+
+    size_t ptr = 20;
+    std::vector<int16_t> deltas(count, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (arrivals[i] < 0)
+            continue;
+
+        int64_t delta = arrivals[i] / DELTA_TICK_US - prev;
+
+        if (delta >= 0 && delta <= UINT8_MAX) {
+            symbols[i] = STATUS_SMALL_DELTA;
+        } else {
+            delta      = std::min(std::max(delta, (int64_t)INT16_MIN), (int64_t)INT16_MAX);
+            symbols[i] = STATUS_LARGE_DELTA;
+        }
+
+        deltas[i] = (int16_t)delta;
+        prev     += delta;
+    }
+
+    /* packet status chunks */
+    for (size_t i = 0; i < count;) {
+        size_t run = 1;
+
+        while (i + run < count && symbols[i + run] == symbols[i] && run < MAX_RUN_LENGTH)
+            ++run;
+
+        uint16_t chunk = 0;
+
+        if (run >= 14) {
+            chunk = (uint16_t)((symbols[i] << 13) | run);
+            i    += run;
+        } else {
+            bool one_bit = true;
+
+            for (size_t k = i; k < std::min(i + 14, count); ++k) {
+                if (symbols[k] == STATUS_LARGE_DELTA)
+                    one_bit = false;
+            }
+
+            if (one_bit) {
+                chunk = 0x8000;
+
+                for (size_t k = 0; k < 14 && i < count; ++k, ++i)
+                    chunk |= symbols[i] << (13 - k);
+            } else {
+                chunk = 0xc000;
+
+                for (size_t k = 0; k < 7 && i < count; ++k, ++i)
+                    chunk |= symbols[i] << (2 * (6 - k));
+            }
+        }
+
+        *(uint16_t *)&buffer[ptr] = htons(chunk);
+        ptr += 2;
+    }
+
+    /* receive deltas */
+    for (size_t i = 0; i < count; ++i) {
+        if (symbols[i] == STATUS_SMALL_DELTA) {
+            buffer[ptr++] = (uint8_t)deltas[i];
+        } else if (symbols[i] == STATUS_LARGE_DELTA) {
+            *(uint16_t *)&buffer[ptr] = htons((uint16_t)deltas[i]);
+            ptr += 2;
+        }
+    }
+
+    /* zero padding to a multiple of 32 bits */
+    while (ptr % 4)
+        buffer[ptr++] = 0;
+
+    buffer[0] = (2 << 6) | uvgrtp::frame::RTCP_RTPFB_TWCC;
+    buffer[1] = uvgrtp::frame::RTCP_FT_RTPFB;
+    *(uint16_t *)&buffer[2]  = htons((uint16_t)(ptr / 4 - 1));
+    *(uint32_t *)&buffer[4]  = htonl(sender_ssrc);
+    *(uint32_t *)&buffer[8]  = htonl(media_ssrc);
+    *(uint16_t *)&buffer[12] = htons((uint16_t)base);
+    *(uint16_t *)&buffer[14] = htons((uint16_t)count);
+    buffer[16] = (uint8_t)(reference >> 16);
+    buffer[17] = (uint8_t)(reference >>  8);
+    buffer[18] = (uint8_t)(reference >>  0);
+    buffer[19] = feedback_count_++;
+
+    next_report_seq_  = base + count;
+    last_feedback_us_ = std::max(last_feedback_us_, latest_arrival);
+
+    return ptr;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "uvgrtp/clock.hh"
+#include "uvgrtp/util.hh"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace uvgrtp {
+
+    namespace frame {
+        struct rtp_frame;
+    }
+
+    class header_extensions;
+
+    /* How many sent and received packets are remembered, must be a power of two */
+    constexpr size_t TWCC_HISTORY_SIZE           = 4096;
+
+    /* How often the receiver sends feedback and how many packets one feedback may report */
+    constexpr int64_t TWCC_FEEDBACK_INTERVAL_US  = 100 * 1000;
+    constexpr size_t TWCC_MAX_FEEDBACK_PACKETS   = 400;
+
+    /* RTPFB header, sender and media SSRC, the fixed part of the FCI and the worst case
+     * of one status chunk per packet and two-byte deltas */
+    constexpr size_t TWCC_MAX_FEEDBACK_SIZE      = 4 + 8 + 8 + 4 * TWCC_MAX_FEEDBACK_PACKETS;
+
+    constexpr uint32_t TWCC_DEFAULT_MIN_KBPS     = 30;
+    constexpr uint32_t TWCC_DEFAULT_START_KBPS   = 1000;
+    constexpr uint32_t TWCC_DEFAULT_MAX_KBPS     = 50000;
+
+    /* The pacer drains the queue faster than the target so that frames are not delayed by it */
+    constexpr double TWCC_PACING_FACTOR          = 2.5;
+
+    /* Transport-wide congestion control.
+     *
+     * The receiver records the arrival time of every packet carrying a transport-wide
+     * sequence number (RTP_EXT_TRANSPORT_WIDE_SEQ) and periodically reports them back
+     * in RTCP transport-wide feedback messages (RTPFB, FMT 15).
+     *
+     * The sender matches the feedback to the send times of its packets and estimates the
+     * available bandwidth in the same way as Google Congestion Control: the delay-based part
+     * fits a trendline to the accumulated one-way delay variation of packet groups and an
+     * adaptive threshold detects overuse, which drives an AIMD rate controller. The loss-based
+     * part lowers the rate when more than 10 % of the packets are lost. The target bitrate
+     * is the smaller of the two, and it is reported to the application and used by
+     * frame_queue to pace the outgoing packets.
+     *
+     * All functions taking a time in microseconds exist so that the estimator can be run
+     * against an emulated link, the other variants use the local clock. */
+    class transport_cc {
+        public:
+            transport_cc(std::shared_ptr<uvgrtp::header_extensions> ext);
+            ~transport_cc();
+
+            /* sender */
+
+            /* Remember the send time and size of the packet with transport-wide sequence number "seq" */
+            void packet_sent(uint16_t seq, size_t size);
+            void packet_sent(uint16_t seq, size_t size, int64_t send_time_us);
+
+            /* Process the FCI of a transport-wide feedback message and update the target bitrate
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the feedback is malformed */
+            rtp_error_t handle_feedback(const uint8_t *fci, size_t len);
+            rtp_error_t handle_feedback(const uint8_t *fci, size_t len, int64_t now_us);
+
+            /* Return the current target bitrate in bits per second */
+            uint32_t get_target_bitrate() const;
+
+            /* Return the rate at which the pacer sends packets in bits per second */
+            uint32_t get_pacing_rate() const;
+
+            void install_target_bitrate_hook(std::function<void(uint32_t)> hook);
+
+            /* Return RTP_INVALID_VALUE if the limits would not be in order min <= start <= max */
+            rtp_error_t set_min_bitrate(ssize_t kbps);
+            rtp_error_t set_start_bitrate(ssize_t kbps);
+            rtp_error_t set_max_bitrate(ssize_t kbps);
+
+            uint32_t get_min_bitrate() const;
+            uint32_t get_start_bitrate() const;
+            uint32_t get_max_bitrate() const;
+
+            /* receiver */
+
+            /* Record the arrival of "frame" if it carries a transport-wide sequence number
+             *
+             * Return true if a feedback message should be sent now */
+            bool packet_received(const uvgrtp::frame::rtp_frame *frame);
+            bool packet_received(uint16_t seq, int64_t arrival_us);
+
+            /* Write an RTCP transport-wide feedback message covering the packets received since the
+             * previous feedback to "buffer" which must hold at least TWCC_MAX_FEEDBACK_SIZE bytes
+             *
+             * Return the size of the message, 0 if there is nothing to report */
+            size_t create_feedback(uint8_t *buffer, uint32_t sender_ssrc, uint32_t media_ssrc);
+
+        private:
+            struct sent_packet {
+                int64_t send_us = -1;
+                size_t  size    = 0;
+                uint16_t seq    = 0;
+            };
+
+            struct received_packet {
+                int64_t arrival_us = -1;
+                uint16_t seq       = 0;
+            };
+
+            struct packet_result {
+                int64_t send_us;
+                int64_t arrival_us;
+                size_t  size;
+            };
+
+            struct packet_group {
+                int64_t first_send_us = -1;
+                int64_t last_send_us  = -1;
+                int64_t last_arrival_us = -1;
+            };
+
+            enum class BW_USAGE {
+                NORMAL,
+                OVERUSING,
+                UNDERUSING
+            };
+
+            int64_t now_us() const;
+
+            /* Parse the FCI into the results of the received packets, return the number of lost packets */
+            rtp_error_t parse_feedback(const uint8_t *fci, size_t len,
+                std::vector<packet_result>& received, size_t& lost);
+
+            void process_group_delay(const packet_result& packet);
+            void update_trendline(double delay_variation_ms, int64_t arrival_us, int64_t send_delta_us);
+            void update_threshold(double modified_trend, int64_t now_us);
+
+            void update_acked_bitrate(const std::vector<packet_result>& received);
+            void update_delay_based(int64_t now_us);
+            void update_loss_based(double loss_fraction, int64_t now_us);
+
+            uint32_t clamp_bitrate(double bps) const;
+
+            std::shared_ptr<uvgrtp::header_extensions> ext_;
+            uvgrtp::clock::hrc::hrc_t start_;
+
+            /* sender */
+            mutable std::mutex sender_mutex_;
+            std::vector<sent_packet> sent_;
+
+            packet_group current_group_;
+            packet_group previous_group_;
+
+            /* trendline estimator */
+            double accumulated_delay_ms_;
+            double smoothed_delay_ms_;
+            int64_t first_arrival_us_;
+            std::deque<std::pair<double, double>> delay_history_;
+            size_t num_deltas_;
+            double prev_trend_;
+
+            /* overuse detector */
+            double threshold_;
+            int64_t last_threshold_update_us_;
+            double time_over_using_ms_;
+            int overuse_counter_;
+            BW_USAGE usage_;
+
+            /* acknowledged bitrate over the last 500 ms of arrivals */
+            std::deque<std::pair<int64_t, size_t>> acked_;
+            size_t acked_bytes_;
+            uint32_t acked_bitrate_;
+
+            double delay_based_bps_;
+            double loss_based_bps_;
+            int64_t last_update_us_;
+            int64_t last_decrease_us_;
+            int64_t last_loss_decrease_us_;
+
+            uint32_t min_bps_;
+            uint32_t start_bps_;
+            uint32_t max_bps_;
+            uint32_t target_bps_;
+
+            std::function<void(uint32_t)> target_hook_;
+
+            /* receiver */
+            std::mutex receiver_mutex_;
+            std::vector<received_packet> received_;
+            bool receiver_initialized_;
+            int64_t next_report_seq_;    /* unwrapped sequence number of the first unreported packet */
+            int64_t highest_seq_;        /* highest unwrapped sequence number received */
+            int64_t last_feedback_us_;
+            uint8_t feedback_count_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -6,6 +6,7 @@
 #include "zrtp/dh_kxchng.hh"
 #include "zrtp/hello.hh"
 #include "zrtp/hello_ack.hh"
+#include "zrtp/key_pool.hh"
 
 #include "socket.hh"
 #include "crypto.hh"
@@ -30,7 +31,16 @@ using namespace uvgrtp::zrtp_msg;
 
 #define ZRTP_VERSION 110
 
-uvgrtp::zrtp::zrtp():
+/* CRC is the last word of a ZRTP packet. Hello and DHPart messages have variable length
+ * so their CRC is not necessarily at the offset of the crc field of the message struct */
+static uint32_t trailing_crc(const uint8_t *packet, size_t size)
+{
+    uint32_t crc = 0;
+    memcpy(&crc, packet + size - sizeof(crc), sizeof(crc));
+    return crc;
+}
+
+uvgrtp::zrtp::zrtp(std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool):
     initialized_(false),
     dh_finished_(false),
     remote_addr_(),
@@ -46,6 +56,7 @@ uvgrtp::zrtp::zrtp():
     conf1_(nullptr),
     conf2_(nullptr),
     confack_(nullptr),
+    key_pool_(key_pool),
     zrtp_busy_(false)
 {
     cctx_.sha256 = new uvgrtp::crypto::sha256;
@@ -56,6 +67,7 @@ uvgrtp::zrtp::~zrtp()
 {
     delete cctx_.sha256;
     delete cctx_.dh;
+    delete cctx_.ecdh;
 
     cleanup_session();
 }
@@ -149,9 +161,6 @@ void uvgrtp::zrtp::derive_key(const char *label, uint32_t key_len, uint8_t *out_
 
 void uvgrtp::zrtp::generate_secrets()
 {
-    cctx_.dh->generate_keys();
-    cctx_.dh->get_pk(session_.dh_ctx.public_key, 384);
-
     /* uvgRTP does not support Preshared mode (for now at least) so
      * there will be no shared secrets between the endpoints.
      *
@@ -163,10 +172,84 @@ void uvgrtp::zrtp::generate_secrets()
     uvgrtp::crypto::random::generate_random(session_.secrets.rpbx, 32);
 }
 
-void uvgrtp::zrtp::generate_shared_secrets_dh()
+uint32_t uvgrtp::zrtp::select_key_agreement()
+{
+    /* Remote uses the same rule if it is uvgRTP and if not, the responder follows the Commit anyway */
+    for (uint32_t type : SUPPORTED_KEY_AGREEMENTS) {
+        for (uint32_t remote : session_.capabilities.key_agreements) {
+            if (type == remote)
+                return type;
+        }
+    }
+
+    return DH3k;
+}
+
+rtp_error_t uvgrtp::zrtp::generate_keys()
 {
-    cctx_.dh->set_remote_pk(session_.dh_ctx.remote_public, 384);
-    cctx_.dh->get_shared_secret(session_.dh_ctx.dh_result, 384);
+    zrtp_dh_ctx_t& dh_ctx = session_.dh_ctx;
+
+    delete cctx_.ecdh;
+    cctx_.ecdh = nullptr;
+
+    /* Take a precomputed key pair from the pool of the context if one is ready */
+    switch (session_.key_agreement_type) {
+        case DH3k:
+        {
+            std::unique_ptr<uvgrtp::crypto::dh> pooled = key_pool_ ? key_pool_->take_dh() : nullptr;
+
+            if (pooled) {
+                delete cctx_.dh;
+                cctx_.dh = pooled.release();
+            } else {
+                cctx_.dh->generate_keys();
+            }
+
+            dh_ctx.pk_len     = sizeof(dh_ctx.public_key);
+            dh_ctx.result_len = sizeof(dh_ctx.dh_result);
+            cctx_.dh->get_pk(dh_ctx.public_key, dh_ctx.pk_len);
+            break;
+        }
+
+        case EC25:
+        case X255:
+        {
+            auto curve = (session_.key_agreement_type == EC25) ? uvgrtp::crypto::ecdh::P256 : uvgrtp::crypto::ecdh::X25519;
+            std::unique_ptr<uvgrtp::crypto::ecdh> pooled = key_pool_ ? key_pool_->take_ecdh(curve) : nullptr;
+
+            if (!pooled) {
+                pooled = std::unique_ptr<uvgrtp::crypto::ecdh>(new uvgrtp::crypto::ecdh(curve));
+                pooled->generate_keys();
+            }
+
+            cctx_.ecdh        = pooled.release();
+            dh_ctx.pk_len     = cctx_.ecdh->pk_len();
+            dh_ctx.result_len = cctx_.ecdh->ss_len();
+            cctx_.ecdh->get_pk(dh_ctx.public_key, dh_ctx.pk_len);
+            break;
+        }
+
+        default:
+            UVG_LOG_ERROR("ZRTP key agreement type %.4s is not supported", (const char *)&session_.key_agreement_type);
+            return RTP_NOT_SUPPORTED;
+    }
+
+    return RTP_OK;
+}
+
+rtp_error_t uvgrtp::zrtp::generate_shared_secrets_dh()
+{
+    if (cctx_.ecdh) {
+        cctx_.ecdh->set_remote_pk(session_.dh_ctx.remote_public, session_.dh_ctx.pk_len);
+
+        if (!cctx_.ecdh->get_shared_secret(session_.dh_ctx.dh_result, session_.dh_ctx.result_len)) {
+            UVG_LOG_ERROR("Remote sent an invalid ECDH public key");
+            return RTP_INVALID_VALUE;
+        }
+    } else {
+        cctx_.dh->set_remote_pk(session_.dh_ctx.remote_public, session_.dh_ctx.pk_len);
+        cctx_.dh->get_shared_secret(session_.dh_ctx.dh_result, session_.dh_ctx.result_len);
+    }
 
     /* Section 4.4.1.4, calculation of total_hash includes:
      *    - Hello   (responder)
@@ -207,7 +290,7 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     const char *kdf = "ZRTP-HMAC-KDF";
 
     cctx_.sha256->update((uint8_t *)&value,                    sizeof(value));              /* counter */
-    cctx_.sha256->update((uint8_t *)session_.dh_ctx.dh_result, sizeof(session_.dh_ctx.dh_result));
+    cctx_.sha256->update((uint8_t *)session_.dh_ctx.dh_result, session_.dh_ctx.result_len);
     cctx_.sha256->update((uint8_t *)kdf,                       13);
 
     if (session_.role == INITIATOR) {
@@ -239,6 +322,8 @@ void uvgrtp::zrtp::generate_shared_secrets_dh()
     derive_key("Responder ZRTP key", 128, session_.key_ctx.zrtp_keyr);
     derive_key("Initiator HMAC key", 256, session_.key_ctx.hmac_keyi);
     derive_key("Responder HMAC key", 256, session_.key_ctx.hmac_keyr);
+
+    return RTP_OK;
 }
 
 void uvgrtp::zrtp::generate_shared_secrets_msm()
@@ -314,7 +399,7 @@ rtp_error_t uvgrtp::zrtp::validate_session()
     if (RTP_INVALID_VALUE == verify_hash(
             (uint8_t *)hashes[2],
             (uint8_t *)session_.r_msg.hello.second,
-            81,
+            session_.r_msg.hello.first - 8 - 4,
             session_.hash_ctx.r_mac[3]
         ))
     {
@@ -407,7 +492,10 @@ rtp_error_t uvgrtp::zrtp::begin_session()
 
                 /* Copy interesting information from receiver's
                     * message buffer to remote capabilities struct for later use */
-                hello.parse_msg(hello_, session_, hello_len_);
+                if (hello.parse_msg(hello_, session_, hello_len_) != RTP_OK) {
+                    UVG_LOG_ERROR("Failed to parse ZRTP Hello");
+                    return RTP_INVALID_VALUE;
+                }
                 UVG_LOG_DEBUG("ZRTP Hello parsed");
                 if (session_.capabilities.version != ZRTP_VERSION) {
 
@@ -528,6 +616,9 @@ rtp_error_t uvgrtp::zrtp::init_session(int key_agreement)
                 session_.role = RESPONDER;
                 return RTP_OK;
             }
+
+            /* We remain the initiator so the key agreement of our Commit is used */
+            session_.key_agreement_type = key_agreement;
         }
         if (dh1_ || conf1_) {
             return RTP_OK;
@@ -563,8 +654,7 @@ rtp_error_t uvgrtp::zrtp::dh_part1()
 
             /* parse_msg() above extracted the public key of remote and saved it to session_.
                 * Now we must generate shared secrets (DHResult, total_hash, and s0) */
-            generate_shared_secrets_dh();
-            return RTP_OK;
+            return generate_shared_secrets_dh();
         }
 
         long int next_sendslot = i * interval;
@@ -604,7 +694,8 @@ rtp_error_t uvgrtp::zrtp::dh_part2(uvgrtp::zrtp_msg::dh_key_exchange* dh)
     UVG_LOG_DEBUG("DHPart1 parsed");
     /* parse_msg() above extracted the public key of remote and saved it to session_.
      * Now we must generate shared secrets (DHResult, total_hash, and s0) */
-    generate_shared_secrets_dh();
+    if ((ret = generate_shared_secrets_dh()) != RTP_OK)
+        return ret;
 
     uvgrtp::clock::hrc::hrc_t start = uvgrtp::clock::hrc::now();
     int interval = 150;
@@ -810,6 +901,15 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
         return ret;
     }
 
+    /* Select the key agreement type from the Hello messages and create our key pair for it */
+    const uint32_t key_agreement = select_key_agreement();
+    session_.key_agreement_type  = key_agreement;
+
+    if ((ret = generate_keys()) != RTP_OK)
+        return ret;
+
+    UVG_LOG_DEBUG("Using ZRTP key agreement type %.4s", (const char *)&key_agreement);
+
     /* After begin_session() we have remote's Hello message and we can craft
      * DHPart2 in the hopes that we're the Initiator.
      *
@@ -834,11 +934,19 @@ rtp_error_t uvgrtp::zrtp::init_dhm(uint32_t ssrc, std::shared_ptr<uvgrtp::socket
      *
      * init_session() will exchange the Commit messages and select roles for the
      * participants (initiator/responder) based on rules determined in RFC 6189 */
-    if ((ret = init_session(DH3k)) != RTP_OK) {
+    if ((ret = init_session(key_agreement)) != RTP_OK) {
         UVG_LOG_ERROR("Could not agree on ZRTP session parameters or roles of participants!");
         return ret;
     }
 
+    /* As the responder we must use the key agreement type of the initiator's Commit */
+    if (session_.role == RESPONDER && session_.key_agreement_type != key_agreement) {
+        UVG_LOG_DEBUG("Initiator chose ZRTP key agreement type %.4s", (const char *)&session_.key_agreement_type);
+
+        if ((ret = generate_keys()) != RTP_OK)
+            return ret;
+    }
+
     /* From this point on, the execution deviates because both parties have their own roles
      * and different message that they need to send in order to finalize the ZRTP connection */
     if (session_.role == INITIATOR) {
@@ -969,7 +1077,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
             //UVG_LOG_DEBUG("ZRTP Hello message received, verify CRC32!");
             zrtp_hello* hello = (zrtp_hello*)msg;
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, hello->crc)) {
+            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, trailing_crc(read_ptr, size))) {
                 return RTP_NOT_SUPPORTED;
             }
             if (hello_ != nullptr) {
@@ -1043,7 +1151,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
 
             zrtp_dh* dh = (zrtp_dh*)msg;
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, trailing_crc(read_ptr, size)))
                 return RTP_NOT_SUPPORTED;
 
             if (dh1_ != nullptr) {
@@ -1068,7 +1176,7 @@ rtp_error_t uvgrtp::zrtp::packet_handler(void* args, int rce_flags, uint8_t* rea
 
             zrtp_dh* dh = (zrtp_dh*)msg;
 
-            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, dh->crc))
+            if (!uvgrtp::crypto::crc32::verify_crc32(read_ptr, size - 4, trailing_crc(read_ptr, size)))
                 return RTP_NOT_SUPPORTED;
 
             if (dh2_ != nullptr) {
@@ -33,6 +33,8 @@ namespace uvgrtp {
         struct rtp_frame;
     }
 
+    class zrtp_key_pool;
+
     enum ZRTP_ROLE {
         INITIATOR,
         RESPONDER
@@ -40,7 +42,9 @@ namespace uvgrtp {
 
     class zrtp {
         public:
-            zrtp();
+            /* "key_pool" provides precomputed key pairs, if it is nullptr or empty
+             * the key pairs are generated during the handshake */
+            zrtp(std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool);
             ~zrtp();
 
             /* Initialize ZRTP for a multimedia session
@@ -125,12 +129,25 @@ namespace uvgrtp {
             /* Generate zid for this ZRTP instance. ZID is a unique, 96-bit long ID */
             void generate_zid();
 
-            /* Create private/public key pair and generate random values for retained secrets */
+            /* Generate random values for retained secrets */
             void generate_secrets();
 
+            /* Select the fastest key agreement type supported by both us and remote
+             * based on the parsed Hello message of remote */
+            uint32_t select_key_agreement();
+
+            /* Create private/public key pair for the key agreement type of the session
+             *
+             * Return RTP_OK on success
+             * Return RTP_NOT_SUPPORTED if the key agreement type is not supported */
+            rtp_error_t generate_keys();
+
             /* Calculate DHResult, total_hash, and s0
-             * according to rules defined in RFC 6189 for Diffie-Hellman mode*/
-            void generate_shared_secrets_dh();
+             * according to rules defined in RFC 6189 for Diffie-Hellman mode
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if the public key of remote is invalid */
+            rtp_error_t generate_shared_secrets_dh();
 
             /* Calculate shared secrets for Multistream Mode */
             void generate_shared_secrets_msm();
@@ -235,6 +252,10 @@ namespace uvgrtp {
 
             std::mutex state_mutex_;
             std::mutex busy_mutex_;
+
+            /* Precomputed key pairs of the context */
+            std::shared_ptr<uvgrtp::zrtp_key_pool> key_pool_;
+
             bool zrtp_busy_;
     };
 }
@@ -99,10 +99,15 @@ namespace uvgrtp {
             EC25 = 0x35324345,
             EC38 = 0x38334345,
             EC52 = 0x32354345,
+            X255 = 0x35353258,
             PRSH = 0x68737250,
             MULT = 0x746c754d
         };
 
+        /* Key agreement types supported by uvgRTP in the order of preference (fastest first).
+         * They are advertised in Hello and the first one that remote also supports is used */
+        constexpr uint32_t SUPPORTED_KEY_AGREEMENTS[] = { X255, EC25, DH3k };
+
         enum SAS_TYPES {
             B32  = 0x20323342,
             B256 = 0x36353242
@@ -161,12 +166,14 @@ namespace uvgrtp {
 
         class sha256;
         class dh;
+        class ecdh;
     }
 
     typedef struct zrtp_crypto_ctx {
         uvgrtp::crypto::hmac::sha256* hmac_sha256 = nullptr;
         uvgrtp::crypto::sha256* sha256 = nullptr;
         uvgrtp::crypto::dh* dh = nullptr;
+        uvgrtp::crypto::ecdh* ecdh = nullptr; /* used if key agreement is EC25 or X255 */
     } zrtp_crypto_ctx_t;
 
     typedef struct zrtp_secrets {
@@ -218,6 +225,11 @@ namespace uvgrtp {
 
         /* DHResult aka "remote_public ^ private_key mod p" (see src/crypto/crypto.cc) */
         uint8_t dh_result[384];
+
+        /* Lengths of the public keys and DHResult for the negotiated key agreement type,
+         * the buffers above are large enough for DH3k which has the largest keys */
+        size_t pk_len = 384;
+        size_t result_len = 384;
     } zrtp_dh_ctx_t;
 
     typedef struct zrtp_hash_ctx {
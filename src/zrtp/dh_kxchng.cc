@@ -26,11 +26,11 @@ uvgrtp::zrtp_msg::dh_key_exchange::dh_key_exchange(zrtp_session_t& session, int
 
     UVG_LOG_DEBUG("Create ZRTP DHPart%d message", part);
 
-    allocate_frame(sizeof(zrtp_dh));
+    /* The public key is shorter than the pk field unless the key agreement type is DH3k */
+    allocate_frame(sizeof(zrtp_dh) - sizeof(zrtp_dh::pk) + session.dh_ctx.pk_len);
     zrtp_dh* msg = (zrtp_dh*)frame_;
     set_zrtp_start(msg->msg_start, session, strs[part - 1][0]);
 
-    msg->crc = 0;
     memcpy(msg->hash,                session.hash_ctx.o_hash[1], 32);
 
     /* Calculate hashes for the secrets (as defined in Section 4.3.1)
@@ -41,41 +41,45 @@ uvgrtp::zrtp_msg::dh_key_exchange::dh_key_exchange(zrtp_session_t& session, int
     uint8_t mac_full[32];
 
     /* rs1IDr */
-    auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.rs1, 32);
-    hmac_sha256.update((uint8_t *)strs[part - 1][1], 9);
-    hmac_sha256.final(mac_full);
+    uvgrtp::crypto::hmac::sha256 rs1_hmac(session.secrets.rs1, 32);
+    rs1_hmac.update((uint8_t *)strs[part - 1][1], 9);
+    rs1_hmac.final(mac_full);
     memcpy(msg->rs1_id, mac_full, 8);
 
     /* rs2IDr */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.rs2, 32);
-    hmac_sha256.update((uint8_t *)strs[part - 1][1], 9);
-    hmac_sha256.final(mac_full);
+    uvgrtp::crypto::hmac::sha256 rs2_hmac(session.secrets.rs2, 32);
+    rs2_hmac.update((uint8_t *)strs[part - 1][1], 9);
+    rs2_hmac.final(mac_full);
     memcpy(msg->rs2_id, mac_full, 8);
 
     /* auxsecretIDr */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.raux, 32);
-    hmac_sha256.update(session.hash_ctx.o_hash[3], 32);
-    hmac_sha256.final(mac_full);
+    uvgrtp::crypto::hmac::sha256 aux_hmac(session.secrets.raux, 32);
+    aux_hmac.update(session.hash_ctx.o_hash[3], 32);
+    aux_hmac.final(mac_full);
     memcpy(msg->aux_secret, mac_full, 8);
 
     /* pbxsecretIDr */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.secrets.rpbx, 32);
-    hmac_sha256.update((uint8_t *)strs[part - 1][1], 9);
-    hmac_sha256.final(mac_full);
+    uvgrtp::crypto::hmac::sha256 pbx_hmac(session.secrets.rpbx, 32);
+    pbx_hmac.update((uint8_t *)strs[part - 1][1], 9);
+    pbx_hmac.final(mac_full);
     memcpy(msg->pbx_secret, mac_full, 8);
 
     /* public key */
-    memcpy(msg->pk, session.dh_ctx.public_key, sizeof(session.dh_ctx.public_key));
+    memcpy(msg->pk, session.dh_ctx.public_key, session.dh_ctx.pk_len);
+
+    /* MAC and CRC follow the public key */
+    uint8_t *trailer = (uint8_t *)frame_ + len_ - 8 - 4;
 
     /* Calculate truncated HMAC-SHA256 for the Commit Message */
-    hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[0], 32);
-    hmac_sha256.update((uint8_t *)frame_, len_ - 8 - 4);
-    hmac_sha256.final(mac_full);
+    uvgrtp::crypto::hmac::sha256 msg_hmac(session.hash_ctx.o_hash[0], 32);
+    msg_hmac.update((uint8_t *)frame_, len_ - 8 - 4);
+    msg_hmac.final(mac_full);
 
-    memcpy(msg->mac, mac_full, 8);
+    memcpy(trailer, mac_full, 8);
 
     /* Calculate CRC32 for the whole ZRTP packet */
-    msg->crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    memcpy(trailer + 8, &crc, sizeof(uint32_t));
 
     /* Finally make a copy of the message and save it for later use */
     if (session.l_msg.dh.second)
@@ -102,7 +106,12 @@ rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::parse_msg(uvgrtp::zrtp_msg::zrtp_
     allocate_rframe(sizeof(zrtp_dh));
     zrtp_dh* msg = dh;
 
-    memcpy(session.dh_ctx.remote_public, msg->pk, 384);
+    if (len != sizeof(zrtp_dh) - sizeof(zrtp_dh::pk) + session.dh_ctx.pk_len) {
+        UVG_LOG_ERROR("Length of DHPart1/DHPart2 message does not match the key agreement type!");
+        return RTP_INVALID_VALUE;
+    }
+
+    memcpy(session.dh_ctx.remote_public, msg->pk, session.dh_ctx.pk_len);
 
     /* Because uvgRTP only supports DH mode, the retained secrets sent in this
      * DHPartN message are not going to match our own so there not point in parsing them.
@@ -113,7 +122,7 @@ rtp_error_t uvgrtp::zrtp_msg::dh_key_exchange::parse_msg(uvgrtp::zrtp_msg::zrtp_
     session.secrets.s3 = nullptr;
 
     /* Save the MAC value so we can check if later */
-    memcpy(&session.hash_ctx.r_mac[1], &msg->mac, 8);
+    memcpy(&session.hash_ctx.r_mac[1], (uint8_t *)msg + len - 8 - 4, 8);
     memcpy(&session.hash_ctx.r_hash[1], msg->hash, 32);
 
     if (session.r_msg.dh.second)
@@ -30,7 +30,7 @@ namespace uvgrtp {
             uint8_t rs2_id[8];
             uint8_t aux_secret[8];
             uint8_t pbx_secret[8];
-            uint8_t pk[384];
+            uint8_t pk[384]; /* DH3k, EC25 and X255 keys are 384, 64 and 32 bytes, mac and crc follow the key */
             uint8_t mac[8];
             uint32_t crc = 0;
         });
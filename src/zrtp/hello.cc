@@ -21,13 +21,11 @@ uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     /* temporary storage for the full hmac hash */
     uint8_t mac_full[32];
 
-    /* We support only the mandatory algorithms etc. defined in RFC 6189
-     * so for us all the hash algos and key agreement types are set to zero 
-     *
-     * We need to assume that remote supports everything and thus need to
-     * allocate the maximum amount of memory for the message  */
+    /* We support only the mandatory hash, cipher, auth tag and SAS types defined in RFC 6189
+     * so their lists are empty. Our key agreement types are listed before the MAC */
+    const size_t kc = sizeof(SUPPORTED_KEY_AGREEMENTS) / sizeof(SUPPORTED_KEY_AGREEMENTS[0]);
 
-    allocate_frame(sizeof(zrtp_hello));
+    allocate_frame(sizeof(zrtp_hello) + sizeof(SUPPORTED_KEY_AGREEMENTS));
 
     zrtp_hello* msg = (zrtp_hello*)frame_;
 
@@ -46,19 +44,25 @@ uvgrtp::zrtp_msg::hello::hello(zrtp_session_t& session):
     msg->unused = 0;
     msg->hc     = 0;
     msg->ac     = 0;
-    msg->kc     = 0;
+    msg->kc     = kc;
     msg->sc     = 0;
 
-    /* Calculate MAC for the Hello message (only the ZRTP message part) */
+    memcpy(&msg->mac, SUPPORTED_KEY_AGREEMENTS, sizeof(SUPPORTED_KEY_AGREEMENTS));
+
+    /* Calculate MAC for the Hello message, it covers everything up to the MAC
+     * including the algorithm lists (same as Commit and DHPart) */
     auto hmac_sha256 = uvgrtp::crypto::hmac::sha256(session.hash_ctx.o_hash[2], 32);
 
-    hmac_sha256.update((uint8_t *)frame_, 81);
+    hmac_sha256.update((uint8_t *)frame_, len_ - 8 - 4);
     hmac_sha256.final(mac_full);
 
-    memcpy(&msg->mac, mac_full, sizeof(uint64_t));
+    /* MAC and CRC follow the algorithm lists */
+    uint8_t *trailer = (uint8_t *)frame_ + len_ - sizeof(uint64_t) - sizeof(uint32_t);
+    memcpy(trailer, mac_full, sizeof(uint64_t));
 
     /* Calculate CRC32 of the whole packet (excluding crc) */
-    msg->crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    uint32_t crc = uvgrtp::crypto::crc32::calculate_crc32((uint8_t *)frame_, len_ - sizeof(uint32_t));
+    memcpy(trailer + sizeof(uint64_t), &crc, sizeof(uint32_t));
 
     if (session.l_msg.hello.second)
     {
@@ -78,6 +82,12 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::zrtp_hello* hel
 {
     allocate_rframe(sizeof(zrtp_hello) + 5 * 8);
     zrtp_hello* msg = hello;
+    size_t count = msg->hc + msg->cc + msg->ac + msg->kc + msg->sc;
+
+    if (len < sizeof(zrtp_hello) + count * sizeof(uint32_t)) {
+        UVG_LOG_ERROR("ZRTP Hello is too short for its algorithm lists!");
+        return RTP_INVALID_VALUE;
+    }
 
     if (strncmp((const char*)&msg->version, ZRTP_VERSION, 4)) {
         UVG_LOG_ERROR("Invalid ZRTP version!");
@@ -87,6 +97,22 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::zrtp_hello* hel
         session.capabilities.version = 110;
     }
 
+    session.capabilities.hash_algos.clear();
+    session.capabilities.cipher_algos.clear();
+    session.capabilities.auth_tags.clear();
+    session.capabilities.key_agreements.clear();
+    session.capabilities.sas_types.clear();
+
+    /* The algorithm lists are in the order: hash, cipher, auth tag, key agreement, SAS.
+     * Only key agreement types are parsed because for others we support just the mandatory ones */
+    const uint8_t *algos = (const uint8_t *)&msg->mac;
+
+    for (size_t i = 0; i < msg->kc; ++i) {
+        uint32_t type = 0;
+        memcpy(&type, algos + (msg->hc + msg->cc + msg->ac + i) * sizeof(uint32_t), sizeof(uint32_t));
+        session.capabilities.key_agreements.push_back(type);
+    }
+
     /* finally add mandatory algorithms required by the specification to remote capabilities */
     session.capabilities.hash_algos.push_back(S256);
     session.capabilities.cipher_algos.push_back(AES1);
@@ -96,7 +122,7 @@ rtp_error_t uvgrtp::zrtp_msg::hello::parse_msg(uvgrtp::zrtp_msg::zrtp_hello* hel
     session.capabilities.sas_types.push_back(B32);
 
     /* Save the MAC value so we can check if later */
-    memcpy(&session.hash_ctx.r_mac[3], &msg->mac, 8);
+    memcpy(&session.hash_ctx.r_mac[3], algos + count * sizeof(uint32_t), 8);
     memcpy(&session.hash_ctx.r_hash[3], msg->hash, 32);
 
     /* Save ZID */
@@ -50,6 +50,9 @@ namespace uvgrtp {
             *  auth tag types
             *  Key Agreement Types
             *  SAS Types
+            *
+            * When they are present, mac and crc follow them
+            * and are not at the offsets of the fields below
             */
 
             uint64_t mac = 0;
@@ -0,0 +1,196 @@
+#include "key_pool.hh"
+
+#include "../debug.hh"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/* Each DH3k key pair takes tens of milliseconds to generate */
+constexpr size_t MAX_KEY_POOL_SIZE = 256;
+
+/* Key generation must not take CPU time from media processing */
+static void lower_thread_priority()
+{
+#if defined(_WIN32)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(SCHED_IDLE)
+    sched_param param = {};
+    param.sched_priority = 0;
+
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        UVG_LOG_DEBUG("Failed to lower the priority of the ZRTP key pool thread");
+    }
+#endif
+}
+
+/* Generate one key pair to "keys" if it has less than "size" key pairs.
+ * The lock is released for the duration of the generation
+ *
+ * Return true if a key pair was generated */
+template <typename T, typename... Args>
+static bool refill(std::unique_lock<std::mutex>& lock, std::deque<std::unique_ptr<T>>& keys,
+    const size_t& size, Args... args)
+{
+    if (keys.size() >= size)
+        return false;
+
+    lock.unlock();
+    auto key = std::unique_ptr<T>(new T(args...));
+    key->generate_keys();
+    lock.lock();
+
+    /* size may have been reduced in the meantime */
+    if (keys.size() < size)
+        keys.push_back(std::move(key));
+
+    return true;
+}
+
+template <typename T>
+static std::unique_ptr<T> take(std::deque<std::unique_ptr<T>>& keys)
+{
+    if (keys.empty())
+        return nullptr;
+
+    auto key = std::move(keys.front());
+    keys.pop_front();
+
+    return key;
+}
+
+uvgrtp::zrtp_key_pool::zrtp_key_pool():
+    size_(0),
+    taken_(0),
+    dh_(),
+    x25519_(),
+    p256_(),
+    stop_(false),
+    mutex_(),
+    cond_(),
+    thread_(nullptr)
+{
+}
+
+uvgrtp::zrtp_key_pool::~zrtp_key_pool()
+{
+    stop();
+}
+
+rtp_error_t uvgrtp::zrtp_key_pool::set_size(size_t keys)
+{
+    if (keys > MAX_KEY_POOL_SIZE) {
+        UVG_LOG_ERROR("ZRTP key pool size %zu is larger than the maximum %zu", keys, MAX_KEY_POOL_SIZE);
+        return RTP_INVALID_VALUE;
+    }
+
+    if (keys == 0) {
+        stop();
+        return RTP_OK;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_ = keys;
+
+    for (auto *pool : { &x25519_, &p256_ }) {
+        while (pool->size() > size_)
+            pool->pop_front();
+    }
+
+    while (dh_.size() > size_)
+        dh_.pop_front();
+
+    if (!thread_) {
+        stop_   = false;
+        thread_ = std::unique_ptr<std::thread>(new std::thread(&uvgrtp::zrtp_key_pool::generate, this));
+    }
+
+    cond_.notify_one();
+    return RTP_OK;
+}
+
+size_t uvgrtp::zrtp_key_pool::get_size()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+std::unique_ptr<uvgrtp::crypto::dh> uvgrtp::zrtp_key_pool::take_dh()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto key = take(dh_);
+    cond_.notify_one();
+
+    if (key)
+        ++taken_;
+
+    return key;
+}
+
+std::unique_ptr<uvgrtp::crypto::ecdh> uvgrtp::zrtp_key_pool::take_ecdh(uvgrtp::crypto::ecdh::curve curve)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto key = take((curve == uvgrtp::crypto::ecdh::P256) ? p256_ : x25519_);
+    cond_.notify_one();
+
+    if (key)
+        ++taken_;
+
+    return key;
+}
+
+size_t uvgrtp::zrtp_key_pool::get_ready_count()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dh_.size() + x25519_.size() + p256_.size();
+}
+
+size_t uvgrtp::zrtp_key_pool::get_taken_count()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return taken_;
+}
+
+void uvgrtp::zrtp_key_pool::generate()
+{
+    lower_thread_priority();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (!stop_) {
+        /* Fill the pools in the order of preference of the key agreement types
+         * so that the types most likely used are ready first */
+        if (refill(lock, x25519_, size_, uvgrtp::crypto::ecdh::X25519) ||
+            refill(lock, p256_,   size_, uvgrtp::crypto::ecdh::P256)   ||
+            refill(lock, dh_,     size_))
+            continue;
+
+        cond_.wait(lock);
+    }
+}
+
+void uvgrtp::zrtp_key_pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        size_ = 0;
+    }
+    cond_.notify_one();
+
+    if (thread_ && thread_->joinable())
+        thread_->join();
+
+    thread_ = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    dh_.clear();
+    x25519_.clear();
+    p256_.clear();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../crypto.hh"
+
+#include "uvgrtp/util.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace uvgrtp {
+
+    /* Precomputed ephemeral key pairs for the ZRTP sessions of a context.
+     *
+     * Key generation is the slowest part of a ZRTP handshake (especially DH3k),
+     * so a low-priority background thread keeps a number of fresh key pairs of
+     * every supported key agreement type ready. Each key pair is handed out only once */
+    class zrtp_key_pool {
+        public:
+            zrtp_key_pool();
+            ~zrtp_key_pool();
+
+            /* Set the number of key pairs kept ready per key agreement type.
+             * The background thread is started when the size becomes non-zero
+             * and stopped (discarding the remaining key pairs) when it is set to zero
+             *
+             * Return RTP_OK on success
+             * Return RTP_INVALID_VALUE if "keys" is larger than the maximum */
+            rtp_error_t set_size(size_t keys);
+            size_t get_size();
+
+            /* Take a key pair of the key agreement type from the pool
+             *
+             * Return nullptr if no key pair is ready, the caller must then generate its own */
+            std::unique_ptr<uvgrtp::crypto::dh> take_dh();
+            std::unique_ptr<uvgrtp::crypto::ecdh> take_ecdh(uvgrtp::crypto::ecdh::curve curve);
+
+            /* Return the number of key pairs of all types that are ready to be taken */
+            size_t get_ready_count();
+
+            /* Return the number of key pairs taken from the pool since it was created */
+            size_t get_taken_count();
+
+        private:
+            void generate();
+            void stop();
+
+            size_t size_;
+            size_t taken_;
+
+            std::deque<std::unique_ptr<uvgrtp::crypto::dh>> dh_;
+            std::deque<std::unique_ptr<uvgrtp::crypto::ecdh>> x25519_;
+            std::deque<std::unique_ptr<uvgrtp::crypto::ecdh>> p256_;
+
+            bool stop_;
+            std::mutex mutex_;
+            std::condition_variable cond_;
+            std::unique_ptr<std::thread> thread_;
+    };
+}
+
+namespace uvg_rtp = uvgrtp;
@@ -0,0 +1,215 @@
+/* Benchmark of the crypto backend: SRTP protection and unprotection of RTP packets,
+ * the cost of keying the SRTP cipher and HMAC for every packet versus once per context,
+ * and the time of a ZRTP handshake between two local streams.
+ *
+ * The backend is chosen when uvgRTP is configured, so compare backends by running
+ * this program in builds configured with -DUVGRTP_CRYPTO_BACKEND=cryptopp and =openssl */
+
+#include "../src/srtp/srtp.hh"
+#include "../src/crypto.hh"
+
+#include <uvgrtp/lib.hh>
+
+#include <arpa/inet.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+constexpr size_t PACKETS      = 20000;
+constexpr size_t PAYLOAD_SIZE = 1200;
+constexpr size_t HEADER_SIZE  = 12;
+constexpr int ZRTP_ROUNDS     = 5;
+
+constexpr char LOCAL_ADDRESS[] = "127.0.0.1";
+constexpr uint16_t ZRTP_PORT   = 9300;
+
+static double mbps(size_t bytes, std::chrono::steady_clock::duration d)
+{
+    return bytes * 8 / 1e6 / std::chrono::duration<double>(d).count();
+}
+
+static void benchmark_srtp(const char *name, int flags, size_t tag_len)
+{
+    uint8_t key[AES128_KEY_SIZE]  = { 1 };
+    uint8_t salt[UVG_SALT_LENGTH] = { 2 };
+
+    uvgrtp::srtp sender(flags);
+    uvgrtp::srtp receiver(flags);
+
+    if (sender.init(uvgrtp::SRTP, flags, key, key, salt, salt) != RTP_OK ||
+        receiver.init(uvgrtp::SRTP, flags, key, key, salt, salt) != RTP_OK) {
+        std::cout << name << ": SRTP initialization failed" << std::endl;
+        return;
+    }
+
+    size_t packet_size = HEADER_SIZE + PAYLOAD_SIZE + tag_len;
+    std::vector<uint8_t> packets(PACKETS * packet_size, 0xab);
+
+    for (size_t i = 0; i < PACKETS; ++i) {
+        uint8_t *packet = &packets[i * packet_size];
+        uint16_t seq    = htons((uint16_t)i);
+        uint32_t ssrc   = htonl(0x12345678);
+
+        packet[0] = 2 << 6;
+        packet[1] = 96;
+        memcpy(&packet[2], &seq, sizeof(seq));
+        memcpy(&packet[8], &ssrc, sizeof(ssrc));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < PACKETS; ++i) {
+        uint8_t *packet = &packets[i * packet_size];
+        uvgrtp::buf_vec buffers = { { HEADER_SIZE, packet }, { PAYLOAD_SIZE, packet + HEADER_SIZE } };
+
+        if (tag_len)
+            buffers.push_back({ tag_len, packet + HEADER_SIZE + PAYLOAD_SIZE });
+
+        if (uvgrtp::srtp::send_packet_handler(&sender, buffers) != RTP_OK) {
+            std::cout << name << ": encryption failed" << std::endl;
+            return;
+        }
+    }
+
+    auto encrypted = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < PACKETS; ++i) {
+        uvgrtp::frame::rtp_frame frame;
+        uvgrtp::frame::rtp_frame *out = &frame;
+
+        frame.header.seq       = (uint16_t)i;
+        frame.header.ssrc      = 0x12345678;
+        frame.header.timestamp = 0;
+        frame.dgram            = &packets[i * packet_size];
+        frame.dgram_size       = packet_size;
+        frame.payload          = frame.dgram + HEADER_SIZE;
+        frame.payload_len      = PAYLOAD_SIZE + tag_len;
+
+        if (receiver.recv_packet_handler(&receiver, flags, frame.dgram, packet_size, &out) != RTP_PKT_MODIFIED) {
+            std::cout << name << ": decryption failed" << std::endl;
+            return;
+        }
+    }
+
+    auto decrypted = std::chrono::steady_clock::now();
+
+    std::cout << name << ": encrypt " << mbps(PACKETS * PAYLOAD_SIZE, encrypted - start) << " Mbit/s, "
+              << "decrypt " << mbps(PACKETS * PAYLOAD_SIZE, decrypted - encrypted) << " Mbit/s" << std::endl;
+}
+
+/* AES-CM and HMAC-SHA1 of one packet, with the cipher and HMAC either created (and keyed)
+ * for the packet or created once and reused as the SRTP context does */
+static void benchmark_key_setup(bool per_packet)
+{
+    uint8_t key[AES128_KEY_SIZE]           = { 1 };
+    uint8_t auth_key[UVG_HMAC_KEY_LENGTH]  = { 2 };
+    uint8_t iv[UVG_IV_LENGTH]              = { 3 };
+    uint8_t tag[UVG_AUTH_TAG_LENGTH]       = { 0 };
+    std::vector<uint8_t> payload(PAYLOAD_SIZE, 0xab);
+
+    uvgrtp::crypto::aes::ctr cipher(key, sizeof(key));
+    uvgrtp::crypto::hmac::sha1 auth(auth_key, sizeof(auth_key));
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < PACKETS; ++i) {
+        memcpy(iv, &i, sizeof(uint16_t));
+
+        if (per_packet) {
+            uvgrtp::crypto::aes::ctr packet_cipher(key, sizeof(key), iv);
+            uvgrtp::crypto::hmac::sha1 packet_auth(auth_key, sizeof(auth_key));
+
+            packet_cipher.encrypt(payload.data(), payload.data(), payload.size());
+            packet_auth.update(payload.data(), payload.size());
+            packet_auth.final(tag, sizeof(tag));
+        }
+        else {
+            cipher.set_iv(iv);
+            cipher.encrypt(payload.data(), payload.data(), payload.size());
+            auth.update(payload.data(), payload.size());
+            auth.final(tag, sizeof(tag));
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "AES-CM + HMAC-SHA1 keyed " << (per_packet ? "per packet: " : "once: ")
+              << std::chrono::duration<double, std::micro>(elapsed).count() / PACKETS << " us per packet" << std::endl;
+}
+
+static void benchmark_zrtp(size_t key_pool)
+{
+    uvgrtp::context ctx;
+    std::chrono::steady_clock::duration total{};
+
+    if (key_pool) {
+        ctx.set_zrtp_key_pool_size(key_pool);
+
+        /* let the background thread fill the pool */
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+
+    for (int i = 0; i < ZRTP_ROUNDS; ++i) {
+        /* each endpoint of the handshake needs its own session */
+        uvgrtp::session *send_sess = ctx.create_session(LOCAL_ADDRESS, LOCAL_ADDRESS);
+        uvgrtp::session *recv_sess = ctx.create_session(LOCAL_ADDRESS, LOCAL_ADDRESS);
+        uvgrtp::media_stream *send = nullptr;
+        uvgrtp::media_stream *recv = nullptr;
+        uint16_t port              = (uint16_t)(ZRTP_PORT + 4 * i + (key_pool ? 2 * 4 * ZRTP_ROUNDS : 0));
+
+        auto start = std::chrono::steady_clock::now();
+
+        std::thread receiver([&] {
+            recv = recv_sess->create_stream(port + 2, port, RTP_FORMAT_GENERIC, RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP);
+        });
+        send = send_sess->create_stream(port, port + 2, RTP_FORMAT_GENERIC, RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP);
+        receiver.join();
+
+        total += std::chrono::steady_clock::now() - start;
+
+        bool ok = send && recv;
+
+        if (send)
+            send_sess->destroy_stream(send);
+        if (recv)
+            recv_sess->destroy_stream(recv);
+
+        ctx.destroy_session(send_sess);
+        ctx.destroy_session(recv_sess);
+
+        if (!ok) {
+            std::cout << "ZRTP handshake failed" << std::endl;
+            return;
+        }
+    }
+
+    std::cout << "ZRTP handshake" << (key_pool ? " with key pool: " : ": ")
+              << std::chrono::duration<double, std::milli>(total).count() / ZRTP_ROUNDS << " ms on average" << std::endl;
+}
+
+int main()
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled()) {
+        std::cout << "uvgRTP was built without crypto" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Crypto backend: " << UVGRTP_CRYPTO_BACKEND_NAME << ", " << PACKETS << " packets of "
+              << PAYLOAD_SIZE << " bytes" << std::endl;
+
+    benchmark_srtp("AES-CM", RCE_SRTP | RCE_SRTP_KMNGMNT_USER, 0);
+    benchmark_srtp("AES-CM + HMAC-SHA1", RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AUTHENTICATE_RTP, UVG_AUTH_TAG_LENGTH);
+    benchmark_srtp("AES-GCM", RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AEAD_GCM, UVG_AEAD_TAG_LENGTH);
+    benchmark_key_setup(true);
+    benchmark_key_setup(false);
+    benchmark_zrtp(0);
+    benchmark_zrtp(2 * ZRTP_ROUNDS);
+
+    return EXIT_SUCCESS;
+}
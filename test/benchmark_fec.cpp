@@ -0,0 +1,123 @@
+/* Benchmark of FlexFEC: the repair overhead, the share of lost media packets the receiver
+ * recovers and the CPU time of protecting and receiving packets for a few row and column
+ * layouts under independent random loss. Repair packets are lost with the same probability */
+
+#include "../src/fec.hh"
+#include "../src/rtp.hh"
+
+#include <uvgrtp/frame.hh>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+constexpr size_t MEDIA_PACKETS = 100000;
+constexpr size_t TRANSACTION   = 20;
+constexpr size_t PAYLOAD_SIZE  = 1200;
+
+struct fec_result {
+    size_t repair     = 0;
+    size_t lost       = 0;
+    size_t recovered  = 0;
+    double protect_us = 0;
+    double receive_us = 0;
+};
+
+static fec_result run_fec(ssize_t row_length, ssize_t column_depth, double loss)
+{
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(0x12345678);
+    auto rtp  = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC, ssrc, false);
+
+    uvgrtp::fec sender(rtp);
+    uvgrtp::fec receiver(rtp);
+    fec_result result;
+
+    (void)sender.set_row_length(row_length);
+    (void)sender.set_column_depth(column_depth);
+
+    std::mt19937 rng(1337);
+    std::bernoulli_distribution lose(loss);
+
+    std::vector<uvgrtp::frame::rtp_header> headers(TRANSACTION);
+    std::vector<uint8_t> payload(PAYLOAD_SIZE, 0xab);
+    std::vector<uint8_t> datagram;
+    std::chrono::steady_clock::duration protect_time(0);
+    std::chrono::steady_clock::duration receive_time(0);
+
+    for (size_t sent = 0; sent < MEDIA_PACKETS; sent += TRANSACTION) {
+        uvgrtp::pkt_vec packets;
+        std::vector<uint8_t *> storage;
+
+        for (size_t i = 0; i < TRANSACTION; ++i) {
+            rtp->fill_header((uint8_t *)&headers[i]);
+            rtp->inc_sequence();
+
+            packets.push_back({ { sizeof(headers[i]), (uint8_t *)&headers[i] }, { PAYLOAD_SIZE, payload.data() } });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        (void)sender.protect(packets, storage);
+        protect_time += std::chrono::steady_clock::now() - start;
+
+        result.repair += packets.size() - TRANSACTION;
+
+        for (size_t i = 0; i < packets.size(); ++i) {
+            if (lose(rng)) {
+                result.lost += (i < TRANSACTION);
+                continue;
+            }
+
+            datagram.clear();
+            for (auto& buffer : packets[i]) {
+                datagram.insert(datagram.end(), buffer.second, buffer.second + buffer.first);
+            }
+
+            start = std::chrono::steady_clock::now();
+
+            if (receiver.packet_handler(nullptr, 0, datagram.data(), datagram.size(), nullptr) == RTP_MULTIPLE_PKTS_READY) {
+                uint8_t *packet = nullptr;
+                size_t size = 0;
+
+                while (receiver.recovered_getter(&packet, &size) == RTP_PKT_READY)
+                    ;
+            }
+
+            receive_time += std::chrono::steady_clock::now() - start;
+        }
+
+        for (auto& mem : storage) {
+            delete[] mem;
+        }
+    }
+
+    result.recovered  = receiver.get_recovered_packets();
+    result.protect_us = std::chrono::duration<double, std::micro>(protect_time).count() / MEDIA_PACKETS;
+    result.receive_us = std::chrono::duration<double, std::micro>(receive_time).count() / MEDIA_PACKETS;
+
+    return result;
+}
+
+int main()
+{
+    std::vector<std::pair<ssize_t, ssize_t>> layouts = { { 10, 0 }, { 5, 0 }, { 10, 5 }, { 5, 4 } };
+
+    std::cout << "FEC of " << MEDIA_PACKETS << " media packets of " << PAYLOAD_SIZE << " bytes" << std::endl;
+
+    for (auto& layout : layouts) {
+        for (double loss : { 0.01, 0.05 }) {
+            fec_result r = run_fec(layout.first, layout.second, loss);
+
+            std::cout << "L " << layout.first << " D " << layout.second << ", loss " << loss * 100 << " %: "
+                      << "overhead " << 100.0 * r.repair / MEDIA_PACKETS << " %, "
+                      << "recovered " << r.recovered << " of " << r.lost << " lost ("
+                      << (r.lost ? 100.0 * r.recovered / r.lost : 100.0) << " %), "
+                      << "protect " << r.protect_us << " us/packet, "
+                      << "receive " << r.receive_us << " us/packet" << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+/* Benchmark of the media formats: the throughput of the start code lookup (SCL) implementations,
+ * the time SCL of large H.265 frames takes serially and split between the threads of the shared
+ * thread pool and the rate at which fragmented H.265 NAL units are reassembled */
+
+#include "../src/formats/h265.hh"
+#include "../src/formats/start_code.hh"
+#include "../src/rtp.hh"
+#include "../src/socket.hh"
+#include "../src/thread_pool.hh"
+
+#include <uvgrtp/lib.hh>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+/* compressed slice data rarely has zeros, there is a NAL unit boundary every 64 kB */
+constexpr size_t NAL_INTERVAL = 64 * 1000;
+
+static std::vector<uint8_t> create_frame(std::mt19937& rng, size_t frame_size)
+{
+    std::vector<uint8_t> frame(frame_size);
+
+    for (size_t i = 0; i < frame_size; ++i) {
+        frame[i] = (uint8_t)(1 + rng() % 255);
+    }
+
+    for (size_t i = 0; i + 4 <= frame_size; i += NAL_INTERVAL) {
+        frame[i] = frame[i + 1] = frame[i + 2] = 0;
+        frame[i + 3] = 1;
+    }
+
+    return frame;
+}
+
+static size_t count_start_codes(uvgrtp::formats::h265& format, uvgrtp::formats::start_code_finder find,
+    uint8_t *data, size_t len)
+{
+    size_t found = 0;
+    uint8_t start_len = 0;
+    ssize_t offset = find ? find(data, len, 0, start_len) : format.find_h26x_start_code_scalar(data, len, 0, start_len);
+
+    while (offset > -1) {
+        ++found;
+        offset = find ? find(data, len, (size_t)offset, start_len) :
+            format.find_h26x_start_code_scalar(data, len, (size_t)offset, start_len);
+    }
+
+    return found;
+}
+
+static void benchmark_scl_variants()
+{
+    std::shared_ptr<uvgrtp::rtp> rtp;
+    auto socket = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format = uvgrtp::formats::h265(socket, rtp, 0);
+
+    const size_t FRAME_SIZE = 16 * 1000 * 1000;
+    const int ROUNDS = 5;
+
+    std::mt19937 rng(1337);
+    std::vector<uint8_t> frame = create_frame(rng, FRAME_SIZE);
+
+    std::vector<uvgrtp::formats::start_code_variant> variants = {
+        { "scalar", nullptr }, { "bytewise", uvgrtp::formats::find_start_code_bytewise }
+    };
+
+    for (auto& variant : uvgrtp::formats::get_start_code_variants()) {
+        variants.push_back(variant);
+    }
+
+    for (auto& variant : variants) {
+        size_t found = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        for (int round = 0; round < ROUNDS; ++round) {
+            found = count_start_codes(format, variant.find, frame.data(), FRAME_SIZE);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (found != (FRAME_SIZE + NAL_INTERVAL - 4) / NAL_INTERVAL) {
+            std::cout << "SCL " << variant.name << " found " << found << " start codes, that is wrong" << std::endl;
+            return;
+        }
+
+        std::cout << "SCL " << variant.name << ": " << (FRAME_SIZE * ROUNDS / seconds / 1e9) << " GB/s" << std::endl;
+    }
+}
+
+static void benchmark_scl_parallel()
+{
+    std::shared_ptr<uvgrtp::rtp> rtp;
+    auto socket = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format = uvgrtp::formats::h265(socket, rtp, 0);
+
+    std::mt19937 rng(1337);
+
+    std::cout << "Parallel SCL with " << uvgrtp::thread_pool::shared().get_worker_count() + 1 << " threads" << std::endl;
+
+    for (size_t frame_size : { 1000 * 1000, 4 * 1000 * 1000, 16 * 1000 * 1000, 64 * 1000 * 1000 }) {
+        std::vector<uint8_t> frame = create_frame(rng, frame_size);
+        double ms[2] = { 0, 0 };
+
+        for (size_t threshold : { (size_t)0, (size_t)1 }) {
+            format.set_parallel_scl_threshold(threshold);
+
+            std::vector<uvgrtp::formats::nal_info> nals;
+            auto start = std::chrono::steady_clock::now();
+
+            format.find_nal_units(frame.data(), frame_size, nals);
+
+            ms[threshold] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (nals.size() != (frame_size + NAL_INTERVAL - 4) / NAL_INTERVAL) {
+                std::cout << "SCL found " << nals.size() << " NAL units, that is wrong" << std::endl;
+                return;
+            }
+        }
+
+        std::cout << "SCL of " << frame_size / 1000 << " kB frame: serial " << ms[0]
+                  << " ms, parallel " << ms[1] << " ms" << std::endl;
+    }
+}
+
+static uvgrtp::frame::rtp_frame* create_h265_fu(uint32_t ts, uint16_t seq, bool start, bool end, size_t payload_len)
+{
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(3 + payload_len);
+
+    frame->header.timestamp = ts;
+    frame->header.seq = seq;
+
+    frame->payload[0] = 49 << 1; // FU
+    frame->payload[1] = 1;
+    frame->payload[2] = (start ? 0x80 : 0) | (end ? 0x40 : 0) | 1; // TRAIL_R
+    memset(frame->payload + 3, (uint8_t)seq, payload_len);
+
+    return frame;
+}
+
+static void benchmark_h265_reassembly()
+{
+    auto socket = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto rtp = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H265, std::make_shared<std::atomic<std::uint32_t>>(1), false);
+    auto format = uvgrtp::formats::h265(socket, rtp, 0);
+
+    const size_t PACKETS = 1000 * 1000;
+    const size_t FRAGMENTS_PER_NAL = 10;
+    const size_t BATCH = 100;
+    const size_t FU_PAYLOAD = 1200;
+
+    std::vector<uvgrtp::frame::rtp_frame*> output;
+    size_t nal_units = 0;
+
+    /* each packet is created right before it is handled like rtp::packet_handler() does */
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < PACKETS; ++i) {
+        size_t index = i % FRAGMENTS_PER_NAL;
+        uvgrtp::frame::rtp_frame* out = create_h265_fu(uint32_t(i / FRAGMENTS_PER_NAL), uint16_t(i), index == 0,
+            index == FRAGMENTS_PER_NAL - 1, FU_PAYLOAD);
+
+        if (format.packet_handler(nullptr, RCE_NO_FLAGS, nullptr, 0, &out) == RTP_PKT_READY) {
+            output.push_back(out);
+        }
+
+        if (output.size() == BATCH) {
+            nal_units += output.size();
+            for (auto nal : output) {
+                (void)uvgrtp::frame::dealloc_frame(nal);
+            }
+            output.clear();
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    nal_units += output.size();
+    for (auto nal : output) {
+        (void)uvgrtp::frame::dealloc_frame(nal);
+    }
+
+    if (nal_units != PACKETS / FRAGMENTS_PER_NAL) {
+        std::cout << "H265 reassembly completed " << nal_units << " NAL units, that is wrong" << std::endl;
+        return;
+    }
+
+    std::cout << "H265 reassembly: " << (PACKETS / elapsed.count() / 1e6) << " million packets/s" << std::endl;
+}
+
+int main()
+{
+    /* the context initializes the sockets on Windows */
+    uvgrtp::context ctx;
+
+    benchmark_scl_variants();
+    benchmark_scl_parallel();
+    benchmark_h265_reassembly();
+
+    return EXIT_SUCCESS;
+}
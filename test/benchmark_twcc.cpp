@@ -0,0 +1,33 @@
+/* Benchmark of transport-wide congestion control on an emulated bottleneck link: how fast the
+ * target bitrate converges below the capacity, how much of the capacity it uses afterwards and
+ * how much queueing delay and loss it causes for a few capacities and propagation delays */
+
+#include "twcc_link_emulator.hh"
+
+#include <iostream>
+
+int main()
+{
+    std::cout << "Transport-wide congestion control on an emulated link, starting at twice the capacity" << std::endl;
+
+    for (int64_t capacity_kbps : { 500, 1000, 5000 }) {
+        for (int64_t propagation_ms : { 20, 50, 100 }) {
+            twcc_link link;
+
+            link.capacity_bps   = capacity_kbps * 1000;
+            link.propagation_us = propagation_ms * 1000;
+            link.start_kbps     = 2 * capacity_kbps;
+
+            twcc_link_result r = run_twcc_link_emulation(link);
+
+            std::cout << capacity_kbps << " kbps, " << propagation_ms << " ms: "
+                      << "converged in " << r.converged_us / 1000 << " ms, "
+                      << "average target " << r.average_target / 1000 << " kbps ("
+                      << 100.0 * r.average_target / link.capacity_bps << " %), "
+                      << "queueing delay " << r.average_delay << " ms, "
+                      << r.dropped << "/" << r.sent << " packets dropped" << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
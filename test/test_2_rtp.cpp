@@ -1,6 +1,11 @@
 #include "test_common.hh"
 #include <array>
 
+#include "../src/fec.hh"
+#include "../src/header_extensions.hh"
+#include "../src/jitter_buffer.hh"
+#include "../src/rtp.hh"
+
 /* TODO: 1) Test only sending, 2) test sending with different configuration, 3) test receiving with different configurations, and 
  * 4) test sending and receiving within same test while checking frame size */
 
@@ -757,4 +762,380 @@ TEST(RTPTests, uvgrtp_user_frames)
     cleanup_ms(sess, sender);
     cleanup_ms(sess, receiver);
     cleanup_sess(ctx, sess);
-}*/
\ No newline at end of file
+}*/
+
+TEST(RTPTests, fec_recovery)
+{
+    // Tests FlexFEC row and column recovery without the network
+    std::cout << "Starting FEC recovery test" << std::endl;
+
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(0x12345678);
+    auto rtp = std::shared_ptr<uvgrtp::rtp>(new uvgrtp::rtp(RTP_FORMAT_GENERIC, ssrc, false));
+    uvgrtp::fec sender(rtp);
+    uvgrtp::fec receiver(rtp);
+
+    EXPECT_EQ(RTP_OK, sender.set_row_length(5));
+    EXPECT_EQ(RTP_OK, sender.set_column_depth(4));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender.set_column_depth(1));
+
+    const size_t media_packets = 20;
+    std::vector<std::vector<uint8_t>> originals;
+    std::vector<uvgrtp::frame::rtp_header> headers(media_packets);
+    uvgrtp::pkt_vec packets;
+    std::vector<uint8_t*> storage;
+
+    for (size_t i = 0; i < media_packets; ++i) {
+        std::vector<uint8_t> payload(100 + i * 13);
+        for (size_t j = 0; j < payload.size(); ++j) {
+            payload[j] = (uint8_t)(i * 7 + j);
+        }
+
+        rtp->fill_header((uint8_t*)&headers[i]);
+        rtp->inc_sequence();
+        if (i % 4 == 3)
+            ((uint8_t*)&headers[i])[1] |= 0x80;
+
+        std::vector<uint8_t> original((uint8_t*)&headers[i], (uint8_t*)&headers[i] + sizeof(headers[i]));
+        original.insert(original.end(), payload.begin(), payload.end());
+        originals.push_back(original);
+    }
+
+    for (size_t i = 0; i < media_packets; ++i) {
+        packets.push_back({ { sizeof(headers[i]), (uint8_t*)&headers[i] },
+                            { originals[i].size() - sizeof(headers[i]), originals[i].data() + sizeof(headers[i]) } });
+    }
+
+    EXPECT_EQ(RTP_OK, sender.protect(packets, storage));
+
+    // 4 row repair packets and 5 column repair packets
+    EXPECT_EQ(media_packets + 4 + 5, packets.size());
+
+    // repair packets have an SSRC of their own and carry the protected SSRC as their only CSRC
+    for (size_t i = media_packets; i < packets.size(); ++i) {
+        uint8_t* repair = packets[i].at(0).second;
+
+        EXPECT_EQ(1, repair[0] & 0x0f);
+        EXPECT_EQ(sender.get_ssrc(), ntohl(*(uint32_t*)&repair[8]));
+        EXPECT_NE(rtp->get_ssrc(), ntohl(*(uint32_t*)&repair[8]));
+        EXPECT_EQ(rtp->get_ssrc(), ntohl(*(uint32_t*)&repair[12]));
+    }
+    EXPECT_EQ(RTP_INVALID_VALUE, sender.set_ssrc(rtp->get_ssrc()));
+
+    // lose one packet from a row and a burst of two packets that only columns can recover
+    std::set<size_t> lost = { 2, 10, 11 };
+    std::vector<std::vector<uint8_t>> recovered;
+
+    for (size_t i = 0; i < packets.size(); ++i) {
+        if (lost.find(i) != lost.end())
+            continue;
+
+        std::vector<uint8_t> datagram;
+        for (auto& buffer : packets[i]) {
+            datagram.insert(datagram.end(), buffer.second, buffer.second + buffer.first);
+        }
+
+        rtp_error_t ret = receiver.packet_handler(nullptr, 0, datagram.data(), datagram.size(), nullptr);
+
+        if (i < media_packets) {
+            EXPECT_EQ(RTP_PKT_NOT_HANDLED, ret);
+        }
+        else if (ret == RTP_MULTIPLE_PKTS_READY) {
+            uint8_t* packet = nullptr;
+            size_t size = 0;
+
+            while (receiver.recovered_getter(&packet, &size) == RTP_PKT_READY) {
+                recovered.push_back(std::vector<uint8_t>(packet, packet + size));
+            }
+        }
+    }
+
+    EXPECT_EQ(lost.size(), recovered.size());
+    EXPECT_EQ(lost.size(), receiver.get_recovered_packets());
+
+    for (auto& packet : recovered) {
+        uint16_t seq = ntohs(*(uint16_t*)&packet[2]);
+        uint16_t first = ntohs(*(uint16_t*)&originals[0][2]);
+        size_t index = (uint16_t)(seq - first);
+
+        EXPECT_TRUE(lost.find(index) != lost.end());
+        EXPECT_TRUE(packet == originals[index]);
+    }
+
+    for (auto& mem : storage) {
+        delete[] mem;
+    }
+}
+
+TEST(RTPTests, fec_late_media_packet)
+{
+    // Tests that a held repair packet is used when the media packet it was waiting for arrives late
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(0x12345678);
+    auto rtp = std::shared_ptr<uvgrtp::rtp>(new uvgrtp::rtp(RTP_FORMAT_GENERIC, ssrc, false));
+    uvgrtp::fec sender(rtp);
+    uvgrtp::fec receiver(rtp);
+
+    EXPECT_EQ(RTP_OK, sender.set_row_length(5));
+
+    const size_t media_packets = 5;
+    std::vector<uvgrtp::frame::rtp_header> headers(media_packets);
+    std::vector<uint8_t> payload(200, 0x5a);
+    uvgrtp::pkt_vec packets;
+    std::vector<uint8_t*> storage;
+
+    for (size_t i = 0; i < media_packets; ++i) {
+        rtp->fill_header((uint8_t*)&headers[i]);
+        rtp->inc_sequence();
+
+        packets.push_back({ { sizeof(headers[i]), (uint8_t*)&headers[i] }, { payload.size(), payload.data() } });
+    }
+
+    EXPECT_EQ(RTP_OK, sender.protect(packets, storage));
+    ASSERT_EQ(media_packets + 1, packets.size());
+
+    std::vector<std::vector<uint8_t>> datagrams;
+    for (auto& packet : packets) {
+        std::vector<uint8_t> datagram;
+        for (auto& buffer : packet) {
+            datagram.insert(datagram.end(), buffer.second, buffer.second + buffer.first);
+        }
+        datagrams.push_back(datagram);
+    }
+
+    // packets 1 and 2 are missing when the repair packet arrives, so it has to wait
+    for (size_t i : { 0, 3, 4, 5 }) {
+        receiver.packet_handler(nullptr, 0, datagrams[i].data(), datagrams[i].size(), nullptr);
+    }
+
+    uint8_t* packet = nullptr;
+    size_t size = 0;
+    EXPECT_EQ(RTP_NOT_FOUND, receiver.recovered_getter(&packet, &size));
+
+    // the late packet 2 is processed normally and completes the repair packet, which recovers packet 1
+    EXPECT_EQ(RTP_PKT_NOT_HANDLED, receiver.packet_handler(nullptr, 0, datagrams[2].data(), datagrams[2].size(), nullptr));
+    ASSERT_EQ(RTP_PKT_READY, receiver.recovered_getter(&packet, &size));
+    EXPECT_TRUE(std::vector<uint8_t>(packet, packet + size) == datagrams[1]);
+    EXPECT_EQ(1u, receiver.get_recovered_packets());
+
+    for (auto& mem : storage) {
+        delete[] mem;
+    }
+}
+
+static void check_header_extensions(uvgrtp::header_extensions& ext, uvgrtp::rtp& rtp, bool two_byte,
+    const std::vector<uint8_t>& app_data, uint8_t app_id)
+{
+    const size_t count = 3;
+    size_t block_size = ext.get_size();
+    ASSERT_GT(block_size, 0u);
+
+    std::vector<uvgrtp::frame::rtp_header> headers(count);
+    std::vector<uint8_t> blocks(block_size * count);
+    uint8_t payload[50] = { 0 };
+    uvgrtp::pkt_vec packets;
+
+    for (size_t i = 0; i < count; ++i) {
+        rtp.fill_header((uint8_t*)&headers[i]);
+        rtp.inc_sequence();
+        ((uint8_t*)&headers[i])[0] |= (1 << 4);
+        if (i == count - 1)
+            ((uint8_t*)&headers[i])[1] |= 0x80;
+
+        packets.push_back({ { sizeof(headers[i]), (uint8_t*)&headers[i] },
+                            { block_size, &blocks[i * block_size] },
+                            { sizeof(payload), payload } });
+    }
+
+    ext.write(packets, blocks.data(), block_size);
+
+    uint16_t first_seq = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<uint8_t> datagram;
+        for (auto& buffer : packets[i]) {
+            datagram.insert(datagram.end(), buffer.second, buffer.second + buffer.first);
+        }
+
+        EXPECT_EQ(two_byte ? 0x10 : 0xbe, datagram[12]);
+
+        uvgrtp::frame::rtp_frame* frame = nullptr;
+        ASSERT_EQ(RTP_PKT_MODIFIED, rtp.packet_handler(nullptr, 0, datagram.data(), datagram.size(), &frame));
+        EXPECT_EQ(nullptr, frame->ext);
+        EXPECT_EQ(sizeof(payload), frame->payload_len);
+
+        size_t len = 0;
+        const uint8_t* data = uvgrtp::frame::get_header_extension(frame, 1, &len);
+        ASSERT_NE(nullptr, data);
+        EXPECT_EQ(2u, len);
+        uint16_t seq = (data[0] << 8) | data[1];
+        if (i == 0)
+            first_seq = seq;
+        EXPECT_EQ((uint16_t)(first_seq + i), seq);
+
+        EXPECT_NE(nullptr, uvgrtp::frame::get_header_extension(frame, 2, &len));
+        EXPECT_EQ(3u, len);
+
+        data = uvgrtp::frame::get_header_extension(frame, 3, &len);
+        ASSERT_NE(nullptr, data);
+        EXPECT_EQ(1u, len);
+        EXPECT_EQ(i == 0, (data[0] & 0x80) != 0);
+        EXPECT_EQ(i == count - 1, (data[0] & 0x40) != 0);
+
+        data = uvgrtp::frame::get_header_extension(frame, app_id, &len);
+        ASSERT_NE(nullptr, data);
+        EXPECT_TRUE(std::vector<uint8_t>(data, data + len) == app_data);
+
+        EXPECT_EQ(nullptr, uvgrtp::frame::get_header_extension(frame, 9, &len));
+
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+}
+
+TEST(RTPTests, header_extensions)
+{
+    // Tests writing and parsing of RFC 8285 header extensions without the network
+    std::cout << "Starting header extension test" << std::endl;
+
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(0x12345678);
+    uvgrtp::rtp rtp(RTP_FORMAT_GENERIC, ssrc, false);
+    uvgrtp::header_extensions ext;
+
+    EXPECT_EQ(0u, ext.get_size());
+    EXPECT_EQ(RTP_INVALID_VALUE, ext.register_extension(RTP_EXT_TRANSPORT_WIDE_SEQ, 0));
+    EXPECT_EQ(RTP_OK, ext.register_extension(RTP_EXT_TRANSPORT_WIDE_SEQ, 1));
+    EXPECT_EQ(RTP_INVALID_VALUE, ext.register_extension(RTP_EXT_TRANSPORT_WIDE_SEQ, 4));
+    EXPECT_EQ(RTP_OK, ext.register_extension(RTP_EXT_ABS_SEND_TIME, 2));
+    EXPECT_EQ(RTP_OK, ext.register_extension(RTP_EXT_FRAME_MARKING, 3));
+    EXPECT_EQ(RTP_INVALID_VALUE, ext.register_extension(RTP_EXT_APPLICATION, 3));
+    EXPECT_EQ(RTP_OK, ext.register_extension(RTP_EXT_APPLICATION, 4));
+
+    // one-byte form
+    std::vector<uint8_t> app_data = { 1, 2, 3, 4, 5 };
+    EXPECT_EQ(RTP_NOT_SUPPORTED, ext.set_extension_data(1, app_data.data(), app_data.size()));
+    EXPECT_EQ(RTP_OK, ext.set_extension_data(4, app_data.data(), app_data.size()));
+    check_header_extensions(ext, rtp, false, app_data, 4);
+
+    // an element longer than 16 bytes requires the two-byte form
+    app_data.resize(30, 0xab);
+    EXPECT_EQ(RTP_OK, ext.set_extension_data(4, app_data.data(), app_data.size()));
+    check_header_extensions(ext, rtp, true, app_data, 4);
+}
+
+
+static uvgrtp::frame::rtp_frame* create_jitter_frame(uint32_t ts, uint16_t seq)
+{
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame();
+    frame->header.ssrc = 0x12345678;
+    frame->header.timestamp = ts;
+    frame->header.seq = seq;
+    return frame;
+}
+
+static uint32_t pop_jitter_frame(uvgrtp::jitter_buffer& jb, int64_t now_us)
+{
+    uvgrtp::frame::rtp_frame* frame = jb.pop(now_us);
+    if (!frame)
+        return UINT32_MAX;
+
+    uint32_t ts = frame->header.timestamp;
+    (void)uvgrtp::frame::dealloc_frame(frame);
+    return ts;
+}
+
+TEST(RTPTests, jitter_buffer)
+{
+    // Tests the reordering and playout schedule of the jitter buffer with an emulated clock
+    std::cout << "Starting jitter buffer test" << std::endl;
+
+    auto ssrc = std::make_shared<std::atomic<std::uint32_t>>(0x12345678);
+    auto rtp = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H265, ssrc, false);
+    uvgrtp::jitter_buffer jb(rtp, nullptr);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, jb.set_min_delay(-1));
+    EXPECT_EQ(RTP_INVALID_VALUE, jb.set_min_delay(uvgrtp::JITTER_BUFFER_DEFAULT_MAX_DELAY_MS + 1));
+    EXPECT_EQ(RTP_INVALID_VALUE, jb.set_late_policy(2));
+    EXPECT_EQ(RTP_OK, jb.set_min_delay(20));
+    EXPECT_EQ(RTP_INVALID_VALUE, jb.set_max_delay(19));
+    EXPECT_EQ(-1, jb.time_to_next_playout(0));
+
+    // 900 ticks is 10 ms at 90 kHz, the frame of 10 ms arrives after the frame of 20 ms
+    jb.push(create_jitter_frame(0, 0), 0);
+    jb.push(create_jitter_frame(1800, 2), 20000);
+    EXPECT_EQ(20000, jb.time_to_next_playout(0));
+    EXPECT_EQ(UINT32_MAX, pop_jitter_frame(jb, 19999));
+    EXPECT_EQ(0u, pop_jitter_frame(jb, 20000));
+
+    jb.push(create_jitter_frame(900, 1), 25000);
+    EXPECT_EQ(UINT32_MAX, pop_jitter_frame(jb, 25000));
+    EXPECT_EQ(900u, pop_jitter_frame(jb, 31000));
+    EXPECT_EQ(UINT32_MAX, pop_jitter_frame(jb, 31000));
+    EXPECT_EQ(1800u, pop_jitter_frame(jb, 41000));
+    EXPECT_EQ(20, jb.get_target_delay());
+
+    // a frame older than the latest played out frame is late
+    jb.push(create_jitter_frame(1700, 3), 42000);
+    EXPECT_EQ(1u, jb.get_late_frames());
+    EXPECT_EQ(-1, jb.time_to_next_playout(42000));
+
+    EXPECT_EQ(RTP_OK, jb.set_late_policy(RTP_JITTER_DELIVER_LATE));
+    jb.push(create_jitter_frame(1750, 4), 43000);
+    EXPECT_EQ(2u, jb.get_late_frames());
+    EXPECT_EQ(1750u, pop_jitter_frame(jb, 43000));
+
+    // no frame waits longer than the largest delay
+    EXPECT_EQ(RTP_OK, jb.set_max_delay(30));
+    jb.push(create_jitter_frame(90000, 5), 50000);
+    EXPECT_EQ(30000, jb.time_to_next_playout(50000));
+    EXPECT_EQ(90000u, pop_jitter_frame(jb, 80000));
+}
+
+TEST(RTPTests, jitter_buffer_reordering)
+{
+    // Tests that frames sent out of timestamp order are received in order
+    std::cout << "Starting jitter buffer reordering test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(REMOTE_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (sess)
+    {
+        sender = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_GENERIC, RCE_NO_FLAGS);
+        receiver = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_GENERIC, RCE_JITTER_BUFFER);
+    }
+
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_JITTER_BUFFER_MIN_DELAY, 50));
+    EXPECT_EQ(-1, sender->get_configuration_value(RCC_JITTER_BUFFER_MIN_DELAY));
+    EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_JITTER_BUFFER_MIN_DELAY, 50));
+    EXPECT_EQ(50, receiver->get_configuration_value(RCC_JITTER_BUFFER_MIN_DELAY));
+    EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_JITTER_BUFFER_MAX_DELAY, 40));
+    EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_JITTER_BUFFER_MAX_DELAY, 300));
+    EXPECT_EQ(300, receiver->get_configuration_value(RCC_JITTER_BUFFER_MAX_DELAY));
+    EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_JITTER_BUFFER_LATE_POLICY, RTP_JITTER_DELIVER_LATE));
+    EXPECT_EQ(RTP_JITTER_DELIVER_LATE, receiver->get_configuration_value(RCC_JITTER_BUFFER_LATE_POLICY));
+
+    // 10 ms apart at 90 kHz, the second and the third frame are swapped
+    std::vector<uint32_t> timestamps = { 0, 1800, 900, 2700, 3600 };
+    size_t size = 1000;
+    for (auto& ts : timestamps)
+    {
+        std::unique_ptr<uint8_t[]> test_frame = create_test_packet(RTP_FORMAT_GENERIC, 0, false, size, RTP_NO_FLAGS);
+        EXPECT_EQ(RTP_OK, sender->push_frame(std::move(test_frame), size, ts, RTP_NO_FLAGS));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    for (uint32_t expected = 0; expected <= 3600; expected += 900)
+    {
+        uvgrtp::frame::rtp_frame* frame = receiver->pull_frame(500);
+        ASSERT_NE(nullptr, frame);
+        EXPECT_EQ(expected, frame->header.timestamp);
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
@@ -1,4 +1,5 @@
 #include "test_common.hh"
+#include "twcc_link_emulator.hh"
 
 constexpr char LOCAL_INTERFACE[] = "127.0.0.1";
 constexpr char LOCAL_INTERFACE_IP6[] = "::1";
@@ -428,6 +429,102 @@ TEST(RTCPTests, rtcp_multiplex2)
 
 }
 
+TEST(RTCPTests, transport_cc_link_emulation)
+{
+    /* 1 Mbps bottleneck with a drop-tail queue and 20 ms one-way delay, the sender starts at twice
+     * the capacity. benchmark_twcc.cpp reports the same emulation for other links */
+    twcc_link link;
+    twcc_link_result result = run_twcc_link_emulation(link);
+
+    EXPECT_EQ(0u, result.feedback_errors);
+    EXPECT_TRUE(result.hook_matches);
+    EXPECT_GE(result.converged_us, 0);
+    EXPECT_LT(result.converged_us, 5 * 1000 * 1000);
+    EXPECT_GT(result.average_target, 0.6 * link.capacity_bps);
+    EXPECT_LT(result.average_target, 1.2 * link.capacity_bps);
+    EXPECT_LT(result.average_delay, 100);
+}
+
+
+TEST(RTCPTests, keyframe_requests)
+{
+    /* The receiver has not seen a keyframe, so it drops the inter frames it receives
+     * and asks the sender for a keyframe, first with a PLI and then with a FIR */
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session(REMOTE_ADDRESS);
+    uvgrtp::session* remote_session = ctx.create_session(LOCAL_INTERFACE);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    if (local_session)
+    {
+        sender = local_session->create_stream(LOCAL_PORT, REMOTE_PORT, RTP_FORMAT_H265, RCE_RTCP);
+    }
+
+    if (remote_session)
+    {
+        receiver = remote_session->create_stream(REMOTE_PORT, LOCAL_PORT, RTP_FORMAT_H265,
+            RCE_RTCP | RCE_H26X_KEYFRAME_REQUESTS | RCE_H26X_DEPENDENCY_ENFORCEMENT);
+    }
+
+    EXPECT_NE(nullptr, sender);
+    EXPECT_NE(nullptr, receiver);
+
+    if (sender && receiver)
+    {
+        std::atomic<int> requests(0);
+        uint32_t receiver_ssrc = (uint32_t)receiver->get_configuration_value(RCC_SSRC);
+        uint32_t sender_ssrc = (uint32_t)sender->get_configuration_value(RCC_SSRC);
+
+        EXPECT_EQ(RTP_OK, sender->get_rtcp()->install_keyframe_request_hook([&](uint32_t requester) {
+            EXPECT_EQ(receiver_ssrc, requester);
+            ++requests;
+        }));
+
+        /* keyframe requests are configured on the receiving side */
+        EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_KEYFRAME_REQUEST_INTERVAL, 100));
+        EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_KEYFRAME_REQUEST_TYPE, uvgrtp::frame::RTCP_PSFB_SLI));
+        EXPECT_EQ(uvgrtp::frame::RTCP_PSFB_PLI, receiver->get_configuration_value(RCC_KEYFRAME_REQUEST_TYPE));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_KEYFRAME_REQUEST_INTERVAL, 10000));
+        EXPECT_EQ(10000, receiver->get_configuration_value(RCC_KEYFRAME_REQUEST_INTERVAL));
+
+        /* a TRAIL_R picture large enough to be fragmented */
+        size_t size = 5000;
+        std::unique_ptr<uint8_t[]> inter(new uint8_t[size]);
+        memset(inter.get(), 'a', size);
+        inter[0] = 1 << 1;
+        inter[1] = 1;
+
+        /* only the first of these is requested within the interval */
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_EQ(RTP_OK, sender->push_frame(inter.get(), size, RTP_NO_H26X_SCL));
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        EXPECT_EQ(1, requests.load());
+
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_KEYFRAME_REQUEST_TYPE, uvgrtp::frame::RTCP_PSFB_FIR));
+        EXPECT_EQ(RTP_OK, receiver->configure_ctx(RCC_KEYFRAME_REQUEST_INTERVAL, 0));
+        EXPECT_EQ(RTP_OK, sender->push_frame(inter.get(), size, RTP_NO_H26X_SCL));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        EXPECT_EQ(2, requests.load());
+
+        /* every FIR sent by the application is a new request */
+        EXPECT_EQ(RTP_OK, receiver->get_rtcp()->send_fir_packet(sender_ssrc));
+        EXPECT_EQ(RTP_OK, receiver->get_rtcp()->send_pli_packet(sender_ssrc));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        EXPECT_EQ(4, requests.load());
+
+        sender->get_rtcp()->remove_all_hooks();
+    }
+
+    cleanup(ctx, local_session, remote_session, sender, receiver);
+}
 
 void m_r_hook1(uvgrtp::frame::rtcp_receiver_report* frame)
 {
@@ -14,6 +14,9 @@ constexpr size_t PAYLOAD_LEN = 100;
 inline void aggr_receive_hook(void* arg, uvgrtp::frame::rtp_frame* frame);
 int aggr_received = 0;
 
+/* This hook collects the frames of the access unit delivery test */
+inline void access_unit_hook(void* arg, uvgrtp::frame::rtp_frame* frame);
+
 // TODO: Use real files
 
 TEST(FormatTests, h26x_flags)
@@ -834,9 +837,467 @@ TEST(FormatTests, h265_disable_aggr)
     cleanup_sess(ctx, sess);
 }
 
+TEST(FormatTests, h265_push_nal_units)
+{
+    std::cout << "Starting h265 push_nal_units test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    aggr_received = 0;
+    int expected = 5;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver->install_receive_hook(nullptr, aggr_receive_hook);
+    }
+
+    ASSERT_NE(nullptr, sender);
+
+    /* each NAL unit is in its own buffer, the four byte start codes are skipped */
+    std::vector<size_t> test_sizes = { 100, 200, 1700, 300, 400 };
+    std::vector<std::unique_ptr<uint8_t[]>> buffers;
+    std::vector<uvgrtp::frame::nal_unit> nals;
+
+    for (auto& size : test_sizes)
+    {
+        buffers.push_back(create_test_packet(RTP_FORMAT_H265, 8, true, size + 4, RTP_NO_FLAGS));
+        nals.push_back({ buffers.back().get() + 4, size });
+    }
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_nal_units(nullptr, 0, RTP_NO_FLAGS));
+
+    uvgrtp::frame::nal_unit empty = { nullptr, 0 };
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->push_nal_units(&empty, 1, RTP_NO_FLAGS));
+
+    EXPECT_EQ(RTP_OK, sender->push_nal_units(nals.data(), nals.size(), RTP_NO_FLAGS));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::cout << "H265: Received/expected: " << aggr_received << "/" << expected << std::endl;
+    EXPECT_EQ(expected, aggr_received);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_access_units)
+{
+    std::cout << "Starting h265 access unit delivery test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    std::vector<uvgrtp::frame::rtp_frame*> received;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS);
+        receiver->install_receive_hook(&received, access_unit_hook);
+    }
+
+    ASSERT_NE(nullptr, sender);
+
+    /* parameter sets go to an aggregation packet, the first slice is fragmented and the second one is sent as is */
+    std::vector<uint8_t> nal_types = { 32, 33, 34, 19, 1 };
+    std::vector<size_t> test_sizes = { 30, 40, 20, 5000, 500 };
+    size_t total_size = std::accumulate(test_sizes.begin(), test_sizes.end(), (size_t)0);
+
+    std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[total_size]);
+    size_t pos = 0;
+
+    for (size_t i = 0; i < test_sizes.size(); ++i)
+    {
+        std::unique_ptr<uint8_t[]> nal_unit = create_test_packet(RTP_FORMAT_H265, nal_types[i], true, test_sizes[i], RTP_NO_FLAGS);
+        memcpy(test_frame.get() + pos, nal_unit.get(), test_sizes[i]);
+        pos += test_sizes[i];
+    }
+
+    const int frames = 3;
+    for (int i = 0; i < frames; ++i)
+    {
+        EXPECT_EQ(RTP_OK, sender->push_frame(test_frame.get(), total_size, 3000 * (i + 1), RTP_NO_FLAGS));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    /* every access unit is delivered as one frame identical to what was sent */
+    ASSERT_EQ((size_t)frames, received.size());
+
+    for (auto& frame : received)
+    {
+        EXPECT_EQ(total_size, frame->payload_len);
+        EXPECT_EQ(0, memcmp(test_frame.get(), frame->payload, std::min(total_size, frame->payload_len)));
+        ASSERT_EQ(test_sizes.size(), frame->nal_count);
+
+        size_t offset = 0;
+        for (size_t i = 0; i < frame->nal_count; ++i)
+        {
+            EXPECT_EQ(offset + 4, frame->nals[i].offset);
+            EXPECT_EQ(test_sizes[i] - 4, frame->nals[i].len);
+            offset += test_sizes[i];
+        }
+
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_push_slices)
+{
+    std::cout << "Starting h265 slice by slice sending test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    std::vector<uvgrtp::frame::rtp_frame*> received;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS);
+        receiver->install_receive_hook(&received, access_unit_hook);
+    }
+
+    ASSERT_NE(nullptr, sender);
+
+    /* the first slice is fragmented, the other two are sent as single NAL unit packets */
+    std::vector<size_t> test_sizes = { 5000, 500, 800 };
+    size_t total_size = std::accumulate(test_sizes.begin(), test_sizes.end(), (size_t)0);
+    std::vector<std::unique_ptr<uint8_t[]>> slices;
+
+    for (auto& size : test_sizes)
+    {
+        slices.push_back(create_test_packet(RTP_FORMAT_H265, 1, true, size, RTP_NO_FLAGS));
+    }
+
+    uint8_t dummy = 0;
+    EXPECT_EQ(RTP_NOT_READY, sender->push_slice(&dummy, 1, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_NOT_READY, sender->end_frame());
+
+    EXPECT_EQ(RTP_OK, sender->begin_frame(1000));
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->end_frame());
+
+    const int frames = 3;
+    for (int i = 0; i < frames; ++i)
+    {
+        EXPECT_EQ(RTP_OK, sender->begin_frame(3000 * (i + 1)));
+        for (size_t j = 0; j < slices.size(); ++j)
+        {
+            EXPECT_EQ(RTP_OK, sender->push_slice(slices[j].get(), test_sizes[j], RTP_NO_FLAGS));
+        }
+        EXPECT_EQ(RTP_OK, sender->end_frame());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    /* the marker bit of end_frame() finishes each access unit */
+    ASSERT_EQ((size_t)frames, received.size());
+
+    for (int i = 0; i < frames; ++i)
+    {
+        uvgrtp::frame::rtp_frame* frame = received[i];
+
+        EXPECT_EQ((uint32_t)(3000 * (i + 1)), frame->header.timestamp);
+        ASSERT_EQ(total_size, frame->payload_len);
+        ASSERT_EQ(test_sizes.size(), frame->nal_count);
+
+        size_t offset = 0;
+        for (size_t j = 0; j < test_sizes.size(); ++j)
+        {
+            EXPECT_EQ(0, memcmp(slices[j].get(), frame->payload + offset, test_sizes[j]));
+            offset += test_sizes[j];
+        }
+
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_push_slice_sent_early)
+{
+    std::cout << "Testing that a slice is sent before the frame is ended" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    std::mutex chunk_mutex;
+    std::vector<uint8_t> received;
+    bool complete = false;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_NO_FLAGS);
+    }
+
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    EXPECT_EQ(RTP_OK, receiver->install_nal_chunk_hook([&](const uvgrtp::frame::nal_chunk& chunk) {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        received.insert(received.end(), chunk.data, chunk.data + chunk.len);
+        complete = (chunk.state == RTP_NAL_CHUNK_COMPLETE);
+    }));
+
+    const size_t slice_size = 5000;
+    std::unique_ptr<uint8_t[]> expected = create_test_packet(RTP_FORMAT_H265, 1, true, slice_size, RTP_NO_FLAGS);
+    std::vector<uint8_t> slice(expected.get(), expected.get() + slice_size);
+
+    EXPECT_EQ(RTP_OK, sender->begin_frame(90000));
+    EXPECT_EQ(RTP_OK, sender->push_slice(slice.data(), slice.size(), RTP_NO_FLAGS));
+
+    /* the slice buffer can be reused as soon as the call returns */
+    std::fill(slice.begin(), slice.end(), (uint8_t)0xff);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    /* every fragment except the last one is received before the frame is ended */
+    {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        EXPECT_FALSE(complete);
+        EXPECT_GT(received.size(), slice_size / 2);
+        EXPECT_LT(received.size(), slice_size);
+    }
+
+    EXPECT_EQ(RTP_OK, sender->end_frame());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    {
+        std::lock_guard<std::mutex> lock(chunk_mutex);
+        EXPECT_TRUE(complete);
+        ASSERT_EQ(slice_size, received.size());
+        EXPECT_EQ(0, memcmp(expected.get(), received.data(), slice_size));
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_parameter_sets)
+{
+    std::cout << "Starting h265 parameter set caching test" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    std::vector<uvgrtp::frame::rtp_frame*> received;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_H26X_PARAMETER_SETS);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS | RCE_H26X_PARAMETER_SETS);
+        receiver->install_receive_hook(&received, access_unit_hook);
+    }
+
+    ASSERT_NE(nullptr, sender);
+    ASSERT_NE(nullptr, receiver);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender->configure_ctx(RCC_PARAMETER_SET_INTERVAL, -1));
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_PARAMETER_SET_INTERVAL, 0));
+    EXPECT_EQ(0, sender->get_configuration_value(RCC_PARAMETER_SET_INTERVAL));
+
+    /* the parameter sets are sent only with the first intra picture */
+    std::vector<std::vector<uint8_t>> frame_types = { { 32, 33, 34, 19 }, { 1 }, { 19 } };
+    std::vector<size_t> sizes = { 30, 40, 20, 5000 };
+
+    for (size_t f = 0; f < frame_types.size(); ++f)
+    {
+        std::vector<uint8_t> frame;
+
+        for (auto& type : frame_types[f])
+        {
+            size_t size = (type == 1) ? 500 : sizes[type == 19 ? 3 : type - 32];
+            std::unique_ptr<uint8_t[]> nal_unit = create_test_packet(RTP_FORMAT_H265, type, true, size, RTP_NO_FLAGS);
+            frame.insert(frame.end(), nal_unit.get(), nal_unit.get() + size);
+        }
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), 3000 * (uint32_t)(f + 1), RTP_NO_FLAGS));
+    }
+
+    /* an intra picture sent in two slices gets the parameter sets only in front of the first one */
+    EXPECT_EQ(RTP_OK, sender->begin_frame(3000 * (uint32_t)(frame_types.size() + 1)));
+    for (int i = 0; i < 2; ++i)
+    {
+        EXPECT_EQ(RTP_OK, sender->push_slice(create_test_packet(RTP_FORMAT_H265, 19, true, 5000, RTP_NO_FLAGS).get(), 5000, RTP_NO_FLAGS));
+    }
+    EXPECT_EQ(RTP_OK, sender->end_frame());
+
+    /* AUD, SEI and SPS + IDR: VPS and PPS go after the AUD and SEI, around the SPS */
+    std::vector<uint8_t> frame;
+    for (auto& nal : std::vector<std::pair<uint8_t, size_t>>{ { 35, 10 }, { 39, 20 }, { 33, 40 }, { 19, 5000 } })
+    {
+        std::unique_ptr<uint8_t[]> nal_unit = create_test_packet(RTP_FORMAT_H265, nal.first, true, nal.second, RTP_NO_FLAGS);
+        frame.insert(frame.end(), nal_unit.get(), nal_unit.get() + nal.second);
+    }
+    EXPECT_EQ(RTP_OK, sender->push_frame(frame.data(), frame.size(), 3000 * (uint32_t)(frame_types.size() + 2), RTP_NO_FLAGS));
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    /* the cached parameter sets were inserted in front of the later intra pictures */
+    std::vector<std::vector<uint8_t>> expected_types = { { 32, 33, 34, 19 }, { 1 }, { 32, 33, 34, 19 }, { 32, 33, 34, 19, 19 },
+        { 35, 39, 32, 33, 34, 19 } };
+    ASSERT_EQ(expected_types.size(), received.size());
+
+    for (size_t f = 0; f < received.size(); ++f)
+    {
+        ASSERT_EQ(expected_types[f].size(), received[f]->nal_count);
+
+        for (size_t i = 0; i < received[f]->nal_count; ++i)
+        {
+            EXPECT_EQ(expected_types[f][i], (received[f]->payload[received[f]->nals[i].offset] >> 1) & 0x3f);
+        }
+
+        (void)uvgrtp::frame::dealloc_frame(received[f]);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_latency_budget)
+{
+    std::cout << "Testing shedding of NAL units with RCC_SEND_LATENCY_BUDGET" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    aggr_received = 0;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_RTCP | RCE_TRANSPORT_CC);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_RTCP);
+        receiver->install_receive_hook(nullptr, aggr_receive_hook);
+    }
+
+    ASSERT_NE(nullptr, sender);
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_SEND_LATENCY_BUDGET, 1));
+    EXPECT_EQ(1, sender->get_configuration_value(RCC_SEND_LATENCY_BUDGET));
+    EXPECT_EQ(RTP_INVALID_VALUE, receiver->configure_ctx(RCC_SEND_LATENCY_BUDGET, 1));
+
+    /* get the sender through RTCP source probation before the actual test frames */
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_EQ(RTP_OK, sender->push_frame(create_test_packet(RTP_FORMAT_H265, 32, true, 100, RTP_NO_FLAGS), 100, RTP_NO_FLAGS));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    aggr_received = 0;
+
+    /* VPS + IDR, TRAIL_N, TRAIL_R, a small TRAIL_R that references the shed one and VPS + IDR again */
+    std::vector<std::vector<std::pair<uint8_t, size_t>>> frames = {
+        { { 32, 100 }, { 19, 5000 } },
+        { { 0, 5000 } },
+        { { 1, 5000 } },
+        { { 1, 50 } },
+        { { 32, 100 }, { 19, 5000 } },
+    };
+
+    for (auto& nals : frames)
+    {
+        size_t total_size = 0;
+        for (auto& nal : nals)
+            total_size += nal.second;
+
+        std::unique_ptr<uint8_t[]> test_frame = std::unique_ptr<uint8_t[]>(new uint8_t[total_size]);
+        size_t pos = 0;
+
+        for (auto& nal : nals)
+        {
+            std::unique_ptr<uint8_t[]> nal_unit = create_test_packet(RTP_FORMAT_H265, nal.first, true, nal.second, RTP_NO_FLAGS);
+            memcpy(test_frame.get() + pos, nal_unit.get(), nal.second);
+            pos += nal.second;
+        }
+
+        EXPECT_EQ(RTP_OK, sender->push_frame(std::move(test_frame), total_size, RTP_NO_FLAGS));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    EXPECT_EQ(0u, sender->get_shed_bytes(RTP_NAL_PRIORITY_NON_VCL));
+    EXPECT_EQ(0u, sender->get_shed_bytes(RTP_NAL_PRIORITY_INTRA));
+    EXPECT_EQ(5000u - 4, sender->get_shed_bytes(RTP_NAL_PRIORITY_NON_REFERENCE));
+    EXPECT_EQ(5050u - 8, sender->get_shed_bytes(RTP_NAL_PRIORITY_REFERENCE));
+
+    std::cout << "H265: Received/expected: " << aggr_received << "/" << 4 << std::endl;
+    EXPECT_EQ(4, aggr_received);
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
+TEST(FormatTests, h265_latency_budget_slices)
+{
+    std::cout << "Testing the end of a frame sent slice by slice with RCC_SEND_LATENCY_BUDGET" << std::endl;
+    uvgrtp::context ctx;
+    uvgrtp::session* sess = ctx.create_session(LOCAL_ADDRESS);
+
+    uvgrtp::media_stream* sender = nullptr;
+    uvgrtp::media_stream* receiver = nullptr;
+
+    std::vector<uvgrtp::frame::rtp_frame*> received;
+
+    if (sess)
+    {
+        sender = sess->create_stream(SEND_PORT, RECEIVE_PORT, RTP_FORMAT_H265, RCE_RTCP | RCE_TRANSPORT_CC);
+        receiver = sess->create_stream(RECEIVE_PORT, SEND_PORT, RTP_FORMAT_H265, RCE_H26X_ACCESS_UNITS);
+        receiver->install_receive_hook(&received, access_unit_hook);
+    }
+
+    ASSERT_NE(nullptr, sender);
+    EXPECT_EQ(RTP_OK, sender->configure_ctx(RCC_SEND_LATENCY_BUDGET, 1));
+
+    /* the first slice is never shed, the large TRAIL_N that ends the frame would be */
+    std::unique_ptr<uint8_t[]> first = create_test_packet(RTP_FORMAT_H265, 19, true, 50, RTP_NO_FLAGS);
+    std::unique_ptr<uint8_t[]> last = create_test_packet(RTP_FORMAT_H265, 0, true, 5000, RTP_NO_FLAGS);
+
+    EXPECT_EQ(RTP_OK, sender->begin_frame(90000));
+    EXPECT_EQ(RTP_OK, sender->push_slice(first.get(), 50, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_OK, sender->push_slice(last.get(), 5000, RTP_NO_FLAGS));
+    EXPECT_EQ(RTP_OK, sender->end_frame());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    /* the first slice was already sent, so the last one is kept to end the access unit with the marker bit */
+    EXPECT_EQ(0u, sender->get_shed_bytes(RTP_NAL_PRIORITY_NON_REFERENCE));
+    ASSERT_EQ(1u, received.size());
+    EXPECT_EQ(90000u, received[0]->header.timestamp);
+    EXPECT_EQ(2u, received[0]->nal_count);
+
+    for (auto frame : received)
+    {
+        (void)uvgrtp::frame::dealloc_frame(frame);
+    }
+
+    cleanup_ms(sess, sender);
+    cleanup_ms(sess, receiver);
+    cleanup_sess(ctx, sess);
+}
+
 inline void aggr_receive_hook(void* arg, uvgrtp::frame::rtp_frame* frame)
 {
     std::cout << "Rec frame size " << frame->payload_len << std::endl;
     aggr_received++;
     (void)uvgrtp::frame::dealloc_frame(frame);
-}
\ No newline at end of file
+}
+
+inline void access_unit_hook(void* arg, uvgrtp::frame::rtp_frame* frame)
+{
+    ((std::vector<uvgrtp::frame::rtp_frame*>*)arg)->push_back(frame);
+}
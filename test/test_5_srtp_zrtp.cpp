@@ -1,5 +1,11 @@
 #include "test_common.hh"
 
+#include "../src/srtp/srtp.hh"
+#include "../src/crypto.hh"
+#include "../src/socketfactory.hh"
+#include "../src/thread_pool.hh"
+#include "../src/zrtp/key_pool.hh"
+
 
 // network parameters of example
 constexpr char SENDER_ADDRESS[] = "127.0.0.1";
@@ -19,14 +25,14 @@ constexpr int SALT_SIZE_BYTES = SALT_SIZE / 8;
 
 constexpr int TEST_PACKET_SIZE = 1000;
 
-void user_send_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], int key_size);
-void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size);
+void user_send_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], int key_size, unsigned extra_flags);
+void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], int key_size, unsigned extra_flags);
 void zrtp_sender_func(uvgrtp::session* sender_session, int sender_port, int receiver_port, unsigned int flags, 
     uint32_t local_ssrc = 0, uint32_t remote_ssrc = 0);
 void zrtp_receive_func(uvgrtp::session* receiver_session, int sender_port, int receiver_port, unsigned int flags,
     uint32_t local_ssrc = 0, uint32_t remote_ssrc = 0);
 
-void test_user_key(Key_length len);
+void test_user_key(Key_length len, unsigned extra_flags = 0);
 int received_packets;
 // User key management test
 
@@ -45,7 +51,283 @@ TEST(EncryptionTests, srtp_user_key_256)
     test_user_key(SRTP_256);
 }
 
-void test_user_key(Key_length len)
+TEST(EncryptionTests, srtp_user_key_gcm_128)
+{
+    test_user_key(SRTP_128, RCE_SRTP_AEAD_GCM);
+}
+
+TEST(EncryptionTests, srtp_user_key_gcm_256)
+{
+    test_user_key(SRTP_256, RCE_SRTP_AEAD_GCM);
+}
+
+TEST(EncryptionTests, srtp_replay_window)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its SRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    uint8_t key[AES128_KEY_SIZE]  = { 0 };
+    uint8_t salt[UVG_SALT_LENGTH] = { 0 };
+
+    uvgrtp::srtp srtp(RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_REPLAY_PROTECTION);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, srtp.set_replay_window_size(32));
+    EXPECT_EQ(RTP_INVALID_VALUE, srtp.set_replay_window_size(100));
+    EXPECT_EQ(RTP_INVALID_VALUE, srtp.set_replay_window_size(2048));
+    EXPECT_EQ(RTP_OK, srtp.set_replay_window_size(128));
+    EXPECT_EQ(RTP_OK, srtp.init(uvgrtp::SRTP, RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_REPLAY_PROTECTION,
+        key, key, salt, salt));
+
+    EXPECT_FALSE(srtp.is_replayed_packet(1000));
+    EXPECT_TRUE(srtp.is_replayed_packet(1000));
+
+    // late packets inside the window are accepted once
+    EXPECT_FALSE(srtp.is_replayed_packet(900));
+    EXPECT_TRUE(srtp.is_replayed_packet(900));
+    EXPECT_FALSE(srtp.is_replayed_packet(1000 - 127));
+
+    // packets behind the window are rejected
+    EXPECT_TRUE(srtp.is_replayed_packet(1000 - 128));
+
+    // moving the window forward forgets the old bits sharing the same position
+    EXPECT_FALSE(srtp.is_replayed_packet(1100));
+    EXPECT_FALSE(srtp.is_replayed_packet(1100 - 127));
+    EXPECT_TRUE(srtp.is_replayed_packet(900));
+
+    // a jump over the whole window clears it
+    EXPECT_FALSE(srtp.is_replayed_packet(5000));
+    EXPECT_FALSE(srtp.is_replayed_packet(5000 - 64));
+    EXPECT_TRUE(srtp.is_replayed_packet(5000 - 64));
+}
+
+TEST(EncryptionTests, srtp_input_not_modified)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its SRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    uint8_t key[AES128_KEY_SIZE]  = { 0 };
+    uint8_t salt[UVG_SALT_LENGTH] = { 0 };
+
+    uvgrtp::session* sess = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+
+    if (sess)
+    {
+        send = sess->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_H265,
+            RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AUTHENTICATE_RTP);
+    }
+
+    EXPECT_NE(nullptr, send);
+
+    if (send)
+    {
+        EXPECT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+
+        // the frame is fragmented so the payload of each packet consists of several buffers
+        size_t frame_size = 10000;
+        std::unique_ptr<uint8_t[]> frame = create_test_packet(RTP_FORMAT_H265, 1, true, frame_size, RTP_NO_FLAGS);
+        std::unique_ptr<uint8_t[]> copy  = std::unique_ptr<uint8_t[]>(new uint8_t[frame_size]);
+        memcpy(copy.get(), frame.get(), frame_size);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_EQ(RTP_OK, send->push_frame(frame.get(), frame_size, RTP_NO_FLAGS));
+            EXPECT_EQ(0, memcmp(copy.get(), frame.get(), frame_size));
+        }
+    }
+
+    cleanup_ms(sess, send);
+    cleanup_sess(ctx, sess);
+}
+
+/* Key "sender" and "receiver" with the same keys and check that a stream accepts the configuration "rcc" */
+static void init_srtp_pair(uvgrtp::context& ctx, uvgrtp::srtp& sender, uvgrtp::srtp& receiver, int flags, int rcc, int value)
+{
+    uint8_t key[AES128_KEY_SIZE]  = { 0 };
+    uint8_t salt[UVG_SALT_LENGTH] = { 0 };
+
+    ASSERT_EQ(RTP_OK, sender.init(uvgrtp::SRTP, flags, key, key, salt, salt));
+    ASSERT_EQ(RTP_OK, receiver.init(uvgrtp::SRTP, flags, key, key, salt, salt));
+
+    uvgrtp::session* sess = ctx.create_session(RECEIVER_ADDRESS);
+    uvgrtp::media_stream* send = nullptr;
+
+    if (sess)
+        send = sess->create_stream(SENDER_PORT, RECEIVER_PORT, RTP_FORMAT_GENERIC, flags);
+
+    EXPECT_NE(nullptr, send);
+
+    if (send)
+    {
+        EXPECT_EQ(RTP_OK, send->add_srtp_ctx(key, salt));
+        EXPECT_EQ(RTP_INVALID_VALUE, send->configure_ctx(rcc, -1));
+        EXPECT_EQ(RTP_OK, send->configure_ctx(rcc, value));
+        EXPECT_EQ(value, send->get_configuration_value(rcc));
+    }
+
+    cleanup_ms(sess, send);
+    cleanup_sess(ctx, sess);
+}
+
+/* Protect a transaction (one frame) of "packets" RTP packets with "sender" the way the media stream
+ * does, encrypting the payload from the caller's buffer to an output buffer, then unprotect them
+ * with "receiver" and check that the payloads are the ones that were sent */
+static void srtp_round_trip(uvgrtp::srtp& sender, uvgrtp::srtp& receiver, int flags, size_t packets, uint16_t& seq)
+{
+    const size_t header_size  = 12;
+    const size_t payload_size = TEST_PACKET_SIZE;
+    const uint32_t ssrc       = 0x12345678;
+    const uint32_t ts         = (uint32_t)seq + 1; /* the receiver tells the frames apart by their timestamps */
+    size_t tag_len            = uvgrtp::get_srtp_tag_length(flags);
+
+    std::vector<std::vector<uint8_t>> headers(packets, std::vector<uint8_t>(header_size, 0));
+    std::vector<std::vector<uint8_t>> payloads(packets, std::vector<uint8_t>(payload_size));
+    std::vector<std::vector<uint8_t>> outputs(packets, std::vector<uint8_t>(payload_size + tag_len));
+    uvgrtp::pkt_vec transaction(packets);
+
+    for (size_t i = 0; i < packets; ++i)
+    {
+        uint16_t nseq   = htons((uint16_t)(seq + i));
+        uint32_t nts    = htonl(ts);
+        uint32_t nssrc  = htonl(ssrc);
+        headers[i][0]   = 2 << 6;
+        headers[i][1]   = 96;
+        memcpy(&headers[i][2], &nseq, sizeof(nseq));
+        memcpy(&headers[i][4], &nts, sizeof(nts));
+        memcpy(&headers[i][8], &nssrc, sizeof(nssrc));
+
+        for (size_t j = 0; j < payload_size; ++j)
+            payloads[i][j] = (uint8_t)(i + j);
+
+        transaction[i] = { { header_size, headers[i].data() }, { payload_size, payloads[i].data() },
+            { 0, outputs[i].data() } };
+
+        if (tag_len)
+            transaction[i].push_back({ tag_len, outputs[i].data() + payload_size });
+    }
+
+    ASSERT_EQ(RTP_OK, uvgrtp::srtp::send_packets_handler(&sender, transaction));
+
+    for (size_t i = 0; i < packets; ++i)
+    {
+        std::vector<uint8_t> dgram(headers[i]);
+        dgram.insert(dgram.end(), outputs[i].begin(), outputs[i].end());
+
+        uvgrtp::frame::rtp_frame frame;
+        uvgrtp::frame::rtp_frame *out = &frame;
+
+        frame.header.seq       = (uint16_t)(seq + i);
+        frame.header.ssrc      = ssrc;
+        frame.header.timestamp = ts;
+        frame.dgram            = dgram.data();
+        frame.dgram_size       = dgram.size();
+        frame.payload          = frame.dgram + header_size;
+        frame.payload_len      = payload_size + tag_len;
+
+        ASSERT_EQ(RTP_PKT_MODIFIED, receiver.recv_packet_handler(&receiver, flags, frame.dgram, frame.dgram_size, &out));
+        ASSERT_EQ(payload_size, frame.payload_len);
+        EXPECT_EQ(0, memcmp(payloads[i].data(), frame.payload, payload_size));
+    }
+
+    seq = (uint16_t)(seq + packets);
+}
+
+TEST(EncryptionTests, srtp_parallel)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its SRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    // a private pool so that the packets are split between threads even on a single-core machine
+    auto pool = std::make_shared<uvgrtp::thread_pool>(2);
+
+    for (int flags : { RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AUTHENTICATE_RTP | RCE_SRTP_REPLAY_PROTECTION,
+                       RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AEAD_GCM | RCE_SRTP_REPLAY_PROTECTION })
+    {
+        uvgrtp::srtp sender(flags);
+        uvgrtp::srtp receiver(flags);
+        init_srtp_pair(ctx, sender, receiver, flags, RCC_PARALLEL_SRTP_THRESHOLD, 8);
+
+        sender.set_parallel_threshold(8);
+        sender.set_thread_pool(pool);
+
+        // transactions below the threshold are protected serially
+        uint16_t seq = 0xfff0;
+        for (size_t packets : { 70, 4, 70, 33 })
+        {
+            srtp_round_trip(sender, receiver, flags, packets, seq);
+        }
+    }
+}
+
+TEST(EncryptionTests, srtp_keystream_lookahead)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its SRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    int flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | RCE_SRTP_AUTHENTICATE_RTP;
+
+    uvgrtp::srtp sender(flags);
+    uvgrtp::srtp receiver(flags);
+    init_srtp_pair(ctx, sender, receiver, flags, RCC_SRTP_KEYSTREAM_LOOKAHEAD, 16);
+
+    EXPECT_EQ(RTP_INVALID_VALUE, sender.set_keystream_lookahead(2000, TEST_PACKET_SIZE));
+    EXPECT_EQ(RTP_OK, sender.set_keystream_lookahead(16, TEST_PACKET_SIZE));
+    EXPECT_EQ(16u, sender.get_keystream_lookahead());
+
+    // the first packet is encrypted with the cipher, the rest with precomputed keystream if it is ready
+    uint16_t seq = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        srtp_round_trip(sender, receiver, flags, 1, seq);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_LT(0u, sender.get_keystream_hits());
+    EXPECT_GE(19u, sender.get_keystream_hits());
+
+    // resizing the lookahead waits until the packet being encrypted is done with its keystream
+    std::atomic<bool> sending(true);
+    std::thread resizer([&]() {
+        for (size_t i = 0; sending; ++i)
+        {
+            EXPECT_EQ(RTP_OK, sender.set_keystream_lookahead(i % 4 * 8, TEST_PACKET_SIZE));
+        }
+    });
+
+    for (int i = 0; i < 500; ++i)
+    {
+        srtp_round_trip(sender, receiver, flags, 1, seq);
+    }
+
+    sending = false;
+    resizer.join();
+}
+
+void test_user_key(Key_length len, unsigned extra_flags)
 {
     std::cout << "Starting ZRTP sender thread" << std::endl;
     uvgrtp::context ctx;
@@ -60,8 +342,8 @@ void test_user_key(Key_length len)
     for (int i = 0; i < SALT_SIZE_BYTES; ++i)
         salt[i] = i * 2;
 
-    std::unique_ptr<std::thread> sender_thread = std::unique_ptr<std::thread>(new std::thread(user_send_func, key, salt, len));
-    std::unique_ptr<std::thread> receiver_thread = std::unique_ptr<std::thread>(new std::thread(user_receive_func, key, salt, len));
+    std::unique_ptr<std::thread> sender_thread = std::unique_ptr<std::thread>(new std::thread(user_send_func, key, salt, len, extra_flags));
+    std::unique_ptr<std::thread> receiver_thread = std::unique_ptr<std::thread>(new std::thread(user_receive_func, key, salt, len, extra_flags));
 
     if (sender_thread && sender_thread->joinable())
     {
@@ -76,7 +358,7 @@ void test_user_key(Key_length len)
     delete[] key;
 }
 
-void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], int key_size)
+void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], int key_size, unsigned extra_flags)
 {
     uvgrtp::context ctx;
     uvgrtp::session* sender_session = nullptr;
@@ -85,7 +367,7 @@ void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], int key_size)
     sender_session = ctx.create_session(RECEIVER_ADDRESS);
 
     // Enable SRTP and let user manage the keys
-    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | extra_flags;
     if (key_size == 192)
     {
         flags |= RCE_SRTP_KEYSIZE_192;
@@ -118,14 +400,14 @@ void user_send_func(uint8_t* key, uint8_t salt[SALT_SIZE_BYTES], int key_size)
     }
 }
 
-void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_size)
+void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], int key_size, unsigned extra_flags)
 {
     /* See sending.cc for more details */
     uvgrtp::context ctx;
     uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS);
 
     /* Enable SRTP and let user manage keys */
-    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER;
+    unsigned flags = RCE_SRTP | RCE_SRTP_KMNGMNT_USER | extra_flags;
     received_packets = 0;
 
     if (key_size == 192)
@@ -177,6 +459,47 @@ void user_receive_func(uint8_t *key, uint8_t salt[SALT_SIZE_BYTES], uint8_t key_
 
 // ZRTP key management tests
 
+TEST(EncryptionTests, zrtp_ecdh)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its ZRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    for (auto curve : { uvgrtp::crypto::ecdh::X25519, uvgrtp::crypto::ecdh::P256 })
+    {
+        uvgrtp::crypto::ecdh local(curve);
+        uvgrtp::crypto::ecdh remote(curve);
+
+        uint8_t local_pk[64]  = { 0 };
+        uint8_t remote_pk[64] = { 0 };
+        uint8_t local_ss[32]  = { 0 };
+        uint8_t remote_ss[32] = { 0 };
+
+        local.generate_keys();
+        remote.generate_keys();
+        local.get_pk(local_pk, local.pk_len());
+        remote.get_pk(remote_pk, remote.pk_len());
+
+        local.set_remote_pk(remote_pk, remote.pk_len());
+        remote.set_remote_pk(local_pk, local.pk_len());
+
+        EXPECT_TRUE(local.get_shared_secret(local_ss, sizeof(local_ss)));
+        EXPECT_TRUE(remote.get_shared_secret(remote_ss, sizeof(remote_ss)));
+        EXPECT_EQ(0, memcmp(local_ss, remote_ss, sizeof(local_ss)));
+
+        /* zero is not a point on P-256 and has low order on Curve25519 */
+        uint8_t invalid_pk[64] = { 0 };
+
+        local.set_remote_pk(invalid_pk, local.pk_len());
+        EXPECT_FALSE(local.get_shared_secret(local_ss, sizeof(local_ss)));
+    }
+}
+
 TEST(EncryptionTests, zrtp)
 {
     uvgrtp::context ctx;
@@ -210,6 +533,63 @@ TEST(EncryptionTests, zrtp)
     cleanup_sess(ctx, receiver_session);
 }
 
+TEST(EncryptionTests, zrtp_key_pool)
+{
+    uvgrtp::context ctx;
+
+    EXPECT_EQ(RTP_INVALID_VALUE, ctx.set_zrtp_key_pool_size(100000));
+    EXPECT_EQ(RTP_OK, ctx.set_zrtp_key_pool_size(2));
+    EXPECT_EQ(2, ctx.get_zrtp_key_pool_size());
+    EXPECT_EQ(RTP_OK, ctx.set_zrtp_key_pool_size(0));
+    EXPECT_EQ(0, ctx.get_zrtp_key_pool_size());
+
+    /* the sessions get a pool of their own so that taking key pairs from it can be observed */
+    auto key_pool = std::make_shared<uvgrtp::zrtp_key_pool>();
+    auto sfp = std::make_shared<uvgrtp::socketfactory>(RCE_NO_FLAGS);
+
+    EXPECT_EQ(RTP_OK, key_pool->set_size(2));
+
+    /* wait for the background thread to generate two key pairs of each type */
+    for (int i = 0; i < 250 && key_pool->get_ready_count() < 6; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    ASSERT_EQ(6u, key_pool->get_ready_count());
+    EXPECT_EQ(0u, key_pool->get_taken_count());
+
+    uvgrtp::session* sender_session = new uvgrtp::session("sender", RECEIVER_ADDRESS, SENDER_ADDRESS, sfp, key_pool);
+    uvgrtp::session* receiver_session = new uvgrtp::session("receiver", SENDER_ADDRESS, RECEIVER_ADDRESS, sfp, key_pool);
+
+    unsigned zrtp_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP;
+    received_packets = 0;
+
+    std::unique_ptr<std::thread> sender_thread =
+        std::unique_ptr<std::thread>(new std::thread(zrtp_sender_func, sender_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, 0, 0));
+
+    std::unique_ptr<std::thread> receiver_thread =
+        std::unique_ptr<std::thread>(new std::thread(zrtp_receive_func, receiver_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, 0, 0));
+
+    if (sender_thread && sender_thread->joinable())
+    {
+        sender_thread->join();
+    }
+
+    if (receiver_thread && receiver_thread->joinable())
+    {
+        receiver_thread->join();
+    }
+
+    std::cout << received_packets << " / 10 packets received" << std::endl;
+    EXPECT_TRUE(received_packets > 5);
+
+    /* both endpoints use a pooled key pair instead of generating their own */
+    std::cout << key_pool->get_taken_count() << " key pairs taken from the pool" << std::endl;
+    EXPECT_EQ(2u, key_pool->get_taken_count());
+
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
 TEST(EncryptionTests, zrtp_authenticate)
 {
     uvgrtp::context ctx;
@@ -250,6 +630,46 @@ TEST(EncryptionTests, zrtp_authenticate)
     cleanup_sess(ctx, receiver_session);
 }
 
+TEST(EncryptionTests, zrtp_gcm)
+{
+    uvgrtp::context ctx;
+
+    if (!ctx.crypto_enabled())
+    {
+        std::cout << "Please link crypto to uvgRTP library in order to tests its ZRTP feature!" << std::endl;
+        FAIL();
+        return;
+    }
+
+    uvgrtp::session* sender_session = ctx.create_session(RECEIVER_ADDRESS, SENDER_ADDRESS);
+    uvgrtp::session* receiver_session = ctx.create_session(SENDER_ADDRESS, RECEIVER_ADDRESS);
+
+    unsigned zrtp_flags = RCE_SRTP | RCE_SRTP_KMNGMNT_ZRTP | RCE_SRTP_AEAD_GCM;
+    received_packets = 0;
+
+    std::unique_ptr<std::thread> sender_thread =
+        std::unique_ptr<std::thread>(new std::thread(zrtp_sender_func, sender_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, 0, 0));
+
+    std::unique_ptr<std::thread> receiver_thread =
+        std::unique_ptr<std::thread>(new std::thread(zrtp_receive_func, receiver_session, SENDER_PORT, RECEIVER_PORT, zrtp_flags, 0, 0));
+
+    if (sender_thread && sender_thread->joinable())
+    {
+        sender_thread->join();
+    }
+
+    if (receiver_thread && receiver_thread->joinable())
+    {
+        receiver_thread->join();
+    }
+
+    std::cout << received_packets << " / 10 packets received" << std::endl;
+    EXPECT_TRUE(received_packets > 5);
+
+    cleanup_sess(ctx, sender_session);
+    cleanup_sess(ctx, receiver_session);
+}
+
 TEST(EncryptionTests, zrtp_multistream)
 {
     uvgrtp::context ctx;
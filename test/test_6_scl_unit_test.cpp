@@ -7,7 +7,16 @@
 #include "test_common.hh"
 
 #include "../src/formats/h264.hh"
+#include "../src/formats/h265.hh"
 #include "../src/formats/h266.hh"
+#include "../src/formats/start_code.hh"
+#include "../src/formats/media.hh"
+#include "../src/rtp.hh"
+#include "../src/thread_pool.hh"
+
+#include <chrono>
+#include <map>
+#include <random>
 
 const int DATA_SIZE = 128;
 const int DATA_VALUE = 128;
@@ -130,4 +139,447 @@ TEST(FormatTests, h266_scl) {
         EXPECT_EQ(4 + offset, (int)out);
         EXPECT_EQ(4, start_len);
     }
-}
\ No newline at end of file
+}
+/* Run the start code lookup over the whole buffer the same way scl() does */
+template <typename Finder>
+static std::vector<std::pair<ssize_t, uint8_t>> scan_start_codes(Finder find, uint8_t* data, size_t len, size_t offset)
+{
+    std::vector<std::pair<ssize_t, uint8_t>> found;
+    uint8_t start_len = 0;
+    ssize_t out = find(data, len, offset, start_len);
+
+    while (out > -1) {
+        found.push_back({ out, start_len });
+        out = find(data, len, (size_t)out, start_len);
+    }
+
+    return found;
+}
+
+TEST(FormatTests, scl_simd_matches_scalar) {
+    uvgrtp::context ctx;
+    uvgrtp::session* local_session = ctx.create_session("127.0.0.1");
+    std::shared_ptr<uvgrtp::rtp>    rtp_;
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format_26x = uvgrtp::formats::h264(socket_, rtp_, 0);
+
+    auto scalar = [&](uint8_t* data, size_t len, size_t offset, uint8_t& start_len) {
+        return format_26x.find_h26x_start_code_scalar(data, len, offset, start_len);
+    };
+
+    std::vector<uvgrtp::formats::start_code_variant> variants = uvgrtp::formats::get_start_code_variants();
+    std::cout << "Testing " << variants.size() << " vectorized SCL implementations" << std::endl;
+
+    std::mt19937 rng(1337);
+    std::vector<uint8_t> data(300);
+
+    for (int round = 0; round < 2000; ++round) {
+        size_t len = 1 + rng() % data.size();
+
+        /* mostly zeros and ones so that the prefixes and their lengths vary */
+        for (size_t i = 0; i < len; ++i) {
+            uint32_t r = rng() % 8;
+            data[i] = (r < 4) ? 0 : (r < 6) ? 1 : (uint8_t)rng();
+        }
+
+        for (size_t offset = 0; offset < 8 && offset < len; ++offset) {
+            auto expected = scan_start_codes(scalar, data.data(), len, offset);
+
+            for (auto& variant : variants) {
+                ASSERT_EQ(expected, scan_start_codes(variant.find, data.data(), len, offset))
+                    << variant.name << " differs from the scalar lookup, length " << len << ", offset " << offset;
+            }
+        }
+    }
+}
+
+TEST(FormatTests, scl_prefix_ends_frame) {
+    std::shared_ptr<uvgrtp::rtp>    rtp_;
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format_26x = uvgrtp::formats::h265(socket_, rtp_, 0);
+
+    std::vector<uint8_t> data(64, 0x55);
+    data[0] = data[1] = data[2] = 0;
+    data[3] = 1;
+    data[61] = data[62] = 0;
+    data[63] = 1;
+
+    /* every lookup reports the prefix that ends the frame */
+    uint8_t start_len = 0;
+    EXPECT_EQ(64, format_26x.find_h26x_start_code_scalar(data.data(), data.size(), 4, start_len));
+    EXPECT_EQ(3, start_len);
+
+    for (auto& variant : uvgrtp::formats::get_start_code_variants()) {
+        EXPECT_EQ(64, variant.find(data.data(), data.size(), 4, start_len)) << variant.name;
+        EXPECT_EQ(3, start_len) << variant.name;
+    }
+
+    /* but it starts no NAL unit */
+    format_26x.set_scl_thread_pool(std::make_shared<uvgrtp::thread_pool>(3));
+
+    for (size_t threshold : { (size_t)0, (size_t)1 }) {
+        format_26x.set_parallel_scl_threshold(threshold);
+
+        std::vector<uvgrtp::formats::nal_info> nals;
+        format_26x.find_nal_units(data.data(), data.size(), nals);
+
+        ASSERT_EQ(1u, nals.size());
+        EXPECT_EQ(4u, nals[0].offset);
+    }
+}
+
+TEST(FormatTests, scl_parallel_matches_serial) {
+    uvgrtp::context ctx;
+    std::shared_ptr<uvgrtp::rtp>    rtp_;
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto format_26x = uvgrtp::formats::h265(socket_, rtp_, 0);
+
+    /* a private pool so that the frames are split into four chunks whatever the number of CPU cores */
+    format_26x.set_scl_thread_pool(std::make_shared<uvgrtp::thread_pool>(3));
+
+    std::mt19937 rng(1337);
+    std::vector<uint8_t> data(4000);
+
+    for (int round = 0; round < 500; ++round) {
+        size_t len = 1 + rng() % data.size();
+
+        for (size_t i = 0; i < len; ++i) {
+            uint32_t r = rng() % 8;
+            data[i] = (r < 4) ? 0 : (r < 6) ? 1 : (uint8_t)rng();
+        }
+
+        std::vector<uvgrtp::formats::nal_info> serial;
+        std::vector<uvgrtp::formats::nal_info> parallel;
+
+        format_26x.set_parallel_scl_threshold(0);
+        format_26x.find_nal_units(data.data(), len, serial);
+
+        /* split even the smallest frames so that the chunk boundaries hit every kind of prefix */
+        format_26x.set_parallel_scl_threshold(1);
+        format_26x.find_nal_units(data.data(), len, parallel);
+
+        ASSERT_EQ(serial.size(), parallel.size()) << "length " << len;
+
+        for (size_t i = 0; i < serial.size(); ++i) {
+            ASSERT_EQ(serial[i].offset, parallel[i].offset) << "length " << len;
+            ASSERT_EQ(serial[i].prefix_len, parallel[i].prefix_len) << "length " << len << ", offset " << serial[i].offset;
+        }
+    }
+}
+
+static uvgrtp::frame::rtp_frame* create_h265_fu(uint32_t ts, uint16_t seq, bool start, bool end, size_t payload_len)
+{
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(3 + payload_len);
+
+    frame->header.timestamp = ts;
+    frame->header.seq = seq;
+
+    frame->payload[0] = 49 << 1; // FU
+    frame->payload[1] = 1;
+    frame->payload[2] = (start ? 0x80 : 0) | (end ? 0x40 : 0) | 1; // TRAIL_R
+    memset(frame->payload + 3, (uint8_t)seq, payload_len);
+
+    return frame;
+}
+
+static rtp_error_t handle_fu(uvgrtp::formats::h265& format, uvgrtp::frame::rtp_frame* frame, uvgrtp::frame::rtp_frame** out)
+{
+    *out = frame;
+    return format.packet_handler(nullptr, RCE_NO_FLAGS, nullptr, 0, out);
+}
+
+TEST(FormatTests, h265_fragment_reassembly) {
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto rtp_ = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H265, std::make_shared<std::atomic<std::uint32_t>>(1), false);
+    auto format_26x = uvgrtp::formats::h265(socket_, rtp_, 0);
+
+    const size_t FU_PAYLOAD = 100;
+    uvgrtp::frame::rtp_frame* out = nullptr;
+
+    /* out of order with a duplicate, seqs 10 - 14 */
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 10, true, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 12, false, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 11, false, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_GENERIC_ERROR, handle_fu(format_26x, create_h265_fu(1000, 12, false, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 14, false, true, FU_PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_fu(format_26x, create_h265_fu(1000, 13, false, false, FU_PAYLOAD), &out));
+
+    /* start code, NAL unit header and the fragments in sequence number order */
+    ASSERT_EQ(4 + 2 + 5 * FU_PAYLOAD, out->payload_len);
+    EXPECT_EQ(1, out->payload[3]);
+    EXPECT_EQ(1, (out->payload[4] >> 1) & 0x3f);
+
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_EQ(10 + i, out->payload[6 + i * FU_PAYLOAD]);
+    }
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* the middle fragment is lost so the NAL unit is never completed */
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 15, true, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 17, false, true, FU_PAYLOAD), &out));
+
+    /* end fragment before the start fragment */
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 19, false, true, FU_PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_fu(format_26x, create_h265_fu(1000, 18, true, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(4 + 2 + 2 * FU_PAYLOAD, out->payload_len);
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* larger than the previous NAL units and in reverse order after the start fragment */
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 20, true, false, FU_PAYLOAD), &out));
+    for (uint16_t seq = 39; seq > 21; --seq) {
+        EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, seq, false, seq == 39, FU_PAYLOAD), &out));
+    }
+    ASSERT_EQ(RTP_PKT_READY, handle_fu(format_26x, create_h265_fu(1000, 21, false, false, FU_PAYLOAD), &out));
+    ASSERT_EQ(4 + 2 + 20 * FU_PAYLOAD, out->payload_len);
+
+    for (size_t i = 0; i < 20; ++i) {
+        EXPECT_EQ(20 + i, out->payload[6 + i * FU_PAYLOAD]);
+        EXPECT_EQ(20 + i, out->payload[6 + i * FU_PAYLOAD + FU_PAYLOAD - 1]);
+    }
+    (void)uvgrtp::frame::dealloc_frame(out);
+}
+
+TEST(FormatTests, h265_nal_chunks) {
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto rtp_ = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H265, std::make_shared<std::atomic<std::uint32_t>>(1), false);
+    auto format_26x = uvgrtp::formats::h265(socket_, rtp_, 0);
+
+    const size_t FU_PAYLOAD = 100;
+    uvgrtp::frame::rtp_frame* out = nullptr;
+
+    std::vector<uvgrtp::frame::nal_chunk> chunks;
+    std::map<uint16_t, std::vector<uint8_t>> received;
+
+    EXPECT_EQ(RTP_OK, format_26x.install_nal_chunk_hook([&](const uvgrtp::frame::nal_chunk& chunk) {
+        EXPECT_EQ(received[chunk.seq].size(), chunk.offset);
+        received[chunk.seq].insert(received[chunk.seq].end(), chunk.data, chunk.data + chunk.len);
+        chunks.push_back(chunk);
+    }));
+    format_26x.set_nal_chunk_size(250);
+
+    /* the first chunk is given once 250 bytes have been received in order, the rest when the NAL unit is complete */
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 10, true, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 12, false, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(0u, chunks.size());
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 11, false, false, FU_PAYLOAD), &out));
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_EQ(RTP_NAL_CHUNK_PARTIAL, chunks[0].state);
+    EXPECT_EQ(4 + 2 + 3 * FU_PAYLOAD, chunks[0].len);
+
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 13, false, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(1u, chunks.size());
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(1000, 14, false, true, FU_PAYLOAD), &out));
+    ASSERT_EQ(2u, chunks.size());
+    EXPECT_EQ(RTP_NAL_CHUNK_COMPLETE, chunks[1].state);
+    EXPECT_EQ(1000u, chunks[1].timestamp);
+    EXPECT_EQ(10, chunks[1].seq);
+
+    /* start code, NAL unit header and the fragments in sequence number order */
+    auto& nal = received[10];
+    ASSERT_EQ(4 + 2 + 5 * FU_PAYLOAD, nal.size());
+    EXPECT_EQ(1, nal[3]);
+    EXPECT_EQ(1, (nal[4] >> 1) & 0x3f);
+
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_EQ(10 + i, nal[6 + i * FU_PAYLOAD]);
+    }
+
+    /* the rest of the NAL unit is lost, which is told once garbage collection drops it */
+    chunks.clear();
+    format_26x.set_nal_chunk_size(0);
+    rtp_->set_pkt_max_delay(10);
+
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(2000, 15, true, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(2000, 16, false, false, FU_PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(2000, 18, false, true, FU_PAYLOAD), &out));
+    EXPECT_EQ(2u, chunks.size());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_EQ(RTP_OK, handle_fu(format_26x, create_h265_fu(3000, 19, true, false, FU_PAYLOAD), &out));
+
+    ASSERT_EQ(4u, chunks.size());
+    EXPECT_EQ(RTP_NAL_CHUNK_PARTIAL, chunks[2].state);
+    EXPECT_EQ(3000u, chunks[2].timestamp);
+    EXPECT_EQ(RTP_NAL_CHUNK_LOST, chunks[3].state);
+    EXPECT_EQ(2000u, chunks[3].timestamp);
+    EXPECT_EQ(0u, chunks[3].len);
+}
+
+static uvgrtp::frame::rtp_frame* create_h265_single_nal(uint32_t ts, uint16_t seq, uint8_t type, bool marker, size_t payload_len)
+{
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(2 + payload_len);
+
+    frame->header.timestamp = ts;
+    frame->header.seq = seq;
+    frame->header.marker = marker;
+
+    frame->payload[0] = type << 1;
+    frame->payload[1] = 1;
+    memset(frame->payload + 2, (uint8_t)seq, payload_len);
+
+    return frame;
+}
+
+TEST(FormatTests, h265_parameter_sets_on_join) {
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto rtp_ = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_H265, std::make_shared<std::atomic<std::uint32_t>>(1), false);
+    int flags = RCE_H26X_ACCESS_UNITS | RCE_H26X_PARAMETER_SETS | RCE_H26X_DEPENDENCY_ENFORCEMENT;
+    auto format_26x = uvgrtp::formats::h265(socket_, rtp_, flags);
+
+    uvgrtp::frame::rtp_frame* out = nullptr;
+    auto handle = [&](uvgrtp::frame::rtp_frame* frame) {
+        out = frame;
+        return format_26x.packet_handler(nullptr, flags, nullptr, 0, &out);
+    };
+
+    /* the receiver joins at an inter picture, which is dropped together with its parameter sets */
+    EXPECT_EQ(RTP_OK, handle(create_h265_single_nal(1000, 10, 32, false, 10)));
+    EXPECT_EQ(RTP_OK, handle(create_h265_single_nal(1000, 11, 33, false, 20)));
+    EXPECT_EQ(RTP_OK, handle(create_h265_single_nal(1000, 12, 34, false, 30)));
+    EXPECT_EQ(RTP_OK, handle(create_h265_fu(1000, 13, true, false, 100)));
+    EXPECT_EQ(RTP_GENERIC_ERROR, handle(create_h265_fu(1000, 14, false, true, 100)));
+
+    /* the first intra picture gets the parameter sets it needs */
+    ASSERT_EQ(RTP_PKT_READY, handle(create_h265_single_nal(2000, 15, 19, true, 40)));
+    ASSERT_EQ(4u, out->nal_count);
+
+    std::vector<uint8_t> types = { 32, 33, 34, 19 };
+    std::vector<size_t> lens = { 12, 22, 32, 42 };
+
+    for (size_t i = 0; i < out->nal_count; ++i) {
+        EXPECT_EQ(types[i], (out->payload[out->nals[i].offset] >> 1) & 0x3f);
+        EXPECT_EQ(lens[i], out->nals[i].len);
+    }
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* only the first intra picture is completed */
+    ASSERT_EQ(RTP_PKT_READY, handle(create_h265_single_nal(3000, 16, 19, true, 40)));
+    EXPECT_EQ(1u, out->nal_count);
+    (void)uvgrtp::frame::dealloc_frame(out);
+}
+
+static uvgrtp::frame::rtp_frame* create_generic_fragment(uint32_t ts, uint16_t seq, bool marker, size_t payload_len)
+{
+    uvgrtp::frame::rtp_frame* frame = uvgrtp::frame::alloc_rtp_frame(payload_len);
+
+    frame->header.timestamp = ts;
+    frame->header.seq = seq;
+    frame->header.marker = marker;
+    memset(frame->payload, (uint8_t)seq, payload_len);
+
+    return frame;
+}
+
+static rtp_error_t handle_generic(uvgrtp::formats::media& format, uvgrtp::frame::rtp_frame* frame, uvgrtp::frame::rtp_frame** out)
+{
+    *out = frame;
+    return format.packet_handler(nullptr, RCE_FRAGMENT_GENERIC, nullptr, 0, out);
+}
+
+TEST(FormatTests, generic_fragment_reassembly) {
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto rtp_ = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC, std::make_shared<std::atomic<std::uint32_t>>(1), false);
+    auto format = uvgrtp::formats::media(socket_, rtp_, RCE_FRAGMENT_GENERIC);
+
+    const size_t PAYLOAD = 100;
+    uvgrtp::frame::rtp_frame* out = nullptr;
+
+    /* the first packet starts the first frame, seqs 100 - 102 */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(1000, 100, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(1000, 102, true, PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(1000, 101, false, PAYLOAD), &out));
+    ASSERT_EQ(3 * PAYLOAD, out->payload_len);
+    EXPECT_EQ(102, out->header.seq);
+    EXPECT_EQ(1, out->header.marker);
+
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(100 + i, out->payload[i * PAYLOAD]);
+    }
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* the start of a frame is found from the end of the previous frame, seqs 103 - 105 */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(2000, 104, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(2000, 105, true, PAYLOAD), &out));
+    EXPECT_EQ(RTP_GENERIC_ERROR, handle_generic(format, create_generic_fragment(2000, 105, true, PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(2000, 103, false, PAYLOAD), &out));
+    ASSERT_EQ(3 * PAYLOAD, out->payload_len);
+    EXPECT_EQ(103, out->payload[0]);
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* the last packet of a frame completes the frame after it too, seqs 106 - 109 */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(4000, 108, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(4000, 109, true, PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(3000, 107, true, PAYLOAD), &out));
+    EXPECT_EQ(4000u, out->header.timestamp);
+    EXPECT_EQ(108, out->payload[0]);
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(3000, 106, false, PAYLOAD), &out));
+    EXPECT_EQ(3000u, out->header.timestamp);
+    EXPECT_EQ(2 * PAYLOAD, out->payload_len);
+    (void)uvgrtp::frame::dealloc_frame(out);
+    EXPECT_EQ(RTP_NOT_FOUND, format.frame_getter(&out));
+
+    /* a frame with a lost packet is dropped after RCC_PKT_MAX_DELAY, seqs 110 - 112 */
+    rtp_->set_pkt_max_delay(50);
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(5000, 110, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(5000, 112, true, PAYLOAD), &out));
+    EXPECT_EQ(0u, format.get_lost_frames());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+
+    /* a single packet frame */
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(6000, 113, true, PAYLOAD), &out));
+    EXPECT_EQ(PAYLOAD, out->payload_len);
+    (void)uvgrtp::frame::dealloc_frame(out);
+    EXPECT_EQ(1u, format.get_lost_frames());
+
+    /* the lost packet arrives too late to complete the frame */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(5000, 111, false, PAYLOAD), &out));
+}
+
+TEST(FormatTests, generic_fragment_lost_end) {
+    auto socket_ = std::shared_ptr<uvgrtp::socket>(new uvgrtp::socket(0));
+    auto rtp_ = std::make_shared<uvgrtp::rtp>(RTP_FORMAT_GENERIC, std::make_shared<std::atomic<std::uint32_t>>(1), false);
+    auto format = uvgrtp::formats::media(socket_, rtp_, RCE_FRAGMENT_GENERIC);
+
+    const size_t PAYLOAD = 100;
+    uvgrtp::frame::rtp_frame* out = nullptr;
+
+    rtp_->set_pkt_max_delay(200);
+
+    /* the end of a frame is lost, seqs 200 - 202, and the frame after it is delivered right away, seqs 203 - 204 */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(1000, 200, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(1000, 201, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(2000, 203, false, PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(2000, 204, true, PAYLOAD), &out));
+    EXPECT_EQ(2000u, out->header.timestamp);
+    EXPECT_EQ(2 * PAYLOAD, out->payload_len);
+    EXPECT_EQ(203, out->payload[0]);
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* the end of the frame is also found when the packet after the lost end arrives first, seqs 205 - 209 */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(3000, 205, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(4000, 208, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(4000, 209, true, PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(3000, 206, false, PAYLOAD), &out));
+    EXPECT_EQ(4000u, out->header.timestamp);
+    EXPECT_EQ(208, out->payload[0]);
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* when more than one packet is lost, the next frame waits until the frame before it is dropped, seqs 210 - 215 */
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(5000, 210, false, PAYLOAD), &out));
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(5000, 211, false, PAYLOAD), &out));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    EXPECT_EQ(RTP_OK, handle_generic(format, create_generic_fragment(6000, 214, false, PAYLOAD), &out));
+    ASSERT_EQ(RTP_PKT_READY, handle_generic(format, create_generic_fragment(6000, 215, true, PAYLOAD), &out));
+    EXPECT_EQ(6000u, out->header.timestamp);
+    EXPECT_EQ(2 * PAYLOAD, out->payload_len);
+    EXPECT_EQ(214, out->payload[0]);
+    (void)uvgrtp::frame::dealloc_frame(out);
+
+    /* the frames whose ends were lost */
+    EXPECT_EQ(3u, format.get_lost_frames());
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../src/header_extensions.hh"
+#include "../src/transport_cc.hh"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/* Emulation of a bottleneck link with a drop-tail queue for transport-wide congestion control.
+ * The sender starts at "start_kbps" and sends at whatever rate the congestion controller allows.
+ * The emulation runs in virtual time so the result does not depend on the load of the machine */
+struct twcc_link {
+    int64_t capacity_bps   = 1000 * 1000;
+    int64_t propagation_us = 20 * 1000;
+    int64_t queue_limit_us = 300 * 1000;
+    size_t  packet_size    = 1200;
+    int64_t duration_us    = 30 * 1000 * 1000;
+    ssize_t start_kbps     = 2 * 1000;
+};
+
+struct twcc_link_result {
+    int64_t converged_us   = -1;     /* first time the target is below 1.2x capacity */
+    double average_target  = 0;      /* bps, over the second half of the run */
+    double average_delay   = 0;      /* queueing delay in ms, over the second half of the run */
+    size_t sent            = 0;
+    size_t dropped         = 0;
+    size_t feedback_errors = 0;
+    bool hook_matches      = false;  /* the target bitrate hook saw the final target */
+};
+
+inline twcc_link_result run_twcc_link_emulation(const twcc_link& link)
+{
+    constexpr int64_t STEP_US = 1000;
+
+    auto ext = std::shared_ptr<uvgrtp::header_extensions>(new uvgrtp::header_extensions());
+    uvgrtp::transport_cc sender(ext);
+    uvgrtp::transport_cc receiver(ext);
+    twcc_link_result result;
+
+    (void)sender.set_start_bitrate(link.start_kbps);
+
+    uint32_t hook_target = 0;
+    sender.install_target_bitrate_hook([&hook_target](uint32_t bps) { hook_target = bps; });
+
+    std::deque<std::pair<int64_t, uint16_t>> in_flight;                  /* arrival time, sequence number */
+    std::deque<std::pair<int64_t, std::vector<uint8_t>>> feedback;       /* delivery time, RTCP packet */
+    std::vector<uint8_t> buffer(uvgrtp::TWCC_MAX_FEEDBACK_SIZE);
+
+    int64_t next_send    = 0;
+    int64_t link_free    = 0;
+    uint16_t seq         = 0;
+
+    double delay_sum     = 0;
+    size_t delay_count   = 0;
+    double target_sum    = 0;
+    size_t target_count  = 0;
+
+    for (int64_t now = 0; now < link.duration_us; now += STEP_US) {
+        /* send at the target bitrate of the congestion controller */
+        while (next_send <= now) {
+            int64_t serialization = link.packet_size * 8 * 1000000 / link.capacity_bps;
+            int64_t start         = std::max(next_send, link_free);
+
+            sender.packet_sent(seq, link.packet_size, next_send);
+            ++result.sent;
+
+            if (start - next_send > link.queue_limit_us) {
+                ++result.dropped;
+            } else {
+                link_free = start + serialization;
+                in_flight.push_back({ link_free + link.propagation_us, seq });
+
+                if (next_send > link.duration_us / 2) {
+                    delay_sum += (double)(start - next_send);
+                    ++delay_count;
+                }
+            }
+
+            ++seq;
+            next_send += link.packet_size * 8 * 1000000 / sender.get_target_bitrate();
+        }
+
+        /* the receiver records arrivals and sends feedback back over the same path */
+        while (!in_flight.empty() && in_flight.front().first <= now) {
+            if (receiver.packet_received(in_flight.front().second, in_flight.front().first)) {
+                size_t size = receiver.create_feedback(buffer.data(), 1, 2);
+
+                if (size)
+                    feedback.push_back({ now + link.propagation_us, std::vector<uint8_t>(buffer.begin(), buffer.begin() + size) });
+            }
+            in_flight.pop_front();
+        }
+
+        while (!feedback.empty() && feedback.front().first <= now) {
+            auto& packet = feedback.front().second;
+
+            /* skip the RTCP header and the SSRCs, see RFC 4585 section 6.1 */
+            if (sender.handle_feedback(packet.data() + 12, packet.size() - 12, now) != RTP_OK)
+                ++result.feedback_errors;
+
+            feedback.pop_front();
+        }
+
+        uint32_t target = sender.get_target_bitrate();
+
+        if (result.converged_us < 0 && target < 1.2 * link.capacity_bps)
+            result.converged_us = now;
+
+        if (now > link.duration_us / 2) {
+            target_sum += target;
+            ++target_count;
+        }
+    }
+
+    result.average_target = target_count ? target_sum / target_count : 0;
+    result.average_delay  = delay_count ? delay_sum / delay_count / 1000 : 0;
+    result.hook_matches   = hook_target == sender.get_target_bitrate();
+
+    return result;
+}